@@ -440,12 +440,19 @@ extern "C" {
  */
 
 enum {
-    /// Maximum supported state nesting levels in a hierarchical state machine 
+    /// @deprecated State nesting depth is no longer limited; entry
+    ///             paths longer than FSM_CONFIG_ENTRY_PATH_CAPACITY
+    ///             are entered in several passes.  Retained for
+    ///             source compatibility only.
     kFsmMaxStateNestingDepth = 10
 };
 
 /**
- * A Finite State Machine
+ * A state in a state machine
+ * 
+ * The opaque fields mirror the kinds of SME's internal fields
+ * (pointers, then packed 16-bit fields), so that the structure
+ * has no padding on either ILP32 or LP64 targets.
  * 
  * @note WARNING: Changing the size or alignment of this
  *       structure will break binary API compatibility.
@@ -454,11 +461,19 @@ enum {
  *       only and off-limits to users of the API
  */
 typedef struct {
-    void*                   opaque_[22];
-} FsmMachine;
+    void*                   opaque_[6];
+    unsigned short          opaqueFields_[8];
+    void*                   opaqueCold_[2];
+} FsmState;
 
 /**
- * A state in a state machine
+ * A Finite State Machine
+ * 
+ * The engine's runtime data that event dispatch and state
+ * transitions use fits in the first 64 bytes of the structure,
+ * i.e., in one cache line if you place the structure on a 64-byte
+ * boundary; the state entry path of a transition is kept on the stack, and
+ * the logging configuration in the cold tail of the structure.
  * 
  * @note WARNING: Changing the size or alignment of this
  *       structure will break binary API compatibility.
@@ -466,9 +481,111 @@ typedef struct {
  * @note All fields ending in underscore are for internal use
  *       only and off-limits to users of the API
  */
+typedef struct {
+    void*                   opaque_[9];
+    FsmState                opaqueRoot_;
+    void*                   opaqueTail_[6];
+} FsmMachine;
+
+/**
+ * Storage for one state of a sealed state machine: its compact
+ * record, and its name, which SME keeps in a separate array; @see
+ * FsmSealMachine()
+ *
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API
+ */
+typedef struct {
+    void*                   opaque_[6];
+    unsigned short          opaqueFields_[8];
+    void*                   opaqueName_;
+} FsmSealedState;
+
+/**
+ * Number of FsmSealedState elements needed by FsmSealMachine()
+ * to seal a state machine with the given number of user states
+ * (one extra element holds the root state).
+ */
+#define FSM_SEALED_STATE_COUNT(numUserStates__) ((numUserStates__) + 1)
+
+/**
+ * Maximum number of user states in a state machine: states are
+ * numbered with 16-bit ids, and the root state takes one of them
+ * (@see FsmInsertState()).
+ */
+#define FSM_MAX_USER_STATES 65534
+
+/**
+ * A cached transition plan; @see FsmAttachTransitionCache()
+ *
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API
+ */
 typedef struct {
     void*                   opaque_[3];
-} FsmState;
+} FsmTransitionPlan;
+
+/**
+ * Transition plan cache of a state machine; @see
+ * FsmAttachTransitionCache()
+ *
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API
+ */
+typedef struct {
+    void*                   opaque_[4];
+} FsmTransitionCache;
+
+/**
+ * Byte-stream DFA of a state machine; @see FsmCompileByteDfa()
+ *
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API
+ */
+typedef struct {
+    void*                   opaque_[4];
+} FsmByteDfa;
+
+/**
+ * Storage for one cell of a byte-stream DFA table; @see
+ * FsmCompileByteDfa()
+ *
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API
+ */
+typedef struct {
+    void*                   opaque_[2];
+} FsmByteDfaCell;
+
+/**
+ * A state machine definition shared by any number of instances;
+ * @see FsmInitDefinition()
+ *
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API
+ */
+typedef struct {
+    void*                   opaque_[2];
+} FsmDefinition;
+
+/**
+ * A lightweight instance of a state machine definition: the
+ * runtime data of an FsmMachine, without the topology; @see
+ * FsmInitInstance()
+ *
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API
+ */
+typedef struct {
+    void*                   opaque_[11];
+} FsmInstance;
+
+/**
+ * Returns the FsmMachine pointer by which the given instance is
+ * passed to the runtime API (FsmStart(), FsmDispatchEvent(),
+ * etc.), and to state handlers; @see FsmInitInstance()
+ */
+#define FSM_INSTANCE_MACHINE(pInstance__)   ((FsmMachine*)(pInstance__))
 
 
 /// Reserved event identifiers
@@ -515,11 +632,54 @@ typedef enum {
 /// Event identifier type
 typedef int FsmEventIdType;
 
+
+/// State capability flags.  Multiple flags may be bitwise OR'ed
+/// together.
+/// 
+/// @note Used as argument for FsmInitStateEx().
+enum FsmStateFlags {
+    /// The state's handler ignores kFsmEventEnterScope; SME won't
+    /// deliver it
+    kFsmStateFlagNoEntry        = 0x01,
+
+    /// The state's handler ignores kFsmEventExitScope; SME won't
+    /// deliver it
+    kFsmStateFlagNoExit         = 0x02,
+
+    /// The state's handler never makes an initial transition; SME
+    /// won't deliver kFsmEventBegin to it
+    kFsmStateFlagNoBegin        = 0x04,
+
+    /// Convenience combination for pass-through (grouping) states
+    /// that have no entry, exit or initial transition behavior
+    kFsmStateFlagPassThrough    = 0x07,
+
+    /// For internal use only: SME flags the state records of sealed
+    /// topologies, whose names are kept apart from the records
+    kFsmStateFlagSealedRecord_  = 0x8000,
+
+    /// For internal use only: the state records of constant
+    /// topologies, which may live in read-only memory, are flagged
+    /// so that SME never writes to them
+    kFsmStateFlagReadOnlyRecord_ = 0x4000
+};
+
 /// Base event structure
 typedef struct {
     FsmEventIdType evtId;    ///< FsmEventId or user-defined event id
 } FsmEvent;
 
+/**
+ * Event that FsmFeedBytes() dispatches for an input byte: evtId
+ * is the byte class's event id (@see FsmCompileByteDfa()), so
+ * handlers, guards and actions may cast the event to
+ * FsmByteEvent when its id is in the byte class range.
+ */
+typedef struct {
+    FsmEvent        evt;     ///< MUST be first member
+    unsigned char   byte;    ///< the input byte
+} FsmByteEvent;
+
 
 
 /**
@@ -544,6 +704,248 @@ typedef int FsmStateHandlerFnType(FsmState* pState,
                                   FsmMachine* pFsm,
                                   const FsmEvent* pEvt);
 
+/**
+ * Guard condition callback function type of a declarative
+ * transition; @see FsmDeclareStateTransitions().
+ * 
+ * @param pState Non-NULL pointer to the state that declared the
+ *               transition.
+ * @param pFsm Non-NULL pointer to the state's state machine.
+ * @param pEvt Non-NULL pointer to the event structure
+ * 
+ * @return int true (non-zero) if the transition should be taken;
+ *         false (zero) otherwise.
+ * 
+ * @note A guard MUST NOT have side-effects on the state machine
+ *       (i.e., don't call FsmBeginTransition() from it).
+ */
+typedef int FsmTransitionGuardFnType(FsmState* pState,
+                                     FsmMachine* pFsm,
+                                     const FsmEvent* pEvt);
+
+/**
+ * Action callback function type of a declarative transition;
+ * @see FsmDeclareStateTransitions().
+ * 
+ * Called after the source state configuration has been exited
+ * and before the target state configuration is entered, per UML
+ * transition ordering.
+ * 
+ * @param pState Non-NULL pointer to the state that declared the
+ *               transition.
+ * @param pFsm Non-NULL pointer to the state's state machine.
+ * @param pEvt Non-NULL pointer to the event structure
+ * 
+ * @note Do NOT call FsmBeginTransition() from an action.
+ */
+typedef void FsmTransitionActionFnType(FsmState* pState,
+                                       FsmMachine* pFsm,
+                                       const FsmEvent* pEvt);
+
+/**
+ * A declarative state transition; @see
+ * FsmDeclareStateTransitions().
+ */
+typedef struct {
+    FsmEventIdType              evtId;      ///< triggering user event id
+    FsmState*                   pTarget;    ///< Non-NULL target state
+    FsmTransitionGuardFnType*   pGuard;     ///< optional; NULL if none
+    FsmTransitionActionFnType*  pAction;    ///< optional; NULL if none
+} FsmTransitionDef;
+
+/**
+ * A state's record for the bulk topology builder; @see
+ * FsmBuildStates().
+ */
+typedef struct {
+    FsmStateHandlerFnType*      pHandler;   ///< Non-NULL state handler
+    const char*                 pName;      ///< @see FsmInitState()
+    int                         parent;     ///< parent's record index; -1
+                                            ///  for a top super-state
+    unsigned int                flags;      ///< @see FsmInitStateEx()
+} FsmStateRecord;
+
+/**
+ * A state record of a constant state machine topology; @see
+ * FSM_CONST_TOPOLOGY().
+ *
+ * Unlike SME's other structures, the layout of this one is public
+ * (it mirrors SME's internal state record), so that topologies
+ * can be constant-initialized.
+ *
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API: initialize the
+ *       records via FSM_CONST_ROOT_STATE(), FSM_CONST_STATE() and
+ *       FSM_CONST_STATE_EX() only.
+ */
+typedef struct FsmConstState_tag {
+    FsmStateHandlerFnType*          pHandler_;
+    FsmState*                       pUser_;
+    const struct FsmConstState_tag* pParent_;
+    const struct FsmConstState_tag* pInitial_;
+    const FsmEventIdType*           pEventIds_;
+    const FsmTransitionDef*         pTransitions_;
+    unsigned short                  depth_;
+    unsigned short                  id_;
+    unsigned short                  flags_;
+    unsigned short                  walkParentId_;
+    unsigned short                  preOrder_;
+    unsigned short                  lastOrder_;
+    unsigned short                  numEventIds_;
+    unsigned short                  numTransitions_;
+} FsmConstState;
+
+/**
+ * Type of a constant state machine topology with the given number
+ * of user states: the topology of a sealed state machine (@see
+ * FsmSealMachine()) as constant-initialized data, which the
+ * engine runs on directly (@see FsmInitConstDefinition()).  A
+ * const topology with static storage duration costs nothing at
+ * startup, and lives in read-only memory.
+ *
+ * The state records are listed in pre-order (each state precedes
+ * its descendants, and a state's descendants are listed
+ * contiguously), starting with the root state; a state's id is
+ * its index.  Their user state objects, which state handlers
+ * receive and which transitions target, are the records
+ * themselves (@see FSM_CONST_USER_STATE()); the second array
+ * holds the states' names by id (@see FsmInitState()), the FSM's
+ * name first.
+ *
+ * Example (a state machine with a "parent" state that has two
+ * substates, "on" and "off", and an initial substate):
+ *
+ * typedef FSM_CONST_TOPOLOGY(3) MyTopology;
+ *
+ * extern const MyTopology kMyTopology;
+ *
+ * static const FsmTransitionDef kParentTransitions[] = {
+ *     {kMyEvtIdReset, FSM_CONST_USER_STATE(kMyTopology, 3), NULL, NULL}
+ * };
+ *
+ * const MyTopology kMyTopology = {
+ *     {
+ *         FSM_CONST_ROOT_STATE(kMyTopology),
+ *         FSM_CONST_STATE_EX(kMyTopology, 1, &ParentHandler, 0, 0, 1, 3,
+ *                            0, 3, NULL, 0, kParentTransitions, 1),
+ *         FSM_CONST_STATE(kMyTopology, 2, &OnHandler, 1, 2, 2),
+ *         FSM_CONST_STATE(kMyTopology, 3, &OffHandler, 1, 2, 3)
+ *     },
+ *     {"MyFsm", "parent", "on", "off"}
+ * };
+ *
+ * (the forward declaration is needed only if transitions target
+ * the topology's states; otherwise, a single "static const
+ * FSM_CONST_TOPOLOGY(3) kMyTopology = {...};" will do).
+ *
+ * @note The layout is compatible with C and C++: use the same
+ *       macros from PalmFsm.hpp (@see pmfsm::ConstDefinition).
+ */
+#define FSM_CONST_TOPOLOGY(numUserStates__)                                 \
+    struct {                                                                \
+        FsmConstState           aStates_[(numUserStates__) + 1];            \
+        const char*             apStateNames_[(numUserStates__) + 1];       \
+    }
+
+/**
+ * Number of user states of the given constant topology
+ */
+#define FSM_CONST_NUM_STATES(topology__)                                    \
+    (sizeof((topology__).aStates_) / sizeof((topology__).aStates_[0]) - 1)
+
+/**
+ * The user state object of the state with the given id in the
+ * given constant topology
+ */
+#define FSM_CONST_USER_STATE(topology__, id__)                              \
+    ((FsmState*)&(topology__).aStates_[id__])
+
+/**
+ * Initializer of the root state record (id 0) of the given
+ * constant topology.
+ *
+ * @param topology__ The constant topology being initialized.
+ */
+#define FSM_CONST_ROOT_STATE(topology__)                                    \
+    {&FsmRootStateHandler, FSM_CONST_USER_STATE(topology__, 0), NULL, NULL, \
+     NULL, NULL, 0, 0,                                                      \
+     kFsmStateFlagSealedRecord_ | kFsmStateFlagReadOnlyRecord_, 0, 0,       \
+     FSM_CONST_NUM_STATES(topology__), 0, 0}
+
+/**
+ * Initializer of the record of a user state of the given constant
+ * topology that declares no event subscription set, transitions,
+ * initial substate or flags.
+ *
+ * @param topology__ The constant topology being initialized.
+ * @param id__ The state's id: its index in the topology.
+ * @param pHandler__ Non-NULL state handler.
+ * @param parentId__ The parent state's id; 0 for a top-level state.
+ * @param depth__ The state's depth: 1 for a top-level state, and
+ *                so forth.
+ * @param lastId__ The id of the state's last descendant (in
+ *                 pre-order); id__ if the state has no substates.
+ */
+#define FSM_CONST_STATE(topology__, id__, pHandler__, parentId__, depth__,  \
+                        lastId__)                                           \
+    FSM_CONST_STATE_EX(topology__, id__, pHandler__, parentId__, parentId__,\
+                       depth__, lastId__, 0, 0, NULL, 0, NULL, 0)
+
+/**
+ * Initializer of the record of a user state of the given constant
+ * topology.
+ *
+ * Same as FSM_CONST_STATE(), plus:
+ *
+ * @param walkParentId__ The id of the state's nearest proper
+ *                       ancestor that isn't flagged with
+ *                       kFsmStateFlagPassThrough (0 for the root
+ *                       state); same as parentId__ if the parent
+ *                       isn't a pass-through state.
+ * @param flags__ enum FsmStateFlags; @see FsmInitStateEx().
+ * @param initialId__ The id of the state's initial substate (@see
+ *                    FsmSetInitialSubstate()), which MUST itself
+ *                    not declare one: name the innermost state of
+ *                    the chain of initial substates; 0 if none.
+ * @param aEventIds__ The state's sorted event subscription set
+ *                    (@see FsmDeclareStateEvents()); NULL if none.
+ * @param numEventIds__ Number of elements in aEventIds__.
+ * @param aTransitions__ The state's declarative transitions,
+ *                       sorted by event id (@see
+ *                       FsmDeclareStateTransitions()); NULL if none.
+ * @param numTransitions__ Number of elements in aTransitions__.
+ */
+#define FSM_CONST_STATE_EX(topology__, id__, pHandler__, parentId__,         \
+                           walkParentId__, depth__, lastId__, flags__,      \
+                           initialId__, aEventIds__, numEventIds__,         \
+                           aTransitions__, numTransitions__)                \
+    {(pHandler__), FSM_CONST_USER_STATE(topology__, id__),                  \
+     &(topology__).aStates_[parentId__],                                    \
+     (initialId__) ? &(topology__).aStates_[initialId__] : NULL,            \
+     (aEventIds__), (aTransitions__), (depth__), (id__),                    \
+     (flags__) | kFsmStateFlagSealedRecord_ | kFsmStateFlagReadOnlyRecord_, \
+     (walkParentId__), (id__),                                              \
+     (lastId__), (numEventIds__), (numTransitions__)}
+
+/**
+ * Initializes the given definition from the given constant
+ * topology; @see FsmInitConstDefinition()
+ */
+#define FSM_INIT_CONST_DEFINITION(pDef__, topology__)                       \
+    FsmInitConstDefinition((pDef__), (topology__).aStates_,                 \
+                           FSM_CONST_NUM_STATES(topology__))
+
+
+/**
+ * Linkage of the SME API functions: external by default; the
+ * header-only engine (@see PalmFsmHeaderOnly.h) redefines it to
+ * compile the API into the user's translation unit.
+ */
+#ifndef FSM_API
+    #define FSM_API
+#endif
+
+
 /**
  * Initializes an FSM instance
  * 
@@ -554,7 +956,7 @@ typedef int FsmStateHandlerFnType(FsmState* pState,
  *              string).  The names "FSM" and "UNNAMED-FSM" are
  *              reserved.
  */
-void
+FSM_API void
 FsmInitMachine(FsmMachine* pFsm, const char* pName);
 
 
@@ -570,10 +972,37 @@ FsmInitMachine(FsmMachine* pFsm, const char* pName);
  *              the string).  The names "ROOT" and
  *              "UNNAMED-STATE" are reserved.
  */
-void
+FSM_API void
 FsmInitState(FsmState* pState, FsmStateHandlerFnType* pStateHandlerCbFunc,
              const char* pName);
 
+/**
+ * Initializes an FSM state instance with the given capability
+ * flags.
+ * 
+ * Same as FsmInitState(), but also declares which of the
+ * reserved events the state's handler ignores, so that SME can
+ * skip those handler calls altogether.  In a sealed state machine
+ * (@see FsmSealMachine()), the entry and exit walks of state
+ * transitions also bypass states flagged with both
+ * kFsmStateFlagNoEntry and kFsmStateFlagNoExit.
+ * 
+ * @param pState Non-NULL pointer to an instance of FsmState
+ *               structure to be initialized.
+ * @param pStateHandlerCbFunc Non-NULL state event handler
+ *                            function
+ * @param pName State name to use for logging and debugging.
+ *              FSM saves the given pointer (i.e., doesn't copy
+ *              the string).  The names "ROOT" and
+ *              "UNNAMED-STATE" are reserved.
+ * @param flags Zero or more enum FsmStateFlags constants bitwise
+ *              OR'ed together; FsmInitState() is the same as
+ *              passing zero.
+ */
+FSM_API void
+FsmInitStateEx(FsmState* pState, FsmStateHandlerFnType* pStateHandlerCbFunc,
+               const char* pName, unsigned int flags);
+
 /**
  * Inserts a state instance into an initialized state machine
  * 
@@ -582,6 +1011,11 @@ FsmInitState(FsmState* pState, FsmStateHandlerFnType* pStateHandlerCbFunc,
  * @note Do NOT insert a given state instance more than once
  *       within a given state machine instance's lifetime.
  * 
+ * @note A state machine holds at most FSM_MAX_USER_STATES
+ *       (65534) user states.  Inserting more is a fatal error,
+ *       in release builds too: it's logged, and the process is
+ *       aborted.
+ * 
  * @param pFsm Non-NULL pointer to an initialized state machine.
  * @param pState Non-NULL pointer to state being inserted. Note:
  *               It's the caller's responsibility to avoid
@@ -591,9 +1025,169 @@ FsmInitState(FsmState* pState, FsmStateHandlerFnType* pStateHandlerCbFunc,
  *                inserted into this state machine.  Note: It's
  *                the caller's responsibility to avoid cycles.
  */
-void
+FSM_API void
 FsmInsertState(FsmMachine* pFsm, FsmState* pState, FsmState* pParent);
 
+/**
+ * Initializes the given states and inserts them into an
+ * initialized state machine in bulk: the same as calling
+ * FsmInitStateEx() and FsmInsertState() for each state in array
+ * order, but in a single linear pass over the records, plus one
+ * bottom-up pass that counts each state's descendants and
+ * validates the size of the state machine.  Meant for fast
+ * startup of large (e.g., generated) state machines.
+ *
+ * Parents MUST precede their children in aRecords, which also
+ * rules out cycles.  States may also be inserted one at a time
+ * before or after this call.
+ *
+ * @note WARNING: Do NOT insert states after calling FsmStart()!
+ *
+ * @param pFsm Non-NULL pointer to an initialized state machine.
+ * @param aRecords Non-NULL array of numStates state records;
+ *                 aRecords[i] describes *apStates[i].  Handlers
+ *                 and names are saved by reference, as by
+ *                 FsmInitState(); the array itself isn't.
+ * @param apStates Non-NULL array of numStates distinct pointers
+ *                 to the states; need not be initialized.
+ * @param numStates Number of states; together with the states
+ *                  already inserted, at most FSM_MAX_USER_STATES
+ *                  (@see FsmInsertState()).
+ */
+FSM_API void
+FsmBuildStates(FsmMachine* pFsm, const FsmStateRecord aRecords[],
+               FsmState* const apStates[], unsigned int numStates);
+
+
+/**
+ * Declares the set of user-defined events that the given state's
+ * handler may handle (its event subscription set).
+ *
+ * By default, FsmDispatchEvent() calls the handler of the current
+ * state and of each of its ancestors in turn until one of them
+ * handles the event.  SME skips the handler of a state that has
+ * declared its subscription set whenever the event isn't in that
+ * set, so the event is routed straight to the first subscribing
+ * state in the active configuration; if the configuration
+ * consists solely of states that have declared their sets, and
+ * none of them subscribes to the event, the event is dropped
+ * without calling any handlers.  States that don't declare a set
+ * receive every user-defined event, as before.
+ *
+ * @note The subscription set applies only to user-defined events;
+ *       SME always delivers kFsmEventEnterScope,
+ *       kFsmEventExitScope and kFsmEventBegin.
+ *
+ * @note The array is provided by the user and MUST remain valid
+ *       (and unmodified) for the lifetime of the state machine;
+ *       SME doesn't copy it.
+ *
+ * @note WARNING: Declare the set after FsmInitState() and before
+ *       FsmSealMachine() and FsmStart(); do NOT call this
+ *       function from a state event handler.
+ *
+ * @param pState Non-NULL pointer to a state initialized via
+ *               FsmInitState().
+ * @param pSortedEventIds Pointer to an array of numEventIds
+ *                        distinct user-defined event ids in
+ *                        ascending order; may be NULL only if
+ *                        numEventIds is zero, in which case the
+ *                        state doesn't handle any user-defined
+ *                        events.
+ * @param numEventIds Number of elements in pSortedEventIds; MUST
+ *                    be less than 65536.
+ */
+FSM_API void
+FsmDeclareStateEvents(FsmState* pState, const FsmEventIdType* pSortedEventIds,
+                      unsigned int numEventIds);
+
+
+/**
+ * Declares static transitions triggered by user-defined events
+ * in the given state, so that SME can take them without calling
+ * the state's handler.
+ *
+ * When FsmDispatchEvent() passes an event to a state that has
+ * declared transitions, SME first looks the event up in the
+ * state's transition table: transitions for the event are tried
+ * in array order, and the first one whose guard is either NULL
+ * or returns true is taken: SME exits the source configuration
+ * (@see FsmBeginTransition()), calls the optional action, enters
+ * the target configuration, and considers the event handled.  If
+ * the table doesn't cover the event, or none of the guards pass,
+ * SME falls back to the state's handler as usual (subject to its
+ * event subscription set; @see FsmDeclareStateEvents()).
+ *
+ * When the table's event ids are consecutive, SME indexes it
+ * directly; otherwise, it performs a binary search.
+ *
+ * A typical table replaces a handler's switch whose only job is
+ * to call FsmBeginTransition(), e.g.:
+ *
+ *   static const FsmTransitionDef kTransitions[] = {
+ *       {kSig_pressure, &fsm.s2.stateRep, NULL, NULL}
+ *   };
+ *   FsmDeclareStateTransitions(&fsm.s.stateRep, kTransitions, 1);
+ *
+ * @note The array is provided by the user and MUST remain valid
+ *       (and unmodified) for the lifetime of the state machine;
+ *       SME doesn't copy it.
+ *
+ * @note WARNING: Declare the transitions after FsmInitState() and
+ *       before FsmSealMachine() and FsmStart(); do NOT call this
+ *       function from a state event handler.
+ *
+ * @param pState Non-NULL pointer to a state initialized via
+ *               FsmInitState().
+ * @param pSortedTransitions Non-NULL pointer to an array of
+ *                           numTransitions transitions sorted
+ *                           by event id in ascending order;
+ *                           transitions of the same event are
+ *                           tried in array order.  Target states
+ *                           MUST belong to the same state machine
+ *                           as pState.
+ * @param numTransitions Number of elements in
+ *                       pSortedTransitions; MUST be non-zero and
+ *                       less than 65536.
+ */
+FSM_API void
+FsmDeclareStateTransitions(FsmState* pState,
+                           const FsmTransitionDef* pSortedTransitions,
+                           unsigned int numTransitions);
+
+
+/**
+ * Declares the default initial substate of the given composite
+ * state: a static initial transition that SME takes without
+ * delivering kFsmEventBegin to the composite state.
+ *
+ * Whenever the composite state becomes the target of a
+ * transition, SME drills down through the chain of declared
+ * initial substates (the initial substate may declare its own
+ * initial substate, and so forth) in a single step: it enters
+ * all states on the path to the innermost state of the chain,
+ * and then delivers kFsmEventBegin only to that innermost state
+ * (subject to kFsmStateFlagNoBegin; @see FsmInitStateEx()).  SME
+ * computes the innermost state of the chain once, and reuses it
+ * on subsequent entries.
+ *
+ * @note kFsmEventBegin is never delivered to a state that has
+ *       declared its initial substate.
+ *
+ * @note WARNING: Declare the initial substate after
+ *       FsmInitState() and before FsmSealMachine() and
+ *       FsmStart(); do NOT call this function from a state event
+ *       handler.
+ *
+ * @param pState Non-NULL pointer to a state initialized via
+ *               FsmInitState().
+ * @param pInitialSubstate Non-NULL pointer to a proper descendant
+ *                         (a child or the child's child, etc.) of
+ *                         pState in the same state machine.
+ */
+FSM_API void
+FsmSetInitialSubstate(FsmState* pState, FsmState* pInitialSubstate);
+
 
 /**
  * Starts FSM at the given initial state.
@@ -610,12 +1204,22 @@ FsmInsertState(FsmMachine* pFsm, FsmState* pState, FsmState* pParent);
  *       state machine that causes an unconditional transition
  *       to the "final" state.
  * 
+ * @note The topology is frozen by the first FsmStart() (or
+ *       FsmSealMachine()).  If all states are top-level states
+ *       without declared subscription sets or transitions at
+ *       that point (a flat FSM), FsmDispatchEvent() takes a fast
+ *       path that delivers each event straight to the current
+ *       state and transitions by exiting it and entering the
+ *       target; the transition cache isn't consulted in that
+ *       case, and the path isn't taken while a profile is
+ *       attached (@see FsmDbgAttachProfile()).
+ * 
  * @param pFsm Properly initialized state machine instance
  * 
  * @param pInitialState Non-NULL pointer to the initial state in
  *                      the state machine.
  */
-void
+FSM_API void
 FsmStart(FsmMachine* pFsm, FsmState* pInitialState);
 
 
@@ -680,7 +1284,7 @@ FsmStart(FsmMachine* pFsm, FsmState* pInitialState);
  *         given state or one of its parent states); false
  *         (zero) if the event was not handled.
  */
-int
+FSM_API int
 FsmDispatchEvent(FsmMachine* pFsm, const FsmEvent* pEvt);
 
 
@@ -730,10 +1334,340 @@ FsmDispatchEvent(FsmMachine* pFsm, const FsmEvent* pEvt);
  * @param pTargetState Non-NULL pointer to target of the
  *                     transition in the given state machine.
  */
-void
+FSM_API void
 FsmBeginTransition(FsmMachine* pFsm, FsmState* pTargetState);
 
 
+/**
+ * Checks whether the given state machine is currently in the
+ * given state: i.e., whether the given state is the current state
+ * or one of its ancestors.
+ * 
+ * Runs in constant time, regardless of the nesting depth: SME
+ * numbers the states of the hierarchy in pre-order when the
+ * topology is frozen by FsmStart() or FsmSealMachine(), so that
+ * each state's descendants occupy a contiguous interval of
+ * numbers.
+ * 
+ * @param pFsm Non-NULL pointer to a started state machine
+ * @param pState Non-NULL pointer to a state that has been
+ *               inserted into the given state machine.
+ * 
+ * @return int true (non-zero) if the given state is in the active
+ *         configuration; false (zero) if it isn't, or if the
+ *         state machine is in the midst of a state transition
+ *         (e.g., when called from the scope of kFsmEventEnterScope
+ *         or kFsmEventExitScope dispatch).
+ */
+FSM_API int
+FsmIsInState(FsmMachine* pFsm, const FsmState* pState);
+
+
+/**
+ * Checks whether the given state is a proper ancestor (the parent,
+ * the parent's parent, etc.) of another state of the same state
+ * machine.
+ * 
+ * Runs in constant time, regardless of the nesting depth; @see
+ * FsmIsInState().
+ * 
+ * @note Valid only after the state machine's topology has been
+ *       frozen by FsmStart() or FsmSealMachine().
+ * 
+ * @param pAncestor Non-NULL pointer to a state that has been
+ *                  inserted into a state machine.
+ * @param pDescendant Non-NULL pointer to a state that has been
+ *                    inserted into the same state machine.
+ * 
+ * @return int true (non-zero) if pAncestor is a proper ancestor
+ *         of pDescendant; false (zero) otherwise.
+ */
+FSM_API int
+FsmIsAncestor(const FsmState* pAncestor, const FsmState* pDescendant);
+
+
+/**
+ * Attaches an optional transition plan cache to the given state
+ * machine.
+ *
+ * Every regular state transition requires SME to find the
+ * state at which the exit chain of the transition stops and
+ * from which the entry chain begins (the Least Common Ancestor
+ * of Main Source and Target, or Main Source/Target itself in
+ * the case of a Local Transition).  Since the state hierarchy
+ * of a state machine doesn't change after it's been built, this
+ * result depends only on the Main Source and Target states.
+ * With a cache attached, SME computes it once per (Main Source,
+ * Target) pair and replays it in subsequent transitions.
+ *
+ * The cache is direct-mapped: when two pairs map to the same
+ * slot, the most recent one wins.  Hit/miss counters are
+ * available via FsmDbgGetTransitionCacheStats().
+ *
+ * @note Like all other SME objects, the cache storage is
+ *       provided by the user and MUST remain valid for the
+ *       lifetime of the state machine.
+ *
+ * @note WARNING: Attach the cache only after all states have
+ *       been inserted, and do NOT call this function from a
+ *       state event handler or any other callback of the given
+ *       state machine.
+ *
+ * @param pFsm Non-NULL pointer to an initialized state machine
+ *             whose states have all been inserted.
+ * @param pCache Non-NULL pointer to an instance of
+ *               FsmTransitionCache structure to be initialized.
+ * @param pPlans Non-NULL pointer to an array of numPlans
+ *               FsmTransitionPlan structures; need not be
+ *               initialized.
+ * @param numPlans Number of elements in the pPlans array; MUST
+ *                 be non-zero.
+ */
+FSM_API void
+FsmAttachTransitionCache(FsmMachine* pFsm, FsmTransitionCache* pCache,
+                         FsmTransitionPlan* pPlans, unsigned int numPlans);
+
+
+/**
+ * Seals the state hierarchy of the given state machine.
+ *
+ * Sealing freezes the topology built by FsmInsertState() and
+ * compiles it into a contiguous array of compact state records
+ * indexed by dense 16-bit state ids (the root state has id 0;
+ * apStates[i] gets id i+1).  From then on, FsmDispatchEvent(),
+ * FsmBeginTransition() and friends walk these cache-resident
+ * records instead of chasing pointers through the user's state
+ * objects, which are typically scattered across user
+ * structures.  Handlers still receive the user's state objects,
+ * and the user still passes them to the SME API, so sealing is
+ * transparent to state handler code.
+ *
+ * The order of apStates is the order of the compact records; a
+ * profile of the state machine's use can put the hot states
+ * first (@see FsmDbgOrderStatesByUsage()).
+ *
+ * @note WARNING: Seal the state machine only after all of its
+ *       states have been inserted, and before calling
+ *       FsmStart(). Do NOT insert any more states afterwards.
+ *
+ * @note The storage is provided by the user and MUST remain
+ *       valid for the lifetime of the state machine.
+ *
+ * @param pFsm Non-NULL pointer to an initialized state machine
+ *             that hasn't been started yet.
+ * @param apStates Non-NULL array of pointers to ALL of the user
+ *                 states that were inserted into the state
+ *                 machine, in any order.
+ * @param numStates Number of elements in apStates; MUST be
+ *                  non-zero and at most FSM_MAX_USER_STATES.
+ * @param pStorage Non-NULL pointer to an array of at least
+ *                 FSM_SEALED_STATE_COUNT(numStates) elements;
+ *                 need not be initialized.
+ * @param numStorageElements Number of elements in pStorage.
+ */
+FSM_API void
+FsmSealMachine(FsmMachine* pFsm, FsmState* const apStates[],
+               unsigned int numStates, FsmSealedState* pStorage,
+               unsigned int numStorageElements);
+
+
+/**
+ * Number of FsmByteDfaCell elements needed by FsmCompileByteDfa()
+ * for a state machine with the given number of user states and
+ * byte classes
+ */
+#define FSM_BYTE_DFA_CELL_COUNT(numUserStates__, numClasses__)              \
+    (((numUserStates__) + 1) * ((numClasses__) + 2))
+
+/**
+ * Compiles the given state machine into a byte-stream DFA for
+ * FsmFeedBytes().
+ *
+ * Input bytes are mapped to byte classes by aByteClasses, and
+ * byte class c is the user event classEvtBase + c.  For each
+ * state and byte class, the compiler resolves what
+ * FsmDispatchEvent() would do with the class's event by walking
+ * up from the state like the dispatcher does:
+ *
+ *  * the first declarative transition (@see
+ *    FsmDeclareStateTransitions()) of the event without a guard
+ *    is recorded in the table, and FsmFeedBytes() takes it
+ *    without calling any state handlers;
+ *  * a guarded transition, or a handler that subscribes to the
+ *    event (@see FsmDeclareStateEvents()), makes FsmFeedBytes()
+ *    dispatch the byte's event via FsmDispatchEvent();
+ *  * if neither is found, the byte is a self-loop of the state:
+ *    it has no effect, and FsmFeedBytes() skips such bytes in
+ *    bulk (using SIMD instructions where available).
+ *
+ * So, FsmFeedBytes() has the same semantics as dispatching an
+ * FsmByteEvent per byte, except that it doesn't log the bytes
+ * that are skipped.  Declare event subscription sets to let the
+ * compiler find the self-loops.
+ *
+ * @note WARNING: Compile the DFA only after all of the states
+ *       have been inserted, after sealing the state machine (if
+ *       at all), and after declaring event subscription sets and
+ *       transitions.  The topology is frozen from then on.
+ *
+ * @note The storage and the byte class map are provided by the
+ *       user and MUST remain valid for the lifetime of the state
+ *       machine.
+ *
+ * @param pFsm Non-NULL pointer to an initialized state machine.
+ * @param pDfa Non-NULL pointer to storage for the DFA; need not
+ *             be initialized.
+ * @param aByteClasses Non-NULL array of 256 byte classes, indexed
+ *                     by byte value; each MUST be less than
+ *                     numClasses.
+ * @param numClasses Number of byte classes; 1 to 256.
+ * @param classEvtBase Event id of byte class 0; MUST be a user
+ *                     event id.
+ * @param pCells Non-NULL pointer to an array of at least
+ *               FSM_BYTE_DFA_CELL_COUNT(numUserStates, numClasses)
+ *               elements, where numUserStates is the number of
+ *               states inserted into the state machine; need not
+ *               be initialized.
+ * @param numCells Number of elements in pCells.
+ */
+FSM_API void
+FsmCompileByteDfa(FsmMachine* pFsm, FsmByteDfa* pDfa,
+                  const unsigned char aByteClasses[256],
+                  unsigned int numClasses, FsmEventIdType classEvtBase,
+                  FsmByteDfaCell* pCells, unsigned int numCells);
+
+
+/**
+ * Feeds the given bytes to the given state machine via its
+ * byte-stream DFA (@see FsmCompileByteDfa()).  ENTER, EXIT and
+ * BEGIN events are delivered as usual whenever a byte causes a
+ * state transition.
+ *
+ * @note WARNING: DO NOT call this from a state event handler or
+ *       any other callback of the given state machine.
+ *
+ * @param pFsm Non-NULL pointer to a started state machine with a
+ *             compiled byte-stream DFA.
+ * @param pBuf Pointer to the bytes; may be NULL if len is 0.
+ * @param len Number of bytes.
+ *
+ * @return unsigned int Number of bytes that were handled: that
+ *         took a transition, or whose dispatch returned true
+ *         (non-zero).
+ */
+FSM_API unsigned int
+FsmFeedBytes(FsmMachine* pFsm, const void* pBuf, unsigned int len);
+
+
+/**
+ * Turns the given sealed state machine into a definition that any
+ * number of lightweight instances can share (@see
+ * FsmInitInstance()), so that the topology of a state machine
+ * that's run many times over is built once, rather than embedded
+ * into and built for each instance.
+ *
+ * Build the state machine as usual: initialize and insert its
+ * states, declare their event subscription sets, transitions and
+ * initial substates, and seal it (@see FsmSealMachine()).  The
+ * definition then refers to the sealed state storage, which
+ * holds all of the topology the instances need; the engine
+ * doesn't modify it from then on, so instances may share it
+ * freely.
+ *
+ * The state objects are shared by all instances: state handlers
+ * and actions MUST keep per-instance data in the instance's
+ * context (@see FsmGetInstanceContext()) rather than in the
+ * state objects, and transition targets are the shared state
+ * objects.
+ *
+ * @note The state machine, its states, and the sealed state
+ *       storage MUST remain valid (and unmodified) for the
+ *       lifetime of the definition and its instances.  The state
+ *       machine may still be used on its own.
+ *
+ * @param pDef Non-NULL pointer to storage for the definition;
+ *             need not be initialized.
+ * @param pFsm Non-NULL pointer to a sealed state machine.
+ */
+FSM_API void
+FsmInitDefinition(FsmDefinition* pDef, FsmMachine* pFsm);
+
+/**
+ * Initializes the given definition from the given constant
+ * topology (@see FSM_CONST_TOPOLOGY()), without building a state
+ * machine: instances of the definition (@see FsmInitInstance())
+ * run directly on the topology's records.  Use
+ * FSM_INIT_CONST_DEFINITION() rather than calling it directly.
+ *
+ * Transitions to a state of the topology, and FsmIsInState()
+ * queries, take the state's user state object (@see
+ * FSM_CONST_USER_STATE()).
+ *
+ * @note The topology MUST remain valid for the lifetime of the
+ *       definition and its instances; SME never modifies it.
+ *
+ * @param pDef Non-NULL pointer to storage for the definition;
+ *             need not be initialized.
+ * @param aStates Non-NULL state records of a constant topology.
+ * @param numStates Number of user states of the topology; MUST
+ *                  be non-zero and at most FSM_MAX_USER_STATES.
+ */
+FSM_API void
+FsmInitConstDefinition(FsmDefinition* pDef, const FsmConstState aStates[],
+                       unsigned int numStates);
+
+
+/**
+ * Initializes an instance of the given state machine definition.
+ *
+ * An instance holds only the runtime data of a state machine
+ * (and a user context pointer), and runs on its definition's
+ * topology with the same semantics as the state machine that the
+ * definition was built from.  Pass it to the runtime API via
+ * FSM_INSTANCE_MACHINE(): FsmStart(), FsmDispatchEvent(),
+ * FsmBeginTransition(), FsmIsInState(),
+ * FsmAttachTransitionCache(), and the FsmDbg API.  State
+ * handlers receive the instance's FsmMachine pointer, too.
+ *
+ * @note WARNING: DO NOT pass instances to the functions that
+ *       build a state machine (FsmInsertState(),
+ *       FsmSealMachine(), FsmCompileByteDfa()), nor to
+ *       FsmFeedBytes().
+ *
+ * @param pInstance Non-NULL pointer to storage for the instance;
+ *                  need not be initialized.
+ * @param pDef Non-NULL pointer to an initialized definition.
+ * @param pContext Optional user context pointer; may be NULL.
+ */
+FSM_API void
+FsmInitInstance(FsmInstance* pInstance, const FsmDefinition* pDef,
+                void* pContext);
+
+
+/**
+ * Returns the user context pointer of the given instance; handy
+ * in state handlers of shared definitions.
+ *
+ * @param pFsm Non-NULL FsmMachine pointer of an instance (@see
+ *             FSM_INSTANCE_MACHINE()).
+ *
+ * @return void* The pContext argument of FsmInitInstance().
+ */
+FSM_API void*
+FsmGetInstanceContext(const FsmMachine* pFsm);
+
+/**
+ * State handler of the root state that SME provides for each
+ * state machine; constant topologies refer to it (@see
+ * FSM_CONST_ROOT_STATE()).  It doesn't handle any events.
+ *
+ * @see FsmStateHandlerFnType
+ */
+FSM_API int
+FsmRootStateHandler(FsmState* pState, FsmMachine* pFsm,
+                    const FsmEvent* pEvt);
+
+
 
 
 #ifdef __cplusplus
@@ -49,6 +49,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#if __cplusplus >= 201103L
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#endif
+
 #include "PalmFsm.h"
 
 
@@ -65,7 +73,10 @@ namespace pmfsm {
  * pmfsm::StateMachineBase
  * 
  * Create your state classes by subclassing from the class
- * template pmfsm::StateBase.
+ * template pmfsm::StateBase (or pmfsm::StaticStateBase, which
+ * calls your handler method without a virtual call, or
+ * pmfsm::TypedStateBase, which calls an On() overload per typed
+ * event), or build them from lambdas with pmfsm::FunctorState.
  * 
  * You then instantiate the state classes of your state machine
  * *instead* of calling FsmInitState().
@@ -252,10 +263,11 @@ public:
      *              saves the given pointer (i.e., doesn't copy the
      *              string).  The names "ROOT" and "UNNAMED-STATE"
      *              are reserved.
+     * @param flags Capability flags; @see FsmInitStateEx().
      */
-    explicit StateBase(const char* pName)
+    explicit StateBase(const char* pName, unsigned int flags = 0)
     {
-        FsmInitState(this, &GenericStateHandler, pName);
+        FsmInitStateEx(this, &GenericStateHandler, pName, flags);
     }
 
     virtual bool OnFsmEvent(const FsmEvtType_* pEvt, FsmType_* pFsm) = 0;
@@ -285,6 +297,1437 @@ private:
 };
 
 
+/**
+ * A variant of StateBase that calls the derived class's
+ * OnFsmEvent() method directly instead of virtually: the engine
+ * calls a handler specialized for Derived_, which inlines
+ * Derived_::OnFsmEvent(), so that delivering an event takes one
+ * indirect call instead of two.
+ * 
+ * StaticStateBase has no virtual methods, so that its layout is
+ * the one of FsmState: the engine (and any C code) sees a
+ * StaticStateBase pointer and the FsmState pointer as the same
+ * address, and StaticStateBase states may be mixed freely with C
+ * states and StateBase states in the same state machine.
+ * 
+ * Define your state class by subclassing from
+ * StaticStateBase<YourStateClass, ...> and defining the
+ * (non-virtual) method:
+ * 
+ * bool OnFsmEvent(const FsmEvtType_* pEvt, FsmType_* pFsm);
+ * 
+ * Usage Example:
+ * 
+ * class OutdoorsState
+ *     : public pmfsm::StaticStateBase<OutdoorsState, MyWorldFsm, Event> {
+ *  public:
+ *     explicit OutdoorsState(const char* pName)
+ *     : StaticStateBase(pName)
+ *     {
+ *     }
+ * 
+ *     bool OnFsmEvent(const Event* pEvt, MyWorldFsm* pFsm)
+ *     {
+ *         ...
+ *     }
+ * };
+ */
+template<
+    class Derived_,
+    class FsmType_ = FsmMachine,
+    typename FsmEvtType_ = FsmEvent
+>
+class StaticStateBase : public FsmState {
+public:
+    /**
+     * Constructor.
+     * 
+     * @param pName FSM name to use for logging and debugging.  FSM
+     *              saves the given pointer (i.e., doesn't copy the
+     *              string).  The names "ROOT" and "UNNAMED-STATE"
+     *              are reserved.
+     * @param flags Capability flags; @see FsmInitStateEx().
+     */
+    explicit StaticStateBase(const char* pName, unsigned int flags = 0)
+    {
+        #if __cplusplus >= 201103L
+        static_assert(sizeof(StaticStateBase) == sizeof(FsmState) &&
+                      std::is_standard_layout<StaticStateBase>::value,
+                      "StaticStateBase MUST be laid out like FsmState");
+        #endif
+
+        FsmInitStateEx(this, &StaticStateHandler, pName, flags);
+    }
+
+private:
+    /**
+     * Handles event handler callbacks from the state machine engine
+     * by invoking the OnFsmEvent method of the corresponding
+     * Derived_ instance.
+     * 
+     * @param pState @see FsmStateHandlerFnType
+     * @param pFsm @see FsmStateHandlerFnType
+     * @param pEvt @see FsmStateHandlerFnType
+     * 
+     * @return int @see FsmStateHandlerFnType
+     */
+    static int
+    StaticStateHandler(FsmState* pState,
+                       FsmMachine* pFsm,
+                       const FsmEvent* pEvt)
+    {
+        return static_cast<Derived_*>(pState)->OnFsmEvent(
+            static_cast<const FsmEvtType_*>(pEvt),
+            static_cast<FsmType_*>(pFsm));
+    }
+};
+
+
+/**
+ * A state machine definition that runs on a constant topology
+ * (see FSM_CONST_TOPOLOGY() in PalmFsm.h, whose macros work the
+ * same in C++).  Pass a pointer to it to FsmInitInstance().
+ * 
+ * Usage Example:
+ * 
+ * typedef FSM_CONST_TOPOLOGY(2) MyTopology;
+ * 
+ * static const MyTopology kMyTopology = {...};
+ * 
+ * static const pmfsm::ConstDefinition kMyDefinition(kMyTopology);
+ */
+class ConstDefinition : public FsmDefinition {
+public:
+    /**
+     * Constructor
+     * 
+     * @param topology Constant topology; MUST remain valid for the
+     *                 lifetime of the definition and its instances.
+     */
+    template<typename TopologyType_>
+    explicit ConstDefinition(const TopologyType_& topology)
+    {
+        FSM_INIT_CONST_DEFINITION(this, topology);
+    }
+};
+
+
+#if __cplusplus >= 201103L
+
+/**
+ * Maximum nesting depth of the states of a StaticHsm (top-level
+ * states are at depth 1); states nested deeper don't compile
+ */
+#ifndef PMFSM_STATIC_HSM_MAX_DEPTH
+    #define PMFSM_STATIC_HSM_MAX_DEPTH 16
+#endif
+
+
+/**
+ * The implicit top state of every StaticHsm: the parent of its
+ * top-level states
+ */
+struct StaticHsmTop {
+    typedef StaticHsmTop    Parent;
+    typedef void            Initial;
+};
+
+
+/**
+ * Base of the states of a StaticHsm.  A state is a type, whose
+ * static member functions the StaticHsm calls with a reference
+ * to the state machine (the state's data, if any, lives in the
+ * state machine):
+ * 
+ *  * OnEnter(Fsm&) and OnExit(Fsm&): entry and exit actions.
+ *  * template<class Context> OnEvent(Context& ctx, const Evt&):
+ *    returns true if it handled the event, false to pass it to
+ *    the parent state.  ctx.GetFsm() is the state machine, and
+ *    ctx.Transition<Target>() takes a transition (@see
+ *    StaticHsmContext).
+ * 
+ * The base provides no-op defaults for all three, so that a state
+ * defines only the ones that it needs.
+ * 
+ * @param Parent_ The parent state; StaticHsmTop for top-level
+ *                states.
+ * @param Initial_ The initial substate, entered whenever the
+ *                 state is the target of a transition: a
+ *                 descendant, which may be declared forward; void
+ *                 if none.
+ */
+template<
+    class Parent_ = StaticHsmTop,
+    class Initial_ = void
+>
+struct StaticHsmState {
+    typedef Parent_     Parent;
+    typedef Initial_    Initial;
+
+    template<class Fsm_>
+    static void OnEnter(Fsm_&)
+    {
+    }
+
+    template<class Fsm_>
+    static void OnExit(Fsm_&)
+    {
+    }
+
+    template<class Context_, class Evt_>
+    static bool OnEvent(Context_&, const Evt_&)
+    {
+        return false;
+    }
+};
+
+
+/**
+ * Compile-time topology of StaticHsm states
+ */
+namespace detail {
+
+/// Nesting depth of a state: 0 for StaticHsmTop
+template<class State_>
+struct HsmDepth {
+    static const unsigned int value =
+        HsmDepth<typename State_::Parent>::value + 1;
+
+    static_assert(value <= PMFSM_STATIC_HSM_MAX_DEPTH,
+                  "StaticHsm state nested deeper than "
+                  "PMFSM_STATIC_HSM_MAX_DEPTH");
+};
+
+template<>
+struct HsmDepth<StaticHsmTop> {
+    static const unsigned int value = 0;
+};
+
+
+/// True if Ancestor_ is Descendant_ or one of its ancestors
+template<class Ancestor_, class Descendant_>
+struct HsmContains : std::integral_constant<bool,
+    std::is_same<Ancestor_, Descendant_>::value ||
+    HsmContains<Ancestor_, typename Descendant_::Parent>::value> {
+};
+
+template<class Ancestor_>
+struct HsmContains<Ancestor_, StaticHsmTop>
+    : std::is_same<Ancestor_, StaticHsmTop> {
+};
+
+
+/// The deepest state that contains both states: aligns their depths,
+/// then steps upward in lockstep
+template<
+    class State1_,
+    class State2_,
+    int kDeeper_ = (HsmDepth<State1_>::value > HsmDepth<State2_>::value) -
+                   (HsmDepth<State1_>::value < HsmDepth<State2_>::value)
+>
+struct HsmCommonAncestor
+    : HsmCommonAncestor<typename State1_::Parent, typename State2_::Parent> {
+};
+
+template<class State1_, class State2_>
+struct HsmCommonAncestor<State1_, State2_, 1>
+    : HsmCommonAncestor<typename State1_::Parent, State2_> {
+};
+
+template<class State1_, class State2_>
+struct HsmCommonAncestor<State1_, State2_, -1>
+    : HsmCommonAncestor<State1_, typename State2_::Parent> {
+};
+
+template<class State_>
+struct HsmCommonAncestor<State_, State_, 0> {
+    typedef State_ type;
+};
+
+
+/// The state below which a transition from Source_ (the state whose
+/// handler takes it) to Target_ exits and enters states; the same
+/// local transition semantics as FsmBeginTransition()'s
+template<class Source_, class Target_>
+struct HsmTransitionAnchor {
+    typedef typename std::conditional<
+        std::is_same<typename Source_::Parent,
+                     typename Target_::Parent>::value,
+        typename Source_::Parent,
+        typename std::conditional<
+            HsmContains<Source_, Target_>::value,
+            Source_,
+            typename HsmCommonAncestor<typename Source_::Parent,
+                                       Target_>::type>::type>::type type;
+};
+
+
+/// Exits State_ and its ancestors below Anchor_, innermost first
+template<class Fsm_, class State_, class Anchor_>
+struct HsmExit {
+    static void Run(Fsm_& fsm)
+    {
+        State_::OnExit(fsm);
+        HsmExit<Fsm_, typename State_::Parent, Anchor_>::Run(fsm);
+    }
+};
+
+template<class Fsm_, class Anchor_>
+struct HsmExit<Fsm_, Anchor_, Anchor_> {
+    static void Run(Fsm_&)
+    {
+    }
+};
+
+
+/// Enters the states below Anchor_ down to State_, outermost first
+template<class Fsm_, class Anchor_, class State_>
+struct HsmEnter {
+    static void Run(Fsm_& fsm)
+    {
+        HsmEnter<Fsm_, Anchor_, typename State_::Parent>::Run(fsm);
+        State_::OnEnter(fsm);
+    }
+};
+
+template<class Fsm_, class Anchor_>
+struct HsmEnter<Fsm_, Anchor_, Anchor_> {
+    static void Run(Fsm_&)
+    {
+    }
+};
+
+
+/// Enters the chain of initial substates below State_; Leaf is the
+/// state that becomes current
+template<class Fsm_, class State_, class Initial_ = typename State_::Initial>
+struct HsmDrill {
+    static_assert(!std::is_same<State_, Initial_>::value &&
+                  HsmContains<State_, Initial_>::value,
+                  "Initial substate MUST be a descendant of its state");
+
+    typedef typename HsmDrill<Fsm_, Initial_>::Leaf Leaf;
+
+    static void Run(Fsm_& fsm)
+    {
+        HsmEnter<Fsm_, State_, Initial_>::Run(fsm);
+        HsmDrill<Fsm_, Initial_>::Run(fsm);
+    }
+};
+
+template<class Fsm_, class State_>
+struct HsmDrill<Fsm_, State_, void> {
+    typedef State_ Leaf;
+
+    static void Run(Fsm_&)
+    {
+    }
+};
+
+
+/// A state's runtime record, by which StaticHsm::IsInState() finds
+/// the current state's ancestors
+struct HsmStateInfo {
+    const HsmStateInfo* pParent;
+};
+
+template<class State_>
+struct HsmInfoOf {
+    static const HsmStateInfo kInfo;
+};
+
+/// @note StaticHsmTop's record ends the chain
+template<class State_>
+const HsmStateInfo HsmInfoOf<State_>::kInfo = {
+    std::is_same<State_, StaticHsmTop>::value
+        ? NULL : &HsmInfoOf<typename State_::Parent>::kInfo
+};
+
+struct HsmNoAction {
+    template<class Fsm_>
+    void operator()(Fsm_&) const
+    {
+    }
+};
+
+template<class Fsm_, class Evt_, class Leaf_, class Source_>
+struct HsmDeliver;
+
+} // end namespace detail
+
+
+/**
+ * What the OnEvent() handler of a StaticHsm state receives
+ * besides the event: the state machine, and the transitions that
+ * the handler may take.  The current state (Leaf_) and the state
+ * whose handler is running (Source_) are known at compile time,
+ * so that a transition compiles down to the straight-line calls
+ * of the exit and entry actions that it requires.
+ */
+template<class Fsm_, class Leaf_, class Source_>
+class StaticHsmContext {
+public:
+    explicit StaticHsmContext(Fsm_& fsm)
+    : fsm_(fsm), isTransitioned_(false)
+    {
+    }
+
+    Fsm_& GetFsm() const
+    {
+        return fsm_;
+    }
+
+    /**
+     * Returns true if the given state is active, i.e., if it is
+     * the current state or one of its ancestors
+     */
+    template<class State_>
+    static constexpr bool IsInState()
+    {
+        return detail::HsmContains<State_, Leaf_>::value;
+    }
+
+    /**
+     * Takes the transition to the given state: exits the current
+     * state and its ancestors up to the transition's anchor, calls
+     * action(fsm), enters the states down to Target_, and then
+     * Target_'s chain of initial substates.  The semantics are
+     * those of FsmBeginTransition(): UML local transitions.
+     * 
+     * @note A handler MUST NOT take more than one transition per
+     *       event; the event isn't passed to the parent state once
+     *       the handler took a transition.
+     * 
+     * @param action Transition action: a function or function
+     *               object called with the state machine.
+     */
+    template<class Target_, class Action_>
+    void Transition(Action_ action)
+    {
+        typedef typename detail::HsmTransitionAnchor<
+            Source_, Target_>::type         Anchor;
+        typedef detail::HsmDrill<Fsm_, Target_> Drill;
+
+        detail::HsmExit<Fsm_, Leaf_, Anchor>::Run(fsm_);
+        action(fsm_);
+        detail::HsmEnter<Fsm_, Anchor, Target_>::Run(fsm_);
+        Drill::Run(fsm_);
+
+        fsm_.template SetCurrentState<typename Drill::Leaf>();
+        isTransitioned_ = true;
+    }
+
+    template<class Target_>
+    void Transition()
+    {
+        Transition<Target_>(detail::HsmNoAction());
+    }
+
+    bool IsTransitioned() const
+    {
+        return isTransitioned_;
+    }
+
+private:
+    Fsm_&   fsm_;
+    bool    isTransitioned_;
+};
+
+
+namespace detail {
+
+/// Offers the event to Source_, then to its ancestors, while the
+/// current state is Leaf_
+template<class Fsm_, class Evt_, class Leaf_, class Source_>
+struct HsmDeliver {
+    static bool Run(Fsm_& fsm, const Evt_& evt)
+    {
+        StaticHsmContext<Fsm_, Leaf_, Source_> ctx(fsm);
+
+        if (Source_::OnEvent(ctx, evt) || ctx.IsTransitioned()) {
+            return true;
+        }
+
+        return HsmDeliver<Fsm_, Evt_, Leaf_,
+                          typename Source_::Parent>::Run(fsm, evt);
+    }
+};
+
+template<class Fsm_, class Evt_, class Leaf_>
+struct HsmDeliver<Fsm_, Evt_, Leaf_, StaticHsmTop> {
+    static bool Run(Fsm_&, const Evt_&)
+    {
+        return false;
+    }
+};
+
+} // end namespace detail
+
+
+/**
+ * A hierarchical state machine whose topology is expressed in
+ * types (@see StaticHsmState), as an alternative to
+ * StateMachineBase and StateBase for state machines whose
+ * topology is fixed at compile time.  Parent chains, transition
+ * anchors, and the sequences of exit and entry actions are
+ * computed by the compiler, which can inline the handlers; the
+ * only runtime dispatch is one indirect call per event, to the
+ * handler chain of the current state.
+ * 
+ * StaticHsm doesn't use the engine: the native Fsm API doesn't
+ * apply to it.  There are no ENTER/EXIT/BEGIN events (a state's
+ * OnEnter()/OnExit() functions and its Initial substate take
+ * their place), and no logging.
+ * 
+ * Requires C++11.
+ * 
+ * Usage Example:
+ * 
+ * class Lamp : public pmfsm::StaticHsm<Lamp> {
+ *  public:
+ *      struct Dimmed;
+ * 
+ *      struct On : pmfsm::StaticHsmState<pmfsm::StaticHsmTop, Dimmed> {
+ *          template<class Context>
+ *          static bool OnEvent(Context& ctx, const FsmEvent& evt)
+ *          {
+ *              if (kLampEvtIdSwitch == evt.evtId) {
+ *                  ctx.template Transition<Off>();
+ *                  return true;
+ *              }
+ *              return false;
+ *          }
+ *      };
+ * 
+ *      struct Dimmed : pmfsm::StaticHsmState<On> {
+ *          static void OnEnter(Lamp& lamp) { lamp.SetLevel(10); }
+ *      };
+ * 
+ *      struct Off : pmfsm::StaticHsmState<> {...};
+ * };
+ * 
+ * Lamp lamp;
+ * lamp.Start<Lamp::Off>();
+ * lamp.DispatchEvent(switchEvt);
+ * 
+ * @param Derived_ Your state machine class, which subclasses
+ *                 StaticHsm<Derived_, ...>.
+ * @param FsmEvtType_ Event type.
+ * 
+ * @note Transitions MUST NOT be taken from OnEnter() and OnExit()
+ * 
+ * @note This class is NOT thread-safe
+ */
+template<
+    class Derived_,
+    typename FsmEvtType_ = FsmEvent
+>
+class StaticHsm {
+public:
+    StaticHsm()
+    : pCurrent_(NULL), pDispatch_(NULL)
+    {
+    }
+
+    /**
+     * Enters the given state and its ancestors, outermost first,
+     * and then its chain of initial substates
+     */
+    template<class Initial_>
+    void Start()
+    {
+        typedef detail::HsmDrill<Derived_, Initial_> Drill;
+
+        detail::HsmEnter<Derived_, StaticHsmTop, Initial_>::Run(Self());
+        Drill::Run(Self());
+
+        SetCurrentState<typename Drill::Leaf>();
+    }
+
+    /**
+     * Dispatches the event to the current state's handler, and up
+     * its ancestors' handlers until one of them handles it; MUST
+     * be called after Start(), and not from the scope of a
+     * handler.
+     * 
+     * @return bool true if a state handled the event
+     */
+    bool DispatchEvent(const FsmEvtType_& evt)
+    {
+        return pDispatch_(Self(), evt);
+    }
+
+    /**
+     * Returns true if the given state is active, i.e., if it is
+     * the current state or one of its ancestors
+     */
+    template<class State_>
+    bool IsInState() const
+    {
+        const detail::HsmStateInfo* pInfo = pCurrent_;
+
+        for (; pInfo; pInfo = pInfo->pParent) {
+            if (&detail::HsmInfoOf<State_>::kInfo == pInfo) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    template<class, class, class> friend class StaticHsmContext;
+
+    Derived_& Self()
+    {
+        return static_cast<Derived_&>(*this);
+    }
+
+    template<class Leaf_>
+    void SetCurrentState()
+    {
+        pCurrent_ = &detail::HsmInfoOf<Leaf_>::kInfo;
+        pDispatch_ = &detail::HsmDeliver<Derived_, FsmEvtType_,
+                                         Leaf_, Leaf_>::Run;
+    }
+
+    const detail::HsmStateInfo* pCurrent_;
+
+    bool (*pDispatch_)(Derived_&, const FsmEvtType_&);
+};
+
+
+/**
+ * Maximum number of entries of the jump table of a TypedStateBase
+ * state: one per event id from kFsmEventBegin to the state
+ * machine's highest event id
+ */
+#ifndef PMFSM_TYPED_EVENT_TABLE_MAX
+    #define PMFSM_TYPED_EVENT_TABLE_MAX 256
+#endif
+
+
+/**
+ * Base of typed events, whose event id is a compile-time constant
+ * of the event type; @see TypedStateBase.
+ * 
+ * Usage Example:
+ * 
+ * struct WindEvt : public pmfsm::TypedEvent<kMyEvtIdWind> {
+ *     float mph; ///< Wind speed in miles per hour
+ * };
+ * 
+ * @param kId_ The event id: a user-defined event id, or one of the
+ *             reserved ones (@see EnterEvt, ExitEvt and BeginEvt).
+ */
+template<FsmEventIdType kId_>
+struct TypedEvent : public FsmEvent {
+    static constexpr FsmEventIdType kId = kId_;
+
+    TypedEvent()
+    {
+        evtId = kId_;
+    }
+};
+
+template<FsmEventIdType kId_>
+constexpr FsmEventIdType TypedEvent<kId_>::kId;
+
+/// The reserved events as typed events: a TypedStateBase state
+/// receives them only if it has On() overloads for them
+typedef TypedEvent<kFsmEventEnterScope>     EnterEvt;
+typedef TypedEvent<kFsmEventExitScope>      ExitEvt;
+typedef TypedEvent<kFsmEventBegin>          BeginEvt;
+
+
+/**
+ * The typed user-defined events of a state machine, in ascending
+ * order of their ids; @see TypedStateBase
+ */
+template<class... Evts_>
+struct EventList {
+};
+
+
+namespace detail {
+
+/// The sequence of indexes 0..kN_-1
+template<unsigned int... kIdx_>
+struct IndexSeq {
+    typedef IndexSeq type;
+};
+
+template<class Seq1_, class Seq2_>
+struct ConcatIndexSeq;
+
+template<unsigned int... kIdx1_, unsigned int... kIdx2_>
+struct ConcatIndexSeq<IndexSeq<kIdx1_...>, IndexSeq<kIdx2_...> >
+    : IndexSeq<kIdx1_..., (sizeof...(kIdx1_) + kIdx2_)...> {
+};
+
+template<unsigned int kN_>
+struct MakeIndexSeq
+    : ConcatIndexSeq<typename MakeIndexSeq<kN_ / 2>::type,
+                     typename MakeIndexSeq<kN_ - kN_ / 2>::type> {
+};
+
+template<>
+struct MakeIndexSeq<0> : IndexSeq<> {
+};
+
+template<>
+struct MakeIndexSeq<1> : IndexSeq<0> {
+};
+
+
+/// True if the events' ids are user-defined event ids in strictly
+/// ascending order
+template<class... Evts_>
+struct EventIdsAscending : std::true_type {
+};
+
+template<class Evt_>
+struct EventIdsAscending<Evt_>
+    : std::integral_constant<bool,
+                             Evt_::kId >= kFsmEventFirstUserEvent> {
+};
+
+template<class Evt1_, class Evt2_, class... Rest_>
+struct EventIdsAscending<Evt1_, Evt2_, Rest_...>
+    : std::integral_constant<bool,
+                             Evt1_::kId >= kFsmEventFirstUserEvent &&
+                             Evt1_::kId < Evt2_::kId &&
+                             EventIdsAscending<Evt2_, Rest_...>::value> {
+};
+
+
+/// The highest event id of the events; kFsmEventBegin if none
+template<class... Evts_>
+struct MaxEventId : std::integral_constant<FsmEventIdType, kFsmEventBegin> {
+};
+
+template<class Evt_, class... Rest_>
+struct MaxEventId<Evt_, Rest_...>
+    : std::integral_constant<FsmEventIdType,
+                             (Evt_::kId > MaxEventId<Rest_...>::value)
+                                 ? Evt_::kId
+                                 : MaxEventId<Rest_...>::value> {
+};
+
+
+/// True if State_ has an On() overload for Evt_
+template<class State_, class FsmType_, class Evt_>
+struct HasOnEvent {
+    template<class S_>
+    static char Test(decltype(std::declval<S_&>().On(
+        std::declval<const Evt_&>(), std::declval<FsmType_*>()))*);
+
+    template<class S_>
+    static long Test(...);
+
+    static const bool value = sizeof(Test<State_>(NULL)) == 1;
+};
+
+
+/// Calls State_'s On() overload for Evt_
+template<class State_, class FsmType_, class Evt_>
+struct EventThunk {
+    static bool Run(State_* pState, const FsmEvent* pEvt, FsmType_* pFsm)
+    {
+        return pState->On(static_cast<const Evt_&>(*pEvt), pFsm);
+    }
+};
+
+template<class State_, class FsmType_, class Evt_, bool kHandles_>
+struct EventThunkOf {
+    typedef bool (*FnType)(State_*, const FsmEvent*, FsmType_*);
+
+    static constexpr FnType Get()
+    {
+        return &EventThunk<State_, FsmType_, Evt_>::Run;
+    }
+};
+
+template<class State_, class FsmType_, class Evt_>
+struct EventThunkOf<State_, FsmType_, Evt_, false> {
+    typedef bool (*FnType)(State_*, const FsmEvent*, FsmType_*);
+
+    static constexpr FnType Get()
+    {
+        return NULL;
+    }
+};
+
+
+/// The jump table entry of the event id kId_: the thunk of the
+/// event of that id, if State_ handles it; NULL otherwise
+template<class State_, class FsmType_, FsmEventIdType kId_, class... Evts_>
+struct EventThunkFor {
+    typedef bool (*FnType)(State_*, const FsmEvent*, FsmType_*);
+
+    static constexpr FnType Get()
+    {
+        return NULL;
+    }
+};
+
+template<class State_, class FsmType_, FsmEventIdType kId_, class Evt_,
+         class... Rest_>
+struct EventThunkFor<State_, FsmType_, kId_, Evt_, Rest_...> {
+    typedef bool (*FnType)(State_*, const FsmEvent*, FsmType_*);
+
+    static constexpr FnType Get()
+    {
+        return (kId_ == Evt_::kId)
+            ? EventThunkOf<State_, FsmType_, Evt_,
+                           HasOnEvent<State_, FsmType_, Evt_>::value>::Get()
+            : EventThunkFor<State_, FsmType_, kId_, Rest_...>::Get();
+    }
+};
+
+
+/// The user-defined events that State_ handles, in the order of
+/// the list
+template<class State_, class FsmType_, class Handled_, class... Evts_>
+struct HandledEvents {
+    typedef Handled_ type;
+};
+
+template<class State_, class FsmType_, class... Handled_, class Evt_,
+         class... Rest_>
+struct HandledEvents<State_, FsmType_, EventList<Handled_...>, Evt_,
+                     Rest_...>
+    : HandledEvents<State_, FsmType_,
+                    typename std::conditional<
+                        HasOnEvent<State_, FsmType_, Evt_>::value,
+                        EventList<Handled_..., Evt_>,
+                        EventList<Handled_...> >::type,
+                    Rest_...> {
+};
+
+
+/// The subscription set of the events (@see FsmDeclareStateEvents())
+template<class Events_>
+struct EventIdSet;
+
+template<class... Evts_>
+struct EventIdSet<EventList<Evts_...> > {
+    static const unsigned int kCount = sizeof...(Evts_);
+
+    static const FsmEventIdType* Get()
+    {
+        /// @note The extra element keeps the array from being empty
+        static const FsmEventIdType kIds[] = {Evts_::kId..., 0};
+
+        return kIds;
+    }
+};
+
+
+/// The compile-time tables of a TypedStateBase state: the jump
+/// table indexed by event id - kFsmEventBegin, the subscription
+/// set, and the state flags that spare the reserved events that
+/// the state doesn't handle
+template<class State_, class FsmType_, class Events_>
+struct TypedStateTables;
+
+template<class State_, class FsmType_, class... Evts_>
+struct TypedStateTables<State_, FsmType_, EventList<Evts_...> > {
+    typedef bool (*FnType)(State_*, const FsmEvent*, FsmType_*);
+
+    static_assert(EventIdsAscending<Evts_...>::value,
+                  "EventList MUST list user-defined events in ascending "
+                  "order of their ids");
+
+    static const unsigned int kNumEntries =
+        MaxEventId<Evts_...>::value - kFsmEventBegin + 1;
+
+    static_assert(kNumEntries <= PMFSM_TYPED_EVENT_TABLE_MAX,
+                  "Event ids too sparse for a jump table; see "
+                  "PMFSM_TYPED_EVENT_TABLE_MAX");
+
+    static const unsigned int kFlags =
+        (HasOnEvent<State_, FsmType_, EnterEvt>::value
+            ? 0 : kFsmStateFlagNoEntry) |
+        (HasOnEvent<State_, FsmType_, ExitEvt>::value
+            ? 0 : kFsmStateFlagNoExit) |
+        (HasOnEvent<State_, FsmType_, BeginEvt>::value
+            ? 0 : kFsmStateFlagNoBegin);
+
+    typedef EventIdSet<typename HandledEvents<
+        State_, FsmType_, EventList<>, Evts_...>::type> IdSet;
+
+    template<unsigned int... kIdx_>
+    static const FnType* GetJumpTable(IndexSeq<kIdx_...>)
+    {
+        static const FnType kTable[] = {
+            EventThunkFor<State_, FsmType_,
+                          (FsmEventIdType)kIdx_ + kFsmEventBegin,
+                          BeginEvt, ExitEvt, EnterEvt, Evts_...>::Get()...
+        };
+
+        return kTable;
+    }
+
+    static const FnType* GetJumpTable()
+    {
+        return GetJumpTable(typename MakeIndexSeq<kNumEntries>::type());
+    }
+};
+
+} // end namespace detail
+
+
+/**
+ * A state base for typed events (@see TypedEvent): define an On()
+ * overload for each event type that your state handles,
+ * 
+ * bool On(const WindEvt& evt, MyWorldFsm* pFsm);
+ * 
+ * which returns true if it handled the event, as OnFsmEvent()
+ * does.  The overloads MUST be public.  The state's handler picks
+ * the overload from a jump table indexed by event id, which the
+ * compiler builds from the event types of Events_ (and the
+ * reserved events, EnterEvt, ExitEvt and BeginEvt).
+ * 
+ * The state declares the user-defined events of its overloads as
+ * its subscription set (@see FsmDeclareStateEvents()), and the
+ * reserved events that it has no overloads for with its
+ * capability flags (@see FsmInitStateEx()), so that the engine
+ * passes the events that the state doesn't handle on to the
+ * parent state without calling the state's handler.
+ * 
+ * Like StaticStateBase, TypedStateBase is laid out like FsmState.
+ * 
+ * Requires C++11.
+ * 
+ * Usage Example:
+ * 
+ * typedef pmfsm::EventList<WindEvt, RainEvt> MyEvents;
+ * 
+ * class OutdoorsState
+ *     : public pmfsm::TypedStateBase<OutdoorsState, MyWorldFsm, MyEvents> {
+ *  public:
+ *     explicit OutdoorsState(const char* pName)
+ *     : TypedStateBase(pName)
+ *     {
+ *     }
+ * 
+ *     bool On(const WindEvt& evt, MyWorldFsm* pFsm)
+ *     {
+ *         if (evt.mph > 15) {
+ *             FsmBeginTransition(pFsm, &pFsm->shelter);
+ *         }
+ *         return true;
+ *     }
+ * 
+ *     bool On(const pmfsm::EnterEvt&, MyWorldFsm* pFsm)
+ *     {
+ *         ...
+ *     }
+ * };
+ * 
+ * WindEvt evt;
+ * evt.mph = 100;
+ * FsmDispatchEvent(&world, &evt);
+ * 
+ * @param Derived_ Your state class.
+ * @param FsmType_ Your state machine class.
+ * @param Events_ EventList of the state machine's typed
+ *                user-defined events.
+ */
+template<
+    class Derived_,
+    class FsmType_,
+    class Events_
+>
+class TypedStateBase : public FsmState {
+public:
+    /**
+     * Constructor.
+     * 
+     * @param pName FSM name to use for logging and debugging.  FSM
+     *              saves the given pointer (i.e., doesn't copy the
+     *              string).  The names "ROOT" and "UNNAMED-STATE"
+     *              are reserved.
+     * @param flags Additional capability flags; @see
+     *              FsmInitStateEx().
+     */
+    explicit TypedStateBase(const char* pName, unsigned int flags = 0)
+    {
+        typedef detail::TypedStateTables<Derived_, FsmType_, Events_> Tables;
+
+        static_assert(sizeof(TypedStateBase) == sizeof(FsmState) &&
+                      std::is_standard_layout<TypedStateBase>::value,
+                      "TypedStateBase MUST be laid out like FsmState");
+
+        FsmInitStateEx(this, &TypedStateHandler, pName,
+                       flags | Tables::kFlags);
+        FsmDeclareStateEvents(this, Tables::IdSet::Get(),
+                              Tables::IdSet::kCount);
+    }
+
+private:
+    /**
+     * Handles event handler callbacks from the state machine engine
+     * by invoking the On() overload of the event's type
+     * 
+     * @note The engine delivers only the events that the state
+     *       subscribed to in the constructor, so the jump table
+     *       entry is never NULL -- unless the subscription set or
+     *       the state flags were re-declared since
+     */
+    static int
+    TypedStateHandler(FsmState* pState,
+                      FsmMachine* pFsm,
+                      const FsmEvent* pEvt)
+    {
+        typedef detail::TypedStateTables<Derived_, FsmType_, Events_> Tables;
+        typename Tables::FnType pOnFn = NULL;
+        const long index = (long)pEvt->evtId - (long)kFsmEventBegin;
+
+        assert(index >= 0 && index < (long)Tables::kNumEntries &&
+               "Event id outside of the state's EventList");
+
+        pOnFn = Tables::GetJumpTable()[index];
+        assert(pOnFn && "Event not handled by the state's On() overloads");
+
+        return pOnFn(static_cast<Derived_*>(pState), pEvt,
+                     static_cast<FsmType_*>(pFsm));
+    }
+};
+
+
+/**
+ * Default capacity, in bytes, of the inline storage of an
+ * EventHolder
+ */
+#ifndef PMFSM_EVENT_HOLDER_CAPACITY
+    #define PMFSM_EVENT_HOLDER_CAPACITY 64
+#endif
+
+
+/**
+ * A move-only holder of an event of any type derived from FsmEvent
+ * (e.g., a TypedEvent whose payload owns strings or buffers), for
+ * queueing and forwarding events without copying them.
+ * 
+ * The event is moved into the holder's inline storage if it fits
+ * (and its move constructor doesn't throw), so that neither
+ * holding, moving nor dispatching it allocates; bigger events are
+ * allocated on the heap as a fallback.  Moving a holder moves its
+ * event (or, if on the heap, steals it); holders can't be copied.
+ * 
+ * Dispatch the held event with FsmDispatchEvent(pFsm, holder.Get()):
+ * the handlers receive the payload by reference, in place.
+ * 
+ * Requires C++11.
+ * 
+ * Usage Example:
+ * 
+ * struct LineEvt : public pmfsm::TypedEvent<kMyEvtIdLine> {
+ *     std::string text;
+ * };
+ * 
+ * std::deque<pmfsm::EventHolder<> > queue;
+ * 
+ * LineEvt evt;
+ * evt.text = ...;
+ * queue.emplace_back(std::move(evt));
+ * ...
+ * FsmDispatchEvent(&myFsm, queue.front().Get());
+ * queue.pop_front();
+ * 
+ * @param kCapacity_ Capacity of the inline storage in bytes.
+ */
+template<unsigned int kCapacity_ = PMFSM_EVENT_HOLDER_CAPACITY>
+class EventHolder {
+public:
+    /// True if events of type Evt_ are held inline
+    template<class Evt_>
+    struct IsInline : std::integral_constant<bool,
+        sizeof(Evt_) <= kCapacity_ &&
+        alignof(Evt_) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible<Evt_>::value> {
+    };
+
+    /// Constructs an empty holder
+    EventHolder() noexcept
+    : pEvt_(NULL), pOps_(NULL)
+    {
+    }
+
+    /// Constructs a holder of the given event, moved (or copied, if
+    /// it's an lvalue) into the holder
+    template<class Evt_, class = typename std::enable_if<
+        std::is_base_of<FsmEvent, typename std::decay<Evt_>::type>::value
+    >::type>
+    EventHolder(Evt_&& evt)
+    : pEvt_(NULL), pOps_(NULL)
+    {
+        Emplace<typename std::decay<Evt_>::type>(std::forward<Evt_>(evt));
+    }
+
+    EventHolder(EventHolder&& other) noexcept
+    : pEvt_(NULL), pOps_(NULL)
+    {
+        MoveFrom(other);
+    }
+
+    EventHolder& operator=(EventHolder&& other) noexcept
+    {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    EventHolder(const EventHolder&) = delete;
+    EventHolder& operator=(const EventHolder&) = delete;
+
+    ~EventHolder()
+    {
+        Reset();
+    }
+
+    /**
+     * Replaces the held event, if any, with an event of type Evt_
+     * constructed in place from the given arguments
+     * 
+     * @return Evt_& The new event
+     */
+    template<class Evt_, class... Args_>
+    Evt_& Emplace(Args_&&... args)
+    {
+        static_assert(std::is_base_of<FsmEvent, Evt_>::value,
+                      "Evt_ MUST be derived from FsmEvent");
+
+        Evt_* pEvt;
+
+        Reset();
+        pEvt = Ops<Evt_>::Create(storage_, std::forward<Args_>(args)...);
+
+        pEvt_ = pEvt;
+        pOps_ = &Ops<Evt_>::kOps;
+        return *pEvt;
+    }
+
+    /// Destroys the held event, if any, leaving the holder empty
+    void Reset() noexcept
+    {
+        if (pOps_) {
+            pOps_->pDestroy(pEvt_);
+            pEvt_ = NULL;
+            pOps_ = NULL;
+        }
+    }
+
+    /// @return const FsmEvent* The held event; NULL if empty
+    const FsmEvent* Get() const noexcept
+    {
+        return pEvt_;
+    }
+
+    /// @return FsmEvent* The held event, e.g., to move its payload
+    ///         on after dispatching it; NULL if empty
+    FsmEvent* Get() noexcept
+    {
+        return pEvt_;
+    }
+
+    /// @return bool true if the holder doesn't hold an event
+    bool IsEmpty() const noexcept
+    {
+        return !pOps_;
+    }
+
+    /// @return bool true if the held event is in the inline storage
+    bool IsHeldInline() const noexcept
+    {
+        return pOps_ && pOps_->pMoveTo;
+    }
+
+private:
+    /// Type-specific operations on the held event: Create()
+    /// constructs it in the given storage (or on the heap), pMoveTo
+    /// moves an inline event to another holder's storage (NULL if
+    /// the event is on the heap), and pDestroy destroys it
+    struct OpsType {
+        FsmEvent*   (*pMoveTo)(FsmEvent* pEvt, void* pStorage);
+        void        (*pDestroy)(FsmEvent* pEvt);
+    };
+
+    template<class Evt_, bool kIsInline_ = IsInline<Evt_>::value>
+    struct Ops {
+        template<class... Args_>
+        static Evt_* Create(void* pStorage, Args_&&... args)
+        {
+            return new (pStorage) Evt_(std::forward<Args_>(args)...);
+        }
+
+        static FsmEvent* MoveTo(FsmEvent* pEvt, void* pStorage)
+        {
+            Evt_* pSrc = static_cast<Evt_*>(pEvt);
+            Evt_* pDst = new (pStorage) Evt_(std::move(*pSrc));
+
+            pSrc->~Evt_();
+            return pDst;
+        }
+
+        static void Destroy(FsmEvent* pEvt)
+        {
+            static_cast<Evt_*>(pEvt)->~Evt_();
+        }
+
+        static const OpsType kOps;
+    };
+
+    template<class Evt_>
+    struct Ops<Evt_, false> {
+        template<class... Args_>
+        static Evt_* Create(void* /*pStorage*/, Args_&&... args)
+        {
+            return new Evt_(std::forward<Args_>(args)...);
+        }
+
+        static void Destroy(FsmEvent* pEvt)
+        {
+            delete static_cast<Evt_*>(pEvt);
+        }
+
+        static const OpsType kOps;
+    };
+
+    void MoveFrom(EventHolder& other) noexcept
+    {
+        if (other.IsHeldInline()) {
+            pEvt_ = other.pOps_->pMoveTo(other.pEvt_, storage_);
+        }
+        else {
+            pEvt_ = other.pEvt_;
+        }
+
+        pOps_ = other.pOps_;
+        other.pEvt_ = NULL;
+        other.pOps_ = NULL;
+    }
+
+    FsmEvent*           pEvt_;      ///< The held event
+    const OpsType*      pOps_;      ///< The held event's operations
+
+    alignas(std::max_align_t) unsigned char storage_[kCapacity_];
+};
+
+template<unsigned int kCapacity_>
+template<class Evt_, bool kIsInline_>
+const typename EventHolder<kCapacity_>::OpsType
+EventHolder<kCapacity_>::Ops<Evt_, kIsInline_>::kOps = {
+    &EventHolder<kCapacity_>::Ops<Evt_, kIsInline_>::MoveTo,
+    &EventHolder<kCapacity_>::Ops<Evt_, kIsInline_>::Destroy
+};
+
+template<unsigned int kCapacity_>
+template<class Evt_>
+const typename EventHolder<kCapacity_>::OpsType
+EventHolder<kCapacity_>::Ops<Evt_, false>::kOps = {
+    NULL,
+    &EventHolder<kCapacity_>::Ops<Evt_, false>::Destroy
+};
+
+
+/**
+ * Default capacity, in bytes, of the inline storage of a
+ * FunctorState's callable: enough for a lambda that captures a
+ * std::string by value, or up to four pointers, on both ILP32
+ * and LP64
+ */
+#ifndef PMFSM_FUNCTOR_STATE_CAPACITY
+    #define PMFSM_FUNCTOR_STATE_CAPACITY 32
+#endif
+
+
+/**
+ * A state whose event handler is a lambda or other function
+ * object, so that you don't need to write a state class per state.
+ * 
+ * The callable is stored in the state object itself (no
+ * std::function, no heap), and its handler is a trampoline
+ * specific to the callable's type, so each delivery costs the
+ * engine's indirect call of the handler and nothing more.  The
+ * callable is called as
+ * 
+ * fn(const FsmEvtType_& evt, FsmType_& fsm)
+ * 
+ * and returns true if it handled the event, as OnFsmEvent() does.
+ * 
+ * @note A FunctorState MUST NOT be moved after it has been
+ *       inserted into a state machine; moving one leaves the
+ *       source without a callable.
+ * 
+ * Requires C++11.
+ * 
+ * Usage Example:
+ * 
+ * class MyWorldFsm : public pmfsm::StateMachineBase {
+ *  public:
+ *     typedef pmfsm::FunctorState<MyWorldFsm, Event> State;
+ * 
+ *     MyWorldFsm()
+ *     : StateMachineBase("MyWorldFsm"),
+ *       outdoors("outdoors", [](const Event& evt, MyWorldFsm& fsm) {
+ *           if (kMyEvtIdWind == evt.evtId && evt.wind.mph > 15) {
+ *               FsmBeginTransition(&fsm, &fsm.shelter);
+ *               return true;
+ *           }
+ *           return false;
+ *       }),
+ *       shelter("shelter", [](const Event&, MyWorldFsm&) {
+ *           return false;
+ *       })
+ *     {
+ *         FsmInsertState(this, &outdoors, NULL);
+ *         FsmInsertState(this, &shelter, NULL);
+ *     }
+ * 
+ *     State outdoors;
+ *     State shelter;
+ * };
+ * 
+ * Or, for states that aren't class members:
+ * 
+ * auto idle = pmfsm::make_state(
+ *     "idle", [&](const FsmEvent& evt, FsmMachine& fsm) {...});
+ * 
+ * @param FsmType_ Your state machine class; FsmMachine by default.
+ * @param FsmEvtType_ Your event class; FsmEvent by default.
+ * @param kCapacity_ Capacity of the callable's storage in bytes.
+ */
+template<
+    typename FsmType_ = FsmMachine,
+    typename FsmEvtType_ = FsmEvent,
+    unsigned int kCapacity_ = PMFSM_FUNCTOR_STATE_CAPACITY
+>
+class FunctorState : public FsmState {
+public:
+    /**
+     * Constructor.
+     * 
+     * @param pName FSM name to use for logging and debugging.  FSM
+     *              saves the given pointer (i.e., doesn't copy the
+     *              string).  The names "ROOT" and "UNNAMED-STATE"
+     *              are reserved.
+     * @param fn The callable, moved (or copied) into the state.
+     * @param flags Capability flags; @see FsmInitStateEx().
+     */
+    template<typename Fn_>
+    FunctorState(const char* pName, Fn_&& fn, unsigned int flags = 0)
+    {
+        typedef typename std::decay<Fn_>::type FnType;
+
+        static_assert(sizeof(FnType) <= kCapacity_,
+                      "Callable too big for FunctorState; see "
+                      "PMFSM_FUNCTOR_STATE_CAPACITY");
+        static_assert(alignof(FnType) <= alignof(std::max_align_t),
+                      "Callable over-aligned for FunctorState");
+        static_assert(std::is_nothrow_move_constructible<FnType>::value,
+                      "Callable MUST be nothrow move constructible");
+
+        new (static_cast<void*>(storage_)) FnType(std::forward<Fn_>(fn));
+        pManage_ = &Manage<FnType>;
+
+        FsmInitStateEx(this, &FunctorStateHandler<FnType>, pName, flags);
+    }
+
+    /// Moves the callable of a state that hasn't been inserted into
+    /// a state machine
+    FunctorState(FunctorState&& other) noexcept
+    : FsmState(other), pManage_(other.pManage_)
+    {
+        if (pManage_) {
+            pManage_(storage_, other.storage_);
+            other.pManage_ = NULL;
+        }
+    }
+
+    FunctorState(const FunctorState&) = delete;
+    FunctorState& operator=(const FunctorState&) = delete;
+    FunctorState& operator=(FunctorState&&) = delete;
+
+    ~FunctorState()
+    {
+        if (pManage_) {
+            pManage_(NULL, storage_);
+        }
+    }
+
+private:
+    /// Moves the callable from pSrc to pDst, or destroys it if pDst
+    /// is NULL
+    template<typename Fn_>
+    static void Manage(void* pDst, void* pSrc) noexcept
+    {
+        Fn_* pFn = static_cast<Fn_*>(pSrc);
+
+        if (pDst) {
+            new (pDst) Fn_(std::move(*pFn));
+        }
+        pFn->~Fn_();
+    }
+
+    /**
+     * Handles event handler callbacks from the state machine engine
+     * by calling the state's callable of type Fn_
+     * 
+     * @param pState @see FsmStateHandlerFnType
+     * @param pFsm @see FsmStateHandlerFnType
+     * @param pEvt @see FsmStateHandlerFnType
+     * 
+     * @return int @see FsmStateHandlerFnType
+     */
+    template<typename Fn_>
+    static int
+    FunctorStateHandler(FsmState* pState,
+                        FsmMachine* pFsm,
+                        const FsmEvent* pEvt)
+    {
+        Fn_& fn = *reinterpret_cast<Fn_*>(
+            static_cast<FunctorState*>(pState)->storage_);
+
+        return fn(static_cast<const FsmEvtType_&>(*pEvt),
+                  static_cast<FsmType_&>(*pFsm)) ? 1 : 0;
+    }
+
+    void                (*pManage_)(void* pDst, void* pSrc);
+
+    alignas(std::max_align_t) unsigned char storage_[kCapacity_];
+};
+
+
+/**
+ * Creates a FunctorState of the given callable; @see FunctorState.
+ * 
+ * @note Before C++17, the returned state is moved into place
+ *       (which FunctorState allows until the state is inserted).
+ * 
+ * @param pName The state's name.
+ * @param fn The callable.
+ * @param flags Capability flags; @see FsmInitStateEx().
+ * 
+ * @return FunctorState<FsmType_, FsmEvtType_>
+ */
+template<typename FsmType_ = FsmMachine, typename FsmEvtType_ = FsmEvent,
+         typename Fn_>
+FunctorState<FsmType_, FsmEvtType_>
+make_state(const char* pName, Fn_&& fn, unsigned int flags = 0)
+{
+    return FunctorState<FsmType_, FsmEvtType_>(pName, std::forward<Fn_>(fn),
+                                               flags);
+}
+
+#endif // __cplusplus >= 201103L
+
+
 } // end namespace
 
 
@@ -87,6 +87,47 @@ enum FsmDbgLogOptions {
 };
 
 
+/**
+ * Logging configuration of a state machine; @see
+ * FsmDbgAttachLogConfig().
+ * 
+ * @note WARNING: Changing the size or alignment of this
+ *       structure will break binary API compatibility.
+ * 
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API
+ */
+typedef struct {
+    void*                   opaque_[3];
+} FsmDbgLogConfig;
+
+
+/**
+ * FsmDbgAttachLogConfig(): Attaches user-provided storage for the
+ * logging configuration of the given state machine instance (@see
+ * FsmInitInstance()).  Logging is disabled, and the log level
+ * threshold is kFsmDbgLogLevelInfo, until changed via the other
+ * functions of this API.
+ * 
+ * An FsmMachine keeps its logging configuration in the cold tail
+ * of its own structure, but an FsmInstance carries only runtime
+ * data: an instance without an attached logging configuration
+ * doesn't log anything, and calling FsmDbgEnableLogging(),
+ * FsmDbgEnableLoggingViaPmLogLib() or
+ * FsmDbgSetLogLevelThreshold() on it is a fatal error.
+ * 
+ * @param pFsm Non-NULL FsmMachine pointer of an instance (@see
+ *             FSM_INSTANCE_MACHINE()).
+ * @param pLogConfig Non-NULL pointer to storage for the logging
+ *                   configuration; need not be initialized.  The
+ *                   storage MUST remain valid for as long as the
+ *                   instance is in use, and may not be shared
+ *                   with other instances.
+ */
+FSM_API void
+FsmDbgAttachLogConfig(FsmMachine* pFsm, FsmDbgLogConfig* pLogConfig);
+
+
 #ifdef STATE_MACHINE_ENGINE_WEBOS_FEATURES
 /**
  * FsmDbgEnableLoggingViaPmLogLib(): Enable FSM logging by 
@@ -113,7 +154,8 @@ enum FsmDbgLogOptions {
  *       PmLogLib documentation for details.
  *  
  * @param pFsm Non-NULL pointer to a properly-initialized state
- *             machine.
+ *             machine; an instance MUST have an attached logging
+ *             configuration (@see FsmDbgAttachLogConfig()).
  * @param logOptions Non-zero log options.  Pass one or more
  *                   enum FsmDbgLogOptions constants bitwise
  *                   OR'ed together.
@@ -127,7 +169,7 @@ enum FsmDbgLogOptions {
  *  
  * @see FsmDbgDisableLogging 
  */
-void
+FSM_API void
 FsmDbgEnableLoggingViaPmLogLib(FsmMachine*  pFsm,
                                unsigned int logOptions,
                                PmLogContext pmlogContext,
@@ -142,7 +184,8 @@ FsmDbgEnableLoggingViaPmLogLib(FsmMachine*  pFsm,
  * @note On WebOS, use FsmDbgEnableLoggingViaPmLogLib() instead.
  * 
  * @param pFsm Non-NULL pointer to a properly-initialized state
- *             machine.
+ *             machine; an instance MUST have an attached logging
+ *             configuration (@see FsmDbgAttachLogConfig()).
  * @param logOptions Non-zero log options.  Pass one or more 
  *                   enum FsmDbgLogOptions constants bitwise
  *                   OR'ed together.
@@ -178,7 +221,7 @@ FsmDbgEnableLoggingViaPmLogLib(FsmMachine*  pFsm,
  * @see FsmDbgDisableLogging 
  * @see FsmDbgSetLogLevelThreshold 
  */
-void
+FSM_API void
 FsmDbgEnableLogging(FsmMachine*             pFsm,
                     unsigned int            logOptions,
                     FsmDbgLogLineFnType*    pLogCbFunc,
@@ -194,11 +237,12 @@ FsmDbgEnableLogging(FsmMachine*             pFsm,
  *       output is gated by PmLogLib's own mechanism.
  * 
  * @param pFsm Non-NULL pointer to a properly-initialized state
- *             machine.
+ *             machine; an instance MUST have an attached logging
+ *             configuration (@see FsmDbgAttachLogConfig()).
  * @param level A valid log level value or kFsmDbgLogLevelNone
  *              to suppress all log output.
  */
-void
+FSM_API void
 FsmDbgSetLogLevelThreshold(FsmMachine* pFsm, enum FsmDbgLogLevel level);
 
 
@@ -209,7 +253,7 @@ FsmDbgSetLogLevelThreshold(FsmMachine* pFsm, enum FsmDbgLogLevel level);
  *             machine.
  * 
  */
-void
+FSM_API void
 FsmDbgDisableLogging(FsmMachine* pFsm);
 
 
@@ -222,7 +266,7 @@ FsmDbgDisableLogging(FsmMachine* pFsm);
  * @return const char* Pointer to name of the state machine
  *         supplied by user via FsmInitMachine().
  */
-const char*
+FSM_API const char*
 FsmDbgPeekMachineName(FsmMachine* pFsm);
 
 
@@ -237,7 +281,7 @@ FsmDbgPeekMachineName(FsmMachine* pFsm);
  *         given FSM; NULL if the FSM hasn't been started yet or
  *         is in the midst of a state transition.
  */
-const FsmState*
+FSM_API const FsmState*
 FsmDbgPeekCurrentState(FsmMachine* pFsm);
 
 /**
@@ -251,7 +295,7 @@ FsmDbgPeekCurrentState(FsmMachine* pFsm);
  * @return const char* Pointer to name of the state as supplied
  *         by user via FsmInitState().
  */
-const char*
+FSM_API const char*
 FsmDbgPeekStateName(const FsmState* pState);
 
 /**
@@ -267,10 +311,158 @@ FsmDbgPeekStateName(const FsmState* pState);
  *         state, or NULL if the given state is a top-level user
  *         state.
  */
-const FsmState*
+FSM_API const FsmState*
 FsmDbgPeekParentState(FsmMachine* pFsm, const FsmState* pState);
 
 
+/**
+ * For debugging only: Retrieves the hit/miss counters of the
+ * transition plan cache attached to the given state machine.
+ *
+ * @see FsmAttachTransitionCache()
+ *
+ * @param pFsm Non-NULL, properly initialized state machine
+ *             instance
+ * @param pHits Non-NULL pointer to variable for returning the
+ *              number of transitions that were replayed from
+ *              the cache; set to 0 if no cache is attached.
+ * @param pMisses Non-NULL pointer to variable for returning
+ *                the number of transitions whose plan had to be
+ *                computed; set to 0 if no cache is attached.
+ */
+FSM_API void
+FsmDbgGetTransitionCacheStats(FsmMachine* pFsm, unsigned long* pHits,
+                              unsigned long* pMisses);
+
+
+/**
+ * Usage counters of a state in a profiled state machine; @see
+ * FsmDbgAttachProfile()
+ */
+typedef struct {
+    /// User events that FsmDispatchEvent() routed through the state
+    /// on their way from the current state to the state that handled
+    /// them (or to the root state)
+    unsigned long           visits;
+
+    /// Events delivered to the state's handler, reserved events
+    /// included
+    unsigned long           deliveries;
+
+    /// State transitions taken with the state as Main Source
+    unsigned long           transitions;
+} FsmDbgStateUsage;
+
+
+/**
+ * For profiling: Attaches user-provided usage counters to the
+ * given sealed state machine (or instance), and resets them.
+ * From then on, SME counts how often it uses each of the state
+ * machine's states, so that a later build can lay out the hot
+ * states together (@see FsmDbgOrderStatesByUsage()).
+ *
+ * Profiling doesn't depend on logging (@see
+ * FsmDbgAttachLogConfig()); a state machine without a profile
+ * pays for it with a flag test per event delivery.
+ *
+ * @note The byte-stream fast path of FsmFeedBytes() and dispatch
+ *       code generated by fsmgen (@see PalmFsmGen.h) don't keep
+ *       all of the counters up to date.
+ *
+ * @param pFsm Non-NULL pointer to a sealed state machine (@see
+ *             FsmSealMachine()) or a state machine instance.
+ * @param aUsage Array of numUsage counters, indexed by state id
+ *               (the root state's at index 0, apStates[i]'s at
+ *               index i+1); need not be initialized.  The storage
+ *               MUST remain valid for as long as it's attached.
+ *               NULL detaches the profile.
+ * @param numUsage Number of elements in aUsage; at least
+ *                 FSM_SEALED_STATE_COUNT() of the number of
+ *                 user states.
+ */
+FSM_API void
+FsmDbgAttachProfile(FsmMachine* pFsm, FsmDbgStateUsage aUsage[],
+                    unsigned int numUsage);
+
+
+/**
+ * For profiling: Writes the usage counters of the given profiled
+ * state machine as text, for storing in a profile file.
+ *
+ * After a comment line with the state machine's name, each user
+ * state gets a line with its visits, deliveries and transitions
+ * counters, followed by its name (e.g., "1200 340 12 idle").
+ * States are matched by name when the profile is read back, so
+ * their names should be unique.
+ *
+ * @param pFsm Non-NULL pointer to a profiled state machine (@see
+ *             FsmDbgAttachProfile()).
+ * @param pBuf Buffer for the text; may be NULL if bufSize is 0.
+ * @param bufSize Size of pBuf, in bytes.
+ *
+ * @return unsigned int Length of the text, not counting the
+ *         terminating NUL; like snprintf(), the text is complete
+ *         only if it's less than bufSize.
+ */
+FSM_API unsigned int
+FsmDbgWriteProfile(FsmMachine* pFsm, char* pBuf, unsigned int bufSize);
+
+
+/**
+ * Reads the usage counters of the given states from a profile
+ * written by FsmDbgWriteProfile(), e.g., by an earlier run of the
+ * same program.
+ *
+ * Counters of states that the profile doesn't mention are set to
+ * 0; lines that don't parse are ignored.
+ *
+ * @note To look the profile's names up in O(log(numStates)) time,
+ *       this function sorts apStates by name; the result is
+ *       meant for FsmDbgOrderStatesByUsage(), which reorders the
+ *       states by use anyway.
+ *
+ * @param pProfile Profile text; need not be NUL-terminated.
+ * @param profileSize Length of pProfile, in bytes.
+ * @param apStates Non-NULL array of numStates user states; sorted
+ *                 by name on return.
+ * @param aUsage Non-NULL array of numStates elements for
+ *               returning the counters of apStates[i] (in the
+ *               sorted order) in aUsage[i].
+ * @param numStates Number of elements in apStates and aUsage.
+ *
+ * @return unsigned int Number of states that the profile
+ *         mentions.
+ */
+FSM_API unsigned int
+FsmDbgReadProfile(const char* pProfile, unsigned int profileSize,
+                  FsmState* apStates[], FsmDbgStateUsage aUsage[],
+                  unsigned int numStates);
+
+
+/**
+ * Sorts the given states by decreasing use, for sealing them in
+ * that order (@see FsmSealMachine()): the compact records of the
+ * hot states then share cache lines and pages.
+ *
+ * A state's use is the sum of its counters.  The sort is stable,
+ * and reorders aUsage along with apStates.
+ *
+ * @note Only the order of the states is profile-driven: the
+ *       entries of transition tables and subscription sets keep
+ *       their order (@see FsmDeclareStateTransitions()).  For
+ *       generated dispatch code, pass the profile to fsmgen
+ *       instead (@see PalmFsmGen.h).
+ *
+ * @param apStates Non-NULL array of numStates user states.
+ * @param aUsage Non-NULL array of the numStates states' counters
+ *               (@see FsmDbgReadProfile()).
+ * @param numStates Number of elements in apStates and aUsage.
+ */
+FSM_API void
+FsmDbgOrderStatesByUsage(FsmState* apStates[], FsmDbgStateUsage aUsage[],
+                         unsigned int numStates);
+
+
 
 
 
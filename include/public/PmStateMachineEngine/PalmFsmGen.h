@@ -0,0 +1,127 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ *******************************************************************************
+ * @file PalmFsmGen.h
+ *
+ * @brief  State Machine Engine's support API for generated
+ *         dispatch code.
+ *
+ * The fsmgen tool (tools/fsmgen) compiles a statechart
+ * description into a constant topology (@see
+ * FSM_CONST_TOPOLOGY()) and an event dispatch function that is
+ * specialized for it: a switch on the current state and the
+ * event, whose cases call the guards, actions and state handlers
+ * of the statechart directly, and take declarative transitions
+ * via precomputed sequences of exit and entry handler calls.
+ * The dispatch function replaces FsmDispatchEvent() for the
+ * instances of the generated definition, with the same
+ * semantics.
+ *
+ * The generated code shares the instance's runtime with SME, so
+ * that state handlers may keep using FsmBeginTransition(),
+ * FsmIsInState(), etc.; this header gives it access to that
+ * runtime.  It's NOT meant to be used by hand-written code.
+ *
+ * @note Generated dispatch doesn't log event deliveries (@see
+ *       FsmDbgEnableLogging()), nor count them in profiles (@see
+ *       FsmDbgAttachProfile()); to profile a generated machine,
+ *       drive its instances via FsmDispatchEvent().  fsmgen takes
+ *       the profile to lay out the generated code of the hot
+ *       states together.
+ *
+ * @note This API is NOT thread-safe
+ *******************************************************************************
+ */
+
+#ifndef STATE_MACHINE_ENGINE_FSM_GEN_H
+#define STATE_MACHINE_ENGINE_FSM_GEN_H
+
+
+#include "PalmFsm.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * The runtime of a state machine instance, as generated dispatch
+ * code sees it.
+ *
+ * Unlike SME's other structures, the layout of this one is public
+ * (it mirrors the leading fields of SME's internal state machine
+ * structure), so that generated code can track state transitions
+ * without calling into SME.  The states are the records of the
+ * definition's constant topology (@see FSM_CONST_USER_STATE()).
+ */
+typedef struct {
+    /// Current state; NULL while a state transition is underway
+    FsmState*   pCurrentState;
+
+    /// State to which a user event is being dispatched; NULL if none
+    FsmState*   pDispatchSrcState;
+
+    /// Target of the state transition that is underway; NULL if none
+    FsmState*   pTranTarget;
+
+    /// The state below which the transition's entry path begins
+    FsmState*   pEntryAnchor;
+} FsmGenRuntime;
+
+
+/**
+ * Returns the runtime of the given state machine instance
+ */
+#define FSM_GEN_RUNTIME(pFsm__)     ((FsmGenRuntime*)(pFsm__))
+
+
+/**
+ * Completes the dispatch of a user event that generated code
+ * delivered to a state handler, the way FsmDispatchEvent() does:
+ * if the handler requested a state transition (@see
+ * FsmBeginTransition()), enters the target state configuration,
+ * including the initial transitions.
+ *
+ * Generated code also calls it to finish the declarative
+ * transitions whose target state receives kFsmEventBegin: with
+ * the runtime's pTranTarget and pEntryAnchor set to that state,
+ * the target state configuration has been entered.
+ *
+ * @param pFsm Non-NULL pointer to a state machine instance.
+ * @param pEvt Non-NULL pointer to the event.
+ * @param isHandled The state handler's result.
+ *
+ * @return int isHandled; SME reports handlers that request a
+ *         state transition without handling the event, as
+ *         FsmDispatchEvent() does.
+ */
+FSM_API int
+FsmGenCompleteDispatch(FsmMachine* pFsm, const FsmEvent* pEvt, int isHandled);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif // STATE_MACHINE_ENGINE_FSM_GEN_H
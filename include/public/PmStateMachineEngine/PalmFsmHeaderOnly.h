@@ -0,0 +1,88 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ *******************************************************************************
+ * @file PalmFsmHeaderOnly.h
+ *
+ * @brief  Header-only (amalgamated) variant of the State Machine
+ *         Engine.
+ *
+ * Including this header *instead of* PalmFsm.h/PalmFsmDbg.h
+ * (and PalmFsmImage.h, PalmFsmLive.h) compiles the complete
+ * engine into the including translation unit, with all API
+ * functions having internal linkage.  This lets the compiler
+ * inline FsmDispatchEvent(), FsmBeginTransition(), etc. into
+ * the user's event loop and resolve calls to statically-known
+ * state handlers directly, instead of going through the shared
+ * library's PLT.  The API and its semantics are identical to
+ * those of the shared library.
+ *
+ * Usage:
+ *
+ * #include <PmStateMachineEngine/PalmFsmHeaderOnly.h>
+ *
+ * Restrictions:
+ *
+ *  * Every translation unit that includes this header gets its
+ *    own private copy of the engine.  An FsmMachine instance
+ *    (and its states) MUST be initialized and driven
+ *    exclusively via the API of ONE such copy; in particular,
+ *    do not pass machines initialized by the header-only engine
+ *    to code that uses the shared library, or vice versa.
+ *  * This header MUST be the first engine header included in the
+ *    translation unit (it may not be mixed with a prior include
+ *    of PalmFsm.h in the same translation unit).
+ *  * The engine's build configuration (FSM_CONFIG_xxx, @see
+ *    FsmBuildConfig.h) may be overridden by defining the
+ *    corresponding macros before including this header.
+ *
+ * @note The engine's implementation is provided by
+ *       PalmFsmEngine.inc, which is generated from the engine's
+ *       sources at build time and installed alongside this
+ *       header; like the other engine headers, it is found via
+ *       the include directory that contains PmStateMachineEngine/.
+ *
+ * @note This API is NOT thread-safe
+ *******************************************************************************
+ */
+
+#ifndef STATE_MACHINE_ENGINE_FSM_HEADER_ONLY_H
+#define STATE_MACHINE_ENGINE_FSM_HEADER_ONLY_H
+
+#ifdef STATE_MACHINE_ENGINE_FSM_H
+    #error "PalmFsmHeaderOnly.h must be included before PalmFsm.h"
+#endif
+
+
+#define FSM_CONFIG_HEADER_ONLY 1
+
+#if defined(__cplusplus)
+    #define FSM_API static inline
+#elif defined(__GNUC__)
+    #define FSM_API static __inline__
+#else
+    #define FSM_API static
+#endif
+
+
+#include <PmStateMachineEngine/PalmFsmEngine.inc>
+
+
+
+#endif // STATE_MACHINE_ENGINE_FSM_HEADER_ONLY_H
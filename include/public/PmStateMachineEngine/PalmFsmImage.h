@@ -0,0 +1,311 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ *******************************************************************************
+ * @file PalmFsmImage.h
+ *
+ * @brief  State Machine Engine's binary definition image API.
+ *
+ * A definition image is a position-independent binary form of a
+ * sealed state machine's topology: the state table with
+ * index-based parents, the event subscription sets and
+ * declarative transitions, and a pool of names.  State handlers,
+ * guards and actions are referred to by name, and bound to
+ * functions through the user's binding table when the image is
+ * loaded.
+ *
+ * Write an image with FsmWriteDefinitionImage() (e.g., at build
+ * time), store it in a file, and map the file into memory (e.g.,
+ * with mmap()) wherever the state machine is needed.  The image
+ * isn't parsed: FsmLoadDefinitionImage() validates it and binds
+ * the state records that the engine runs on in a single pass,
+ * while names and event subscription sets stay in the image, so
+ * that processes that map the same file share its pages.  The
+ * topology can thus be changed by replacing the file, without
+ * recompiling the code that uses it.
+ *
+ * Usage:
+ *
+ * int fd = open("MyFsm.fsmi", O_RDONLY);
+ * struct stat st;
+ * fstat(fd, &st);
+ * void* pImage = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+ *
+ * unsigned int numStates, numTransitions;
+ * FsmGetDefinitionImageInfo(pImage, st.st_size, &numStates,
+ *                           &numTransitions);
+ * // allocate FSM_SEALED_STATE_COUNT(numStates) FsmSealedState and
+ * // numTransitions FsmTransitionDef elements, then
+ * FsmLoadDefinitionImage(&def, pImage, st.st_size, kMyBindings,
+ *                        numBindings, pStorage, numStorageElements,
+ *                        aTransitions, numTransitions);
+ *
+ * FsmInitInstance(&instance, &def, pMyContext);
+ * FsmStart(FSM_INSTANCE_MACHINE(&instance),
+ *          FsmFindDefinitionState(&def, "idle"));
+ *
+ * @note Images use the host's byte order; images of the other
+ *       byte order are rejected.
+ *
+ * @note This API is NOT thread-safe
+ *******************************************************************************
+ */
+
+#ifndef STATE_MACHINE_ENGINE_FSM_IMAGE_H
+#define STATE_MACHINE_ENGINE_FSM_IMAGE_H
+
+
+#include "PalmFsm.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * An entry of the binding table that maps the names of state
+ * handlers, guards and actions in definition images to the
+ * functions; @see FsmWriteDefinitionImage() and
+ * FsmLoadDefinitionImage().
+ *
+ * An entry may bind a state handler, a guard and an action by
+ * the same name; unused fields are NULL.
+ */
+typedef struct {
+    const char*                 pName;      ///< Non-NULL, unique name
+    FsmStateHandlerFnType*      pHandler;   ///< state handler; or NULL
+    FsmTransitionGuardFnType*   pGuard;     ///< guard; or NULL
+    FsmTransitionActionFnType*  pAction;    ///< action; or NULL
+} FsmImageBinding;
+
+
+/**
+ * The definition image format, for tools that inspect or patch
+ * images; FsmGetDefinitionImageInfo() and FsmLoadDefinitionImage()
+ * validate every field, so patched images need not be trusted.
+ *
+ * An image consists of a header, followed by the state records
+ * (the root state's first, then the user states' in pre-order,
+ * so that a state's index is its pre-order number), the pool of
+ * event subscription sets, the pool of transitions, and the
+ * string pool.  Cross references are indexes into the tables and
+ * byte offsets into the string pool, so the image is
+ * position-independent.  All fields are 32 bits wide (or pairs of
+ * 16-bit fields), in the host's byte order.
+ */
+#define FSM_IMAGE_MAGIC     0x494D5346u     ///< "FSMI" in little-endian
+#define FSM_IMAGE_VERSION   1u
+
+/// Missing string pool offset or table index
+#define FSM_IMAGE_NONE      0xFFFFFFFFu
+
+/// The image header, at offset 0
+typedef struct {
+    unsigned int            magic_;
+    unsigned int            version_;
+    unsigned int            imageSize_;
+
+    /// Number of user states, and depth of the deepest state
+    unsigned int            numStates_;
+    unsigned int            maxDepth_;
+
+    /// String pool offset of the FSM's name
+    unsigned int            machineName_;
+
+    /// Byte offsets of the tables from the start of the image, and
+    /// their numbers of elements
+    unsigned int            statesOffset_;
+    unsigned int            eventIdsOffset_;
+    unsigned int            numEventIds_;
+    unsigned int            transitionsOffset_;
+    unsigned int            numTransitions_;
+    unsigned int            stringsOffset_;
+    unsigned int            stringsSize_;
+} FsmImageHeader;
+
+/// An element of the state table (numStates_ + 1 elements)
+typedef struct {
+    /// String pool offsets of the name of the state handler's
+    /// binding (FSM_IMAGE_NONE for the root state), and of the
+    /// state's name
+    unsigned int            handler_;
+    unsigned int            name_;
+
+    /// State indexes; initial_ is 0 if none
+    unsigned short          parent_;
+    unsigned short          walkParent_;
+    unsigned short          initial_;
+    unsigned short          lastOrder_;
+
+    unsigned short          depth_;
+    unsigned short          flags_;
+
+    /// Slices of the event id and transition pools; firstEventId_
+    /// is FSM_IMAGE_NONE if the state didn't declare its
+    /// subscription set
+    unsigned int            firstEventId_;
+    unsigned int            firstTransition_;
+    unsigned short          numEventIds_;
+    unsigned short          numTransitions_;
+} FsmImageStateRecord;
+
+/// An element of the transition pool
+typedef struct {
+    FsmEventIdType          evtId_;
+
+    /// Target state index
+    unsigned int            target_;
+
+    /// String pool offsets of the names of the guard's and the
+    /// action's bindings; FSM_IMAGE_NONE if none
+    unsigned int            guard_;
+    unsigned int            action_;
+} FsmImageTransitionRecord;
+
+
+/**
+ * Writes the definition image of the given sealed state machine.
+ *
+ * The image holds the state machine's user states in the order in
+ * which FsmSealMachine() received them, and refers to their state
+ * handlers, guards and actions by the names that aBindings gives
+ * them.  Chains of initial substates are resolved to their
+ * innermost states.
+ *
+ * @param pFsm Non-NULL pointer to a sealed state machine (@see
+ *             FsmSealMachine()); not an instance.
+ * @param aBindings Array of numBindings entries that name every
+ *                  state handler, guard and action of the state
+ *                  machine.
+ * @param numBindings Number of elements in aBindings.
+ * @param pBuf Buffer for the image; may be NULL if bufSize is 0.
+ *             MUST be aligned for unsigned int.
+ * @param bufSize Size of pBuf, in bytes.
+ *
+ * @return unsigned int Size of the image, in bytes; the image is
+ *         written only if it fits in bufSize (call with bufSize 0
+ *         to query the size).  0 if aBindings doesn't name one of
+ *         the state machine's functions.
+ */
+FSM_API unsigned int
+FsmWriteDefinitionImage(FsmMachine* pFsm, const FsmImageBinding aBindings[],
+                        unsigned int numBindings, void* pBuf,
+                        unsigned int bufSize);
+
+
+/**
+ * Validates the header of the given definition image, and
+ * returns the sizes of the storage that FsmLoadDefinitionImage()
+ * needs for it.
+ *
+ * @param pImage Non-NULL pointer to the image; MUST be aligned
+ *               for unsigned int.
+ * @param imageSize Size of the image, in bytes.
+ * @param pNumStates Non-NULL pointer to variable for returning
+ *                   the number of user states.
+ * @param pNumTransitions Non-NULL pointer to variable for
+ *                        returning the number of declarative
+ *                        transitions.
+ *
+ * @return int true (non-zero) if the header is valid; false
+ *         (zero) otherwise.
+ */
+FSM_API int
+FsmGetDefinitionImageInfo(const void* pImage, unsigned int imageSize,
+                          unsigned int* pNumStates,
+                          unsigned int* pNumTransitions);
+
+
+/**
+ * Initializes the given definition from the given definition
+ * image (@see FsmWriteDefinitionImage()); instances of the
+ * definition (@see FsmInitInstance()) have the same semantics as
+ * those of the state machine that the image was written from.
+ *
+ * The image is validated in full, so it need not be trusted.  The
+ * state records and transitions are bound in the given storage;
+ * state names and event subscription sets are referred to in the
+ * image.  The user state objects, which state handlers receive
+ * and which transitions target, are the state records in pStorage
+ * (@see FsmFindDefinitionState()).
+ *
+ * @note The image and the storage MUST remain valid (and
+ *       unmodified) for the lifetime of the definition and its
+ *       instances.
+ *
+ * @param pDef Non-NULL pointer to storage for the definition;
+ *             need not be initialized.
+ * @param pImage Non-NULL pointer to the image; MUST be aligned
+ *               for unsigned int.
+ * @param imageSize Size of the image, in bytes.
+ * @param aBindings Array of numBindings entries that bind every
+ *                  name in the image to a function of the right
+ *                  kind.
+ * @param numBindings Number of elements in aBindings.
+ * @param pStorage Non-NULL pointer to an array of at least
+ *                 FSM_SEALED_STATE_COUNT(numStates) elements
+ *                 (@see FsmGetDefinitionImageInfo()); need not
+ *                 be initialized.
+ * @param numStorageElements Number of elements in pStorage.
+ * @param aTransitions Array of at least numTransitions elements
+ *                     (@see FsmGetDefinitionImageInfo()); need
+ *                     not be initialized.  May be NULL if the
+ *                     image has no transitions.
+ * @param numTransitionElements Number of elements in
+ *                              aTransitions.
+ *
+ * @return int true (non-zero) on success; false (zero) if the
+ *         image is malformed, a name isn't bound, or the storage
+ *         is too small, in which case the definition MUST NOT be
+ *         used.
+ */
+FSM_API int
+FsmLoadDefinitionImage(FsmDefinition* pDef, const void* pImage,
+                       unsigned int imageSize,
+                       const FsmImageBinding aBindings[],
+                       unsigned int numBindings, FsmSealedState* pStorage,
+                       unsigned int numStorageElements,
+                       FsmTransitionDef* aTransitions,
+                       unsigned int numTransitionElements);
+
+
+/**
+ * Looks up the user state object of the given definition's state
+ * of the given name; handy for starting instances of loaded
+ * definitions, which have no state objects of their own.
+ *
+ * @param pDef Non-NULL pointer to an initialized definition.
+ * @param pName Non-NULL state name.
+ *
+ * @return FsmState* The first state of the given name in the
+ *         order of the definition's states; NULL if none.
+ */
+FSM_API FsmState*
+FsmFindDefinitionState(const FsmDefinition* pDef, const char* pName);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif // STATE_MACHINE_ENGINE_FSM_IMAGE_H
@@ -0,0 +1,286 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ *******************************************************************************
+ * @file PalmFsmLive.h
+ *
+ * @brief  State Machine Engine's live definition API.
+ *
+ * A live definition is a state machine definition (@see
+ * FsmInitDefinition()) whose instances can be moved to a new
+ * version of the topology while they run, e.g., to ship a fix of
+ * a statechart without restarting the process.  The publisher
+ * publishes each new version along with a map from the state ids
+ * of the previous version to those of the new one; every live
+ * instance moves to the newest version at its next
+ * run-to-completion boundary (i.e., on its next call to
+ * FsmDispatchEvent()), and carries on in the corresponding state.
+ *
+ * Dispatch takes no locks: instances pin the version that they
+ * run on with an atomic count, and the hot path only checks
+ * whether that version has been superseded.  A superseded
+ * version, along with its definition, topology and id map, may be
+ * reclaimed once all the instances that ran on it have moved on
+ * or been released (@see FsmReclaimLiveVersion()).
+ *
+ * Usage:
+ *
+ * // Start-up
+ * FsmInitLiveDefinition(&live, &versions[0], &def1);
+ * FsmInitLiveInstance(&instance, &live, pMyContext);
+ * FsmStart(FSM_INSTANCE_MACHINE(&instance),
+ *          FsmFindDefinitionState(
+ *              FsmGetLiveInstanceDefinition(
+ *                  FSM_INSTANCE_MACHINE(&instance)), "idle"));
+ *
+ * // Publisher, e.g., after loading the new image into def2
+ * FsmMapDefinitionStates(&def1, &def2, aIdMap, numSealedStates1);
+ * FsmPublishLiveDefinition(&live, &versions[1], &def2, aIdMap,
+ *                          numSealedStates1);
+ * ...
+ * while ((pOld = FsmReclaimLiveVersion(&live)) != NULL) {
+ *     // free pOld, along with its definition's storage and id map
+ * }
+ *
+ * @note The publisher's functions (FsmInitLiveDefinition(),
+ *       FsmPublishLiveDefinition(), FsmReclaimLiveVersion()) MUST
+ *       be called from one thread at a time.  Each live instance
+ *       runs in a single thread as usual, and any number of them
+ *       may attach, dispatch and be released concurrently with the
+ *       publisher.  On compilers without the GNU atomic builtins,
+ *       live definitions are confined to a single thread.
+ *
+ * @note State handlers of a live instance MUST refer to the
+ *       states of the version that it runs on (e.g., via
+ *       FsmFindDefinitionState() of FsmGetLiveInstanceDefinition()),
+ *       not to the state objects of another version.
+ *
+ * @note Only the engine's dispatch moves instances: the
+ *       specialized dispatch functions that fsmgen generates (@see
+ *       PalmFsmGen.h) are compiled against one topology and
+ *       don't support live definitions.
+ *******************************************************************************
+ */
+
+#ifndef STATE_MACHINE_ENGINE_FSM_LIVE_H
+#define STATE_MACHINE_ENGINE_FSM_LIVE_H
+
+
+#include "PalmFsm.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * A live definition; @see FsmInitLiveDefinition()
+ *
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API
+ */
+typedef struct {
+    void*                   opaque_[3];
+} FsmLiveDefinition;
+
+/**
+ * A version of a live definition; @see
+ * FsmPublishLiveDefinition()
+ *
+ * @note All fields ending in underscore are for internal use
+ *       only and off-limits to users of the API
+ */
+typedef struct {
+    void*                   opaque_[4];
+} FsmLiveVersion;
+
+
+/**
+ * Initializes a live definition with its first version.
+ *
+ * @param pLive Non-NULL pointer to storage for the live
+ *              definition; need not be initialized.
+ * @param pVersion Non-NULL pointer to storage for the version
+ *                 record; need not be initialized.  MUST remain
+ *                 valid until the version is reclaimed.
+ * @param pDef Non-NULL pointer to an initialized definition
+ *             (@see FsmInitDefinition()); MUST remain valid (along
+ *             with its topology) until the version is reclaimed.
+ */
+FSM_API void
+FsmInitLiveDefinition(FsmLiveDefinition* pLive, FsmLiveVersion* pVersion,
+                      const FsmDefinition* pDef);
+
+
+/**
+ * Fills in the map from the state ids of one definition to those
+ * of another, by state name; handy for publishing a new version
+ * of a live definition (@see FsmPublishLiveDefinition()).
+ *
+ * The state ids of a definition range from 0 (the root state) to
+ * FSM_SEALED_STATE_COUNT(numStates) - 1.  Each of pFrom's user
+ * states is mapped to the first of pTo's states of the same name
+ * (@see FsmFindDefinitionState()), and the root state to the
+ * root state.
+ *
+ * @param pFrom Non-NULL pointer to an initialized definition.
+ * @param pTo Non-NULL pointer to an initialized definition.
+ * @param aIdMap Array of mapSize elements for the map.
+ * @param mapSize Number of elements in aIdMap; MUST be
+ *                FSM_SEALED_STATE_COUNT(numStates) for pFrom's
+ *                numStates.
+ *
+ * @return unsigned int The number of pFrom's user states without
+ *         a namesake in pTo, whose elements of aIdMap are set to
+ *         0; the user MUST map them to other states before
+ *         publishing the map.
+ */
+FSM_API unsigned int
+FsmMapDefinitionStates(const FsmDefinition* pFrom, const FsmDefinition* pTo,
+                       unsigned short aIdMap[], unsigned int mapSize);
+
+
+/**
+ * Publishes a new version of a live definition.
+ *
+ * Returns right away: every instance of the live definition moves
+ * to the new version at its next run-to-completion boundary, and
+ * its current state becomes the state that aIdMap maps it to.
+ * The new state is neither exited nor entered, and the instance's
+ * transition cache (@see FsmAttachTransitionCache()) is cleared;
+ * its profile (@see FsmDbgAttachProfile()), which counts the
+ * previous version's states, is detached.
+ *
+ * @param pLive Non-NULL pointer to an initialized live
+ *              definition.
+ * @param pVersion Non-NULL pointer to storage for the version
+ *                 record; need not be initialized.  MUST remain
+ *                 valid until the version is reclaimed.
+ * @param pDef Non-NULL pointer to an initialized definition; MUST
+ *             remain valid (along with its topology) until the
+ *             version is reclaimed.
+ * @param aIdMap Map from the state ids of the current version to
+ *               those of pDef (@see FsmMapDefinitionStates());
+ *               MUST map the root state to the root state, and
+ *               every other state to one of pDef's user states.
+ *               May be NULL if the ids are the same in both
+ *               versions.  MUST remain valid until the version is
+ *               reclaimed.
+ * @param mapSize Number of elements in aIdMap: the number of
+ *                state ids of the current version; ignored if
+ *                aIdMap is NULL.
+ */
+FSM_API void
+FsmPublishLiveDefinition(FsmLiveDefinition* pLive, FsmLiveVersion* pVersion,
+                         const FsmDefinition* pDef,
+                         const unsigned short aIdMap[],
+                         unsigned int mapSize);
+
+
+/**
+ * Reclaims the oldest version of a live definition if no
+ * instances run on it anymore.
+ *
+ * Versions are reclaimed in the order in which they were
+ * published; the current version is never reclaimed.  Call
+ * repeatedly to reclaim every version that can be reclaimed.
+ *
+ * @note An instance that's idle (doesn't dispatch events) keeps
+ *       running on its version; call FsmUpdateLiveInstance() or
+ *       FsmReleaseLiveInstance() on it to let the version go.
+ *
+ * @param pLive Non-NULL pointer to an initialized live
+ *              definition.
+ *
+ * @return FsmLiveVersion* The reclaimed version record (of
+ *         FsmInitLiveDefinition() or FsmPublishLiveDefinition()),
+ *         which the engine won't access anymore; the storage of
+ *         its definition and id map may be freed along with it.
+ *         NULL if the oldest version can't be reclaimed yet.
+ */
+FSM_API FsmLiveVersion*
+FsmReclaimLiveVersion(FsmLiveDefinition* pLive);
+
+
+/**
+ * Initializes an instance of the current version of the given
+ * live definition; @see FsmInitInstance().
+ *
+ * @param pInstance Non-NULL pointer to storage for the instance;
+ *                  need not be initialized.
+ * @param pLive Non-NULL pointer to an initialized live
+ *              definition.
+ * @param pContext Optional user context pointer; may be NULL.
+ */
+FSM_API void
+FsmInitLiveInstance(FsmInstance* pInstance, FsmLiveDefinition* pLive,
+                    void* pContext);
+
+
+/**
+ * Releases the version that the given live instance runs on; the
+ * instance MUST NOT be used afterwards (but may be initialized
+ * again).
+ *
+ * @param pInstance Non-NULL pointer to an instance initialized by
+ *                  FsmInitLiveInstance(); MUST NOT be dispatching
+ *                  an event.
+ */
+FSM_API void
+FsmReleaseLiveInstance(FsmInstance* pInstance);
+
+
+/**
+ * Moves the given live instance to the newest version of its
+ * definition, if it doesn't run on it already; FsmDispatchEvent()
+ * does it before dispatching each event.
+ *
+ * @param pFsm Non-NULL FsmMachine pointer of an instance (@see
+ *             FSM_INSTANCE_MACHINE()); MUST NOT be dispatching an
+ *             event.  No-op if the instance isn't live.
+ *
+ * @return int true (non-zero) if the instance moved; false
+ *         (zero) otherwise.
+ */
+FSM_API int
+FsmUpdateLiveInstance(FsmMachine* pFsm);
+
+
+/**
+ * Returns the definition of the version that the given live
+ * instance runs on.
+ *
+ * @param pFsm Non-NULL FsmMachine pointer of an instance
+ *             initialized by FsmInitLiveInstance().
+ *
+ * @return const FsmDefinition*
+ */
+FSM_API const FsmDefinition*
+FsmGetLiveInstanceDefinition(const FsmMachine* pFsm);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif // STATE_MACHINE_ENGINE_FSM_LIVE_H
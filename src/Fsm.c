@@ -32,6 +32,7 @@
  * ****************************************************************************
  */
 
+#include <stddef.h> ///< for offsetof
 #include <string.h>
 #include <stdio.h>  ///< for snprintf
 
@@ -41,9 +42,15 @@
 
 #include "PalmFsm.h"
 #include "PalmFsmDbg.h"
+#include "PalmFsmGen.h"
+#include "PalmFsmLive.h"
 
 #include "FsmPrv.h"
 
+#if FSM_CONFIG_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 
 /**
  * This structure contains the compile-time checks for this
@@ -58,11 +65,99 @@ typedef struct CompileAssert {
                                           sizeof(FsmMachineImpl))];
 
     /**
-     * If FsmState and FsmStateImpl structure sizes don't match, the
-     * compiler should generate a "divide by zero" error.
+     * If FsmState and FsmUserStateImpl structure sizes don't match,
+     * the compiler should generate a "divide by zero" error.
      */
     char    FsmState_is_correct_size[1/(sizeof(FsmState) ==
-                                        sizeof(FsmStateImpl))];
+                                        sizeof(FsmUserStateImpl))];
+
+    /**
+     * If FsmTransitionPlan and FsmTransitionPlanImpl structure
+     * sizes don't match, the compiler should generate a "divide by
+     * zero" error.
+     */
+    char    FsmTransitionPlan_is_correct_size[
+        1/(sizeof(FsmTransitionPlan) == sizeof(FsmTransitionPlanImpl))];
+
+    /**
+     * If FsmTransitionCache and FsmTransitionCacheImpl structure
+     * sizes don't match, the compiler should generate a "divide by
+     * zero" error.
+     */
+    char    FsmTransitionCache_is_correct_size[
+        1/(sizeof(FsmTransitionCache) == sizeof(FsmTransitionCacheImpl))];
+
+    /**
+     * If FsmSealedState doesn't provide room for exactly one
+     * compact state record plus one name pointer, the compiler
+     * should generate a "divide by zero" error.
+     */
+    char    FsmSealedState_is_correct_size[
+        1/(sizeof(FsmSealedState) ==
+           sizeof(FsmStateImpl) + sizeof(const char*))];
+
+    /**
+     * If the public FsmConstState record doesn't match the size of
+     * FsmStateImpl, whose layout it mirrors, the compiler should
+     * generate a "divide by zero" error.
+     */
+    char    FsmConstState_is_correct_size[
+        1/(sizeof(FsmConstState) == sizeof(FsmStateImpl))];
+
+    /**
+     * If the public FsmGenRuntime doesn't match the size of
+     * FsmRuntimeImpl, whose layout it mirrors, the compiler should
+     * generate a "divide by zero" error.
+     */
+    char    FsmGenRuntime_is_correct_size[
+        1/(sizeof(FsmGenRuntime) == sizeof(FsmRuntimeImpl))];
+
+    /**
+     * If FsmDbgLogConfig and FsmLogConfigImpl structure sizes don't
+     * match, the compiler should generate a "divide by zero" error.
+     */
+    char    FsmDbgLogConfig_is_correct_size[
+        1/(sizeof(FsmDbgLogConfig) == sizeof(FsmLogConfigImpl))];
+
+    /**
+     * If the runtime fields that event dispatch and state
+     * transitions use (the ones that precede pProfile_) take more
+     * than eight pointers' worth (64 bytes on LP64 targets), the
+     * compiler should generate a "divide by zero" error.  Whether
+     * they share one cache line depends on where the user places
+     * the FsmMachine.
+     */
+    char    FsmMachine_hot_fields_fit_64_bytes[
+        1/(offsetof(FsmMachineImpl, pProfile_) <= 8 * sizeof(void*))];
+
+    /**
+     * If FsmByteDfa and FsmByteDfaImpl (or FsmByteDfaCell and
+     * FsmByteDfaCellImpl) structure sizes don't match, or the SIMD
+     * scan record doesn't fit in two cells, the compiler should
+     * generate a "divide by zero" error.
+     */
+    char    FsmByteDfa_is_correct_size[
+        1/(sizeof(FsmByteDfa) == sizeof(FsmByteDfaImpl))];
+    char    FsmByteDfaCell_is_correct_size[
+        1/(sizeof(FsmByteDfaCell) == sizeof(FsmByteDfaCellImpl))];
+    char    FsmByteDfaScan_fits_two_cells[
+        1/(sizeof(FsmByteDfaScanImpl) <= 2 * sizeof(FsmByteDfaCellImpl))];
+
+    /**
+     * If FsmDefinition and FsmDefinitionImpl (or FsmInstance and
+     * FsmInstanceImpl) structure sizes don't match, or an
+     * instance's fields that precede pContext_ don't take as much
+     * room as the fields of FsmMachineImpl that precede rootState_
+     * (which they mirror), the compiler should generate a "divide by
+     * zero" error.
+     */
+    char    FsmDefinition_is_correct_size[
+        1/(sizeof(FsmDefinition) == sizeof(FsmDefinitionImpl))];
+    char    FsmInstance_is_correct_size[
+        1/(sizeof(FsmInstance) == sizeof(FsmInstanceImpl))];
+    char    FsmInstance_mirrors_FsmMachine[
+        1/(offsetof(FsmInstanceImpl, pContext_) ==
+           offsetof(FsmMachineImpl, rootState_))];
 } CompileAssert;
 
 
@@ -73,6 +168,12 @@ static const FsmEvent g_beginEvt    = {kFsmEventBegin};
 static const FsmEvent g_entryEvt    = {kFsmEventEnterScope};
 static const FsmEvent g_exitEvt     = {kFsmEventExitScope};
 
+/**
+ * Empty event subscription set; the root state subscribes to
+ * it, since FsmRootStateHandler() doesn't handle any user events
+ */
+static const FsmEventIdType g_noEventIds[1] = {0};
+
 
 
 /**
@@ -81,13 +182,58 @@ static const FsmEvent g_exitEvt     = {kFsmEventExitScope};
 static void
 DoEntryActions(FsmMachineImpl* pFsm);
 
+static int
+DispatchFlatEvent(FsmMachineImpl* pFsm, const FsmEvent* pEvt);
+
+static void
+DoFlatEntryActions(FsmMachineImpl* pFsm);
+
+static int
+RecordEntryPath(FsmMachineImpl* pFsm, FsmStateImpl* pAncestor,
+                FsmStateImpl* pDescendant, int stride,
+                FsmStateImpl* apPath[FSM_CONFIG_ENTRY_PATH_CAPACITY]);
+
+static void
+EnterLongEntryPath(FsmMachineImpl* pFsm, FsmStateImpl* pAncestor,
+                   FsmStateImpl* pDescendant, int size);
+
+static FsmStateImpl*
+GetTransitionAnchor(FsmMachineImpl* pFsm, FsmStateImpl* pMainSrc,
+                    FsmStateImpl* pTarget);
+
+static FsmStateImpl*
+FindTransitionAnchor(FsmStateImpl* pMainSrc, FsmStateImpl* pTarget);
+
+static FsmStateImpl*
+FindCommonAncestor(FsmStateImpl* pState1, FsmStateImpl* pState2);
+
+static FsmStateImpl*
+GetEngineState(const FsmMachineImpl* pFsm, FsmStateImpl* pUserState);
+
+static int
+IsSubscribedToEvent(const FsmStateImpl* pState, FsmEventIdType evtId);
+
+static const FsmTransitionDef*
+FindDeclaredTransition(FsmMachineImpl* pFsm, const FsmStateImpl* pState,
+                       const FsmEvent* pEvt);
+
+static FsmStateImpl*
+GetInitialDrillDownState(FsmStateImpl* pState);
+
 static void
-RecordInitialEntryPath(FsmMachineImpl* pFsm, FsmStateImpl* pAncestor,
-                       FsmStateImpl* pDescendant);
+NumberStates(FsmMachineImpl* pFsm);
+
+static void
+InitState(FsmUserStateImpl* pUserState, FsmStateHandlerFnType* pHandler,
+          const char* pName, unsigned int flags);
+
+static const unsigned char*
+SkipSelfLoopBytes(const FsmByteDfaImpl* pDfa, const FsmByteDfaCellImpl* pRow,
+                  const unsigned char* p, const unsigned char* pEnd);
 
 /**
  * Delivers the given event, and optionally logs it (logging
- * depends on the pFsm->logOutKind_ setting)
+ * depends on the pFsm->pLog_ configuration)
  * 
  * @param pState
  * @param pFsm
@@ -114,9 +260,14 @@ FsmInitMachine(FsmMachine* pOpaqueFsm, const char* pName)
     FSM_ASSERT(pFsm);
 
     memset(pFsm, 0, sizeof(*pFsm));
-    pFsm->logThresh_ = kFsmDbgLogLevelInfo;
-    FsmInitState(&pFsm->rootState_.pub, &RootStateHandler, "<ROOT>");
-    pFsm->pName_ = (pName && *pName) ? pName : "<UNNAMED-FSM>";
+    FsmInitState(&pFsm->rootState_.pub, &FsmRootStateHandler,
+                 (pName && *pName) ? pName : "<UNNAMED-FSM>");
+    FsmDeclareStateEvents(&pFsm->rootState_.pub, NULL, 0);
+    pFsm->pLastInserted_ = &pFsm->rootState_.impl;
+
+    /// Logging is disabled; pLog_ stays NULL until the FsmDbg API
+    /// configures it
+    pFsm->log_.logThresh_ = kFsmDbgLogLevelInfo;
 }
 
 
@@ -127,14 +278,23 @@ void
 FsmInitState(FsmState* pOpaqueState,
              FsmStateHandlerFnType* pStateHandlerCbFunc, const char* pName)
 {
-    FsmStateImpl* pState = (FsmStateImpl*)pOpaqueState;
+    FsmInitStateEx(pOpaqueState, pStateHandlerCbFunc, pName, 0);
+}
 
-    FSM_ASSERT(pState);
-    FSM_ASSERT(pStateHandlerCbFunc);
 
-    pState->pParent_ = NULL;
-    pState->pHandler_ = pStateHandlerCbFunc;
-    pState->pName_ = (pName && *pName) ? pName : "<UNNAMED-STATE>";
+/**
+ * ****************************************************************************
+ */
+void
+FsmInitStateEx(FsmState* pOpaqueState,
+               FsmStateHandlerFnType* pStateHandlerCbFunc, const char* pName,
+               unsigned int flags)
+{
+    FsmUserStateImpl* pUserState = (FsmUserStateImpl*)pOpaqueState;
+
+    FSM_ASSERT(pUserState);
+
+    InitState(pUserState, pStateHandlerCbFunc, pName, flags);
 }
 
 
@@ -146,26 +306,212 @@ FsmInsertState(FsmMachine* pOpaqueFsm, FsmState* pOpaqueState, FsmState* pParent
 {
     FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
     FsmStateImpl*   pState = (FsmStateImpl*)pOpaqueState;
-    int i;
+    FsmStateImpl*   pAncestor = NULL;
 
 
     FSM_ASSERT(pFsm);
-    FSM_ASSERT(&RootStateHandler == pFsm->rootState_.impl.pHandler_);
+    FSM_ASSERT(!pFsm->isInstance_ && "Can't insert into an FSM instance");
+    FSM_ASSERT(&FsmRootStateHandler == pFsm->rootState_.impl.state_.pHandler_);
+    FSM_ASSERT(!pFsm->pSealedStates_ && "Can't insert into a sealed FSM");
+    FSM_ASSERT(!pFsm->isNumbered_ && "Can't insert after FsmStart()");
     FSM_ASSERT(pState);
     FSM_ASSERT(pState->pHandler_);
     FSM_ASSERT(!pState->pParent_);
 
+    /// The root state counts all inserted states; state ids are 16-bit,
+    /// so reject the insertion in release builds, too
+    if (pFsm->rootState_.impl.state_.lastOrder_ >= FSM_MAX_USER_STATES) {
+        FSM_LOG_FATAL(pFsm,
+                      "FSM.%s(%p/c=%p): ERROR: Can't insert state %s: " \
+                      "too many states (the limit is %d)",
+                      FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                      FSM_STATE_NAME(pState), FSM_MAX_USER_STATES);
+        FSM_VERIFY(FALSE && "Too many states");
+    }
+
     pState->pParent_ = 
-        pParent ? (FsmStateImpl*)pParent : &pFsm->rootState_.impl;
+        pParent ? (FsmStateImpl*)pParent : &pFsm->rootState_.impl.state_;
 
-    /// Validate state nesting and path to root state
-    pState = pState->pParent_;
-    i = 1;
-    while (pState != &pFsm->rootState_.impl) {
-        FSM_ASSERT(i < kFsmMaxStateNestingDepth);
-        ++i;
-        pState = pState->pParent_;
+    /// Validate state nesting: the parent must have been inserted already,
+    /// so its depth is final
+    FSM_ASSERT(pState->pParent_ == &pFsm->rootState_.impl.state_ ||
+               pState->pParent_->pParent_);
+
+    /// @note The state limit above bounds the depth, too; check it
+    ///       anyway, as the depths are 16-bit
+    FSM_VERIFY(pState->pParent_->depth_ < 0xFFFF && "State nested too deep");
+    pState->depth_ = pState->pParent_->depth_ + 1;
+
+    if (pState->depth_ > pFsm->maxDepth_) {
+        pFsm->maxDepth_ = pState->depth_;
+    }
+
+    /// Count the new state among its ancestors' descendants
+    for (pAncestor = pState->pParent_; pAncestor;
+          pAncestor = pAncestor->pParent_) {
+        FSM_ASSERT(pAncestor->lastOrder_ < 0xFFFF && "Too many states");
+        ++pAncestor->lastOrder_;
+    }
+
+    pFsm->pLastInserted_->pNextInserted_ = (FsmUserStateImpl*)pState;
+    pFsm->pLastInserted_ = (FsmUserStateImpl*)pState;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmBuildStates(FsmMachine* pOpaqueFsm, const FsmStateRecord aRecords[],
+               FsmState* const apStates[], unsigned int numStates)
+{
+    FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
+    FsmStateImpl*   pRoot = NULL;
+    FsmUserStateImpl* pLastInserted = NULL;
+    unsigned short  maxDepth = 0;
+    unsigned int    i;
+
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(!pFsm->isInstance_ && "Can't insert into an FSM instance");
+    FSM_ASSERT(&FsmRootStateHandler == pFsm->rootState_.impl.state_.pHandler_);
+    FSM_ASSERT(!pFsm->pSealedStates_ && "Can't insert into a sealed FSM");
+    FSM_ASSERT(!pFsm->isNumbered_ && "Can't insert after FsmStart()");
+    FSM_ASSERT(aRecords);
+    FSM_ASSERT(apStates);
+
+    pRoot = &pFsm->rootState_.impl.state_;
+
+    /// @see FsmInsertState()
+    if (numStates > (unsigned int)(FSM_MAX_USER_STATES - pRoot->lastOrder_)) {
+        FSM_LOG_FATAL(pFsm,
+                      "FSM.%s(%p/c=%p): ERROR: Can't build %u states: " \
+                      "too many states (the limit is %d)",
+                      FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                      numStates, FSM_MAX_USER_STATES);
+        FSM_VERIFY(FALSE && "Too many states");
+    }
+    pLastInserted = pFsm->pLastInserted_;
+    maxDepth = pFsm->maxDepth_;
+
+    /// Initialize and link the states; parents come first, so their depths
+    /// are final by the time their children get here
+    for (i = 0; i < numStates; ++i) {
+        const FsmStateRecord*   pRecord = &aRecords[i];
+        FsmStateImpl*           pState = (FsmStateImpl*)apStates[i];
+
+        FSM_ASSERT(pState);
+        FSM_ASSERT(pRecord->parent < (int)i &&
+                   "Parent record MUST precede its children");
+
+        InitState((FsmUserStateImpl*)pState, pRecord->pHandler, pRecord->pName,
+                  pRecord->flags);
+
+        pState->pParent_ = (pRecord->parent < 0)
+            ? pRoot : (FsmStateImpl*)apStates[pRecord->parent];
+        FSM_VERIFY(pState->pParent_->depth_ < 0xFFFF &&
+                   "State nested too deep");
+        pState->depth_ = pState->pParent_->depth_ + 1;
+
+        if (pState->depth_ > maxDepth) {
+            maxDepth = pState->depth_;
+        }
+
+        pLastInserted->pNextInserted_ = (FsmUserStateImpl*)pState;
+        pLastInserted = (FsmUserStateImpl*)pState;
+    }
+
+    pFsm->maxDepth_ = maxDepth;
+    pFsm->pLastInserted_ = pLastInserted;
+
+    /// Count descendants bottom-up, instead of walking up to the root
+    /// state for each state like FsmInsertState() does; children come
+    /// after their parents, so each state's count is final by the time
+    /// it's added to its parent's
+    for (i = numStates; i-- > 0;) {
+        FsmStateImpl* pState = (FsmStateImpl*)apStates[i];
+        FsmStateImpl* pParent = pState->pParent_;
+
+        FSM_ASSERT((unsigned int)pParent->lastOrder_ + pState->lastOrder_ <
+                   0xFFFF && "Too many states");
+
+        pParent->lastOrder_ =
+            (unsigned short)(pParent->lastOrder_ + pState->lastOrder_ + 1);
+    }
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmDeclareStateEvents(FsmState* pOpaqueState,
+                      const FsmEventIdType* pSortedEventIds,
+                      unsigned int numEventIds)
+{
+    FsmStateImpl*   pState = (FsmStateImpl*)pOpaqueState;
+    unsigned int    i;
+
+    FSM_ASSERT(pState);
+    FSM_ASSERT(pState->pHandler_);
+    FSM_ASSERT(pSortedEventIds || !numEventIds);
+    FSM_ASSERT(numEventIds <= 0xFFFF);
+
+    /// Validate the set: user events only, in strictly ascending order
+    for (i = 0; i < numEventIds; ++i) {
+        FSM_ASSERT(pSortedEventIds[i] >= kFsmEventFirstUserEvent);
+        FSM_ASSERT(!i || pSortedEventIds[i - 1] < pSortedEventIds[i]);
     }
+
+    pState->pEventIds_ = pSortedEventIds ? pSortedEventIds : g_noEventIds;
+    pState->numEventIds_ = (unsigned short)numEventIds;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmDeclareStateTransitions(FsmState* pOpaqueState,
+                           const FsmTransitionDef* pSortedTransitions,
+                           unsigned int numTransitions)
+{
+    FsmStateImpl*   pState = (FsmStateImpl*)pOpaqueState;
+    unsigned int    i;
+
+    FSM_ASSERT(pState);
+    FSM_ASSERT(pState->pHandler_);
+    FSM_ASSERT(pSortedTransitions);
+    FSM_ASSERT(numTransitions > 0 && numTransitions <= 0xFFFF);
+
+    /// Validate the table: user events only, in ascending order
+    for (i = 0; i < numTransitions; ++i) {
+        FSM_ASSERT(pSortedTransitions[i].evtId >= kFsmEventFirstUserEvent);
+        FSM_ASSERT(pSortedTransitions[i].pTarget);
+        FSM_ASSERT(!i || pSortedTransitions[i - 1].evtId <=
+                   pSortedTransitions[i].evtId);
+    }
+
+    pState->pTransitions_ = pSortedTransitions;
+    pState->numTransitions_ = (unsigned short)numTransitions;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmSetInitialSubstate(FsmState* pOpaqueState, FsmState* pInitialSubstate)
+{
+    FsmStateImpl*   pState = (FsmStateImpl*)pOpaqueState;
+
+    FSM_ASSERT(pState);
+    FSM_ASSERT(pState->pHandler_);
+    FSM_ASSERT(pInitialSubstate);
+    FSM_ASSERT(pInitialSubstate != pOpaqueState);
+
+    /// @note The substate may not have been inserted yet, so its
+    ///       ancestry is validated when the chain is drilled into
+    pState->pInitial_ = (FsmStateImpl*)pInitialSubstate;
 }
 
 
@@ -179,19 +525,26 @@ FsmStart(FsmMachine* pOpaqueFsm, FsmState* pInitialOpaqueState)
     FsmStateImpl*   pInitialState = (FsmStateImpl*)pInitialOpaqueState;
 
     FSM_ASSERT(pFsm);
-    FSM_ASSERT(&RootStateHandler == pFsm->rootState_.impl.pHandler_);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
     FSM_ASSERT(pInitialState);
     FSM_ASSERT(pInitialState->pHandler_);
     FSM_ASSERT(pInitialState->pParent_);
 
+    pInitialState = GetEngineState(pFsm, pInitialState);
+
+    /// The topology is frozen from now on
+    if (!pFsm->isNumbered_) {
+        NumberStates(pFsm);
+    }
+
     /// Reset the FSM runtime environment
     memset(&pFsm->rt_, 0, sizeof(pFsm->rt_));
-
-    /// Record the initial state entry path
-    RecordInitialEntryPath(pFsm, &pFsm->rootState_.impl, pInitialState);
+    pFsm->inInitialTrans_ = FALSE;
 
     /// Enter ancestors and the initial state, and process initial transitions
     pFsm->rt_.pTranTarget = pInitialState; ///< DoEntryActions() expects it
+    pFsm->rt_.pEntryAnchor = FSM_ROOT_STATE(pFsm);
+
     DoEntryActions(pFsm);
 }
 
@@ -205,6 +558,7 @@ FsmDispatchEvent(FsmMachine* pOpaqueFsm, const FsmEvent* pEvt)
     int             isHandled = FALSE;
     FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
     FsmStateImpl*   pDisp = NULL;
+    FsmStateImpl*   pStart = NULL;
 
     FSM_ASSERT(pFsm);
     FSM_ASSERT(pEvt);
@@ -216,7 +570,8 @@ FsmDispatchEvent(FsmMachine* pOpaqueFsm, const FsmEvent* pEvt)
                       "while attempting to dispatch EVT.%d; " \
                       "probably re-entered from the scope of " \
                       "ENTER, EXIT, or BEGIN event handler",
-                      pFsm->pName_, pFsm, pFsm->logCookie_, pEvt->evtId);
+                      FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                      pEvt->evtId);
 
         FSM_ASSERT(FALSE && "FSM: NULL-Target-Dispatch Violation; " \
                "probably re-entered from ENTER, EXIT, or BEGIN event handler");
@@ -228,8 +583,9 @@ FsmDispatchEvent(FsmMachine* pOpaqueFsm, const FsmEvent* pEvt)
                       "FSM.%s(%p/c=%p): ERROR: Run-to-Completion Violation " \
                       "while attempting to dispatch EVT.%d to %s " \
                       "from the scope of active dispatch",
-                      pFsm->pName_, pFsm, pFsm->logCookie_, pEvt->evtId,
-                      pFsm->rt_.pCurrentState->pName_);
+                      FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                      pEvt->evtId,
+                      FSM_STATE_NAME(pFsm->rt_.pCurrentState));
 
         FSM_ASSERT(FALSE && "FSM: Run-to-Completion Violation");
     }
@@ -238,18 +594,53 @@ FsmDispatchEvent(FsmMachine* pOpaqueFsm, const FsmEvent* pEvt)
     FSM_ASSERT(pEvt);
     FSM_ASSERT(pEvt->evtId >= kFsmEventFirstUserEvent);
 
-    pFsm->rt_.pDispatchSrcState = pFsm->rt_.pCurrentState;
+    /// A flat FSM isn't an instance, so it has no live version to check
+    if (pFsm->isFlat_ && !pFsm->isProfiled_) {
+        return DispatchFlatEvent(pFsm, pEvt);
+    }
+
+    /// Move a live instance to the newest version of its definition
+    /// while it's between events
+    if (pFsm->isInstance_ &&
+        FSM_LIVE_VERSION_IS_STALE((FsmInstanceImpl*)pFsm)) {
+        (void)FsmUpdateLiveInstance(pOpaqueFsm);
+    }
+
+    pStart = pFsm->rt_.pDispatchSrcState = pFsm->rt_.pCurrentState;
     do {
         pDisp = pFsm->rt_.pDispatchSrcState;
 
+        /// Take a matching declarative transition without calling the handler
+        if (pDisp->pTransitions_) {
+            const FsmTransitionDef* pTran =
+                FindDeclaredTransition(pFsm, pDisp, pEvt);
+
+            if (pTran) {
+                FsmBeginTransition((FsmMachine*)pFsm, pTran->pTarget);
+
+                if (pTran->pAction) {
+                    pTran->pAction(FSM_USER_STATE(pDisp),
+                                   (FsmMachine*)pFsm, pEvt);
+                }
+
+                isHandled = TRUE;
+                continue;
+            }
+        }
+
+        /// Route the event past states that don't subscribe to it
+        if (!IsSubscribedToEvent(pDisp, pEvt->evtId)) {
+            continue;
+        }
+
         isHandled = DeliverEvent(pDisp, pFsm, pEvt);
 
         if (pFsm->rt_.pTranTarget && !isHandled) {
             FSM_LOG_FATAL(pFsm,
                           "FSM.%s(%p/c=%p): ERROR: Can't pass EVT.%d to parent " \
                           "after transition request to state %s",
-                          pFsm->pName_, pFsm, pFsm->logCookie_,
-                          pEvt->evtId, pFsm->rt_.pTranTarget->pName_);
+                          FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                          pEvt->evtId, FSM_STATE_NAME(pFsm->rt_.pTranTarget));
             FSM_ASSERT(FALSE && "FSM: Can't pass evt to parent after " \
                    "state transition request");
         }
@@ -258,6 +649,14 @@ FsmDispatchEvent(FsmMachine* pOpaqueFsm, const FsmEvent* pEvt)
 
     pFsm->rt_.pDispatchSrcState = NULL; ///< we're done with event dispatch
 
+    /// The walk visited the states from the current one up to pDisp
+    if (FSM_PROFILE(pFsm)) {
+        for (; pStart != pDisp; pStart = pStart->pParent_) {
+            ++FSM_PROFILE(pFsm)[pStart->id_].visits;
+        }
+        ++FSM_PROFILE(pFsm)[pDisp->id_].visits;
+    }
+
 
     /// Check if a transition was taken
     if (isHandled && pFsm->rt_.pTranTarget) {
@@ -284,6 +683,7 @@ FsmBeginTransition(FsmMachine* pOpaqueFsm, FsmState* pOpaqueTarget)
     FsmStateImpl*   pTarget = (FsmStateImpl*)pOpaqueTarget;
     FsmStateImpl*   pMainSrc = pFsm->rt_.pDispatchSrcState;
     FsmStateImpl*   pState = NULL;
+    FsmStateImpl*   pAnchor = NULL;
 
     /**
      * @note pFsm->rt_.pCurrentState may be NULL on entry to this
@@ -300,22 +700,23 @@ FsmBeginTransition(FsmMachine* pOpaqueFsm, FsmState* pOpaqueTarget)
 
     FSM_LOG_DEBUG(pFsm,
                   "FSM.%s(%p/c=%p): requesting transition to %s",
-                  pFsm->pName_, pFsm, pFsm->logCookie_, pTarget->pName_);
+                  FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                  FSM_STATE_NAME(pTarget));
 
     FSM_ASSERT(!pFsm->rt_.pTranTarget);
     FSM_ASSERT(pTarget->pHandler_);
     FSM_ASSERT(pTarget->pParent_);
 
-
+    pTarget = GetEngineState(pFsm, pTarget);
 
 
     pFsm->rt_.pTranTarget = pTarget; ///< required by DoEntryActions()
 
-    if (pFsm->rt_.inInitialTrans) {
+    if (pFsm->inInitialTrans_) {
         FSM_ASSERT(!pFsm->rt_.pDispatchSrcState);
         FSM_ASSERT(!pFsm->rt_.pCurrentState);
 
-        /// @note DoEntryActions() will record its own entry path in this case
+        /// @note DoEntryActions() sets the entry anchor in this case
         return;
     }
 
@@ -346,176 +747,658 @@ FsmBeginTransition(FsmMachine* pOpaqueFsm, FsmState* pOpaqueTarget)
     FSM_ASSERT(pFsm->rt_.pCurrentState);
     FSM_ASSERT(pMainSrc);
 
+    if (FSM_PROFILE(pFsm)) {
+        ++FSM_PROFILE(pFsm)[pMainSrc->id_].transitions;
+    }
+
+    /// In a flat FSM, Main Source is the current state, and the anchor
+    /// of every transition (self-transitions included) is the root state
+    pAnchor = pFsm->isFlat_ ? FSM_ROOT_STATE(pFsm)
+                            : GetTransitionAnchor(pFsm, pMainSrc, pTarget);
 
     pState = pFsm->rt_.pCurrentState;
 
     /// We're entering the "no current state" twilight zone
     pFsm->rt_.pCurrentState = NULL;
 
-    /// First, Exit the active configuration up to Main Source
-    for (; pState != pMainSrc; pState = pState->pParent_) {
-        (void)DeliverEvent(pState, pFsm, &g_exitEvt);
+    /// Exit the active configuration up to (but not including) the anchor;
+    /// this exits everything below Main Source first, then Main Source and
+    /// its ancestors, if the transition requires it
+    /// 
+    /// @note The anchor is an ancestor of (or the same as) the current
+    ///       state, so comparing depths works even when the walk bypasses
+    ///       pass-through states, including the anchor itself
+    for (; pState->depth_ > pAnchor->depth_;
+          pState = FSM_WALK_PARENT_STATE(pFsm, pState)) {
+        if (!(pState->flags_ & kFsmStateFlagNoExit)) {
+            (void)DeliverEvent(pState, pFsm, &g_exitEvt);
+        }
     }
 
-    /**
-     * Now, handle the exits and record the entry path in the
-     * transition from Main Source to Main Target
-     */
+    /// DoEntryActions() enters the states from just below the anchor to Target
+    pFsm->rt_.pEntryAnchor = pAnchor;
 
-    pFsm->rt_.entryPath.size = 0;
+} // FsmBeginTransition()
 
-    /// Handle Peer Source/Target states (including Main Source == Target)
-    /// (exit source, enter target)
-    if (pMainSrc->pParent_ == pTarget->pParent_) {
-        (void)DeliverEvent(pMainSrc, pFsm, &g_exitEvt);
-        pFsm->rt_.entryPath.states[0] = pTarget;
-        pFsm->rt_.entryPath.size = 1;
-        return;
-    }
 
-    /// Local Transition: Is Target a descendant of Main Source?
-    /// (don't exit source; enter target)
-    for (pState = pTarget;
-          pState != &pFsm->rootState_.impl;
-          pState = pState->pParent_) {
+/**
+ * ****************************************************************************
+ */
+int
+FsmGenCompleteDispatch(FsmMachine* pOpaqueFsm, const FsmEvent* pEvt,
+                       int isHandled)
+{
+    FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
 
-        if (pState == pMainSrc) {
-            return; /// Target *IS* a descendant of Main Source
-        }
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(pEvt);
+    FSM_ASSERT(pFsm->isInstance_ && "Not an FSM instance");
 
-        /// Record path from Target to Target's top user ancestor
-        FSM_ASSERT(pFsm->rt_.entryPath.size < kFsmMaxStateNestingDepth);
-        pFsm->rt_.entryPath.states[pFsm->rt_.entryPath.size++] = pState;
+    if (pFsm->rt_.pTranTarget && !isHandled) {
+        FSM_LOG_FATAL(pFsm,
+                      "FSM.%s(%p/c=%p): ERROR: Can't pass EVT.%d to parent " \
+                      "after transition request to state %s",
+                      FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                      pEvt->evtId, FSM_STATE_NAME(pFsm->rt_.pTranTarget));
+        FSM_ASSERT(FALSE && "FSM: Can't pass evt to parent after " \
+               "state transition request");
     }
 
-    /**
-     * Target is NOT a descendant of Main Source;
-     * 
-     * entryPath_ now contains the path from Target state to its top
-     * user ancestor
-     */
+    if (!isHandled) {
+        return FALSE;   ///< the generated code passes the event on
+    }
 
-    /**
-     * @note This might be a Local Transition
-     * 
-     * * Exit Main Source and its ancestors up to (but not
-     *   including) the point of intersection, if any, with the path
-     *   from Target to Target's top user ancestor.
-     * * Don't enter the point of intersection.
-     * 
-     * This point of intersection, if any, may be either:
-     *  * 1. The LCA (Least Common Ancestor) of Main Source and
-     *    Target; or
-     *  * 2. The Target state itself, in case Target is the ancestor
-     *    of Main Source, which would make it a Local Transition
-     */
-    (void)DeliverEvent(pMainSrc, pFsm, &g_exitEvt);
-    for (pState = pMainSrc->pParent_;
-          pState != &pFsm->rootState_.impl;
-          pState = pState->pParent_) {
-        int pathIndex;
-
-        /// Check for intersection with Target Entry Path
-        for (pathIndex = 0; pathIndex < pFsm->rt_.entryPath.size; ++pathIndex) {
-            if (pState == pFsm->rt_.entryPath.states[pathIndex]) {
-                /// Found the intersection: either LCA or Target itself
-
-                /// Entry path will beging just after the intersection
-                /// @note If intesected with Target, pathIndex will be 0
-                pFsm->rt_.entryPath.size = pathIndex;
-                return;
-            }
-        }
+    pFsm->rt_.pDispatchSrcState = NULL; ///< we're done with event dispatch
 
-        /// Exit the current ancestor of Main Source
-        (void)DeliverEvent(pState, pFsm, &g_exitEvt);
+    /// @note Exit actions were already processed in FsmBeginTransition()
+    ///       or by the generated code
+    if (pFsm->rt_.pTranTarget) {
+        DoEntryActions(pFsm);
     }
 
-    /**
-     * If we go here, then Main Source and Target did not share a
-     * common user-defined ancestor.
-     * 
-     * In this case, pFsm->rt_.entryPath contains the entry path from
-     * top user-defined ancestor of Target to Target
-     */
+    FSM_ASSERT(!pFsm->rt_.pTranTarget);
 
-} // FsmBeginTransition()
+    return TRUE;
+}
 
 
 /**
- * Delivers the given event, and optionally logs it (logging
- * depends on the pFsm->logOutKind_ setting)
- * 
- * @param pState
- * @param pFsm
- * @param pEvt
- * 
- * @return int
+ * ****************************************************************************
  */
-static int
-DeliverEvent(const FsmStateImpl* pState, FsmMachineImpl* pFsm,
-             const FsmEvent* pEvt)
+int
+FsmIsInState(FsmMachine* pOpaqueFsm, const FsmState* pOpaqueState)
 {
-    int isHandled = FALSE;
-    char evtBuf[100] = "";
+    FsmMachineImpl*     pFsm = (FsmMachineImpl*)pOpaqueFsm;
+    const FsmStateImpl* pState = (const FsmStateImpl*)pOpaqueState;
+    const FsmStateImpl* pCurrent = NULL;
 
-    if (pFsm->logOutKind_ && FSM_LOG_IS_INFO_ENABLED(pFsm)) {
-        enum FsmDbgLogLevel logLevel = kFsmDbgLogLevelInfo;
-        int logDelivery = 1;
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(pState);
+    FSM_ASSERT(pState->pParent_);
+    FSM_ASSERT(pFsm->isNumbered_ && "FSM hasn't been started");
 
-        char numString[20];
-        const char* pEvtName = NULL;
+    pCurrent = pFsm->rt_.pCurrentState;
 
-        switch (pEvt->evtId) {
-        case kFsmEventEnterScope:
-            pEvtName = "ENTER"; ///< this one gets logged @ INFO level
-            break;
-        case kFsmEventExitScope:
-            pEvtName = "EXIT";
-            logLevel = kFsmDbgLogLevelDebug;
-            logDelivery = FSM_LOG_IS_DEBUG_ENABLED(pFsm);
-            break;
-        case kFsmEventBegin:
-            pEvtName = "BEGIN";
-            logLevel = kFsmDbgLogLevelDebug;
-            logDelivery = FSM_LOG_IS_DEBUG_ENABLED(pFsm);
-            break;
+    return (pCurrent &&
+            pState->preOrder_ <= pCurrent->preOrder_ &&
+            pCurrent->preOrder_ <= pState->lastOrder_);
+}
 
-        default:
-            pEvtName = numString;
-            logLevel = kFsmDbgLogLevelDebug;
-            logDelivery = FSM_LOG_IS_DEBUG_ENABLED(pFsm);
-            break;
-        }
 
-        if (logDelivery) {
-            if (pEvtName == numString) {
-                snprintf(numString, sizeof(numString), "%d", (int)pEvt->evtId);
-            }
+/**
+ * ****************************************************************************
+ */
+int
+FsmIsAncestor(const FsmState* pOpaqueAncestor,
+              const FsmState* pOpaqueDescendant)
+{
+    const FsmStateImpl* pAncestor = (const FsmStateImpl*)pOpaqueAncestor;
+    const FsmStateImpl* pDescendant = (const FsmStateImpl*)pOpaqueDescendant;
 
-            snprintf(evtBuf, sizeof(evtBuf), "EVT.%s ==> %s",
-                     pEvtName, pState->pName_);
+    FSM_ASSERT(pAncestor);
+    FSM_ASSERT(pDescendant);
+    FSM_ASSERT(pAncestor->pParent_ && pDescendant->pParent_);
 
-            if (kFsmDbgLogLevelInfo == logLevel) {
-                FSM_LOG_INFO(pFsm, "FSM.%s(%p/c=%p): %s",
-                             pFsm->pName_, pFsm, pFsm->logCookie_, evtBuf);
-            }
-            else {
-                FSM_LOG_DEBUG(pFsm, "FSM.%s(%p/c=%p): %s",
-                              pFsm->pName_, pFsm, pFsm->logCookie_, evtBuf);
-            }
+    return (pAncestor->preOrder_ < pDescendant->preOrder_ &&
+            pDescendant->preOrder_ <= pAncestor->lastOrder_);
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmAttachTransitionCache(FsmMachine* pOpaqueFsm,
+                         FsmTransitionCache* pOpaqueCache,
+                         FsmTransitionPlan* pOpaquePlans,
+                         unsigned int numPlans)
+{
+    FsmMachineImpl*         pFsm = (FsmMachineImpl*)pOpaqueFsm;
+    FsmTransitionCacheImpl* pCache = (FsmTransitionCacheImpl*)pOpaqueCache;
+
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
+    FSM_ASSERT(!pFsm->rt_.pDispatchSrcState);
+    FSM_ASSERT(pCache);
+    FSM_ASSERT(pOpaquePlans);
+    FSM_ASSERT(numPlans > 0);
+
+    memset(pOpaquePlans, 0, numPlans * sizeof(*pOpaquePlans));
+
+    pCache->pPlans = (FsmTransitionPlanImpl*)pOpaquePlans;
+    pCache->numPlans = numPlans;
+    pCache->hits = 0;
+    pCache->misses = 0;
+
+    pFsm->pTranCache_ = pCache;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmSealMachine(FsmMachine* pOpaqueFsm, FsmState* const apStates[],
+               unsigned int numStates, FsmSealedState* pStorage,
+               unsigned int numStorageElements)
+{
+    FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
+    FsmStateImpl*   pSealed = (FsmStateImpl*)pStorage;
+    const char**    ppNames = NULL;
+    unsigned int    i;
+
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(!pFsm->isInstance_ && "Can't seal an FSM instance");
+    FSM_ASSERT(&FsmRootStateHandler == pFsm->rootState_.impl.state_.pHandler_);
+    FSM_ASSERT(!pFsm->pSealedStates_ && "FSM is already sealed");
+    FSM_ASSERT(!pFsm->rt_.pCurrentState && "Seal the FSM before FsmStart()");
+    FSM_ASSERT(!pFsm->pByteDfa_ && "Seal the FSM before FsmCompileByteDfa()");
+    FSM_ASSERT(apStates);
+    FSM_VERIFY(numStates > 0 && numStates <= FSM_MAX_USER_STATES);
+    FSM_ASSERT(pStorage);
+    FSM_ASSERT(numStorageElements >= FSM_SEALED_STATE_COUNT(numStates));
+
+    /// The topology is frozen from now on
+    if (!pFsm->isNumbered_) {
+        NumberStates(pFsm);
+    }
+
+    FSM_ASSERT(numStates == pFsm->rootState_.impl.state_.lastOrder_ &&
+               "All inserted states MUST be in apStates");
+
+    /// The compact state records come first, followed by the states' names
+    /// (@see FSM_SEALED_STATE_NAMES); each record keeps its user state
+    /// object in pUser_ (@see FSM_USER_STATE)
+    ppNames = (const char**)&pSealed[FSM_SEALED_STATE_COUNT(numStates)];
+
+    pSealed[0] = pFsm->rootState_.impl.state_;
+    pSealed[0].flags_ |= kFsmStateFlagSealedRecord_;
+    ppNames[0] = pFsm->rootState_.impl.pName_;
+
+    /// Assign dense ids; until its record is compiled, a record's pUser_
+    /// identifies the state that got its id
+    for (i = 0; i < numStates; ++i) {
+        FsmStateImpl* pState = (FsmStateImpl*)apStates[i];
+
+        FSM_ASSERT(pState);
+        FSM_ASSERT(pState->pParent_ && "State MUST be inserted before sealing");
+
+        pState->id_ = (unsigned short)(i + 1);
+        pSealed[i + 1].pUser_ = apStates[i];
+        ppNames[i + 1] = ((FsmUserStateImpl*)pState)->pName_;
+    }
+
+    /// Compile the compact state records; parents must be in apStates, too
+    for (i = 0; i < numStates; ++i) {
+        FsmStateImpl* pState = (FsmStateImpl*)apStates[i];
+        FsmStateImpl* pParent = pState->pParent_;
+
+        FSM_ASSERT(pSealed[pState->id_].pUser_ == apStates[i] &&
+                   "Duplicate state in apStates");
+
+        if (pParent != &pFsm->rootState_.impl.state_) {
+            FSM_ASSERT(pParent->id_ > 0 && pParent->id_ <= numStates &&
+                       pSealed[pParent->id_].pUser_ == (FsmState*)pParent &&
+                       "Parent state MUST be in apStates");
+        }
+
+        pSealed[i + 1] = *pState;
+        pSealed[i + 1].pParent_ = &pSealed[pParent->id_];
+        pSealed[i + 1].flags_ |= kFsmStateFlagSealedRecord_;
+
+        /// Entry and exit walks bypass pass-through ancestors
+        while (pParent != &pFsm->rootState_.impl.state_ &&
+               FSM_IS_PASS_THROUGH_STATE(pParent)) {
+            pParent = pParent->pParent_;
+        }
+        pSealed[i + 1].walkParentId_ = pParent->id_;
+
+        if (pState->pInitial_) {
+            FSM_ASSERT(pState->pInitial_->id_ > 0 &&
+                       pState->pInitial_->id_ <= numStates &&
+                       pSealed[pState->pInitial_->id_].pUser_ ==
+                       (FsmState*)pState->pInitial_ &&
+                       "Initial substate MUST be in apStates");
+
+            pSealed[i + 1].pInitial_ = &pSealed[pState->pInitial_->id_];
+        }
+    }
+
+    /// Plans recorded so far, if any, refer to the user's state objects
+    if (pFsm->pTranCache_) {
+        memset(pFsm->pTranCache_->pPlans, 0,
+               pFsm->pTranCache_->numPlans * sizeof(FsmTransitionPlanImpl));
+    }
+
+    pFsm->pSealedStates_ = pSealed;
+    pFsm->numSealedStates_ = FSM_SEALED_STATE_COUNT(numStates);
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmCompileByteDfa(FsmMachine* pOpaqueFsm, FsmByteDfa* pOpaqueDfa,
+                  const unsigned char aByteClasses[256],
+                  unsigned int numClasses, FsmEventIdType classEvtBase,
+                  FsmByteDfaCell* pOpaqueCells, unsigned int numCells)
+{
+    FsmMachineImpl*     pFsm = (FsmMachineImpl*)pOpaqueFsm;
+    FsmByteDfaImpl*     pDfa = (FsmByteDfaImpl*)pOpaqueDfa;
+    FsmByteDfaCellImpl* pCells = (FsmByteDfaCellImpl*)pOpaqueCells;
+    FsmStateImpl*       pState = NULL;
+    unsigned int        numStates;
+    unsigned int        rowSize;
+    unsigned int        i;
+
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(!pFsm->isInstance_ && "Compile the DFA of the FSM itself");
+    FSM_ASSERT(&FsmRootStateHandler == pFsm->rootState_.impl.state_.pHandler_);
+    FSM_ASSERT(!pFsm->rt_.pDispatchSrcState);
+    FSM_ASSERT(pDfa);
+    FSM_ASSERT(aByteClasses);
+    FSM_ASSERT(numClasses > 0 && numClasses <= 256);
+    FSM_ASSERT(classEvtBase >= kFsmEventFirstUserEvent);
+    FSM_ASSERT(pCells);
+
+    /// The topology is frozen from now on
+    if (!pFsm->isNumbered_) {
+        NumberStates(pFsm);
+    }
+
+    numStates = FSM_ROOT_STATE(pFsm)->lastOrder_ + 1;
+    rowSize = numClasses + 2;
+
+    FSM_ASSERT(numCells >= numStates * rowSize);
+
+    for (i = 0; i < 256; ++i) {
+        FSM_ASSERT(aByteClasses[i] < numClasses);
+    }
+
+    /// Fill in a row per state, visiting the states in insertion order (or
+    /// the compact state records of a sealed FSM), root state included
+    for (pState = FSM_ROOT_STATE(pFsm), i = 0; pState; ++i) {
+        FsmByteDfaCellImpl* pRow = &pCells[pState->preOrder_ * rowSize];
+        FsmByteDfaScanImpl* pScan = (FsmByteDfaScanImpl*)&pRow[numClasses];
+        unsigned int        c;
+
+        for (c = 0; c < numClasses; ++c) {
+            FsmEventIdType  evtId = (FsmEventIdType)(classEvtBase + c);
+            FsmStateImpl*   pDisp = pState;
+
+            pRow[c].pMainSrc = NULL;
+            pRow[c].pTran = NULL;
+
+            /// Resolve the event like FsmDispatchEvent() does, short of
+            /// evaluating guards or calling handlers
+            for (; pDisp; pDisp = pDisp->pParent_) {
+                const FsmTransitionDef* pTran = NULL;
+                unsigned int            t;
+
+                for (t = 0; pDisp->pTransitions_ &&
+                            t < pDisp->numTransitions_; ++t) {
+                    if (pDisp->pTransitions_[t].evtId == evtId) {
+                        pTran = &pDisp->pTransitions_[t];
+                        break;
+                    }
+                }
+
+                if (pTran || IsSubscribedToEvent(pDisp, evtId)) {
+                    pRow[c].pMainSrc = pDisp;
+                    pRow[c].pTran = (pTran && !pTran->pGuard) ? pTran : NULL;
+                    break;
+                }
+            }
+        }
+
+        /// Record the stop bytes for the SIMD scan
+        pScan->numStopBytes = 0;
+        for (c = 0; c < 256 && pScan->numStopBytes != kFsmByteDfaNoScan; ++c) {
+            if (pRow[aByteClasses[c]].pMainSrc) {
+                if (pScan->numStopBytes < kFsmByteDfaMaxStopBytes) {
+                    pScan->aStopBytes[pScan->numStopBytes++] = (unsigned char)c;
+                }
+                else {
+                    pScan->numStopBytes = kFsmByteDfaNoScan;
+                }
+            }
+        }
+
+        if (pFsm->pSealedStates_) {
+            pState = (i + 1 < pFsm->numSealedStates_)
+                ? &pFsm->pSealedStates_[i + 1] : NULL;
+        }
+        else {
+            pState = (FsmStateImpl*)
+                ((FsmUserStateImpl*)pState)->pNextInserted_;
+        }
+    }
+
+    pDfa->pByteClasses_ = aByteClasses;
+    pDfa->classEvtBase_ = classEvtBase;
+    pDfa->pCells_ = pCells;
+    pDfa->numClasses_ = (unsigned short)numClasses;
+    pDfa->rowSize_ = (unsigned short)rowSize;
+
+    pFsm->pByteDfa_ = pDfa;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+unsigned int
+FsmFeedBytes(FsmMachine* pOpaqueFsm, const void* pBuf, unsigned int len)
+{
+    FsmMachineImpl*         pFsm = (FsmMachineImpl*)pOpaqueFsm;
+    const FsmByteDfaImpl*   pDfa = NULL;
+    const unsigned char*    p = (const unsigned char*)pBuf;
+    const unsigned char*    pEnd = p + len;
+    FsmByteEvent            evt;
+    unsigned int            numHandled = 0;
+
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(pBuf || !len);
+    FSM_ASSERT(!pFsm->isInstance_ && "FSM instances have no byte-stream DFA");
+    FSM_ASSERT(pFsm->pByteDfa_ && "No byte-stream DFA; @see FsmCompileByteDfa()");
+    FSM_ASSERT(pFsm->rt_.pCurrentState && "FSM hasn't been started");
+    FSM_ASSERT(!pFsm->rt_.pDispatchSrcState && "Run-to-Completion Violation");
+
+    pDfa = pFsm->pByteDfa_;
+
+    while (p < pEnd) {
+        const FsmByteDfaCellImpl* pRow =
+            &pDfa->pCells_[pFsm->rt_.pCurrentState->preOrder_ * pDfa->rowSize_];
+        const FsmByteDfaCellImpl* pCell = NULL;
+
+        /// Bytes that are self-loops of the current state have no effect
+        p = SkipSelfLoopBytes(pDfa, pRow, p, pEnd);
+        if (p == pEnd) {
+            break;
+        }
+
+        pCell = &pRow[pDfa->pByteClasses_[*p]];
+
+        evt.evt.evtId = (FsmEventIdType)(pDfa->classEvtBase_ +
+                                         pDfa->pByteClasses_[*p]);
+        evt.byte = *p++;
+
+        if (!pCell->pTran) {
+            numHandled += !!FsmDispatchEvent((FsmMachine*)pFsm, &evt.evt);
+            continue;
+        }
+
+        /// Take the unguarded declarative transition without dispatching
+        FSM_LOG_DEBUG(pFsm,
+                      "FSM.%s(%p/c=%p): EVT.%d ==> %s (declared transition)",
+                      FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                      (int)evt.evt.evtId, FSM_STATE_NAME(pCell->pMainSrc));
+
+        pFsm->rt_.pDispatchSrcState = pCell->pMainSrc;
+
+        FsmBeginTransition((FsmMachine*)pFsm, pCell->pTran->pTarget);
+
+        if (pCell->pTran->pAction) {
+            pCell->pTran->pAction(FSM_USER_STATE(pCell->pMainSrc),
+                                  (FsmMachine*)pFsm, &evt.evt);
+        }
+
+        pFsm->rt_.pDispatchSrcState = NULL;
+
+        DoEntryActions(pFsm);
+
+        ++numHandled;
+    }
+
+    return numHandled;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmInitDefinition(FsmDefinition* pOpaqueDef, FsmMachine* pOpaqueFsm)
+{
+    FsmDefinitionImpl*  pDef = (FsmDefinitionImpl*)pOpaqueDef;
+    FsmMachineImpl*     pFsm = (FsmMachineImpl*)pOpaqueFsm;
+    unsigned int        i;
+
+    FSM_ASSERT(pDef);
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(!pFsm->isInstance_);
+    FSM_ASSERT(&FsmRootStateHandler == pFsm->rootState_.impl.state_.pHandler_);
+    FSM_ASSERT(pFsm->pSealedStates_ && "Seal the FSM first");
+
+    /// Resolve the chains of initial substates, which the engine would
+    /// otherwise memoize in the shared state records on first use
+    for (i = 1; i < pFsm->numSealedStates_; ++i) {
+        if (pFsm->pSealedStates_[i].pInitial_) {
+            (void)GetInitialDrillDownState(&pFsm->pSealedStates_[i]);
+        }
+    }
+
+    pDef->pSealedStates_ = pFsm->pSealedStates_;
+    pDef->numSealedStates_ = pFsm->numSealedStates_;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmInitConstDefinition(FsmDefinition* pOpaqueDef,
+                       const FsmConstState aOpaqueStates[],
+                       unsigned int numStates)
+{
+    FsmDefinitionImpl*  pDef = (FsmDefinitionImpl*)pOpaqueDef;
+    /// @note The engine never writes to the states of a definition
+    FsmStateImpl*       aStates = (FsmStateImpl*)aOpaqueStates;
+    unsigned int        i;
+
+    FSM_ASSERT(pDef);
+    FSM_ASSERT(aStates);
+    FSM_VERIFY(numStates > 0 && numStates <= FSM_MAX_USER_STATES);
+
+    FSM_ASSERT(&FsmRootStateHandler == aStates[0].pHandler_ &&
+               !aStates[0].pParent_ && numStates == aStates[0].lastOrder_ &&
+               !aStates[0].walkParentId_ && !aStates[0].depth_ &&
+               !aStates[0].pInitial_ &&
+               (aStates[0].flags_ & kFsmStateFlagSealedRecord_) &&
+               (aStates[0].flags_ & kFsmStateFlagReadOnlyRecord_) &&
+               aStates[0].pUser_ == (FsmState*)&aStates[0] &&
+               "Bad root state record");
+
+    /// Check the records against the topology's invariants that the
+    /// engine relies on; compiles away along with FSM_ASSERT
+    for (i = 1; i <= numStates; ++i) {
+        const FsmStateImpl* pState = &aStates[i];
+        const FsmStateImpl* pParent = pState->pParent_;
+
+        FSM_ASSERT(pState->pHandler_);
+        FSM_ASSERT(i == pState->id_ && i == pState->preOrder_ &&
+                   pState->pUser_ == (FsmState*)pState && "Bad state id");
+        FSM_ASSERT(pParent >= aStates && pParent < pState &&
+                   i <= pParent->lastOrder_ &&
+                   "States MUST be listed in pre-order");
+        FSM_ASSERT(pState->depth_ == pParent->depth_ + 1 &&
+                   "Bad state depth");
+        FSM_ASSERT(pState->lastOrder_ >= i &&
+                   pState->lastOrder_ <= pParent->lastOrder_ &&
+                   "Bad last descendant");
+        FSM_ASSERT(pState->walkParentId_ < i &&
+                   i <= aStates[pState->walkParentId_].lastOrder_ &&
+                   (pState->walkParentId_ == pParent->id_ ||
+                    FSM_IS_PASS_THROUGH_STATE(pParent)) &&
+                   "Bad walk parent");
+        FSM_ASSERT((!pState->pInitial_ ||
+                    (pState->pInitial_->preOrder_ > i &&
+                     pState->pInitial_->preOrder_ <= pState->lastOrder_ &&
+                     !pState->pInitial_->pInitial_)) &&
+                   "Bad initial substate");
+        FSM_ASSERT((pState->flags_ & kFsmStateFlagSealedRecord_) &&
+                   (pState->flags_ & kFsmStateFlagReadOnlyRecord_) &&
+                   "Initialize the records via FSM_CONST_STATE_EX()");
+    }
+
+    pDef->pSealedStates_ = aStates;
+    pDef->numSealedStates_ = FSM_SEALED_STATE_COUNT(numStates);
+
+    /// The root state holds the depth of the deepest state
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmInitInstance(FsmInstance* pOpaqueInstance, const FsmDefinition* pOpaqueDef,
+                void* pContext)
+{
+    FsmInstanceImpl*            pInstance = (FsmInstanceImpl*)pOpaqueInstance;
+    const FsmDefinitionImpl*    pDef = (const FsmDefinitionImpl*)pOpaqueDef;
+
+    FSM_ASSERT(pInstance);
+    FSM_ASSERT(pDef);
+    FSM_ASSERT(pDef->pSealedStates_);
+    FSM_ASSERT(&FsmRootStateHandler == pDef->pSealedStates_[0].pHandler_);
+
+    memset(pInstance, 0, sizeof(*pInstance));
+
+    /// The engine finds the rest of the topology via the sealed states
+    pInstance->pSealedStates_ = pDef->pSealedStates_;
+    pInstance->numSealedStates_ = pDef->numSealedStates_;
+    pInstance->isNumbered_ = TRUE;
+    pInstance->isInstance_ = TRUE;
+    pInstance->pContext_ = pContext;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void*
+FsmGetInstanceContext(const FsmMachine* pOpaqueFsm)
+{
+    const FsmInstanceImpl* pInstance = (const FsmInstanceImpl*)pOpaqueFsm;
+
+    FSM_ASSERT(pInstance);
+    FSM_ASSERT(pInstance->isInstance_ && "Not an FSM instance");
+
+    return pInstance->pContext_;
+}
+
+
+/**
+ * Delivers the given event, and optionally logs it (logging
+ * depends on the pFsm->pLog_ configuration)
+ * 
+ * @param pState
+ * @param pFsm
+ * @param pEvt
+ * 
+ * @return int
+ */
+static int
+DeliverEvent(const FsmStateImpl* pState, FsmMachineImpl* pFsm,
+             const FsmEvent* pEvt)
+{
+    int isHandled = FALSE;
+    char evtBuf[100];
+
+    if (pFsm->isProfiled_) {
+        ++pFsm->pProfile_[pState->id_].deliveries;
+    }
+
+    /// Fast path: nothing to log
+    if (!pFsm->pLog_ || !pFsm->pLog_->logOutKind_) {
+        return pState->pHandler_(FSM_USER_STATE(pState),
+                                 (FsmMachine*)pFsm, pEvt);
+    }
+
+    evtBuf[0] = '\0';
+
+    if (FSM_LOG_IS_INFO_ENABLED(pFsm)) {
+        enum FsmDbgLogLevel logLevel = kFsmDbgLogLevelInfo;
+        int logDelivery = 1;
+
+        char numString[20];
+        const char* pEvtName = NULL;
+
+        switch (pEvt->evtId) {
+        case kFsmEventEnterScope:
+            pEvtName = "ENTER"; ///< this one gets logged @ INFO level
+            break;
+        case kFsmEventExitScope:
+            pEvtName = "EXIT";
+            logLevel = kFsmDbgLogLevelDebug;
+            logDelivery = FSM_LOG_IS_DEBUG_ENABLED(pFsm);
+            break;
+        case kFsmEventBegin:
+            pEvtName = "BEGIN";
+            logLevel = kFsmDbgLogLevelDebug;
+            logDelivery = FSM_LOG_IS_DEBUG_ENABLED(pFsm);
+            break;
+
+        default:
+            pEvtName = numString;
+            logLevel = kFsmDbgLogLevelDebug;
+            logDelivery = FSM_LOG_IS_DEBUG_ENABLED(pFsm);
+            break;
+        }
+
+        if (logDelivery) {
+            if (pEvtName == numString) {
+                snprintf(numString, sizeof(numString), "%d", (int)pEvt->evtId);
+            }
+
+            snprintf(evtBuf, sizeof(evtBuf), "EVT.%s ==> %s",
+                     pEvtName, FSM_STATE_NAME(pState));
+
+            if (kFsmDbgLogLevelInfo == logLevel) {
+                FSM_LOG_INFO(pFsm, "FSM.%s(%p/c=%p): %s",
+                             FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                             evtBuf);
+            }
+            else {
+                FSM_LOG_DEBUG(pFsm, "FSM.%s(%p/c=%p): %s",
+                              FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                              evtBuf);
+            }
         }
     }
 
 
     /// Deliver the event
-    isHandled = pState->pHandler_((FsmState*)pState, (FsmMachine*)pFsm, pEvt);
+    isHandled = pState->pHandler_(FSM_USER_STATE(pState),
+                                  (FsmMachine*)pFsm, pEvt);
 
     FSM_LOG_DEBUG(pFsm,
                   "FSM.%s(%p/c=%p): <-- %s (%s)",
-                  pFsm->pName_,
+                  FSM_MACHINE_NAME(pFsm),
                   pFsm,
-                  pFsm->logCookie_,
+                  FSM_LOG_COOKIE(pFsm),
                   isHandled ? "<HANDLED>" : "<NOT HANDLED>",
                   evtBuf);
 
@@ -534,23 +1417,35 @@ DoEntryActions(FsmMachineImpl* pFsm)
 {
     FsmStateImpl*   pTarget = pFsm->rt_.pTranTarget;
 
+    /// States of the entry path in REVERSE order
+    FsmStateImpl*   apEntryPath[FSM_CONFIG_ENTRY_PATH_CAPACITY];
+    int             entryPathSize = 0;
+
     /// ASSUMPTIONS ON ENTRY:
-    /// * the initial state entry path (if any) is already set-up
     /// * pFsm->rt_.pTranTarget is the destination state
+    /// * pFsm->rt_.pEntryAnchor is the state below which entry begins
 
-    FSM_ASSERT(pFsm->rt_.entryPath.size <= kFsmMaxStateNestingDepth);
     FSM_ASSERT(pFsm->rt_.pTranTarget);
+    FSM_ASSERT(pFsm->rt_.pEntryAnchor);
 
     pFsm->rt_.pCurrentState = NULL;     ///< we're in-between states
 
     /// Enter states in the path and drill down initial transitions
     do {
-        /// Enter all the states in the current entry path, if any
-        while (pFsm->rt_.entryPath.size > 0) {
-            FsmStateImpl* pState =
-                pFsm->rt_.entryPath.states[--pFsm->rt_.entryPath.size];
-
-            (void)DeliverEvent(pState, pFsm, &g_entryEvt);
+        /// Enter all the states in the current entry path, if any (states
+        /// flagged kFsmStateFlagNoEntry aren't recorded in the path)
+        entryPathSize = RecordEntryPath(pFsm, pFsm->rt_.pEntryAnchor,
+                                        pFsm->rt_.pTranTarget, 1, apEntryPath);
+
+        if (entryPathSize <= FSM_CONFIG_ENTRY_PATH_CAPACITY) {
+            while (entryPathSize > 0) {
+                (void)DeliverEvent(apEntryPath[--entryPathSize], pFsm,
+                                   &g_entryEvt);
+            }
+        }
+        else {
+            EnterLongEntryPath(pFsm, pFsm->rt_.pEntryAnchor,
+                               pFsm->rt_.pTranTarget, entryPathSize);
         }
 
         /// Mark initial transition to destination state
@@ -558,55 +1453,684 @@ DoEntryActions(FsmMachineImpl* pFsm)
             pTarget = pFsm->rt_.pTranTarget;
             pFsm->rt_.pTranTarget = NULL;   ///< reset destination holding register
 
-            pFsm->rt_.inInitialTrans = TRUE;
-            (void)DeliverEvent(pTarget, pFsm, &g_beginEvt);
-            pFsm->rt_.inInitialTrans = FALSE;
+            if (pTarget->pInitial_) {
+                /// Drill down the declared initial substates in one step
+                pFsm->rt_.pTranTarget = GetInitialDrillDownState(pTarget);
+            }
+            else if (!(pTarget->flags_ & kFsmStateFlagNoBegin)) {
+                pFsm->inInitialTrans_ = TRUE;
+                (void)DeliverEvent(pTarget, pFsm, &g_beginEvt);
+                pFsm->inInitialTrans_ = FALSE;
+            }
         }
 
         /// Process new initial transition request, if any
         if (pFsm->rt_.pTranTarget) {
-            RecordInitialEntryPath(pFsm, pTarget, pFsm->rt_.pTranTarget);
             /// New destination MUST be a PROPER descendant of current state
-            FSM_ASSERT(pFsm->rt_.entryPath.size > 0);
+            FSM_ASSERT(pFsm->rt_.pTranTarget->depth_ > pTarget->depth_);
+
+            pFsm->rt_.pEntryAnchor = pTarget;
         }         
          
     } while (pFsm->rt_.pTranTarget);
 
+    pFsm->rt_.pEntryAnchor = NULL;
+
     /// State transitions settled down, and we now have a "current" state
     pFsm->rt_.pCurrentState = pTarget;
 
     FSM_LOG_DEBUG(pFsm,
                   "FSM.%s(%p/c=%p): Entry completed; current state is %s",
-                  pFsm->pName_, pFsm, pFsm->logCookie_, pTarget->pName_);
+                  FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                  FSM_STATE_NAME(pTarget));
 } // DoEntryActions()
 
 
 /**
- * Record entry path for an initial transition
+ * FsmDispatchEvent() for flat FSMs (@see
+ * FsmMachineImpl::isFlat_) that aren't being profiled: the
+ * current state is the only candidate handler, because it
+ * subscribes to all events, has no declared transitions, and its
+ * parent is the root state, which doesn't handle any user
+ * events.
+ * 
+ * @param pFsm
+ * @param pEvt
+ * 
+ * @return int @see FsmDispatchEvent()
+ */
+static int
+DispatchFlatEvent(FsmMachineImpl* pFsm, const FsmEvent* pEvt)
+{
+    FsmStateImpl*   pState = pFsm->rt_.pCurrentState;
+    int             isHandled = FALSE;
+
+    pFsm->rt_.pDispatchSrcState = pState;
+
+    isHandled = DeliverEvent(pState, pFsm, pEvt);
+
+    if (pFsm->rt_.pTranTarget && !isHandled) {
+        FSM_LOG_FATAL(pFsm,
+                      "FSM.%s(%p/c=%p): ERROR: Can't pass EVT.%d to parent " \
+                      "after transition request to state %s",
+                      FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                      pEvt->evtId, FSM_STATE_NAME(pFsm->rt_.pTranTarget));
+        FSM_ASSERT(FALSE && "FSM: Can't pass evt to parent after " \
+               "state transition request");
+    }
+
+    pFsm->rt_.pDispatchSrcState = NULL; ///< we're done with event dispatch
+
+    /// Check if a transition was taken
+    if (isHandled && pFsm->rt_.pTranTarget) {
+        /// @note FsmBeginTransition() already exited the current state
+        DoFlatEntryActions(pFsm);
+    }
+
+    FSM_ASSERT(!pFsm->rt_.pTranTarget);
+
+    return isHandled;
+}
+
+
+/**
+ * DoEntryActions() for flat FSMs: the entry path consists of the
+ * target state alone, and the target state has no substates to
+ * drill down into.
+ * 
+ * @param pFsm
+ */
+static void
+DoFlatEntryActions(FsmMachineImpl* pFsm)
+{
+    FsmStateImpl*   pTarget = pFsm->rt_.pTranTarget;
+
+    FSM_ASSERT(pTarget);
+    FSM_ASSERT(FSM_ROOT_STATE(pFsm) == pFsm->rt_.pEntryAnchor);
+    FSM_ASSERT(!pTarget->pInitial_ &&
+               "Initial substate MUST be a PROPER descendant");
+
+    pFsm->rt_.pCurrentState = NULL;     ///< we're in-between states
+
+    if (!(pTarget->flags_ & kFsmStateFlagNoEntry)) {
+        (void)DeliverEvent(pTarget, pFsm, &g_entryEvt);
+    }
+
+    pFsm->rt_.pTranTarget = NULL;   ///< reset destination holding register
+    pFsm->rt_.pEntryAnchor = NULL;
+
+    if (!(pTarget->flags_ & kFsmStateFlagNoBegin)) {
+        pFsm->inInitialTrans_ = TRUE;
+        (void)DeliverEvent(pTarget, pFsm, &g_beginEvt);
+        pFsm->inInitialTrans_ = FALSE;
+
+        /// A top-level state has no proper descendants to transition to
+        FSM_ASSERT(!pFsm->rt_.pTranTarget &&
+                   "Initial transition MUST target a PROPER descendant");
+    }
+
+    /// State transitions settled down, and we now have a "current" state
+    pFsm->rt_.pCurrentState = pTarget;
+
+    FSM_LOG_DEBUG(pFsm,
+                  "FSM.%s(%p/c=%p): Entry completed; current state is %s",
+                  FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                  FSM_STATE_NAME(pTarget));
+} // DoFlatEntryActions()
+
+
+/**
+ * Record entry path from (but not including) the given ancestor
+ * to the given descendant.  Only states that need to receive
+ * kFsmEventEnterScope are recorded; in a sealed FSM, the walk
+ * also bypasses pass-through states.
+ * 
+ * Every stride-th state of the path (counting from the
+ * descendant) is recorded, as long as apPath has room for it;
+ * if the whole path doesn't fit, the caller enters it with
+ * EnterLongEntryPath().
  * 
  * @param pFsm
  * @param pAncestor
  * @param pDescendant
+ * @param stride 1 to record the whole path
+ * @param apPath Array for returning the (recorded) states of
+ *               the path in REVERSE order
+ * 
+ * @return int number of states in the path
  */
-static void
-RecordInitialEntryPath(FsmMachineImpl* pFsm, FsmStateImpl* pAncestor,
-                       FsmStateImpl* pDescendant)
+static int
+RecordEntryPath(FsmMachineImpl* pFsm, FsmStateImpl* pAncestor,
+                FsmStateImpl* pDescendant, int stride,
+                FsmStateImpl* apPath[FSM_CONFIG_ENTRY_PATH_CAPACITY])
 {
-    FsmStateImpl* pState;
-    pFsm->rt_.entryPath.size = 0;
-    for (pState = pDescendant;
-          pState != pAncestor;
-          pState = pState->pParent_) {
+    FsmStateImpl*   pState = pDescendant;
+    int             size = 0;
+    int             numRecorded = 0;
+    int             nextToRecord = 0;
+
+    for (; pState->depth_ > pAncestor->depth_;
+          pState = FSM_WALK_PARENT_STATE(pFsm, pState)) {
 
         FSM_ASSERT(pState);
-        FSM_ASSERT(pState != &pFsm->rootState_.impl &&
+        FSM_ASSERT(pState != FSM_ROOT_STATE(pFsm) &&
                "Ancestor MUST be reachable from Descendant!");
-        FSM_ASSERT(pFsm->rt_.entryPath.size < kFsmMaxStateNestingDepth);
+        FSM_ASSERT(size < pDescendant->depth_ - pAncestor->depth_);
+
+        if (!(pState->flags_ & kFsmStateFlagNoEntry)) {
+            if (size == nextToRecord &&
+                numRecorded < FSM_CONFIG_ENTRY_PATH_CAPACITY) {
+                apPath[numRecorded++] = pState;
+                nextToRecord += stride;
+            }
+            ++size;
+        }
+    }
+
+    FSM_ASSERT((pState == pAncestor || pFsm->pSealedStates_) &&
+               "Ancestor MUST be reachable from Descendant!");
+
+    return size;
+}
+
+/**
+ * Enters the states on an entry path too long for
+ * RecordEntryPath() to record whole, top-down: the path is
+ * split into at most FSM_CONFIG_ENTRY_PATH_CAPACITY segments,
+ * each of which is entered the same way if it's still too long.
+ * The stack used stays bounded (an array per power of
+ * FSM_CONFIG_ENTRY_PATH_CAPACITY of path length), and the path
+ * is walked O(log(length)) times.
+ * 
+ * @param pFsm
+ * @param pAncestor
+ * @param pDescendant
+ * @param size number of states in the path (@see RecordEntryPath)
+ */
+static void
+EnterLongEntryPath(FsmMachineImpl* pFsm, FsmStateImpl* pAncestor,
+                   FsmStateImpl* pDescendant, int size)
+{
+    /// Bottom states of the segments, and states of a segment, in
+    /// REVERSE order
+    FsmStateImpl*   apSegments[FSM_CONFIG_ENTRY_PATH_CAPACITY];
+    FsmStateImpl*   apPath[FSM_CONFIG_ENTRY_PATH_CAPACITY];
+    int             numSegments = 0;
+    int             stride = 0;
+
+    FSM_ASSERT(size > FSM_CONFIG_ENTRY_PATH_CAPACITY);
+
+    stride = (size + FSM_CONFIG_ENTRY_PATH_CAPACITY - 1) /
+             FSM_CONFIG_ENTRY_PATH_CAPACITY;
+    numSegments = (size + stride - 1) / stride;
+    (void)RecordEntryPath(pFsm, pAncestor, pDescendant, stride, apSegments);
+
+    while (numSegments > 0) {
+        FsmStateImpl*   pBottom = apSegments[--numSegments];
+
+        size = RecordEntryPath(pFsm, pAncestor, pBottom, 1, apPath);
+
+        if (size <= FSM_CONFIG_ENTRY_PATH_CAPACITY) {
+            while (size > 0) {
+                (void)DeliverEvent(apPath[--size], pFsm, &g_entryEvt);
+            }
+        }
+        else {
+            EnterLongEntryPath(pFsm, pAncestor, pBottom, size);
+        }
+
+        pAncestor = pBottom;
+    }
+}
+
+/**
+ * Returns the transition anchor for the given Main Source and
+ * Target, replaying it from the transition plan cache, if one
+ * is attached and holds the plan.
+ * 
+ * @see FindTransitionAnchor
+ * 
+ * @param pFsm
+ * @param pMainSrc
+ * @param pTarget
+ * 
+ * @return FsmStateImpl*
+ */
+static FsmStateImpl*
+GetTransitionAnchor(FsmMachineImpl* pFsm, FsmStateImpl* pMainSrc,
+                    FsmStateImpl* pTarget)
+{
+    FsmTransitionCacheImpl* pCache = pFsm->pTranCache_;
+    FsmTransitionPlanImpl*  pPlan;
+    size_t                  hash;
+
+    if (!pCache) {
+        return FindTransitionAnchor(pMainSrc, pTarget);
+    }
+
+    /// State structures are pointer-aligned, so drop the low bits
+    hash = ((size_t)pMainSrc >> 3) * 31 + ((size_t)pTarget >> 3);
+    pPlan = &pCache->pPlans[hash % pCache->numPlans];
+
+    if (pPlan->pAnchor &&
+        pPlan->pMainSrc == pMainSrc && pPlan->pTarget == pTarget) {
+        ++pCache->hits;
+        return pPlan->pAnchor;
+    }
+
+    ++pCache->misses;
+
+    pPlan->pMainSrc = pMainSrc;
+    pPlan->pTarget = pTarget;
+    pPlan->pAnchor = FindTransitionAnchor(pMainSrc, pTarget);
+
+    return pPlan->pAnchor;
+}
+
+
+/**
+ * Finds the transition anchor for a regular transition from
+ * Main Source to Target: the state at which the exit chain
+ * stops, and just below which the entry chain begins (neither
+ * chain includes the anchor itself).
+ * 
+ * This implements the UML Local Transition semantics described
+ * in FsmBeginTransition().  The anchor is:
+ * 
+ *  * The common parent for Peer Source/Target states
+ *    (including Main Source == Target): exit source, enter
+ *    target
+ *  * Main Source itself, if Target is its descendant: don't
+ *    exit source; enter target
+ *  * Otherwise, the first ancestor of Main Source that is also
+ *    on the path from Target to Target's top user ancestor.
+ *    This point of intersection may be either the LCA (Least
+ *    Common Ancestor) of Main Source and Target, or the Target
+ *    state itself, in case Target is the ancestor of Main
+ *    Source.  If Main Source and Target don't share a common
+ *    user-defined ancestor, the anchor is the root state.
+ * 
+ * @param pMainSrc
+ * @param pTarget
+ * 
+ * @return FsmStateImpl*
+ */
+static FsmStateImpl*
+FindTransitionAnchor(FsmStateImpl* pMainSrc, FsmStateImpl* pTarget)
+{
+    FsmStateImpl* pState;
+
+    /// Peer Source/Target states (including Main Source == Target)
+    if (pMainSrc->pParent_ == pTarget->pParent_) {
+        return pMainSrc->pParent_;
+    }
+
+    /// Local Transition: Is Target a descendant of Main Source?
+    if (pTarget->depth_ > pMainSrc->depth_) {
+        for (pState = pTarget;
+              pState->depth_ > pMainSrc->depth_;
+              pState = pState->pParent_) {
+        }
+
+        if (pState == pMainSrc) {
+            return pMainSrc;
+        }
+    }
+
+    /**
+     * The first ancestor of Main Source that is also on the path
+     * from Target to the root is the deepest common ancestor of
+     * Main Source's parent and Target (Target itself, if it's an
+     * ancestor of Main Source; the root state, if they don't share
+     * a common user-defined ancestor)
+     */
+    return FindCommonAncestor(pMainSrc->pParent_, pTarget);
+}
+
+
+/**
+ * Finds the deepest state that is an ancestor of (or the same
+ * as) both of the given states by aligning their depths and
+ * then stepping upward in lockstep.
+ * 
+ * @param pState1
+ * @param pState2
+ * 
+ * @return FsmStateImpl*
+ */
+static FsmStateImpl*
+FindCommonAncestor(FsmStateImpl* pState1, FsmStateImpl* pState2)
+{
+    while (pState1->depth_ > pState2->depth_) {
+        pState1 = pState1->pParent_;
+    }
+
+    while (pState2->depth_ > pState1->depth_) {
+        pState2 = pState2->pParent_;
+    }
+
+    while (pState1 != pState2) {
+        pState1 = pState1->pParent_;
+        pState2 = pState2->pParent_;
+    }
 
-        pFsm->rt_.entryPath.states[pFsm->rt_.entryPath.size++] = pState;
+    return pState1;
+}
+
+
+/**
+ * Maps a user's state object to the state that the engine runs
+ * on: its compact copy in a sealed FSM, or the user's state
+ * object itself otherwise.
+ * 
+ * @param pFsm
+ * @param pUserState
+ * 
+ * @return FsmStateImpl*
+ */
+static FsmStateImpl*
+GetEngineState(const FsmMachineImpl* pFsm, FsmStateImpl* pUserState)
+{
+    if (!pFsm->pSealedStates_) {
+        return pUserState;
+    }
+
+    FSM_ASSERT(pUserState->id_ < pFsm->numSealedStates_ &&
+               pFsm->pSealedStates_[pUserState->id_].pUser_ ==
+               (FsmState*)pUserState &&
+               "State MUST belong to the sealed FSM");
+
+    return &pFsm->pSealedStates_[pUserState->id_];
+}
+
+
+/**
+ * Checks whether the given state's handler subscribes to the
+ * given user event (@see FsmDeclareStateEvents()).
+ * 
+ * @param pState
+ * @param evtId
+ * 
+ * @return int true (non-zero) if the state didn't declare its
+ *         subscription set or the set contains evtId; false
+ *         (zero) otherwise.
+ */
+static int
+IsSubscribedToEvent(const FsmStateImpl* pState, FsmEventIdType evtId)
+{
+    unsigned int lo = 0;
+    unsigned int hi = pState->numEventIds_;
+
+    if (!pState->pEventIds_) {
+        return TRUE;
     }
+
+    /// Binary search of the sorted set
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+
+        if (pState->pEventIds_[mid] < evtId) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    return (lo < pState->numEventIds_ && pState->pEventIds_[lo] == evtId);
 }
 
+
+/**
+ * Looks up the given user event in the given state's declarative
+ * transition table (@see FsmDeclareStateTransitions()), and
+ * evaluates the guards of the matching transitions.
+ * 
+ * @param pFsm
+ * @param pState
+ * @param pEvt
+ * 
+ * @return const FsmTransitionDef* The first matching transition
+ *         whose guard passes; NULL if none.
+ */
+static const FsmTransitionDef*
+FindDeclaredTransition(FsmMachineImpl* pFsm, const FsmStateImpl* pState,
+                       const FsmEvent* pEvt)
+{
+    const FsmTransitionDef* pTable = pState->pTransitions_;
+    unsigned int            num = pState->numTransitions_;
+    unsigned int            lo = 0;
+    unsigned int            hi = num;
+
+    if (pEvt->evtId < pTable[0].evtId || pEvt->evtId > pTable[num - 1].evtId) {
+        return NULL;
+    }
+
+    if ((unsigned int)(pTable[num - 1].evtId - pTable[0].evtId) == num - 1) {
+        /// Consecutive (hence, distinct) event ids: index directly
+        lo = (unsigned int)(pEvt->evtId - pTable[0].evtId);
+    }
+    else {
+        /// Binary search for the first transition of the event
+        while (lo < hi) {
+            unsigned int mid = (lo + hi) / 2;
+
+            if (pTable[mid].evtId < pEvt->evtId) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+    }
+
+    /// Try the event's transitions in table order
+    for (; lo < num && pTable[lo].evtId == pEvt->evtId; ++lo) {
+        if (!pTable[lo].pGuard ||
+            pTable[lo].pGuard(FSM_USER_STATE(pState),
+                              (FsmMachine*)pFsm, pEvt)) {
+
+            FSM_LOG_DEBUG(pFsm,
+                          "FSM.%s(%p/c=%p): EVT.%d ==> %s (declared transition)",
+                          FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                          (int)pEvt->evtId, FSM_STATE_NAME(pState));
+            return &pTable[lo];
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Returns the innermost state of the chain of declared initial
+ * substates that starts at the given state (@see
+ * FsmSetInitialSubstate()), and memoizes it in place of the
+ * given state's initial substate, so that subsequent drill-downs
+ * take a single step; the records of constant topologies, which
+ * may be read-only, are never written to.
+ * 
+ * @param pState A state with a declared initial substate
+ * 
+ * @return FsmStateImpl*
+ */
+static FsmStateImpl*
+GetInitialDrillDownState(FsmStateImpl* pState)
+{
+    FsmStateImpl* pInnermost = pState->pInitial_;
+
+    while (pInnermost->pInitial_) {
+        pInnermost = pInnermost->pInitial_;
+    }
+
+    FSM_ASSERT(pInnermost->pParent_ && "Initial substate MUST be inserted");
+
+    /// @note Chains of FSM definitions are resolved up front (@see
+    ///       FsmInitDefinition(), FsmLoadDefinitionImage()), and
+    ///       FSM_CONST_STATE_EX() requires resolved chains, which
+    ///       only debug builds check; so a chain here is a mistake in
+    ///       a constant topology in that case
+    if (pInnermost != pState->pInitial_ &&
+        !(pState->flags_ & kFsmStateFlagReadOnlyRecord_)) {
+        pState->pInitial_ = pInnermost;
+    }
+
+    return pInnermost;
+}
+
+
+/**
+ * Initializes the given state for FsmInitStateEx() and
+ * FsmBuildStates()
+ * 
+ * @param pUserState
+ * @param pHandler
+ * @param pName
+ * @param flags
+ */
+static void
+InitState(FsmUserStateImpl* pUserState, FsmStateHandlerFnType* pHandler,
+          const char* pName, unsigned int flags)
+{
+    FsmStateImpl* pState = &pUserState->state_;
+
+    FSM_ASSERT(pHandler);
+    FSM_ASSERT(!(flags & ~(unsigned int)kFsmStateFlagPassThrough));
+
+    pState->pParent_ = NULL;
+    pState->pHandler_ = pHandler;
+    pState->pUser_ = (FsmState*)pUserState;
+    pState->depth_ = 0;
+    pState->id_ = 0;
+    pState->pEventIds_ = NULL;
+    pState->pTransitions_ = NULL;
+    pState->numEventIds_ = 0;
+    pState->numTransitions_ = 0;
+    pState->flags_ = (unsigned short)flags;
+    pState->walkParentId_ = 0;
+    pState->pInitial_ = NULL;
+    pState->preOrder_ = 0;
+    pState->lastOrder_ = 0;
+
+    pUserState->pName_ = (pName && *pName) ? pName : "<UNNAMED-STATE>";
+    pUserState->pNextInserted_ = NULL;
+}
+
+
+/**
+ * Assigns the pre-order intervals of all states (@see
+ * FsmStateImpl::preOrder_) in a single pass over the states in
+ * insertion order, which visits each state after its parent.
+ * 
+ * Each state's descendants are placed from the end of the
+ * state's interval backward: preOrder_ serves as the placement
+ * cursor, and it reaches the state's own pre-order number once
+ * all of the state's children have been placed.
+ * 
+ * The same pass finds out whether the FSM is flat (@see
+ * FsmMachineImpl::isFlat_).
+ * 
+ * @param pFsm
+ */
+static void
+NumberStates(FsmMachineImpl* pFsm)
+{
+    FsmStateImpl*       pRoot = &pFsm->rootState_.impl.state_;
+    FsmUserStateImpl*   pUserState;
+    int                 isFlat = TRUE;
+
+    /// The root state spans all states
+    pRoot->preOrder_ = pRoot->lastOrder_;
+
+    for (pUserState = pFsm->rootState_.impl.pNextInserted_; pUserState;
+          pUserState = pUserState->pNextInserted_) {
+        FsmStateImpl*   pState = &pUserState->state_;
+        FsmStateImpl*   pParent = pState->pParent_;
+        unsigned short  numDescendants = pState->lastOrder_;
+
+        pState->lastOrder_ = pParent->preOrder_;
+        pState->preOrder_ = pState->lastOrder_;
+        pParent->preOrder_ =
+            (unsigned short)(pState->lastOrder_ - numDescendants - 1);
+
+        isFlat = isFlat && pParent == pRoot &&
+                 !pState->pEventIds_ && !pState->pTransitions_;
+    }
+
+    FSM_ASSERT(0 == pRoot->preOrder_);
+
+    pFsm->isNumbered_ = TRUE;
+    pFsm->isFlat_ = isFlat;
+}
+
+
+/**
+ * Skips the bytes that are self-loops of a DFA state, using the
+ * state's SIMD scan record (@see FsmByteDfaScanImpl) where
+ * possible.
+ * 
+ * @param pDfa
+ * @param pRow The state's row in the DFA table
+ * @param p First byte to examine
+ * @param pEnd End of the input
+ * 
+ * @return const unsigned char* The first byte that isn't a
+ *         self-loop of the state; pEnd if none.
+ */
+static const unsigned char*
+SkipSelfLoopBytes(const FsmByteDfaImpl* pDfa, const FsmByteDfaCellImpl* pRow,
+                  const unsigned char* p, const unsigned char* pEnd)
+{
+    const FsmByteDfaScanImpl* pScan =
+        (const FsmByteDfaScanImpl*)&pRow[pDfa->numClasses_];
+
+    if (0 == pScan->numStopBytes) {
+        return pEnd;
+    }
+
+#if FSM_CONFIG_USE_SSE2
+    if (pScan->numStopBytes != kFsmByteDfaNoScan) {
+        __m128i         aStop[kFsmByteDfaMaxStopBytes];
+        unsigned int    numStop = pScan->numStopBytes;
+        unsigned int    i;
+
+        for (i = 0; i < numStop; ++i) {
+            aStop[i] = _mm_set1_epi8((char)pScan->aStopBytes[i]);
+        }
+
+        /// Compare 16 bytes at a time against each stop byte
+        for (; pEnd - p >= 16; p += 16) {
+            __m128i         chunk = _mm_loadu_si128((const __m128i*)p);
+            __m128i         hits = _mm_cmpeq_epi8(chunk, aStop[0]);
+            unsigned int    mask;
+
+            for (i = 1; i < numStop; ++i) {
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, aStop[i]));
+            }
+
+            mask = (unsigned int)_mm_movemask_epi8(hits);
+            if (mask) {
+#if defined(__GNUC__)
+                return p + __builtin_ctz(mask);
+#else
+                for (; !(mask & 1); mask >>= 1) {
+                    ++p;
+                }
+                return p;
+#endif
+            }
+        }
+    }
+#endif // FSM_CONFIG_USE_SSE2
+
+    while (p < pEnd && !pRow[pDfa->pByteClasses_[*p]].pMainSrc) {
+        ++p;
+    }
+
+    return p;
+}
+
+
 /**
  * State handler for a state machine's root state provided by
  * the FSM implementation.
@@ -620,8 +2144,8 @@ RecordInitialEntryPath(FsmMachineImpl* pFsm, FsmStateImpl* pAncestor,
  * @return int always returns false (zero) (i.e., not handled)
  */
 int
-RootStateHandler(FsmState* pOpaqueState, FsmMachine* pOpaqueFsm,
-                 const FsmEvent* pEvt)
+FsmRootStateHandler(FsmState* pOpaqueState, FsmMachine* pOpaqueFsm,
+                    const FsmEvent* pEvt)
 {
     //FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
     //FsmStateImpl* pState = (FsmStateImpl*)pOpaqueState;
@@ -63,6 +63,21 @@
 #endif
 
 
+/**
+ * FSM_VERIFY: Same as FSM_ASSERT, but remains in effect when
+ * NDEBUG is defined; guards the few API misuses and limits that
+ * would otherwise corrupt SME's data structures or go unnoticed
+ * in release builds
+ */
+#ifdef	NDEBUG
+    #include <stdlib.h>
+
+    #define FSM_VERIFY(pred__)      ((pred__) ? ((void)0) : abort())
+#else
+    #define FSM_VERIFY(pred__)      FSM_ASSERT(pred__)
+#endif
+
+
 
 
 
@@ -53,11 +53,47 @@ extern "C" {
 #endif
 
 
+/**
+ * FSM_CONFIG_HEADER_ONLY: Set by PalmFsmHeaderOnly.h when the
+ * engine is compiled into the user's translation unit
+ */
+#ifndef FSM_CONFIG_HEADER_ONLY
+    #define FSM_CONFIG_HEADER_ONLY 0
+#endif
+
+
+/**
+ * FSM_CONFIG_USE_SSE2: If non-zero, FsmFeedBytes() scans for the
+ * end of runs of self-loop bytes with SSE2 instructions; defaults
+ * to non-zero when the compiler targets SSE2
+ */
+#ifndef FSM_CONFIG_USE_SSE2
+    #if defined(__SSE2__) || defined(_M_X64)
+        #define FSM_CONFIG_USE_SSE2 1
+    #else
+        #define FSM_CONFIG_USE_SSE2 0
+    #endif
+#endif
+
+
+/**
+ * FSM_CONFIG_ENTRY_PATH_CAPACITY: Number of states of a
+ * transition's entry path that DoEntryActions() collects on the
+ * stack; longer entry paths (in deeper state machines) are split
+ * into that many segments, and walked once more per segmenting
+ */
+#ifndef FSM_CONFIG_ENTRY_PATH_CAPACITY
+    #define FSM_CONFIG_ENTRY_PATH_CAPACITY 16
+#endif
+
+
 /**
  * Define the appropriate inline attribute for inline functions
  */
 #ifndef FSM_CONFIG_INLINE_FUNC
-    #ifdef __GNUC__
+    #if FSM_CONFIG_HEADER_ONLY
+        #define FSM_CONFIG_INLINE_FUNC  static __inline
+    #elif defined(__GNUC__)
         #define FSM_CONFIG_INLINE_FUNC  extern __inline
     #else
         #define FSM_CONFIG_INLINE_FUNC  extern __inline
@@ -33,7 +33,9 @@
  * ****************************************************************************
  */
 
+#include <stdlib.h> ///< for qsort
 #include <string.h>
+#include <stdio.h>  ///< for snprintf
 
 #include "FsmBuildConfig.h"
 
@@ -48,6 +50,19 @@
 
 #include "FsmPrv.h"
 
+/**
+ * Returns the logging configuration of the given FSM, and sets
+ * it up in the FSM's own storage first if it isn't set up yet;
+ * an instance has no such storage, so it MUST have an attached
+ * logging configuration (@see FsmDbgAttachLogConfig())
+ * 
+ * @param pFsm
+ * 
+ * @return FsmLogConfigImpl*
+ */
+static FsmLogConfigImpl*
+GetLogConfig(FsmMachineImpl* pFsm);
+
 /**
  * Reset all logging flags in the given FSM instance
  * 
@@ -70,6 +85,89 @@ ResetLoggingOptions(FsmMachineImpl* pFsm);
 static void
 ApplyLoggingOptions(FsmMachineImpl* pFsm, unsigned int logOptions);
 
+/**
+ * Appends the given text to the profile text being written
+ * 
+ * @param pBuf 
+ * @param bufSize 
+ * @param size Length of the text written so far
+ * @param pText 
+ * @param len Length of pText
+ * 
+ * @return unsigned int Length of the text, pText included
+ */
+static unsigned int
+AppendProfileText(char* pBuf, unsigned int bufSize, unsigned int size,
+                  const char* pText, unsigned int len);
+
+/**
+ * Parses a decimal counter of a profile line
+ * 
+ * @param ppText In/out: the text to parse; advanced past the
+ *               counter and the space that follows it
+ * @param pEnd End of the line
+ * @param pCount 
+ * 
+ * @return int TRUE if a counter was parsed
+ */
+static int
+ParseProfileCount(const char** ppText, const char* pEnd,
+                  unsigned long* pCount);
+
+/**
+ * qsort() comparator that orders pointers to states by name
+ * 
+ * @param pState1 
+ * @param pState2 
+ * 
+ * @return int 
+ */
+static int
+CompareStateNames(const void* pState1, const void* pState2);
+
+/**
+ * Looks a name up among states that are sorted by name
+ * 
+ * @param apStates States sorted by name (@see
+ *                 CompareStateNames())
+ * @param numStates 
+ * @param pName The name; need not be NUL-terminated
+ * @param nameLen Length of pName
+ * 
+ * @return int Index of the state in apStates, or -1 if there's
+ *         no state by that name
+ */
+static int
+FindStateByName(FsmState* const apStates[], unsigned int numStates,
+                const char* pName, unsigned int nameLen);
+
+/**
+ * Returns a state's use for FsmDbgOrderStatesByUsage()
+ */
+#define FSM_STATE_USE(pUsage__)                                             \
+    ((pUsage__)->visits + (pUsage__)->deliveries + (pUsage__)->transitions)
+
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmDbgAttachLogConfig(FsmMachine* pOpaqueFsm, FsmDbgLogConfig* pLogConfig)
+{
+    FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
+
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
+    FSM_ASSERT(pLogConfig);
+    FSM_ASSERT(pFsm->isInstance_ &&
+               "An FsmMachine keeps its own logging configuration");
+
+    pFsm->pLog_ = (FsmLogConfigImpl*)pLogConfig;
+    pFsm->pLog_->logThresh_ = kFsmDbgLogLevelInfo;
+
+    ResetLoggingOptions(pFsm);
+}
 
 
 /**
@@ -84,14 +182,16 @@ FsmDbgEnableLogging(FsmMachine*                   pOpaqueFsm,
     FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
 
     FSM_ASSERT(pFsm);
-    FSM_ASSERT(&RootStateHandler == pFsm->rootState_.impl.pHandler_);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
     FSM_ASSERT(pLogCbFunc);
 
+    (void)GetLogConfig(pFsm);
+
     ResetLoggingOptions(pFsm);
 
-    pFsm->logOutKind_ = kFsmLogOutputKind_cb;
-    pFsm->logOutput.pLogFunc_ = pLogCbFunc;
-    pFsm->logCookie_ = cookie;
+    pFsm->pLog_->logOutKind_ = kFsmLogOutputKind_cb;
+    pFsm->pLog_->logOutput.pLogFunc_ = pLogCbFunc;
+    pFsm->pLog_->logCookie_ = cookie;
 
     ApplyLoggingOptions(pFsm, logOptions);
 
@@ -111,13 +211,15 @@ FsmDbgEnableLoggingViaPmLogLib(FsmMachine*  const pOpaqueFsm,
     FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
 
     FSM_ASSERT(pFsm);
-    FSM_ASSERT(&RootStateHandler == pFsm->rootState_.impl.pHandler_);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
+
+    (void)GetLogConfig(pFsm);
 
     ResetLoggingOptions(pFsm);
 
-    pFsm->logOutKind_ = kFsmLogOutputKind_pmloglib;
-    pFsm->logOutput.pmlogCtx_ = pmlogContext;
-    pFsm->logCookie_ = cookie;
+    pFsm->pLog_->logOutKind_ = kFsmLogOutputKind_pmloglib;
+    pFsm->pLog_->logOutput.pmlogCtx_ = pmlogContext;
+    pFsm->pLog_->logCookie_ = cookie;
 
     ApplyLoggingOptions(pFsm, logOptions);
 }
@@ -133,9 +235,11 @@ FsmDbgDisableLogging(FsmMachine* pOpaqueFsm)
     FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
 
     FSM_ASSERT(pFsm);
-    FSM_ASSERT(&RootStateHandler == pFsm->rootState_.impl.pHandler_);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
 
-    ResetLoggingOptions(pFsm);
+    if (pFsm->pLog_) {
+        ResetLoggingOptions(pFsm);
+    }
 }
 
 
@@ -149,9 +253,9 @@ FsmDbgSetLogLevelThreshold(FsmMachine* const pOpaqueFsm,
     FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
 
     FSM_ASSERT(pFsm);
-    FSM_ASSERT(&RootStateHandler == pFsm->rootState_.impl.pHandler_);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
 
-    pFsm->logThresh_ = level;
+    GetLogConfig(pFsm)->logThresh_ = level;
 }
 
 
@@ -164,9 +268,9 @@ FsmDbgPeekMachineName(FsmMachine* pOpaqueFsm)
     FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
 
     FSM_ASSERT(pFsm);
-    FSM_ASSERT(&RootStateHandler == pFsm->rootState_.impl.pHandler_);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
 
-    return pFsm->pName_;
+    return FSM_MACHINE_NAME(pFsm);
 }
 
 
@@ -179,9 +283,13 @@ FsmDbgPeekCurrentState(FsmMachine* pOpaqueFsm)
     FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
 
     FSM_ASSERT(pFsm);
-    FSM_ASSERT(&RootStateHandler == pFsm->rootState_.impl.pHandler_);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
 
-    return (FsmState*)pFsm->rt_.pCurrentState;
+    if (!pFsm->rt_.pCurrentState) {
+        return NULL;
+    }
+
+    return FSM_USER_STATE(pFsm->rt_.pCurrentState);
 }
 
 
@@ -196,7 +304,7 @@ FsmDbgPeekStateName(const FsmState* pOpaqueState)
     FSM_ASSERT(pState);
     FSM_ASSERT(pState->pHandler_);
 
-    return pState->pName_;
+    return FSM_STATE_NAME(pState);
 }
 
 
@@ -210,12 +318,13 @@ FsmDbgPeekParentState(FsmMachine* pOpaqueFsm, const FsmState* pOpaqueState)
     FsmStateImpl* pState = (FsmStateImpl*)pOpaqueState;
 
     FSM_ASSERT(pFsm);
-    FSM_ASSERT(&RootStateHandler == pFsm->rootState_.impl.pHandler_);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
     FSM_ASSERT(pState);
     FSM_ASSERT(pState->pHandler_);
     FSM_ASSERT(pState->pParent_);
 
-    if (pState->pParent_ == (FsmStateImpl*)&pFsm->rootState_) {
+    /// The root state is the only one without a parent
+    if (!pState->pParent_->pParent_) {
         return NULL;
     }
     else {
@@ -224,19 +333,243 @@ FsmDbgPeekParentState(FsmMachine* pOpaqueFsm, const FsmState* pOpaqueState)
 }
 
 
+/**
+ * ****************************************************************************
+ */
+void
+FsmDbgGetTransitionCacheStats(FsmMachine* pOpaqueFsm, unsigned long* pHits,
+                              unsigned long* pMisses)
+{
+    FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
+
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
+    FSM_ASSERT(pHits);
+    FSM_ASSERT(pMisses);
+
+    if (pFsm->pTranCache_) {
+        *pHits = pFsm->pTranCache_->hits;
+        *pMisses = pFsm->pTranCache_->misses;
+    }
+    else {
+        *pHits = 0;
+        *pMisses = 0;
+    }
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmDbgAttachProfile(FsmMachine* pOpaqueFsm, FsmDbgStateUsage aUsage[],
+                    unsigned int numUsage)
+{
+    FsmMachineImpl* pFsm = (FsmMachineImpl*)pOpaqueFsm;
+
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
+    FSM_ASSERT(pFsm->pSealedStates_ && "Seal the FSM first");
+
+    if (aUsage) {
+        FSM_ASSERT(numUsage >= pFsm->numSealedStates_);
+
+        memset(aUsage, 0, pFsm->numSealedStates_ * sizeof(aUsage[0]));
+    }
+
+    pFsm->pProfile_ = aUsage;
+    pFsm->isProfiled_ = (NULL != aUsage);
+}
+
+
+/**
+ * ****************************************************************************
+ */
+unsigned int
+FsmDbgWriteProfile(FsmMachine* pOpaqueFsm, char* pBuf, unsigned int bufSize)
+{
+    FsmMachineImpl*         pFsm = (FsmMachineImpl*)pOpaqueFsm;
+    const FsmDbgStateUsage* aUsage = NULL;
+    const char* const*      apStateNames = NULL;
+    char                    line[100];
+    unsigned int            size = 0;
+    unsigned int            i;
+    int                     len;
+
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(&FsmRootStateHandler == FSM_ROOT_STATE(pFsm)->pHandler_);
+    FSM_ASSERT(FSM_PROFILE(pFsm) && "Attach a profile first");
+    FSM_ASSERT(pBuf || !bufSize);
+
+    aUsage = FSM_PROFILE(pFsm);
+    apStateNames = FSM_SEALED_STATE_NAMES(pFsm->pSealedStates_);
+
+    size = AppendProfileText(pBuf, bufSize, size, "# FSM profile: ", 15);
+    size = AppendProfileText(pBuf, bufSize, size, FSM_MACHINE_NAME(pFsm),
+                             (unsigned int)strlen(FSM_MACHINE_NAME(pFsm)));
+
+    for (i = 1; i < pFsm->numSealedStates_; ++i) {
+        const char* pName = apStateNames[i];
+
+        len = snprintf(line, sizeof(line), "\n%lu %lu %lu ",
+                       aUsage[i].visits, aUsage[i].deliveries,
+                       aUsage[i].transitions);
+        FSM_ASSERT(len > 0 && len < (int)sizeof(line));
+
+        size = AppendProfileText(pBuf, bufSize, size, line, (unsigned int)len);
+        size = AppendProfileText(pBuf, bufSize, size, pName,
+                                 (unsigned int)strlen(pName));
+    }
+
+    size = AppendProfileText(pBuf, bufSize, size, "\n", 1);
+
+    if (size < bufSize) {
+        pBuf[size] = '\0';
+    }
+    else if (bufSize) {
+        pBuf[bufSize - 1] = '\0';
+    }
+
+    return size;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+unsigned int
+FsmDbgReadProfile(const char* pProfile, unsigned int profileSize,
+                  FsmState* apStates[], FsmDbgStateUsage aUsage[],
+                  unsigned int numStates)
+{
+    const char*     pLine = pProfile;
+    const char*     pProfileEnd = pProfile + profileSize;
+    unsigned int    numMatched = 0;
+    int             i;
+
+    FSM_ASSERT(pProfile || !profileSize);
+    FSM_ASSERT(apStates);
+    FSM_ASSERT(aUsage);
+
+    memset(aUsage, 0, numStates * sizeof(aUsage[0]));
+
+    /// The sorted states are the index that the profile's names are
+    /// looked up in
+    qsort(apStates, numStates, sizeof(apStates[0]), &CompareStateNames);
+
+    for (; pLine < pProfileEnd; ++pLine) {
+        const char*         pEnd = pLine;
+        const char*         pText = pLine;
+        FsmDbgStateUsage    usage;
+        unsigned int        nameLen;
+
+        while (pEnd < pProfileEnd && '\n' != *pEnd) {
+            ++pEnd;
+        }
+
+        /// The line is "<visits> <deliveries> <transitions> <name>"; the
+        /// comment lines don't parse
+        if (ParseProfileCount(&pText, pEnd, &usage.visits) &&
+            ParseProfileCount(&pText, pEnd, &usage.deliveries) &&
+            ParseProfileCount(&pText, pEnd, &usage.transitions)) {
+
+            nameLen = (unsigned int)(pEnd - pText);
+            if (nameLen > 0 && '\r' == pText[nameLen - 1]) {
+                --nameLen;
+            }
+
+            i = FindStateByName(apStates, numStates, pText, nameLen);
+            if (i >= 0) {
+                aUsage[i] = usage;
+                ++numMatched;
+            }
+        }
+
+        pLine = pEnd;
+    }
+
+    return numMatched;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmDbgOrderStatesByUsage(FsmState* apStates[], FsmDbgStateUsage aUsage[],
+                         unsigned int numStates)
+{
+    unsigned int i;
+
+    FSM_ASSERT(apStates);
+    FSM_ASSERT(aUsage);
+
+    /// Binary insertion sort: it's stable, and needs no extra storage
+    for (i = 1; i < numStates; ++i) {
+        FsmState*           pState = apStates[i];
+        FsmDbgStateUsage    usage = aUsage[i];
+        unsigned long       use = FSM_STATE_USE(&usage);
+        unsigned int        lo = 0;
+        unsigned int        hi = i;
+
+        /// Find the first of the sorted states that's used less
+        while (lo < hi) {
+            unsigned int mid = lo + (hi - lo) / 2;
+
+            if (FSM_STATE_USE(&aUsage[mid]) >= use) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+
+        if (lo < i) {
+            memmove(&apStates[lo + 1], &apStates[lo],
+                    (i - lo) * sizeof(apStates[0]));
+            memmove(&aUsage[lo + 1], &aUsage[lo], (i - lo) * sizeof(aUsage[0]));
+
+            apStates[lo] = pState;
+            aUsage[lo] = usage;
+        }
+    }
+}
+
+
+/**
+ * ****************************************************************************
+ */
+static FsmLogConfigImpl*
+GetLogConfig(FsmMachineImpl* const pFsm)
+{
+    if (!pFsm->pLog_) {
+        /// Fail loudly rather than silently dropping the caller's
+        /// logging setup, in release builds, too
+        FSM_VERIFY(!pFsm->isInstance_ &&
+                   "FSM instance has no attached logging configuration");
+
+        pFsm->pLog_ = &pFsm->log_;
+    }
+
+    return pFsm->pLog_;
+}
+
+
 /**
  * ****************************************************************************
  */
 static void
 ResetLoggingOptions(FsmMachineImpl* const pFsm)
 {
+    FSM_ASSERT(pFsm->pLog_);
+
     /// Reset all logging flags
-    pFsm->logOutKind_ = kFsmLogOutputKind_none;
-    pFsm->logOutput.pLogFunc_ = NULL;
+    pFsm->pLog_->logOutKind_ = kFsmLogOutputKind_none;
+    pFsm->pLog_->logOutput.pLogFunc_ = NULL;
     #if FSM_CONFIG_WEBOS_FEATURES
-        pFsm->logOutput.pmlogCtx_ = NULL;
+        pFsm->pLog_->logOutput.pmlogCtx_ = NULL;
     #endif
-    pFsm->logCookie_ = NULL;
+    pFsm->pLog_->logCookie_ = NULL;
 }
 
 
@@ -255,6 +588,99 @@ ApplyLoggingOptions(FsmMachineImpl* const pFsm, unsigned int logOptions)
     if (logOptions != 0) {
         FSM_LOG_ERR(pFsm,
                     "FSM.%s(%p/c=%p): ERROR: unexpected logging options: 0x%X",
-                    pFsm->pName_, pFsm, pFsm->logCookie_, logOptions);
+                    FSM_MACHINE_NAME(pFsm), pFsm, FSM_LOG_COOKIE(pFsm),
+                    logOptions);
+    }
+}
+
+
+/**
+ * ****************************************************************************
+ */
+static unsigned int
+AppendProfileText(char* pBuf, unsigned int bufSize, unsigned int size,
+                  const char* pText, unsigned int len)
+{
+    if (size < bufSize) {
+        memcpy(pBuf + size, pText, (len < bufSize - size) ? len
+                                                          : bufSize - size);
+    }
+
+    return size + len;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+static int
+CompareStateNames(const void* pState1, const void* pState2)
+{
+    return strcmp(FSM_STATE_NAME(*(const FsmStateImpl* const*)pState1),
+                  FSM_STATE_NAME(*(const FsmStateImpl* const*)pState2));
+}
+
+
+/**
+ * ****************************************************************************
+ */
+static int
+FindStateByName(FsmState* const apStates[], unsigned int numStates,
+                const char* pName, unsigned int nameLen)
+{
+    unsigned int lo = 0;
+    unsigned int hi = numStates;
+
+    while (lo < hi) {
+        unsigned int    mid = lo + (hi - lo) / 2;
+        const char*     pMidName =
+            FSM_STATE_NAME((const FsmStateImpl*)apStates[mid]);
+        int             cmp = strncmp(pMidName, pName, nameLen);
+
+        /// A longer name that starts with pName sorts after it
+        if (!cmp && '\0' != pMidName[nameLen]) {
+            cmp = 1;
+        }
+
+        if (!cmp) {
+            return (int)mid;
+        }
+        else if (cmp < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
     }
+
+    return -1;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+static int
+ParseProfileCount(const char** ppText, const char* pEnd,
+                  unsigned long* pCount)
+{
+    const char* p = *ppText;
+
+    *pCount = 0;
+
+    if (p >= pEnd || *p < '0' || *p > '9') {
+        return FALSE;
+    }
+
+    for (; p < pEnd && *p >= '0' && *p <= '9'; ++p) {
+        *pCount = *pCount * 10 + (unsigned long)(*p - '0');
+    }
+
+    if (p >= pEnd || ' ' != *p) {
+        return FALSE;
+    }
+
+    *ppText = p + 1;
+
+    return TRUE;
 }
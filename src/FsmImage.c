@@ -0,0 +1,675 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ * ****************************************************************************
+ * @file FsmImage.c
+ *
+ * @brief  State Machine Engine's binary definition image API.
+ *
+ * Writes and loads the position-independent images of sealed
+ * state machine topologies (@see PalmFsmImage.h).
+ *
+ * @note This API is NOT thread-safe
+ * ****************************************************************************
+ */
+
+#include <string.h>
+
+#include "FsmBuildConfig.h"
+
+#include "FsmAssert.h"
+
+#include "PalmFsm.h"
+#include "PalmFsmImage.h"
+
+#include "FsmPrv.h"
+
+
+/**
+ * This structure contains the compile-time checks for this
+ * module
+ */
+typedef struct ImageCompileAssert {
+    /**
+     * If the image's fields aren't 32 bits wide, the compiler
+     * should generate a "divide by zero" error.
+     */
+    char    FsmImage_fields_are_32_bits[
+        1/(sizeof(unsigned int) == 4 && sizeof(FsmEventIdType) == 4)];
+
+    /**
+     * If the image's records aren't made of whole 32-bit words,
+     * which keeps the tables aligned, the compiler should generate
+     * a "divide by zero" error.
+     */
+    char    FsmImage_records_are_aligned[
+        1/(sizeof(FsmImageHeader) % 4 == 0 &&
+           sizeof(FsmImageStateRecord) % 4 == 0 &&
+           sizeof(FsmImageTransitionRecord) % 4 == 0)];
+} ImageCompileAssert;
+
+
+/**
+ * Empty event subscription set of the root state of loaded
+ * definitions; @see FsmInitMachine()
+ */
+static const FsmEventIdType g_imageNoEventIds[1] = {0};
+
+
+static int
+FindImageBinding(const FsmImageBinding aBindings[], unsigned int numBindings,
+                 FsmStateHandlerFnType* pHandler,
+                 FsmTransitionGuardFnType* pGuard,
+                 FsmTransitionActionFnType* pAction);
+
+static const FsmImageBinding*
+FindImageBindingByName(const FsmImageBinding aBindings[],
+                       unsigned int numBindings, const char* pName);
+
+static unsigned int
+GetImageBindingNameOffset(const FsmImageBinding aBindings[],
+                          unsigned int index, unsigned int poolBase);
+
+static int
+IsValidImageTable(unsigned int imageSize, unsigned int offset,
+                  unsigned int numElements, unsigned int elementSize);
+
+
+
+/**
+ * ****************************************************************************
+ */
+unsigned int
+FsmWriteDefinitionImage(FsmMachine* pOpaqueFsm,
+                        const FsmImageBinding aBindings[],
+                        unsigned int numBindings, void* pBuf,
+                        unsigned int bufSize)
+{
+    FsmMachineImpl*           pFsm = (FsmMachineImpl*)pOpaqueFsm;
+    const FsmStateImpl*       aSealed = NULL;
+    FsmImageHeader*           pHeader = (FsmImageHeader*)pBuf;
+    FsmImageStateRecord*      aRecords = NULL;
+    FsmEventIdType*           aEventIds = NULL;
+    FsmImageTransitionRecord* aTransitions = NULL;
+    char*                     pStrings = NULL;
+    unsigned int              numSealed;
+    unsigned int              numEventIds = 0, numTransitions = 0;
+    unsigned int              stringsSize, bindingsBase, imageSize;
+    unsigned int              i, j;
+
+    FSM_ASSERT(pFsm);
+    FSM_ASSERT(!pFsm->isInstance_ && "Can't write an image of an FSM instance");
+    FSM_ASSERT(pFsm->pSealedStates_ && "Seal the FSM first");
+    FSM_ASSERT(aBindings || !numBindings);
+    FSM_ASSERT(pBuf || !bufSize);
+
+    aSealed = pFsm->pSealedStates_;
+    numSealed = pFsm->numSealedStates_;
+
+    FSM_ASSERT(aSealed[0].lastOrder_ + 1u == numSealed &&
+               "All states MUST be sealed");
+
+    /// Size the image, and check that all functions are bound
+    bindingsBase = (unsigned int)strlen(FSM_MACHINE_NAME(pFsm)) + 1;
+    stringsSize = bindingsBase;
+
+    for (i = 0; i < numBindings; ++i) {
+        FSM_ASSERT(aBindings[i].pName);
+        stringsSize += (unsigned int)strlen(aBindings[i].pName) + 1;
+    }
+
+    for (i = 1; i < numSealed; ++i) {
+        const FsmStateImpl* pState = &aSealed[i];
+
+        if (FindImageBinding(aBindings, numBindings, pState->pHandler_,
+                             NULL, NULL) < 0) {
+            return 0;
+        }
+
+        for (j = 0; j < pState->numTransitions_; ++j) {
+            const FsmTransitionDef* pTran = &pState->pTransitions_[j];
+
+            if ((pTran->pGuard &&
+                 FindImageBinding(aBindings, numBindings, NULL,
+                                  pTran->pGuard, NULL) < 0) ||
+                (pTran->pAction &&
+                 FindImageBinding(aBindings, numBindings, NULL, NULL,
+                                  pTran->pAction) < 0)) {
+                return 0;
+            }
+        }
+
+        stringsSize += (unsigned int)strlen(FSM_STATE_NAME(pState)) + 1;
+        numEventIds += pState->pEventIds_ ? pState->numEventIds_ : 0;
+        numTransitions += pState->numTransitions_;
+    }
+
+    /// Keep the image's size a whole number of words
+    stringsSize = (stringsSize + 3) & ~3u;
+
+    imageSize = sizeof(FsmImageHeader) +
+                numSealed * sizeof(FsmImageStateRecord) +
+                numEventIds * sizeof(FsmEventIdType) +
+                numTransitions * sizeof(FsmImageTransitionRecord) +
+                stringsSize;
+
+    if (imageSize > bufSize) {
+        return imageSize;
+    }
+
+    FSM_ASSERT(0 == (unsigned long)pBuf % sizeof(unsigned int));
+
+    memset(pBuf, 0, imageSize);
+
+    pHeader->magic_ = FSM_IMAGE_MAGIC;
+    pHeader->version_ = FSM_IMAGE_VERSION;
+    pHeader->imageSize_ = imageSize;
+    pHeader->numStates_ = numSealed - 1;
+    pHeader->maxDepth_ = pFsm->maxDepth_;
+    pHeader->machineName_ = 0;
+    pHeader->statesOffset_ = sizeof(FsmImageHeader);
+    pHeader->eventIdsOffset_ = pHeader->statesOffset_ +
+                               numSealed * sizeof(FsmImageStateRecord);
+    pHeader->numEventIds_ = numEventIds;
+    pHeader->transitionsOffset_ = pHeader->eventIdsOffset_ +
+                                  numEventIds * sizeof(FsmEventIdType);
+    pHeader->numTransitions_ = numTransitions;
+    pHeader->stringsOffset_ = pHeader->transitionsOffset_ +
+                              numTransitions * sizeof(FsmImageTransitionRecord);
+    pHeader->stringsSize_ = stringsSize;
+
+    aRecords = (FsmImageStateRecord*)((char*)pBuf + pHeader->statesOffset_);
+    aEventIds = (FsmEventIdType*)((char*)pBuf + pHeader->eventIdsOffset_);
+    aTransitions = (FsmImageTransitionRecord*)
+        ((char*)pBuf + pHeader->transitionsOffset_);
+    pStrings = (char*)pBuf + pHeader->stringsOffset_;
+
+    /// The machine's name, then the bindings' names, then the states'
+    strcpy(pStrings, FSM_MACHINE_NAME(pFsm));
+    stringsSize = bindingsBase;
+    for (i = 0; i < numBindings; ++i) {
+        strcpy(pStrings + stringsSize, aBindings[i].pName);
+        stringsSize += (unsigned int)strlen(aBindings[i].pName) + 1;
+    }
+
+    aRecords[0].handler_ = FSM_IMAGE_NONE;
+    aRecords[0].lastOrder_ = aSealed[0].lastOrder_;
+    aRecords[0].firstEventId_ = FSM_IMAGE_NONE;
+
+    /// The records are placed at their states' pre-order numbers
+    numEventIds = 0;
+    numTransitions = 0;
+    for (i = 1; i < numSealed; ++i) {
+        const FsmStateImpl*  pState = &aSealed[i];
+        FsmImageStateRecord* pRecord = &aRecords[pState->preOrder_];
+
+        pRecord->handler_ = GetImageBindingNameOffset(
+            aBindings,
+            (unsigned int)FindImageBinding(aBindings, numBindings,
+                                           pState->pHandler_, NULL, NULL),
+            bindingsBase);
+
+        pRecord->name_ = stringsSize;
+        strcpy(pStrings + stringsSize, FSM_STATE_NAME(pState));
+        stringsSize += (unsigned int)strlen(FSM_STATE_NAME(pState)) + 1;
+
+        pRecord->parent_ = pState->pParent_->preOrder_;
+        pRecord->walkParent_ = aSealed[pState->walkParentId_].preOrder_;
+        pRecord->lastOrder_ = pState->lastOrder_;
+        pRecord->depth_ = pState->depth_;
+        pRecord->flags_ = pState->flags_ & kFsmStateFlagPassThrough;
+
+        if (pState->pInitial_) {
+            const FsmStateImpl* pInnermost = pState->pInitial_;
+
+            while (pInnermost->pInitial_) {
+                pInnermost = pInnermost->pInitial_;
+            }
+            pRecord->initial_ = pInnermost->preOrder_;
+        }
+
+        pRecord->firstEventId_ = FSM_IMAGE_NONE;
+        if (pState->pEventIds_) {
+            pRecord->firstEventId_ = numEventIds;
+            pRecord->numEventIds_ = pState->numEventIds_;
+            for (j = 0; j < pState->numEventIds_; ++j) {
+                aEventIds[numEventIds++] = pState->pEventIds_[j];
+            }
+        }
+
+        pRecord->firstTransition_ = numTransitions;
+        pRecord->numTransitions_ = pState->numTransitions_;
+        for (j = 0; j < pState->numTransitions_; ++j) {
+            const FsmTransitionDef*     pTran = &pState->pTransitions_[j];
+            FsmImageTransitionRecord*   pOut = &aTransitions[numTransitions++];
+            const FsmStateImpl*         pTarget =
+                &aSealed[((const FsmStateImpl*)pTran->pTarget)->id_];
+
+            pOut->evtId_ = pTran->evtId;
+            pOut->target_ = pTarget->preOrder_;
+            pOut->guard_ = pTran->pGuard
+                ? GetImageBindingNameOffset(
+                    aBindings,
+                    (unsigned int)FindImageBinding(aBindings, numBindings,
+                                                   NULL, pTran->pGuard, NULL),
+                    bindingsBase)
+                : FSM_IMAGE_NONE;
+            pOut->action_ = pTran->pAction
+                ? GetImageBindingNameOffset(
+                    aBindings,
+                    (unsigned int)FindImageBinding(aBindings, numBindings,
+                                                   NULL, NULL, pTran->pAction),
+                    bindingsBase)
+                : FSM_IMAGE_NONE;
+        }
+    }
+
+    return imageSize;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+int
+FsmGetDefinitionImageInfo(const void* pImage, unsigned int imageSize,
+                          unsigned int* pNumStates,
+                          unsigned int* pNumTransitions)
+{
+    const FsmImageHeader* pHeader = (const FsmImageHeader*)pImage;
+
+    FSM_ASSERT(pImage);
+    FSM_ASSERT(0 == (unsigned long)pImage % sizeof(unsigned int));
+    FSM_ASSERT(pNumStates);
+    FSM_ASSERT(pNumTransitions);
+
+    if (imageSize < sizeof(FsmImageHeader) ||
+        FSM_IMAGE_MAGIC != pHeader->magic_ ||
+        FSM_IMAGE_VERSION != pHeader->version_ ||
+        pHeader->imageSize_ > imageSize) {
+        return FALSE;
+    }
+
+    imageSize = pHeader->imageSize_;
+
+    if (pHeader->numStates_ < 1 ||
+        pHeader->numStates_ > FSM_MAX_USER_STATES ||
+        pHeader->maxDepth_ < 1 || pHeader->maxDepth_ > pHeader->numStates_ ||
+        !IsValidImageTable(imageSize, pHeader->statesOffset_,
+                           pHeader->numStates_ + 1,
+                           sizeof(FsmImageStateRecord)) ||
+        !IsValidImageTable(imageSize, pHeader->eventIdsOffset_,
+                           pHeader->numEventIds_, sizeof(FsmEventIdType)) ||
+        !IsValidImageTable(imageSize, pHeader->transitionsOffset_,
+                           pHeader->numTransitions_,
+                           sizeof(FsmImageTransitionRecord)) ||
+        !IsValidImageTable(imageSize, pHeader->stringsOffset_,
+                           pHeader->stringsSize_, 1) ||
+        pHeader->stringsSize_ < 1 ||
+        pHeader->machineName_ >= pHeader->stringsSize_) {
+        return FALSE;
+    }
+
+    /// All strings are terminated within the pool
+    if (((const char*)pImage)[pHeader->stringsOffset_ +
+                              pHeader->stringsSize_ - 1] != '\0') {
+        return FALSE;
+    }
+
+    *pNumStates = pHeader->numStates_;
+    *pNumTransitions = pHeader->numTransitions_;
+
+    return TRUE;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+int
+FsmLoadDefinitionImage(FsmDefinition* pOpaqueDef, const void* pImage,
+                       unsigned int imageSize,
+                       const FsmImageBinding aBindings[],
+                       unsigned int numBindings, FsmSealedState* pStorage,
+                       unsigned int numStorageElements,
+                       FsmTransitionDef* aTransitions,
+                       unsigned int numTransitionElements)
+{
+    FsmDefinitionImpl*              pDef = (FsmDefinitionImpl*)pOpaqueDef;
+    const FsmImageHeader*           pHeader = (const FsmImageHeader*)pImage;
+    FsmStateImpl*                   aStates = (FsmStateImpl*)pStorage;
+    const char**                    apStateNames = NULL;
+    const FsmImageStateRecord*      aRecords = NULL;
+    const FsmEventIdType*           aEventIds = NULL;
+    const FsmImageTransitionRecord* aImageTransitions = NULL;
+    const char*                     pStrings = NULL;
+    const FsmImageBinding*          pHandlerBinding = NULL;
+    unsigned int                    handlerName = FSM_IMAGE_NONE;
+    unsigned int                    numStates, numTransitions, stringsSize;
+    unsigned int                    i, j;
+
+    FSM_ASSERT(pDef);
+    FSM_ASSERT(pStorage);
+    FSM_ASSERT(aBindings || !numBindings);
+
+    if (!FsmGetDefinitionImageInfo(pImage, imageSize, &numStates,
+                                   &numTransitions) ||
+        numStorageElements < FSM_SEALED_STATE_COUNT(numStates) ||
+        numTransitionElements < numTransitions ||
+        (numTransitions && !aTransitions)) {
+        return FALSE;
+    }
+
+    aRecords = (const FsmImageStateRecord*)
+        ((const char*)pImage + pHeader->statesOffset_);
+    aEventIds = (const FsmEventIdType*)
+        ((const char*)pImage + pHeader->eventIdsOffset_);
+    aImageTransitions = (const FsmImageTransitionRecord*)
+        ((const char*)pImage + pHeader->transitionsOffset_);
+    pStrings = (const char*)pImage + pHeader->stringsOffset_;
+    stringsSize = pHeader->stringsSize_;
+
+    if (aRecords[0].depth_ || aRecords[0].lastOrder_ != numStates) {
+        return FALSE;
+    }
+
+    /// The names follow the state records, as in FsmSealMachine(); the
+    /// names themselves stay in the image's string pool
+    apStateNames = (const char**)&aStates[FSM_SEALED_STATE_COUNT(numStates)];
+
+    memset(&aStates[0], 0, sizeof(aStates[0]));
+    aStates[0].pHandler_ = &FsmRootStateHandler;
+    aStates[0].pUser_ = (FsmState*)&aStates[0];
+    aStates[0].pEventIds_ = g_imageNoEventIds;
+    aStates[0].flags_ = kFsmStateFlagSealedRecord_;
+    aStates[0].lastOrder_ = (unsigned short)numStates;
+    apStateNames[0] = pStrings + pHeader->machineName_;
+
+    /// Validate and bind the states in a single pass; a state's
+    /// parent (and its other ancestors) precede it
+    for (i = 1; i <= numStates; ++i) {
+        const FsmImageStateRecord*  pRecord = &aRecords[i];
+        const FsmImageStateRecord*  pParent = &aRecords[pRecord->parent_];
+        FsmStateImpl*               pState = &aStates[i];
+        unsigned int                ancestor = i - 1;
+
+        if (pRecord->parent_ >= i || pRecord->walkParent_ >= i ||
+            pRecord->depth_ != pParent->depth_ + 1 ||
+            pRecord->depth_ > pHeader->maxDepth_ ||
+            pRecord->lastOrder_ < i ||
+            pRecord->lastOrder_ > pParent->lastOrder_ ||
+            i > aRecords[pRecord->walkParent_].lastOrder_ ||
+            (pRecord->flags_ & ~(unsigned int)kFsmStateFlagPassThrough) ||
+            pRecord->name_ >= stringsSize ||
+            pRecord->handler_ >= stringsSize) {
+            return FALSE;
+        }
+
+        /// Pre-order: the parent is the nearest preceding state whose
+        /// subtree contains this one
+        while (aRecords[ancestor].lastOrder_ < i) {
+            ancestor = aRecords[ancestor].parent_;
+        }
+        if (ancestor != pRecord->parent_) {
+            return FALSE;
+        }
+
+        if (pRecord->initial_ &&
+            (pRecord->initial_ <= i ||
+             pRecord->initial_ > pRecord->lastOrder_ ||
+             aRecords[pRecord->initial_].initial_)) {
+            return FALSE;
+        }
+
+        /// Consecutive states usually share their handler, whose
+        /// binding's name is pooled once
+        if (pRecord->handler_ != handlerName) {
+            pHandlerBinding = FindImageBindingByName(
+                aBindings, numBindings, pStrings + pRecord->handler_);
+
+            if (!pHandlerBinding || !pHandlerBinding->pHandler) {
+                return FALSE;
+            }
+            handlerName = pRecord->handler_;
+        }
+
+        pState->pHandler_ = pHandlerBinding->pHandler;
+        pState->pUser_ = (FsmState*)pState;
+        pState->pParent_ = &aStates[pRecord->parent_];
+        pState->depth_ = pRecord->depth_;
+        pState->id_ = (unsigned short)i;
+        pState->pEventIds_ = NULL;
+        pState->numEventIds_ = 0;
+        pState->pTransitions_ = NULL;
+        pState->numTransitions_ = 0;
+        pState->flags_ = pRecord->flags_ | kFsmStateFlagSealedRecord_;
+        pState->walkParentId_ = pRecord->walkParent_;
+        pState->pInitial_ = pRecord->initial_
+                            ? &aStates[pRecord->initial_] : NULL;
+        pState->preOrder_ = (unsigned short)i;
+        pState->lastOrder_ = pRecord->lastOrder_;
+        apStateNames[i] = pStrings + pRecord->name_;
+
+        /// The event subscription set is used in place
+        if (FSM_IMAGE_NONE != pRecord->firstEventId_) {
+            if (pRecord->firstEventId_ > pHeader->numEventIds_ ||
+                pRecord->numEventIds_ >
+                pHeader->numEventIds_ - pRecord->firstEventId_) {
+                return FALSE;
+            }
+
+            pState->pEventIds_ = &aEventIds[pRecord->firstEventId_];
+            for (j = 1; j < pRecord->numEventIds_; ++j) {
+                if (pState->pEventIds_[j] < pState->pEventIds_[j - 1]) {
+                    return FALSE;
+                }
+            }
+
+            pState->numEventIds_ = pRecord->numEventIds_;
+        }
+
+        /// The transitions are bound in the user's storage
+        if (pRecord->numTransitions_) {
+            if (pRecord->firstTransition_ > numTransitions ||
+                pRecord->numTransitions_ >
+                numTransitions - pRecord->firstTransition_) {
+                return FALSE;
+            }
+
+            for (j = 0; j < pRecord->numTransitions_; ++j) {
+                const FsmImageTransitionRecord* pIn =
+                    &aImageTransitions[pRecord->firstTransition_ + j];
+                FsmTransitionDef* pOut =
+                    &aTransitions[pRecord->firstTransition_ + j];
+                const FsmImageBinding* pGuard = NULL;
+                const FsmImageBinding* pAction = NULL;
+
+                if (pIn->evtId_ < kFsmEventFirstUserEvent ||
+                    (j > 0 && pIn->evtId_ < pIn[-1].evtId_) ||
+                    pIn->target_ < 1 || pIn->target_ > numStates) {
+                    return FALSE;
+                }
+
+                if (FSM_IMAGE_NONE != pIn->guard_) {
+                    pGuard = (pIn->guard_ < stringsSize)
+                        ? FindImageBindingByName(aBindings, numBindings,
+                                                 pStrings + pIn->guard_)
+                        : NULL;
+                    if (!pGuard || !pGuard->pGuard) {
+                        return FALSE;
+                    }
+                }
+
+                if (FSM_IMAGE_NONE != pIn->action_) {
+                    pAction = (pIn->action_ < stringsSize)
+                        ? FindImageBindingByName(aBindings, numBindings,
+                                                 pStrings + pIn->action_)
+                        : NULL;
+                    if (!pAction || !pAction->pAction) {
+                        return FALSE;
+                    }
+                }
+
+                pOut->evtId = pIn->evtId_;
+                pOut->pTarget = (FsmState*)&aStates[pIn->target_];
+                pOut->pGuard = pGuard ? pGuard->pGuard : NULL;
+                pOut->pAction = pAction ? pAction->pAction : NULL;
+            }
+
+            pState->pTransitions_ = &aTransitions[pRecord->firstTransition_];
+            pState->numTransitions_ = pRecord->numTransitions_;
+        }
+    }
+
+    pDef->pSealedStates_ = aStates;
+    pDef->numSealedStates_ = FSM_SEALED_STATE_COUNT(numStates);
+
+    return TRUE;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+FsmState*
+FsmFindDefinitionState(const FsmDefinition* pOpaqueDef, const char* pName)
+{
+    const FsmDefinitionImpl*    pDef = (const FsmDefinitionImpl*)pOpaqueDef;
+    const char* const*          apStateNames = NULL;
+    unsigned int                i;
+
+    FSM_ASSERT(pDef);
+    FSM_ASSERT(pDef->pSealedStates_);
+    FSM_ASSERT(pName);
+
+    /// Scan the name array rather than the state records
+    apStateNames = FSM_SEALED_STATE_NAMES(pDef->pSealedStates_);
+
+    for (i = 1; i < pDef->numSealedStates_; ++i) {
+        if (!strcmp(apStateNames[i], pName)) {
+            return FSM_USER_STATE(&pDef->pSealedStates_[i]);
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Looks up the binding of the given function; exactly one of the
+ * function pointers is non-NULL
+ *
+ * @param aBindings
+ * @param numBindings
+ * @param pHandler
+ * @param pGuard
+ * @param pAction
+ *
+ * @return int Index of the first binding of the function; -1 if
+ *         none.
+ */
+static int
+FindImageBinding(const FsmImageBinding aBindings[], unsigned int numBindings,
+                 FsmStateHandlerFnType* pHandler,
+                 FsmTransitionGuardFnType* pGuard,
+                 FsmTransitionActionFnType* pAction)
+{
+    unsigned int i;
+
+    for (i = 0; i < numBindings; ++i) {
+        if ((pHandler && pHandler == aBindings[i].pHandler) ||
+            (pGuard && pGuard == aBindings[i].pGuard) ||
+            (pAction && pAction == aBindings[i].pAction)) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+
+/**
+ * Looks up the binding of the given name
+ *
+ * @param aBindings
+ * @param numBindings
+ * @param pName
+ *
+ * @return const FsmImageBinding* NULL if none.
+ */
+static const FsmImageBinding*
+FindImageBindingByName(const FsmImageBinding aBindings[],
+                       unsigned int numBindings, const char* pName)
+{
+    unsigned int i;
+
+    for (i = 0; i < numBindings; ++i) {
+        if (!strcmp(aBindings[i].pName, pName)) {
+            return &aBindings[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Returns the string pool offset of the given binding's name in
+ * an image written by FsmWriteDefinitionImage(), which places the
+ * names of all bindings in order at poolBase
+ *
+ * @param aBindings
+ * @param index
+ * @param poolBase
+ *
+ * @return unsigned int
+ */
+static unsigned int
+GetImageBindingNameOffset(const FsmImageBinding aBindings[],
+                          unsigned int index, unsigned int poolBase)
+{
+    unsigned int i;
+
+    for (i = 0; i < index; ++i) {
+        poolBase += (unsigned int)strlen(aBindings[i].pName) + 1;
+    }
+
+    return poolBase;
+}
+
+
+/**
+ * Checks that the given table is aligned and lies within the
+ * image
+ *
+ * @param imageSize
+ * @param offset Byte offset of the table from the start of the
+ *               image
+ * @param numElements
+ * @param elementSize
+ *
+ * @return int
+ */
+static int
+IsValidImageTable(unsigned int imageSize, unsigned int offset,
+                  unsigned int numElements, unsigned int elementSize)
+{
+    return (0 == offset % sizeof(unsigned int) && offset <= imageSize &&
+            numElements <= (imageSize - offset) / elementSize);
+}
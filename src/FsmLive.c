@@ -0,0 +1,362 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ * ****************************************************************************
+ * @file FsmLive.c
+ *
+ * @brief  State Machine Engine's live definition API.
+ *
+ * Publishes new versions of definitions to running instances, and
+ * reclaims the versions that no instance runs on anymore (@see
+ * PalmFsmLive.h).
+ * ****************************************************************************
+ */
+
+#include <string.h>
+
+#include "FsmBuildConfig.h"
+
+#include "FsmAssert.h"
+
+#include "PalmFsm.h"
+#include "PalmFsmDbg.h"
+#include "PalmFsmImage.h"
+#include "PalmFsmLive.h"
+
+#include "FsmPrv.h"
+
+
+/**
+ * This structure contains the compile-time checks for this
+ * module
+ */
+typedef struct LiveCompileAssert {
+    /**
+     * If FsmLiveDefinition and FsmLiveDefinitionImpl (or
+     * FsmLiveVersion and FsmLiveVersionImpl) structure sizes don't
+     * match, the compiler should generate a "divide by zero" error.
+     */
+    char    FsmLiveDefinition_is_correct_size[
+        1/(sizeof(FsmLiveDefinition) == sizeof(FsmLiveDefinitionImpl))];
+    char    FsmLiveVersion_is_correct_size[
+        1/(sizeof(FsmLiveVersion) == sizeof(FsmLiveVersionImpl))];
+} LiveCompileAssert;
+
+
+static void
+InitLiveVersion(FsmLiveVersionImpl* pVersion, const FsmDefinitionImpl* pDef,
+                const unsigned short aIdMap[]);
+
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmInitLiveDefinition(FsmLiveDefinition* pOpaqueLive,
+                      FsmLiveVersion* pOpaqueVersion,
+                      const FsmDefinition* pOpaqueDef)
+{
+    FsmLiveDefinitionImpl*  pLive = (FsmLiveDefinitionImpl*)pOpaqueLive;
+    FsmLiveVersionImpl*     pVersion = (FsmLiveVersionImpl*)pOpaqueVersion;
+
+    FSM_ASSERT(pLive);
+
+    InitLiveVersion(pVersion, (const FsmDefinitionImpl*)pOpaqueDef, NULL);
+
+    pLive->pOldest_ = pVersion;
+    pLive->numAttaching_ = 0;
+    FSM_ATOMIC_STORE(&pLive->pCurrent_, pVersion);
+}
+
+
+/**
+ * ****************************************************************************
+ */
+unsigned int
+FsmMapDefinitionStates(const FsmDefinition* pOpaqueFrom,
+                       const FsmDefinition* pOpaqueTo,
+                       unsigned short aIdMap[], unsigned int mapSize)
+{
+    const FsmDefinitionImpl*    pFrom = (const FsmDefinitionImpl*)pOpaqueFrom;
+    const char* const*          apStateNames = NULL;
+    unsigned int                numUnmapped = 0;
+    unsigned int                i;
+
+    FSM_ASSERT(pFrom);
+    FSM_ASSERT(pFrom->pSealedStates_);
+    FSM_ASSERT(pOpaqueTo);
+    FSM_ASSERT(aIdMap);
+    FSM_ASSERT(mapSize == pFrom->numSealedStates_);
+
+    apStateNames = FSM_SEALED_STATE_NAMES(pFrom->pSealedStates_);
+    aIdMap[0] = 0;
+
+    for (i = 1; i < mapSize; ++i) {
+        const FsmStateImpl* pTo = (const FsmStateImpl*)FsmFindDefinitionState(
+            pOpaqueTo, apStateNames[i]);
+
+        if (pTo) {
+            aIdMap[i] = pTo->id_;
+        }
+        else {
+            aIdMap[i] = 0;
+            numUnmapped++;
+        }
+    }
+
+    return numUnmapped;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmPublishLiveDefinition(FsmLiveDefinition* pOpaqueLive,
+                         FsmLiveVersion* pOpaqueVersion,
+                         const FsmDefinition* pOpaqueDef,
+                         const unsigned short aIdMap[],
+                         unsigned int mapSize)
+{
+    FsmLiveDefinitionImpl*      pLive = (FsmLiveDefinitionImpl*)pOpaqueLive;
+    FsmLiveVersionImpl*         pVersion = (FsmLiveVersionImpl*)pOpaqueVersion;
+    const FsmDefinitionImpl*    pDef = (const FsmDefinitionImpl*)pOpaqueDef;
+    FsmLiveVersionImpl*         pPrev = NULL;
+    unsigned int                i;
+
+    FSM_ASSERT(pLive);
+    FSM_ASSERT(pLive->pOldest_ && "Initialize the live definition first");
+
+    /// Only the publisher writes pCurrent_
+    pPrev = pLive->pCurrent_;
+
+    InitLiveVersion(pVersion, pDef, aIdMap);
+
+    if (aIdMap) {
+        FSM_ASSERT(mapSize == pPrev->pDef_->numSealedStates_ &&
+                   "The map MUST cover the current version's states");
+        FSM_ASSERT(0 == aIdMap[0] && "The root MUST map to the root");
+
+        for (i = 1; i < mapSize; ++i) {
+            FSM_ASSERT(aIdMap[i] > 0 && aIdMap[i] < pDef->numSealedStates_ &&
+                       "Every state MUST map to a user state");
+        }
+    }
+    else {
+        FSM_ASSERT(pPrev->pDef_->numSealedStates_ <= pDef->numSealedStates_ &&
+                   "The new version lacks some of the current version's ids");
+    }
+
+    /// The instances that see pNext_ (with acquire semantics) see the
+    /// new version's fields, too
+    FSM_ATOMIC_STORE(&pLive->pCurrent_, pVersion);
+    FSM_ATOMIC_STORE(&pPrev->pNext_, pVersion);
+}
+
+
+/**
+ * ****************************************************************************
+ */
+FsmLiveVersion*
+FsmReclaimLiveVersion(FsmLiveDefinition* pOpaqueLive)
+{
+    FsmLiveDefinitionImpl*  pLive = (FsmLiveDefinitionImpl*)pOpaqueLive;
+    FsmLiveVersionImpl*     pOldest = NULL;
+
+    FSM_ASSERT(pLive);
+    FSM_ASSERT(pLive->pOldest_ && "Initialize the live definition first");
+
+    pOldest = pLive->pOldest_;
+
+    if (pOldest == pLive->pCurrent_) {
+        return NULL;
+    }
+
+    /**
+     * An instance that's attaching may have found the oldest version
+     * current before it was superseded, and be about to pin it; once
+     * no instance is attaching, the ones that attach anew find a
+     * newer version current.  Then, the oldest version is referenced
+     * only by the instances that it counts.
+     */
+    if (FSM_ATOMIC_LOAD(&pLive->numAttaching_) ||
+        FSM_ATOMIC_LOAD(&pOldest->numInstances_)) {
+        return NULL;
+    }
+
+    pLive->pOldest_ = pOldest->pNext_;
+
+    return (FsmLiveVersion*)pOldest;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmInitLiveInstance(FsmInstance* pOpaqueInstance,
+                    FsmLiveDefinition* pOpaqueLive, void* pContext)
+{
+    FsmInstanceImpl*        pInstance = (FsmInstanceImpl*)pOpaqueInstance;
+    FsmLiveDefinitionImpl*  pLive = (FsmLiveDefinitionImpl*)pOpaqueLive;
+    FsmLiveVersionImpl*     pVersion = NULL;
+
+    FSM_ASSERT(pInstance);
+    FSM_ASSERT(pLive);
+
+    FSM_ATOMIC_ADD(&pLive->numAttaching_, 1);
+
+    pVersion = FSM_ATOMIC_LOAD(&pLive->pCurrent_);
+    FSM_ATOMIC_ADD(&pVersion->numInstances_, 1);
+
+    FSM_ATOMIC_SUB(&pLive->numAttaching_, 1);
+
+    FsmInitInstance(pOpaqueInstance, (const FsmDefinition*)pVersion->pDef_,
+                    pContext);
+    pInstance->pLiveVersion_ = pVersion;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+void
+FsmReleaseLiveInstance(FsmInstance* pOpaqueInstance)
+{
+    FsmInstanceImpl* pInstance = (FsmInstanceImpl*)pOpaqueInstance;
+
+    FSM_ASSERT(pInstance);
+    FSM_ASSERT(pInstance->isInstance_ && pInstance->pLiveVersion_ &&
+               "Not a live FSM instance");
+    FSM_ASSERT(!pInstance->rt_.pDispatchSrcState);
+
+    /// After this, the version may be reclaimed at any time
+    FSM_ATOMIC_SUB(&pInstance->pLiveVersion_->numInstances_, 1);
+    pInstance->pLiveVersion_ = NULL;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+int
+FsmUpdateLiveInstance(FsmMachine* pOpaqueFsm)
+{
+    FsmInstanceImpl*            pInstance = (FsmInstanceImpl*)pOpaqueFsm;
+    FsmLiveVersionImpl*         pOld = NULL;
+    FsmLiveVersionImpl*         pVersion = NULL;
+    FsmLiveVersionImpl*         pNext = NULL;
+    const FsmDefinitionImpl*    pDef = NULL;
+    unsigned int                id = 0;
+
+    FSM_ASSERT(pInstance);
+    FSM_ASSERT(pInstance->isInstance_ && "Not an FSM instance");
+
+    pOld = pVersion = pInstance->pLiveVersion_;
+
+    if (!pVersion || !FSM_ATOMIC_LOAD_ACQUIRE(&pVersion->pNext_)) {
+        return FALSE;
+    }
+
+    FSM_ASSERT(!pInstance->rt_.pDispatchSrcState &&
+               !pInstance->rt_.pTranTarget &&
+               "Live instances move only between events");
+
+    if (pInstance->rt_.pCurrentState) {
+        id = pInstance->rt_.pCurrentState->id_;
+    }
+
+    /// The versions in between can't be reclaimed while the instance
+    /// counts in pOld
+    while ((pNext = FSM_ATOMIC_LOAD_ACQUIRE(&pVersion->pNext_)) != NULL) {
+        if (pNext->aIdMap_) {
+            id = pNext->aIdMap_[id];
+        }
+
+        pVersion = pNext;
+    }
+
+    FSM_ATOMIC_ADD(&pVersion->numInstances_, 1);
+
+    pDef = pVersion->pDef_;
+
+    pInstance->pSealedStates_ = pDef->pSealedStates_;
+    pInstance->numSealedStates_ = pDef->numSealedStates_;
+
+    if (pInstance->rt_.pCurrentState) {
+        FSM_ASSERT(id > 0 && id < pDef->numSealedStates_);
+        pInstance->rt_.pCurrentState = &pDef->pSealedStates_[id];
+    }
+
+    /// Cached plans and profile counters refer to the old topology
+    if (pInstance->pTranCache_) {
+        memset(pInstance->pTranCache_->pPlans, 0,
+               pInstance->pTranCache_->numPlans *
+               sizeof(FsmTransitionPlanImpl));
+    }
+
+    pInstance->pProfile_ = NULL;
+    pInstance->isProfiled_ = FALSE;
+
+    pInstance->pLiveVersion_ = pVersion;
+
+    /// After this, pOld may be reclaimed at any time
+    FSM_ATOMIC_SUB(&pOld->numInstances_, 1);
+
+    return TRUE;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+const FsmDefinition*
+FsmGetLiveInstanceDefinition(const FsmMachine* pOpaqueFsm)
+{
+    const FsmInstanceImpl* pInstance = (const FsmInstanceImpl*)pOpaqueFsm;
+
+    FSM_ASSERT(pInstance);
+    FSM_ASSERT(pInstance->isInstance_ && pInstance->pLiveVersion_ &&
+               "Not a live FSM instance");
+
+    return (const FsmDefinition*)pInstance->pLiveVersion_->pDef_;
+}
+
+
+/**
+ * Initializes a version record that isn't published yet
+ *
+ * @param pVersion
+ * @param pDef
+ * @param aIdMap
+ */
+static void
+InitLiveVersion(FsmLiveVersionImpl* pVersion, const FsmDefinitionImpl* pDef,
+                const unsigned short aIdMap[])
+{
+    FSM_ASSERT(pVersion);
+    FSM_ASSERT(pDef);
+    FSM_ASSERT(pDef->pSealedStates_);
+
+    pVersion->pDef_ = pDef;
+    pVersion->pNext_ = NULL;
+    pVersion->aIdMap_ = aIdMap;
+    pVersion->numInstances_ = 0;
+}
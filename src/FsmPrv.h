@@ -68,18 +68,183 @@ extern "C" {
 
 
 /**
- * A state in a state machine
+ * A state in a state machine: the record that event dispatch and
+ * state transitions walk
  * 
  * @note All fields ending in underscore are for internal use
  *       only and off-limits to users of the API
+ * 
+ * @note The pointers come first and the 16-bit fields are packed
+ *       together after them, which leaves no padding on ILP32 or
+ *       LP64 targets (64 bytes on LP64).  Data that only setup,
+ *       logging and debugging use lives elsewhere: in the user's
+ *       state object (@see FsmUserStateImpl), or in the name array
+ *       of a sealed topology (@see FSM_STATE_NAME).
  */
 typedef struct FsmStateImpl_tag {
     FsmStateHandlerFnType*      pHandler_;
+
+    /// The user's state object, which the handler receives: the
+    /// state itself, unless this is the compact copy of a sealed
+    /// FSM's state (@see FSM_USER_STATE)
+    FsmState*                   pUser_;
+
     struct FsmStateImpl_tag*    pParent_;
-    const char*                 pName_;
+
+    /// Declared initial substate (@see FsmSetInitialSubstate());
+    /// NULL if none.  Replaced by the innermost state of the chain of
+    /// initial substates the first time the state is drilled into.
+    struct FsmStateImpl_tag*    pInitial_;
+
+    /// Sorted user event ids that the handler subscribes to
+    /// (@see FsmDeclareStateEvents()); NULL if the state didn't
+    /// declare its subscription set
+    const FsmEventIdType*       pEventIds_;
+
+    /// Declarative transitions sorted by event id (@see
+    /// FsmDeclareStateTransitions()); NULL if none
+    const FsmTransitionDef*     pTransitions_;
+
+    /// Nesting depth: 0 for the root state, 1 for top-level user
+    /// states, and so forth.  Set by FsmInsertState().
+    unsigned short              depth_;
+
+    /// Dense state id assigned by FsmSealMachine(); 0 for the root
+    /// state.  Meaningless in state machines that aren't sealed.
+    unsigned short              id_;
+
+    /// enum FsmStateFlags (@see FsmInitStateEx())
+    unsigned short              flags_;
+
+    /// In a sealed FSM, the id of the nearest proper ancestor that
+    /// the entry and exit walks may not bypass (@see
+    /// FSM_IS_PASS_THROUGH_STATE); assigned by FsmSealMachine().
+    /// 0 in the root state, which is never walked past.
+    unsigned short              walkParentId_;
+
+    /**
+     * Pre-order interval of the state's subtree: the state's own
+     * pre-order number, and the highest pre-order number among its
+     * descendants.  Assigned by NumberStates() when the topology is
+     * frozen; until then, lastOrder_ holds the number of
+     * descendants, which FsmInsertState() maintains.
+     */
+    unsigned short              preOrder_;
+    unsigned short              lastOrder_;
+
+    unsigned short              numEventIds_;
+    unsigned short              numTransitions_;
 } FsmStateImpl;
 
 
+/**
+ * A user's state object (FsmState): the state record, followed
+ * by the fields that only setup, logging and debugging use
+ * 
+ * The state records of sealed topologies (@see FsmSealMachine())
+ * are bare FsmStateImpl records, flagged with
+ * kFsmStateFlagSealedRecord_; so are the user state objects of
+ * constant topologies and loaded images.
+ */
+typedef struct FsmUserStateImpl_tag {
+    FsmStateImpl                    state_;
+
+    /// @see FsmInitState(); read it via FSM_STATE_NAME()
+    const char*                     pName_;
+
+    /// Next state in insertion order; NULL for the last one
+    struct FsmUserStateImpl_tag*    pNextInserted_;
+} FsmUserStateImpl;
+
+
+/**
+ * True if entry and exit walks may bypass the given state
+ * altogether, because it has neither entry nor exit behavior
+ */
+#define FSM_IS_PASS_THROUGH_STATE(pState__)                                 \
+    (((pState__)->flags_ & (kFsmStateFlagNoEntry | kFsmStateFlagNoExit)) == \
+     (kFsmStateFlagNoEntry | kFsmStateFlagNoExit))
+
+
+/**
+ * A cached transition plan
+ *
+ * The exit chain of a regular transition stops just below
+ * pAnchor, and the entry chain begins just below pAnchor.
+ */
+typedef struct FsmTransitionPlanImpl_ {
+    FsmStateImpl*           pMainSrc;   ///< key
+    const FsmStateImpl*     pTarget;    ///< key
+    FsmStateImpl*           pAnchor;    ///< NULL if the slot is unused
+} FsmTransitionPlanImpl;
+
+
+/**
+ * A direct-mapped transition plan cache
+ */
+typedef struct FsmTransitionCacheImpl_ {
+    FsmTransitionPlanImpl*  pPlans;
+    unsigned int            numPlans;
+
+    unsigned long           hits;       ///< plans replayed from the cache
+    unsigned long           misses;     ///< plans computed and recorded
+} FsmTransitionCacheImpl;
+
+
+/**
+ * A cell of a byte-stream DFA table: what FsmFeedBytes() does
+ * with a byte class in a given state
+ * 
+ *  * pMainSrc == NULL: the byte is a self-loop of the state
+ *  * pTran != NULL: take the declarative transition pTran of
+ *    pMainSrc (the state itself or one of its ancestors)
+ *  * otherwise: dispatch the byte's event via FsmDispatchEvent()
+ */
+typedef struct FsmByteDfaCellImpl_ {
+    FsmStateImpl*           pMainSrc;
+    const FsmTransitionDef* pTran;
+} FsmByteDfaCellImpl;
+
+
+enum {
+    /// Maximum number of stop bytes of a DFA state that can be
+    /// scanned for with SIMD instructions; fits two cells on ILP32
+    kFsmByteDfaMaxStopBytes = 7
+};
+
+/**
+ * SIMD scan record of a DFA state: the bytes that aren't
+ * self-loops of the state ("stop bytes").  Occupies the last two
+ * cells of the state's row in the DFA table.
+ */
+typedef struct FsmByteDfaScanImpl_ {
+    /// Number of stop bytes; kFsmByteDfaNoScan if there are too
+    /// many for a SIMD scan
+    unsigned char           numStopBytes;
+
+    unsigned char           aStopBytes[kFsmByteDfaMaxStopBytes];
+} FsmByteDfaScanImpl;
+
+#define kFsmByteDfaNoScan   0xFF
+
+
+/**
+ * A byte-stream DFA (@see FsmCompileByteDfa())
+ * 
+ * The table has a row of rowSize_ cells per state, indexed by the
+ * state's preOrder_: numClasses_ cells, followed by the state's
+ * FsmByteDfaScanImpl.
+ */
+typedef struct FsmByteDfaImpl_ {
+    const unsigned char*    pByteClasses_;  ///< 256 entries
+    FsmEventIdType          classEvtBase_;
+
+    FsmByteDfaCellImpl*     pCells_;
+    unsigned short          numClasses_;
+    unsigned short          rowSize_;
+} FsmByteDfaImpl;
+
+
 /**
  * Log output kind
  */
@@ -93,98 +258,351 @@ typedef enum FsmLogOutputKind_ {
     kFsmLogOutputKind_cb            = 2     ///< via callback function
 } FsmLogOutputKind;
 
+/**
+ * Logging configuration of a state machine (@see
+ * FsmDbgAttachLogConfig())
+ */
+typedef struct FsmLogConfigImpl_ {
+    union {
+        FsmDbgLogLineFnType*    pLogFunc_;  ///< for kFsmLogOutputKind_cb
+
+        #if FSM_CONFIG_WEBOS_FEATURES
+        PmLogContext            pmlogCtx_;  ///< for kFsmLogOutputKind_pmloglib
+        #endif
+    } logOutput;
+
+    const void*             logCookie_;
+
+    /// Log level threshold
+    unsigned int            logThresh_:3;   ///< enum FsmDbgLogLevel
+
+    unsigned int            logOutKind_:2;  ///< FsmLogOutputKind
+} FsmLogConfigImpl;
+
+
+/**
+ * FsmRuntimeImpl contains FSM engine "runtime" information that
+ * gets reset by FsmStart
+ */
+typedef struct FsmRuntimeImpl_ {
+    /// Current state in the active configuration.
+    /// Set/Reset by DoEntryActions(); also reset by FsmBeginTransition().
+    /// NULL value indicates that the FSM is undergoing state transition.
+    FsmStateImpl*           pCurrentState;
+
+    /// State to which a messages is being dispatched. This may
+    /// be pCurrentState or one of its ancestors, if any.
+    /// Managed by FsmDispatchEvent().
+    FsmStateImpl*           pDispatchSrcState;
+
+    /// Set by FsmStart() and FsmBeginTransition() to mark the target
+    /// state of the requested transition.  Used and reset by
+    /// DoEntryActions().
+    FsmStateImpl*           pTranTarget;
+
+    /// Set along with pTranTarget: the states to enter are the ones
+    /// below pEntryAnchor on the path to pTranTarget.  DoEntryActions()
+    /// collects them in a fixed-size array on the stack (@see
+    /// FSM_CONFIG_ENTRY_PATH_CAPACITY).
+    FsmStateImpl*           pEntryAnchor;
+} FsmRuntimeImpl;
+
+
 /**
  * A Finite State Machine
  * 
  * @note All fields ending in underscore are for internal use
  *       only and off-limits to users of the API
+ * 
+ * @note The fields up to (but not including) pProfile_ are the
+ *       ones that event dispatch and state transitions use; they
+ *       take 64 bytes on LP64 targets, so keep them together
+ * 
+ * @note FsmInstanceImpl begins with the same fields; keep the two
+ *       in sync
  */
 typedef struct FsmMachineImpl_ {
+    FsmRuntimeImpl          rt_;    ///< FSM runtime environment
+
+    /// Optional transition plan cache; NULL if none
+    FsmTransitionCacheImpl* pTranCache_;
+
+    /**
+     * Sealed topology (@see FsmSealMachine()); NULL if the FSM
+     * isn't sealed.
+     * 
+     * Once sealed, the engine runs exclusively on the compact
+     * copies of the states in pSealedStates_ (indexed by id_, with
+     * the root state at index 0); they are followed by the states'
+     * names (@see FSM_SEALED_STATE_NAMES).
+     */
+    FsmStateImpl*           pSealedStates_;
+
+    /// Logging configuration; NULL until logging is configured,
+    /// which disables logging without touching the cold tail.
+    /// Points to log_, or to user storage for an instance (@see
+    /// FsmDbgAttachLogConfig())
+    FsmLogConfigImpl*       pLog_;
+
+    /// Number of pSealedStates_ elements, including the root
+    unsigned int            numSealedStates_:16;
+
+    /// Set once the states have been numbered (@see NumberStates())
+    unsigned int            isNumbered_:1;
+
+    /**
+     * DoEntryActions() sets/clears inInitialTrans_ around the
+     * dispatch of kFsmEventBegin.  FsmBeginTransition() tests this
+     * flag to determine which type of transition to record.
+     */
+    unsigned int            inInitialTrans_:1;
+
+    /// Set if this is an FsmInstanceImpl, which doesn't have any of
+    /// the fields below pProfile_ (@see FsmInitInstance())
+    unsigned int            isInstance_:1;
+
+    /// Set while pProfile_ is non-NULL, so that the hot paths test
+    /// for a profile without touching pProfile_
+    unsigned int            isProfiled_:1;
+
+    /// Set by NumberStates() if all user states are top-level states
+    /// without subscription sets or declared transitions, which
+    /// routes FsmDispatchEvent() through the flat-machine fast path
+    /// (@see DispatchFlatEvent()); never set for an instance
+    unsigned int            isFlat_:1;
+
+    /// Optional usage profile: counters indexed by state id (@see
+    /// FsmDbgAttachProfile()); NULL if none
+    FsmDbgStateUsage*       pProfile_;
+
     /**
      * @note The union helps us work around the C99 aliasing rules,
      *       which is permitted by C99 (it helps us avoid compiler
      *       errors like this: "dereferencing type-punned pointer
      *       will break strict-aliasing rules")
+     * 
+     * @note The root state's name is the FSM's name string provided
+     *       by user (_not_ copied; @see FSM_MACHINE_NAME)
      */
     union {
-        FsmState        pub;    ///< public version
-        FsmStateImpl    impl;   ///< private version
+        FsmState            pub;    ///< public version
+        FsmUserStateImpl    impl;   ///< private version
     } rootState_;
 
-    /// FSM's name string proivided by user; _not_ copied
-    const char*             pName_;
+    /// Most recently inserted state (the root state if none); the
+    /// insertion-order list begins at the root state
+    FsmUserStateImpl*       pLastInserted_;
 
-    /// Log level threshold
-    unsigned int            logThresh_:3;   ///< enum FsmDbgLogLevel
+    /// Optional byte-stream DFA (@see FsmCompileByteDfa()); NULL if
+    /// none
+    FsmByteDfaImpl*         pByteDfa_;
 
-    unsigned int            logOutKind_:2;  ///< FsmLogOutputKind
-    union {
-        FsmDbgLogLineFnType*    pLogFunc_;  ///< for kFsmLogOutputKind_cb
+    /// Depth of the deepest inserted state, which definition images
+    /// record (@see FsmWriteDefinitionImage()); maintained by
+    /// FsmInsertState() and FsmBuildStates()
+    unsigned short          maxDepth_;
 
-        #if FSM_CONFIG_WEBOS_FEATURES
-        PmLogContext            pmlogCtx_;  ///< for kFsmLogOutputKind_pmloglib
-        #endif
-    } logOutput;
+    /// Storage for the logging configuration (@see pLog_)
+    FsmLogConfigImpl        log_;
 
-    const void*             logCookie_;
+} FsmMachineImpl;
 
-    /**
-     * FsmRuntime contains FSM engine "runtime" information that
-     * gets reset by FsmStart
-     */
-    struct FsmRuntime {
-        /// Current state in the active configuration.
-        /// Set/Reset by DoEntryActions(); also reset by FsmBeginTransition().
-        /// NULL value indicates that the FSM is undergoing state transition.
-        FsmStateImpl*           pCurrentState;
-
-        /// State to which a messages is being dispatched. This may
-        /// be pCurrentState or one of its ancestors, if any.
-        /// Managed by FsmDispatchEvent().
-        FsmStateImpl*           pDispatchSrcState;
-
-        /// Set by FsmStart() and FsmBeginTransition() to mark the target
-        /// state of the requested transition.  Used and reset by
-        /// DoEntryActions().
-        FsmStateImpl*           pTranTarget;
-
-
-        struct FsmEntryPath {
-            int                     size; ///< number of states in path
-
-            /// States of the entry path in REVERSE order
-            /// 
-            /// @todo Use stack-based entry path to eliminate the extra
-            ///       storage requirement in each state machine instance.
-            FsmStateImpl*           states[kFsmMaxStateNestingDepth];
-        } entryPath;
-
-        /**
-         * DoEntryActions() sets/clears inInitialTrans_ around the
-         * dispatch of kFsmEventBegin.  FsmBeginTransition() tests this
-         * flag to determine which type of transition to record.
-         */
-        int                     inInitialTrans:1;
-
-    }                       rt_;    ///< FSM runtime environment
 
-} FsmMachineImpl;
+/**
+ * A shared state machine definition (@see FsmInitDefinition()):
+ * the sealed topology that its instances run on
+ */
+typedef struct FsmDefinitionImpl_ {
+    FsmStateImpl*           pSealedStates_;
+
+    unsigned int            numSealedStates_:16;
+} FsmDefinitionImpl;
 
 
 /**
- * @brief State Machine Engine's root state handler
+ * A state machine instance (@see FsmInitInstance())
  * 
- * A convenient handler for logging unhandled user events.
- * 
- * @param pState
- * @param pFsm
- * @param pEvt
- * 
- * @return int
+ * The engine accesses instances via FsmMachineImpl pointers:
+ * the fields up to pContext_ MUST match the leading fields of
+ * FsmMachineImpl, and the engine MUST NOT access any fields of an
+ * FsmMachineImpl with isInstance_ set beyond those.  An instance
+ * is always sealed, so that the engine finds its topology via
+ * pSealedStates_ (@see FSM_ROOT_STATE).
+ */
+typedef struct FsmInstanceImpl_ {
+    FsmRuntimeImpl          rt_;
+    FsmTransitionCacheImpl* pTranCache_;
+    FsmStateImpl*           pSealedStates_;
+    FsmLogConfigImpl*       pLog_;
+
+    unsigned int            numSealedStates_:16;
+    unsigned int            isNumbered_:1;
+    unsigned int            inInitialTrans_:1;
+    unsigned int            isInstance_:1;
+    unsigned int            isProfiled_:1;
+    unsigned int            isFlat_:1;
+    FsmDbgStateUsage*       pProfile_;
+
+    /// User context pointer (@see FsmGetInstanceContext())
+    void*                   pContext_;
+
+    /// Version of the live definition that the instance runs on
+    /// (@see FsmInitLiveInstance()); NULL if the instance isn't
+    /// live
+    struct FsmLiveVersionImpl_* pLiveVersion_;
+} FsmInstanceImpl;
+
+
+/**
+ * Atomic accesses to the fields that live definitions share
+ * between threads (@see PalmFsmLive.h); plain accesses, which
+ * confine live definitions to a single thread, on compilers
+ * without the GNU atomic builtins
+ */
+#if defined(__ATOMIC_SEQ_CST)
+    #define FSM_ATOMIC_LOAD(p__)        __atomic_load_n((p__), __ATOMIC_SEQ_CST)
+    #define FSM_ATOMIC_LOAD_ACQUIRE(p__)                                    \
+        __atomic_load_n((p__), __ATOMIC_ACQUIRE)
+    #define FSM_ATOMIC_STORE(p__, v__)                                      \
+        __atomic_store_n((p__), (v__), __ATOMIC_SEQ_CST)
+    #define FSM_ATOMIC_ADD(p__, v__)                                        \
+        ((void)__atomic_add_fetch((p__), (v__), __ATOMIC_SEQ_CST))
+    #define FSM_ATOMIC_SUB(p__, v__)                                        \
+        ((void)__atomic_sub_fetch((p__), (v__), __ATOMIC_SEQ_CST))
+#else
+    #define FSM_ATOMIC_LOAD(p__)                (*(p__))
+    #define FSM_ATOMIC_LOAD_ACQUIRE(p__)        (*(p__))
+    #define FSM_ATOMIC_STORE(p__, v__)          ((void)(*(p__) = (v__)))
+    #define FSM_ATOMIC_ADD(p__, v__)            ((void)(*(p__) += (v__)))
+    #define FSM_ATOMIC_SUB(p__, v__)            ((void)(*(p__) -= (v__)))
+#endif
+
+
+/**
+ * A version of a live definition (@see
+ * FsmPublishLiveDefinition())
+ *
+ * The versions of a live definition form a list from the oldest
+ * one that hasn't been reclaimed to the current one.  Instances
+ * pin the version that they run on by counting themselves in
+ * numInstances_; an instance that finds pNext_ set moves to the
+ * newest version at its next run-to-completion boundary, mapping
+ * its current state through the id maps of the versions in
+ * between.  A version is thus referenced only by the instances
+ * that it or an older version counts, so that versions are
+ * reclaimed in order, oldest first, once they count no instances
+ * (@see FsmReclaimLiveVersion()).
  */
-int
-RootStateHandler(FsmState* pState, FsmMachine* pFsm,
-                 const FsmEvent* pEvt);
+typedef struct FsmLiveVersionImpl_ {
+    const FsmDefinitionImpl*    pDef_;
+
+    /// Next (newer) version; NULL while this version is current
+    struct FsmLiveVersionImpl_* pNext_;             ///< atomic
+
+    /// Maps the state ids of the previous version to the ids of
+    /// this version's states; NULL for the identity map
+    const unsigned short*       aIdMap_;
+
+    /// Number of instances that run on this version
+    unsigned long               numInstances_;      ///< atomic
+} FsmLiveVersionImpl;
+
+
+/**
+ * A live definition (@see FsmInitLiveDefinition())
+ */
+typedef struct FsmLiveDefinitionImpl_ {
+    FsmLiveVersionImpl*     pCurrent_;          ///< atomic
+
+    /// Oldest version that hasn't been reclaimed; only the
+    /// publisher accesses it
+    FsmLiveVersionImpl*     pOldest_;
+
+    /// Number of FsmInitLiveInstance() calls in progress, which
+    /// may be about to pin a version that's no longer current
+    unsigned long           numAttaching_;      ///< atomic
+} FsmLiveDefinitionImpl;
+
+
+/**
+ * Returns non-zero if the given instance runs on a version of a
+ * live definition that has been superseded; the hot path's only
+ * cost of live definitions (@see FsmDispatchEvent())
+ */
+#define FSM_LIVE_VERSION_IS_STALE(pInstance__)                              \
+    ((pInstance__)->pLiveVersion_ &&                                        \
+     FSM_ATOMIC_LOAD_ACQUIRE(&(pInstance__)->pLiveVersion_->pNext_))
+
+
+/**
+ * Returns the name of the given state: a sealed record's name is
+ * in the name array of its topology (@see
+ * FSM_SEALED_STATE_NAMES), and a user state object's in the
+ * object itself
+ */
+#define FSM_STATE_NAME(pState__)                                            \
+    (((pState__)->flags_ & kFsmStateFlagSealedRecord_)                      \
+        ? FSM_SEALED_STATE_NAMES((pState__) - (pState__)->id_)              \
+              [(pState__)->id_]                                             \
+        : ((const FsmUserStateImpl*)(pState__))->pName_)
+
+/**
+ * Returns the FSM's name
+ */
+#define FSM_MACHINE_NAME(pImpl__)   FSM_STATE_NAME(FSM_ROOT_STATE(pImpl__))
+
+/**
+ * Returns the logging cookie of the FSM; NULL if it has no logging
+ * configuration
+ */
+#define FSM_LOG_COOKIE(pImpl__)                                             \
+    ((pImpl__)->pLog_ ? (pImpl__)->pLog_->logCookie_ : NULL)
+
+
+/**
+ * Returns the usage counters of the FSM's profile (@see
+ * FsmDbgAttachProfile()); NULL if it isn't being profiled
+ */
+#define FSM_PROFILE(pImpl__)                                                \
+    ((pImpl__)->isProfiled_ ? (pImpl__)->pProfile_ : NULL)
+
+
+/**
+ * Returns the root state that the engine runs on: the root
+ * state's compact copy in a sealed FSM
+ */
+#define FSM_ROOT_STATE(pImpl__)                                             \
+    ((pImpl__)->pSealedStates_                                              \
+        ? &(pImpl__)->pSealedStates_[0]                                     \
+        : &(pImpl__)->rootState_.impl.state_)
+
+/**
+ * Maps a state that the engine runs on to the user's state object;
+ * the pointer shares the record's cache line with pHandler_, so
+ * handler calls neither branch on whether the FSM is sealed nor
+ * look the object up elsewhere
+ */
+#define FSM_USER_STATE(pState__)    ((pState__)->pUser_)
+
+/**
+ * Returns the names of the states of a sealed topology, indexed by
+ * id, given the topology's root state record: the array follows
+ * the records, so that the records hold only what dispatch and
+ * transitions use (@see FsmSealedState)
+ */
+#define FSM_SEALED_STATE_NAMES(pRoot__)                                     \
+    ((const char* const*)((pRoot__) + (pRoot__)->lastOrder_ + 1))
+
+/**
+ * Returns the next state up the hierarchy that the entry and exit
+ * walks of state transitions need to visit: the parent state, or
+ * the nearest ancestor that isn't a pass-through state in a
+ * sealed FSM
+ */
+#define FSM_WALK_PARENT_STATE(pImpl__, pState__)                            \
+    ((pImpl__)->pSealedStates_                                              \
+        ? &(pImpl__)->pSealedStates_[(pState__)->walkParentId_]             \
+        : (pState__)->pParent_)
 
 
 FSM_CONFIG_INLINE_FUNC int
@@ -192,51 +610,53 @@ IsLogLevelEnabled(const FsmMachineImpl* const pImpl,
                   enum FsmDbgLogLevel   const fsmloglevel,
                   int                   const pmloglevel)
 {
-    if (!pImpl->logOutKind_) {
+    const FsmLogConfigImpl* const pLog = pImpl->pLog_;
+
+    if (!pLog || !pLog->logOutKind_) {
         return 0;
     }
-    else if (kFsmLogOutputKind_cb == pImpl->logOutKind_) {
-        return ((int)fsmloglevel >= (int)pImpl->logThresh_);
+    else if (kFsmLogOutputKind_cb == pLog->logOutKind_) {
+        return ((int)fsmloglevel >= (int)pLog->logThresh_);
     }
     #if FSM_CONFIG_WEBOS_FEATURES
-    else if (kFsmLogOutputKind_pmloglib == pImpl->logOutKind_) {
-        return PmLogIsEnabled(pImpl->logOutput.pmlogCtx_,
+    else if (kFsmLogOutputKind_pmloglib == pLog->logOutKind_) {
+        return PmLogIsEnabled(pLog->logOutput.pmlogCtx_,
                               (PmLogLevel)pmloglevel);
     }
     #endif
     else {
-        FSM_ASSERT(0 && "UNEXPECTED logOutKind_");                  \
+        FSM_ASSERT(0 && "UNEXPECTED logOutKind_");
+        return 0;
     }
 
 }
 
 #if FSM_CONFIG_WEBOS_FEATURES
-    #define LOG_VIA_PMLOGLIB(pImpl__, pmlogLevel__, ...)                    \
+    #define LOG_VIA_PMLOGLIB(pLog__, pmlogLevel__, ...)                     \
         (                                                                   \
-            kFsmLogOutputKind_pmloglib == (pImpl__)->logOutKind_            \
-              ? PmLogPrint((pImpl__)->logOutput.pmlogCtx_,                  \
+            kFsmLogOutputKind_pmloglib == (pLog__)->logOutKind_             \
+              ? PmLogPrint((pLog__)->logOutput.pmlogCtx_,                   \
                            (pmlogLevel__),                                  \
                            __VA_ARGS__), 1                                  \
               : (0)                                                         \
         )
 #else
-    #define LOG_VIA_PMLOGLIB(pImpl__, level__, pmlogLevel__, ...)   (0)
+    #define LOG_VIA_PMLOGLIB(pLog__, pmlogLevel__, ...)     (0)
 #endif
 
 
 #define FSM_LOG_HELPER(pImpl__, level__, pmlogLevel__, ...)                 \
     do {                                                                    \
-        if ((pImpl__)->logOutKind_) {                                       \
-            if (LOG_VIA_PMLOGLIB((pImpl__), (pmlogLevel__), __VA_ARGS__)) { \
-            }                                                               \
-            else if (kFsmLogOutputKind_cb == (pImpl__)->logOutKind_ &&      \
-                     IsLogLevelEnabled((pImpl__), (level__), (pmlogLevel__))) { \
-                (pImpl__)->logOutput.pLogFunc_((FsmMachine*)(pImpl__),      \
-                                               (void*)(pImpl__)->logCookie_,\
-                                               (level__), __VA_ARGS__);     \
+        if (IsLogLevelEnabled((pImpl__), (level__), (pmlogLevel__))) {      \
+            const FsmLogConfigImpl* const pLog__ = (pImpl__)->pLog_;        \
+                                                                            \
+            if (LOG_VIA_PMLOGLIB(pLog__, (pmlogLevel__), __VA_ARGS__)) {    \
             }                                                               \
             else {                                                          \
-                FSM_ASSERT(0 && "UNEXPECTED logOutKind_");                  \
+                FSM_ASSERT(kFsmLogOutputKind_cb == pLog__->logOutKind_);    \
+                pLog__->logOutput.pLogFunc_((FsmMachine*)(pImpl__),         \
+                                            (void*)pLog__->logCookie_,      \
+                                            (level__), __VA_ARGS__);        \
             }                                                               \
         }                                                                   \
     } while (0)
@@ -0,0 +1,120 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ * ****************************************************************************
+ * @file BenchDispatchWorkload.h
+ *
+ * @brief  A tight event loop over a small machine, shared by the
+ *         shared-library and header-only engine benchmarks so
+ *         that both measure the very same code.
+ *
+ * @note Include it after the engine's API header of choice
+ *       (PalmFsm.h or PalmFsmHeaderOnly.h)
+ * ****************************************************************************
+ */
+
+#ifndef BENCH_DISPATCH_WORKLOAD_H
+#define BENCH_DISPATCH_WORKLOAD_H
+
+#include <time.h>
+
+
+enum BenchWorkloadSignals {
+    kBenchWorkloadSig_tick = kFsmEventFirstUserEvent, ///< handled by leaves
+    kBenchWorkloadSig_toggle                          ///< handled by parent
+};
+
+
+struct BenchWorkloadFsm {
+    FsmMachine      fsmRep; ///< MUST be first member for C "subclassing"
+
+    FsmState        parent;
+    FsmState        on;
+    FsmState        off;
+
+    unsigned int    numTicks;
+};
+
+
+static int
+BenchWorkloadParentHandler(FsmState* pState, FsmMachine* pOpaqueFsm,
+                           const FsmEvent* pEvt)
+{
+    BenchWorkloadFsm* pFsm = (BenchWorkloadFsm*)pOpaqueFsm;
+
+    if (kBenchWorkloadSig_toggle == pEvt->evtId) {
+        FsmBeginTransition(pOpaqueFsm,
+                           (FsmDbgPeekCurrentState(pOpaqueFsm) == &pFsm->on)
+                           ? &pFsm->off : &pFsm->on);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int
+BenchWorkloadLeafHandler(FsmState* pState, FsmMachine* pOpaqueFsm,
+                         const FsmEvent* pEvt)
+{
+    if (kBenchWorkloadSig_tick == pEvt->evtId) {
+        ((BenchWorkloadFsm*)pOpaqueFsm)->numTicks++;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Dispatches numEvents events (three ticks per toggle) to a
+ * freshly-built machine
+ *
+ * @return double elapsed seconds
+ */
+static double
+BenchWorkloadRun(unsigned int numEvents)
+{
+    BenchWorkloadFsm    fsm;
+    FsmEvent            evtTick = {kBenchWorkloadSig_tick};
+    FsmEvent            evtToggle = {kBenchWorkloadSig_toggle};
+    clock_t             start;
+    unsigned int        i;
+
+    FsmInitMachine(&fsm.fsmRep, "BenchWorkload");
+    FsmInitState(&fsm.parent, &BenchWorkloadParentHandler, "parent");
+    FsmInitState(&fsm.on, &BenchWorkloadLeafHandler, "on");
+    FsmInitState(&fsm.off, &BenchWorkloadLeafHandler, "off");
+    FsmInsertState(&fsm.fsmRep, &fsm.parent, NULL);
+    FsmInsertState(&fsm.fsmRep, &fsm.on, &fsm.parent);
+    FsmInsertState(&fsm.fsmRep, &fsm.off, &fsm.parent);
+    fsm.numTicks = 0;
+
+    FsmStart(&fsm.fsmRep, &fsm.off);
+
+    start = clock();
+    for (i = 0; i < numEvents; ++i) {
+        FsmDispatchEvent(&fsm.fsmRep, (i & 3) ? &evtTick : &evtToggle);
+    }
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+#endif // BENCH_DISPATCH_WORKLOAD_H
@@ -0,0 +1,2092 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ * ****************************************************************************
+ * @file Benchmark.cpp
+ *
+ * @brief  Throughput benchmarks for PmStateMachineEngine
+ *
+ * ****************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <time.h>
+
+#include <algorithm>
+#include <new>
+#include <string>
+#include <utility>
+
+#include <PmStateMachineEngine/Cplusplus/PalmFsm.hpp>
+#include <PmStateMachineEngine/PalmFsm.h>
+#include <PmStateMachineEngine/PalmFsmDbg.h>
+#include <PmStateMachineEngine/PalmFsmImage.h>
+#include <PmStateMachineEngine/PalmFsmLive.h>
+
+#include "TestCommon.h"
+#include "BenchDispatchWorkload.h"
+#include "BenchGenFsm.h"
+
+
+#undef TRUE
+#define TRUE 1
+
+#undef FALSE
+#define FALSE 0
+
+
+/// Number of timed runs of each machine in A/B comparisons (@see
+/// BenchCompareDispatch())
+static const int kBenchNumRuns = 15;
+
+
+enum BenchSignals {
+    kBenchSig_poke = kFsmEventFirstUserEvent, ///< handled by leaf states
+    kBenchSig_jump,                           ///< handled by top-level states
+
+    /// Byte classes of the byte-stream benchmark
+    kBenchSig_byteText,
+    kBenchSig_byteOpen,
+    kBenchSig_byteClose
+};
+
+
+/**
+ * A benchmark state; the padding emulates state objects that
+ * are embedded in larger user structures
+ */
+struct BenchState {
+    FsmState    stateRep; ///< MUST be first member for C "subclassing"
+
+    char        userData[200];  ///< begins with the state's name
+};
+
+
+struct BenchFsm {
+    FsmMachine      fsmRep; ///< MUST be first member for C "subclassing"
+
+    BenchState**    apStates;
+    unsigned int    numStates;
+
+    BenchState**    apLeaves;
+    unsigned int    numLeaves;
+
+    /// If non-zero, 15 of 16 jumps target one of this many leaf
+    /// states, which are spread evenly across the tree
+    unsigned int    numHotLeaves;
+
+    unsigned int    rng;
+};
+
+
+/**
+ * Benchmark state handlers: leaf states handle kBenchSig_poke;
+ * kBenchSig_jump propagates to the top-level ancestor, which
+ * transitions to a pseudo-random leaf state.
+ * 
+ * @note Like most C state handlers, these don't touch the state
+ *       object itself, so the benchmark measures the engine's
+ *       own memory traffic.
+ */
+static int
+BenchTopStateHandler(FsmState* pState, FsmMachine* pOpaqueFsm,
+                     const FsmEvent* pEvt)
+{
+    BenchFsm* pFsm = (BenchFsm*)pOpaqueFsm;
+
+    if (kBenchSig_jump == pEvt->evtId) {
+        unsigned int leaf;
+
+        pFsm->rng = pFsm->rng * 1103515245 + 12345;
+        leaf = (pFsm->rng >> 8) % pFsm->numLeaves;
+
+        if (pFsm->numHotLeaves && (pFsm->rng >> 28) != 0) {
+            leaf = (leaf % pFsm->numHotLeaves) *
+                   (pFsm->numLeaves / pFsm->numHotLeaves);
+        }
+
+        FsmBeginTransition(&pFsm->fsmRep, &pFsm->apLeaves[leaf]->stateRep);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+static int
+BenchInnerStateHandler(FsmState* pState, FsmMachine* pFsm,
+                       const FsmEvent* pEvt)
+{
+    return FALSE;
+}
+
+
+static int
+BenchLeafStateHandler(FsmState* pState, FsmMachine* pFsm,
+                      const FsmEvent* pEvt)
+{
+    return (kBenchSig_poke == pEvt->evtId) ? TRUE : FALSE;
+}
+
+
+/**
+ * Top-level states of a single-level tree are leaf states, too
+ */
+static int
+BenchFlatStateHandler(FsmState* pState, FsmMachine* pFsm,
+                      const FsmEvent* pEvt)
+{
+    return BenchLeafStateHandler(pState, pFsm, pEvt) ||
+           BenchTopStateHandler(pState, pFsm, pEvt);
+}
+
+
+/**
+ * Builds a complete tree of the given fan-out and depth; states
+ * are allocated individually, so they end up scattered across
+ * the heap.
+ * 
+ * @note None of the benchmark state handlers have entry, exit, or
+ *       initial transition behavior, so it's accurate to flag any
+ *       of them kFsmStateFlagPassThrough.
+ */
+static void
+BenchBuildTree(BenchFsm* pFsm, const char* pName, int fanOut, int depth,
+               unsigned int stateFlags)
+{
+    unsigned int levelBegin = 0;
+    unsigned int levelEnd = 0;
+    unsigned int numStates = 0;
+    unsigned int levelSize = 1;
+    int d;
+
+    for (d = 1; d <= depth; ++d) {
+        levelSize *= fanOut;
+        numStates += levelSize;
+    }
+
+    FsmInitMachine(&pFsm->fsmRep, pName);
+
+    pFsm->apStates = new BenchState*[numStates];
+    pFsm->numStates = 0;
+    pFsm->numHotLeaves = 0;
+    pFsm->rng = 1;
+
+    for (d = 1; d <= depth; ++d) {
+        unsigned int parent;
+        int          child;
+
+        for (parent = levelBegin; parent < (d > 1 ? levelEnd : 1); ++parent) {
+            for (child = 0; child < fanOut; ++child) {
+                BenchState* pState = new BenchState;
+
+                /// Unique names, which profiles refer to states by
+                snprintf(pState->userData, sizeof(pState->userData),
+                         "%s.%u", pName, pFsm->numStates);
+
+                FsmInitStateEx(&pState->stateRep,
+                               (1 == depth) ? &BenchFlatStateHandler
+                               : (1 == d) ? &BenchTopStateHandler
+                               : (depth == d) ? &BenchLeafStateHandler
+                               : &BenchInnerStateHandler,
+                               pState->userData, stateFlags);
+                FsmInsertState(&pFsm->fsmRep, &pState->stateRep,
+                               d > 1 ? &pFsm->apStates[parent]->stateRep : NULL);
+
+                pFsm->apStates[pFsm->numStates++] = pState;
+            }
+        }
+
+        levelBegin = (d > 1) ? levelEnd : 0;
+        levelEnd = pFsm->numStates;
+    }
+
+    pFsm->apLeaves = &pFsm->apStates[levelBegin];
+    pFsm->numLeaves = levelEnd - levelBegin;
+}
+
+
+static void
+BenchDestroyTree(BenchFsm* pFsm)
+{
+    unsigned int i;
+
+    for (i = 0; i < pFsm->numStates; ++i) {
+        delete pFsm->apStates[i];
+    }
+
+    delete [] pFsm->apStates;
+}
+
+
+/**
+ * Seals the given benchmark tree, with its states in the order in
+ * which they were built, or ordered by the given profile (@see
+ * FsmDbgWriteProfile())
+ * 
+ * @return FsmSealedState* the sealed state storage, which the
+ *         caller must delete after destroying the tree
+ */
+static FsmSealedState*
+BenchSealTree(BenchFsm* pFsm, const char* pProfile, unsigned int profileSize)
+{
+    FsmState**      apStates = new FsmState*[pFsm->numStates];
+    FsmSealedState* pSealed =
+        new FsmSealedState[FSM_SEALED_STATE_COUNT(pFsm->numStates)];
+    unsigned int    i;
+
+    for (i = 0; i < pFsm->numStates; ++i) {
+        apStates[i] = &pFsm->apStates[i]->stateRep;
+    }
+
+    if (pProfile) {
+        FsmDbgStateUsage* aUsage = new FsmDbgStateUsage[pFsm->numStates];
+
+        FsmDbgReadProfile(pProfile, profileSize, apStates, aUsage,
+                          pFsm->numStates);
+        FsmDbgOrderStatesByUsage(apStates, aUsage, pFsm->numStates);
+
+        delete [] aUsage;
+    }
+
+    FsmSealMachine(&pFsm->fsmRep, apStates, pFsm->numStates, pSealed,
+                   FSM_SEALED_STATE_COUNT(pFsm->numStates));
+
+    delete [] apStates;
+
+    return pSealed;
+}
+
+
+/**
+ * Dispatches a mix of kBenchSig_poke and kBenchSig_jump events
+ * 
+ * @return double the time it took, in seconds
+ */
+static double
+BenchTimeDispatch(BenchFsm* pFsm, unsigned int numEvents)
+{
+    FsmEvent        evtPoke = {kBenchSig_poke};
+    FsmEvent        evtJump = {kBenchSig_jump};
+    clock_t         start;
+    unsigned int    i;
+
+    FsmStart(&pFsm->fsmRep, &pFsm->apLeaves[0]->stateRep);
+
+    start = clock();
+    for (i = 0; i < numEvents; ++i) {
+        FsmDispatchEvent(&pFsm->fsmRep, (i & 3) ? &evtPoke : &evtJump);
+    }
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+/**
+ * Dispatches a mix of kBenchSig_poke and kBenchSig_jump events
+ * and reports the throughput.
+ */
+static void
+BenchRunDispatch(const char* pLabel, BenchFsm* pFsm, unsigned int numEvents)
+{
+    double secs = BenchTimeDispatch(pFsm, numEvents);
+
+    printf("  %-40s %8.0f dispatches/sec\n", pLabel,
+           secs > 0 ? numEvents / secs : 0.0);
+}
+
+
+/**
+ * Returns the median of the given values, which it sorts
+ */
+static double
+BenchMedian(double* aValues, int numValues)
+{
+    std::sort(aValues, aValues + numValues);
+
+    return (numValues & 1) ? aValues[numValues / 2]
+        : (aValues[numValues / 2 - 1] + aValues[numValues / 2]) / 2;
+}
+
+
+/**
+ * A/B comparison of dispatch on two machines: they take
+ * kBenchNumRuns turns, and the report gives each one's median
+ * throughput, and the median of the per-turn speedups of the
+ * second one over the first one along with their range, which
+ * tells a real difference from noise.
+ */
+static void
+BenchCompareDispatch(BenchFsm* apFsm[2], const char* const apLabels[2],
+                     unsigned int numEvents)
+{
+    double  aaSecs[2][kBenchNumRuns];
+    double  aSpeedups[kBenchNumRuns];
+    double  speedup;
+    int     i, run;
+
+    for (run = 0; run < kBenchNumRuns; ++run) {
+        for (i = 0; i < 2; ++i) {
+            aaSecs[i][run] = BenchTimeDispatch(apFsm[i], numEvents);
+        }
+
+        aSpeedups[run] = (aaSecs[1][run] > 0)
+            ? aaSecs[0][run] / aaSecs[1][run] : 1.0;
+    }
+
+    for (i = 0; i < 2; ++i) {
+        double secs = BenchMedian(aaSecs[i], kBenchNumRuns);
+
+        printf("  %-40s %8.0f dispatches/sec (median of %d)\n", apLabels[i],
+               secs > 0 ? numEvents / secs : 0.0, kBenchNumRuns);
+    }
+
+    speedup = BenchMedian(aSpeedups, kBenchNumRuns);
+    printf("  %-40s %8.3fx (range %.3f-%.3f)\n", "median speedup", speedup,
+           aSpeedups[0], aSpeedups[kBenchNumRuns - 1]);
+}
+
+
+/**
+ * Sealing in the natural (breadth-first) order vs. in the order of
+ * a profile, on a machine with thousands of states and a skewed
+ * workload whose hot states are spread across the tree (@see
+ * BenchCompareDispatch())
+ */
+static void
+BenchProfileGuidedLayout()
+{
+    const unsigned int  kNumEvents = 2000000;
+    const unsigned int  kNumHotLeaves = 1024;
+    const char* const   apLabels[2] = {"natural layout",
+                                       "profile-guided layout"};
+    BenchFsm            aFsm[2];
+    BenchFsm*           apFsm[2] = {&aFsm[0], &aFsm[1]};
+    FsmSealedState*     apSealed[2];
+    FsmDbgStateUsage*   aUsage;
+    char*               pProfile;
+    unsigned int        profileSize;
+    int                 i;
+
+    printf("Natural vs. profile-guided state layout (4680 states, " \
+           "%u hot leaves):\n", kNumHotLeaves);
+
+    /// Training run, with another sequence of jumps than the measured runs
+    BenchBuildTree(&aFsm[0], "BenchLayout", 8, 4, 0);
+    aFsm[0].numHotLeaves = kNumHotLeaves;
+    aFsm[0].rng = 2;
+    apSealed[0] = BenchSealTree(&aFsm[0], NULL, 0);
+
+    aUsage = new FsmDbgStateUsage[FSM_SEALED_STATE_COUNT(aFsm[0].numStates)];
+    FsmDbgAttachProfile(&aFsm[0].fsmRep, aUsage,
+                        FSM_SEALED_STATE_COUNT(aFsm[0].numStates));
+    BenchRunDispatch("natural layout, profiling", &aFsm[0], kNumEvents);
+
+    profileSize = FsmDbgWriteProfile(&aFsm[0].fsmRep, NULL, 0);
+    pProfile = new char[profileSize + 1];
+    FsmDbgWriteProfile(&aFsm[0].fsmRep, pProfile, profileSize + 1);
+
+    BenchDestroyTree(&aFsm[0]);
+    delete [] apSealed[0];
+    delete [] aUsage;
+
+    /// A/B: the same tree and jumps, sealed in either order
+    for (i = 0; i < 2; ++i) {
+        BenchBuildTree(&aFsm[i], "BenchLayout", 8, 4, 0);
+        aFsm[i].numHotLeaves = kNumHotLeaves;
+        apSealed[i] = i ? BenchSealTree(&aFsm[i], pProfile, profileSize)
+                        : BenchSealTree(&aFsm[i], NULL, 0);
+    }
+
+    BenchCompareDispatch(apFsm, apLabels, kNumEvents);
+
+    /// Both machines drew the same pseudo-random numbers, if they took
+    /// the same transitions
+    if (aFsm[0].rng != aFsm[1].rng) {
+        printf("  ERROR: the two layouts took different transitions\n");
+    }
+
+    for (i = 0; i < 2; ++i) {
+        BenchDestroyTree(&aFsm[i]);
+        delete [] apSealed[i];
+    }
+
+    delete [] pProfile;
+}
+
+
+/**
+ * Unsealed vs. sealed dispatch on machines with hundreds and tens
+ * of thousands of states; the larger one's sealed records don't
+ * fit in a typical L2 cache (@see BenchCompareDispatch())
+ */
+static void
+BenchSealed()
+{
+    const unsigned int  kNumEvents = 1000000;
+    const int           aFanOuts[2] = {4, 8};
+    const int           aDepths[2] = {4, 5};
+    const char* const   apLabels[2] = {"unsealed", "sealed"};
+    int                 t;
+
+    for (t = 0; t < 2; ++t) {
+        BenchFsm            aFsm[2];
+        BenchFsm*           apFsm[2] = {&aFsm[0], &aFsm[1]};
+        FsmSealedState*     pSealed;
+        int                 i;
+
+        BenchBuildTree(&aFsm[0], "BenchUnsealed", aFanOuts[t], aDepths[t], 0);
+        BenchBuildTree(&aFsm[1], "BenchSealed", aFanOuts[t], aDepths[t], 0);
+        pSealed = BenchSealTree(&aFsm[1], NULL, 0);
+
+        printf("Sealed vs. unsealed (%u states, depth %d, fan-out %d):\n",
+               aFsm[0].numStates, aDepths[t], aFanOuts[t]);
+
+        BenchCompareDispatch(apFsm, apLabels, kNumEvents);
+
+        for (i = 0; i < 2; ++i) {
+            BenchDestroyTree(&aFsm[i]);
+        }
+        delete [] pSealed;
+    }
+}
+
+
+/**
+ * Dispatch with and without capability flags that let the engine
+ * skip ENTER/EXIT/BEGIN deliveries to states that ignore them
+ */
+static void
+BenchStateFlags()
+{
+    const unsigned int  kNumEvents = 2000000;
+    BenchFsm            fsm;
+    FsmSealedState*     pSealed;
+
+    printf("State capability flags (340 states, depth 4, fan-out 4):\n");
+
+    BenchBuildTree(&fsm, "BenchNoFlags", 4, 4, 0);
+    BenchRunDispatch("no flags", &fsm, kNumEvents);
+    BenchDestroyTree(&fsm);
+
+    BenchBuildTree(&fsm, "BenchFlags", 4, 4, kFsmStateFlagPassThrough);
+    BenchRunDispatch("pass-through flags", &fsm, kNumEvents);
+    BenchDestroyTree(&fsm);
+
+    BenchBuildTree(&fsm, "BenchFlagsSealed", 4, 4, kFsmStateFlagPassThrough);
+    pSealed = BenchSealTree(&fsm, NULL, 0);
+    BenchRunDispatch("pass-through flags, sealed", &fsm, kNumEvents);
+    BenchDestroyTree(&fsm);
+    delete [] pSealed;
+}
+
+
+/**
+ * Dispatch with and without declared event subscription sets:
+ * kBenchSig_jump is routed straight from the leaf state to its
+ * top-level ancestor, skipping the inner states' handlers
+ */
+static void
+BenchSubscriptions()
+{
+    static const FsmEventIdType kTopEvents[] = {kBenchSig_jump};
+    static const FsmEventIdType kLeafEvents[] = {kBenchSig_poke};
+
+    const unsigned int  kNumEvents = 2000000;
+    BenchFsm            fsm;
+    unsigned int        i;
+
+    printf("Event subscription sets (340 states, depth 4, fan-out 4):\n");
+
+    BenchBuildTree(&fsm, "BenchUndeclared", 4, 4, 0);
+    BenchRunDispatch("undeclared", &fsm, kNumEvents);
+    BenchDestroyTree(&fsm);
+
+    BenchBuildTree(&fsm, "BenchDeclared", 4, 4, 0);
+    for (i = 0; i < fsm.numStates; ++i) {
+        FsmState* pState = &fsm.apStates[i]->stateRep;
+
+        if (i < 4) {
+            FsmDeclareStateEvents(pState, kTopEvents, 1);
+        }
+        else if (&fsm.apStates[i] >= fsm.apLeaves) {
+            FsmDeclareStateEvents(pState, kLeafEvents, 1);
+        }
+        else {
+            FsmDeclareStateEvents(pState, NULL, 0);
+        }
+    }
+    BenchRunDispatch("declared", &fsm, kNumEvents);
+    BenchDestroyTree(&fsm);
+}
+
+
+/**
+ * Dispatch on a flat FSM, which takes the flat-machine fast path,
+ * vs. the same FSM with one extra nested state that's never
+ * entered, which makes it take the general hierarchical path
+ * (@see BenchCompareDispatch())
+ */
+static void
+BenchFlat()
+{
+    const unsigned int  kNumEvents = 4000000;
+    const char* const   apLabels[2] = {"flat + 1 nested state (general path)",
+                                       "flat (fast path)"};
+    BenchFsm            aFsm[2];
+    BenchFsm*           apFsm[2] = {&aFsm[0], &aFsm[1]};
+    BenchState          nested;
+    int                 i;
+
+    printf("Flat FSM fast path (16 states):\n");
+
+    BenchBuildTree(&aFsm[0], "BenchFlatNested", 16, 1, 0);
+    FsmInitState(&nested.stateRep, &BenchInnerStateHandler, "nested");
+    FsmInsertState(&aFsm[0].fsmRep, &nested.stateRep,
+                   &aFsm[0].apStates[aFsm[0].numStates - 1]->stateRep);
+
+    BenchBuildTree(&aFsm[1], "BenchFlat", 16, 1, 0);
+
+    BenchCompareDispatch(apFsm, apLabels, kNumEvents);
+
+    for (i = 0; i < 2; ++i) {
+        BenchDestroyTree(&aFsm[i]);
+    }
+}
+
+
+/**
+ * Dispatch on single-chain machines far deeper than the depth
+ * that the engine used to be limited to: every kBenchSig_jump
+ * exits and re-enters the whole chain below the top-level state
+ */
+static void
+BenchDeep()
+{
+    static const int    kDepths[] = {8, 64, 512, 4096};
+
+    const unsigned int  kNumEvents = 400000;
+    unsigned int        i;
+
+    printf("Deep FSMs (fan-out 1):\n");
+
+    for (i = 0; i < sizeof(kDepths) / sizeof(kDepths[0]); ++i) {
+        BenchFsm    fsm;
+        char        label[40];
+
+        snprintf(label, sizeof(label), "depth %d", kDepths[i]);
+
+        BenchBuildTree(&fsm, "BenchDeep", 1, kDepths[i], 0);
+        BenchRunDispatch(label, &fsm, kNumEvents);
+        BenchDestroyTree(&fsm);
+    }
+}
+
+
+/**
+ * Returns true if pState is the current state or one of its
+ * ancestors by walking up the hierarchy: the way to answer the
+ * question without FsmIsInState()
+ */
+static int
+BenchIsInStateByWalk(FsmMachine* pFsm, const FsmState* pState)
+{
+    const FsmState* pWalk = FsmDbgPeekCurrentState(pFsm);
+
+    for (; pWalk; pWalk = FsmDbgPeekParentState(pFsm, pWalk)) {
+        if (pWalk == pState) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+/**
+ * FsmIsInState() vs. walking up the hierarchy from the current
+ * (deepest) state to a top-level state, as depth grows
+ */
+static void
+BenchIsInState()
+{
+    const unsigned int  kNumQueries = 4000000;
+    int                 depth;
+
+    printf("FsmIsInState() vs. hierarchy walk (fan-out 2):\n");
+
+    for (depth = 2; depth <= 10; depth += 2) {
+        BenchFsm        fsm;
+        const FsmState* pTop;
+        FsmState*       pOther;
+        volatile int    numIn = 0;
+        clock_t         start;
+        double          secsFast, secsWalk;
+        unsigned int    i;
+
+        BenchBuildTree(&fsm, "BenchIsInState", 2, depth, 0);
+        FsmStart(&fsm.fsmRep, &fsm.apLeaves[0]->stateRep);
+
+        /// The current state's top-level ancestor, and the other one
+        pTop = &fsm.apStates[0]->stateRep;
+        pOther = &fsm.apStates[1]->stateRep;
+
+        start = clock();
+        for (i = 0; i < kNumQueries; ++i) {
+            numIn += FsmIsInState(&fsm.fsmRep, (i & 1) ? pTop : pOther);
+        }
+        secsFast = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        for (i = 0; i < kNumQueries; ++i) {
+            numIn += BenchIsInStateByWalk(&fsm.fsmRep, (i & 1) ? pTop : pOther);
+        }
+        secsWalk = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        printf("  depth %2d: FsmIsInState %10.0f queries/sec, "
+               "walk %10.0f queries/sec\n", depth,
+               secsFast > 0 ? kNumQueries / secsFast : 0.0,
+               secsWalk > 0 ? kNumQueries / secsWalk : 0.0);
+
+        BenchDestroyTree(&fsm);
+    }
+}
+
+
+/**
+ * The byte-stream benchmark's machine: a tag scanner that counts
+ * the "<...>" tags in its input via declarative transitions
+ */
+struct BenchTagFsm {
+    FsmMachine          fsmRep; ///< MUST be first member for C "subclassing"
+
+    FsmState            text;
+    FsmState            tag;
+
+    FsmTransitionDef    textTransition;
+    FsmTransitionDef    tagTransition;
+
+    unsigned int        numTags;
+};
+
+
+static int
+BenchTagStateHandler(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    return FALSE;
+}
+
+
+static void
+BenchTagOpened(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    ((BenchTagFsm*)pFsm)->numTags++;
+}
+
+
+static void
+BenchBuildTagFsm(BenchTagFsm* pFsm)
+{
+    FsmInitMachine(&pFsm->fsmRep, "BenchTags");
+    FsmInitState(&pFsm->text, &BenchTagStateHandler, "text");
+    FsmInitState(&pFsm->tag, &BenchTagStateHandler, "tag");
+    FsmInsertState(&pFsm->fsmRep, &pFsm->text, NULL);
+    FsmInsertState(&pFsm->fsmRep, &pFsm->tag, NULL);
+
+    /// The handlers don't subscribe to any user events
+    FsmDeclareStateEvents(&pFsm->text, NULL, 0);
+    FsmDeclareStateEvents(&pFsm->tag, NULL, 0);
+
+    pFsm->textTransition.evtId = kBenchSig_byteOpen;
+    pFsm->textTransition.pTarget = &pFsm->tag;
+    pFsm->textTransition.pGuard = NULL;
+    pFsm->textTransition.pAction = &BenchTagOpened;
+    FsmDeclareStateTransitions(&pFsm->text, &pFsm->textTransition, 1);
+
+    pFsm->tagTransition.evtId = kBenchSig_byteClose;
+    pFsm->tagTransition.pTarget = &pFsm->text;
+    pFsm->tagTransition.pGuard = NULL;
+    pFsm->tagTransition.pAction = NULL;
+    FsmDeclareStateTransitions(&pFsm->tag, &pFsm->tagTransition, 1);
+
+    pFsm->numTags = 0;
+}
+
+
+/**
+ * FsmFeedBytes() vs. dispatching an FsmByteEvent per byte on a
+ * 1 MB input with a short tag every 64 bytes
+ */
+static void
+BenchByteStream()
+{
+    const unsigned int  kLen = 1 << 20;
+    const int           kNumPasses = 20;
+    unsigned char*      pBuf = new unsigned char[kLen];
+    unsigned char       aClasses[256];
+    BenchTagFsm         fsm;
+    FsmByteDfa          dfa;
+    FsmByteDfaCell      aCells[FSM_BYTE_DFA_CELL_COUNT(2, 3)];
+    unsigned int        numTagsFed, numTagsDispatched;
+    clock_t             start;
+    double              secsFed, secsDispatched;
+    unsigned int        i;
+    int                 pass;
+
+    printf("Byte-stream DFA (2 states, 1 MB input, a tag per 64 bytes):\n");
+
+    for (i = 0; i < kLen; ++i) {
+        pBuf[i] = (i % 64 == 60) ? '<' : (i % 64 == 62) ? '>' :
+                  (unsigned char)('a' + i % 26);
+    }
+
+    memset(aClasses, 0, sizeof(aClasses));
+    aClasses['<'] = kBenchSig_byteOpen - kBenchSig_byteText;
+    aClasses['>'] = kBenchSig_byteClose - kBenchSig_byteText;
+
+    BenchBuildTagFsm(&fsm);
+    FsmCompileByteDfa(&fsm.fsmRep, &dfa, aClasses, 3, kBenchSig_byteText,
+                      aCells, sizeof(aCells) / sizeof(aCells[0]));
+    FsmStart(&fsm.fsmRep, &fsm.text);
+
+    start = clock();
+    for (pass = 0; pass < kNumPasses; ++pass) {
+        FsmFeedBytes(&fsm.fsmRep, pBuf, kLen);
+    }
+    secsFed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    numTagsFed = fsm.numTags;
+
+    BenchBuildTagFsm(&fsm);
+    FsmStart(&fsm.fsmRep, &fsm.text);
+
+    start = clock();
+    for (pass = 0; pass < kNumPasses; ++pass) {
+        FsmByteEvent evt;
+
+        for (i = 0; i < kLen; ++i) {
+            evt.evt.evtId = kBenchSig_byteText + aClasses[pBuf[i]];
+            evt.byte = pBuf[i];
+            FsmDispatchEvent(&fsm.fsmRep, &evt.evt);
+        }
+    }
+    secsDispatched = (double)(clock() - start) / CLOCKS_PER_SEC;
+    numTagsDispatched = fsm.numTags;
+
+    printf("  %-40s %8.1f MB/sec\n", "FsmFeedBytes",
+           secsFed > 0 ? kNumPasses / secsFed : 0.0);
+    printf("  %-40s %8.1f MB/sec\n", "FsmDispatchEvent per byte",
+           secsDispatched > 0 ? kNumPasses / secsDispatched : 0.0);
+
+    if (numTagsFed != numTagsDispatched) {
+        printf("  ERROR: %u tags fed vs. %u tags dispatched\n",
+               numTagsFed, numTagsDispatched);
+    }
+
+    delete [] pBuf;
+}
+
+
+/**
+ * The shared-definition benchmark's session FSM: the parent state
+ * toggles between its on and off substates, which count ticks in
+ * their session's context
+ */
+struct BenchSessionCtx {
+    FsmState*       pOn;
+    FsmState*       pOff;
+
+    unsigned int    numTicks;
+};
+
+
+/**
+ * A session FSM that embeds its own topology, the way FSMs were
+ * built before shared definitions
+ */
+struct BenchSessionFsm {
+    FsmMachine          fsmRep; ///< MUST be first member for C "subclassing"
+
+    FsmState            parent;
+    FsmState            on;
+    FsmState            off;
+
+    BenchSessionCtx     ctx;
+};
+
+
+/**
+ * The session FSM's definition; the states are shared by all
+ * instances
+ */
+struct BenchSessionDef {
+    FsmMachine          fsmRep;
+
+    FsmState            parent;
+    FsmState            on;
+    FsmState            off;
+
+    FsmSealedState      aSealed[FSM_SEALED_STATE_COUNT(3)];
+    FsmDefinition       def;
+};
+
+
+/**
+ * Returns the session context of a BenchSessionFsm or an instance
+ */
+template <bool kIsInstance>
+static BenchSessionCtx*
+BenchSessionGetCtx(FsmMachine* pFsm)
+{
+    return kIsInstance ? (BenchSessionCtx*)FsmGetInstanceContext(pFsm)
+                       : &((BenchSessionFsm*)pFsm)->ctx;
+}
+
+
+template <bool kIsInstance>
+static int
+BenchSessionParentHandler(FsmState* pState, FsmMachine* pFsm,
+                          const FsmEvent* pEvt)
+{
+    if (kBenchSig_jump == pEvt->evtId) {
+        BenchSessionCtx* pCtx = BenchSessionGetCtx<kIsInstance>(pFsm);
+
+        FsmBeginTransition(pFsm, FsmIsInState(pFsm, pCtx->pOn)
+                                 ? pCtx->pOff : pCtx->pOn);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+template <bool kIsInstance>
+static int
+BenchSessionLeafHandler(FsmState* pState, FsmMachine* pFsm,
+                        const FsmEvent* pEvt)
+{
+    if (kBenchSig_poke == pEvt->evtId) {
+        BenchSessionGetCtx<kIsInstance>(pFsm)->numTicks++;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+template <bool kIsInstance>
+static void
+BenchSessionInitStates(FsmMachine* pFsm, FsmState* pParent, FsmState* pOn,
+                       FsmState* pOff)
+{
+    FsmInitMachine(pFsm, "BenchSession");
+    FsmInitState(pParent, &BenchSessionParentHandler<kIsInstance>, "parent");
+    FsmInitState(pOn, &BenchSessionLeafHandler<kIsInstance>, "on");
+    FsmInitState(pOff, &BenchSessionLeafHandler<kIsInstance>, "off");
+    FsmInsertState(pFsm, pParent, NULL);
+    FsmInsertState(pFsm, pOn, pParent);
+    FsmInsertState(pFsm, pOff, pParent);
+}
+
+
+/**
+ * Sets up many sessions and round-robins events among them: with
+ * each session embedding and building its own topology vs. with
+ * lightweight instances of one shared definition
+ */
+static void
+BenchInstances()
+{
+    const unsigned int  kNumSessions = 100000;
+    const unsigned int  kNumRounds = 20;
+
+    BenchSessionFsm*    aFsms = new BenchSessionFsm[kNumSessions];
+    FsmInstance*        aInstances = new FsmInstance[kNumSessions];
+    BenchSessionCtx*    aCtxs = new BenchSessionCtx[kNumSessions];
+    BenchSessionDef     def;
+    FsmState*           apDefStates[3] = {&def.parent, &def.on, &def.off};
+    FsmEvent            evtPoke = {kBenchSig_poke};
+    FsmEvent            evtJump = {kBenchSig_jump};
+    unsigned int        numTicksFsms = 0, numTicksInstances = 0;
+    clock_t             start;
+    double              secsSetup, secsRun;
+    unsigned int        i, r;
+
+    printf("Shared definition vs. embedded topology (%u sessions, "
+           "3 states):\n", kNumSessions);
+
+    /// Embedded topology
+    start = clock();
+    for (i = 0; i < kNumSessions; ++i) {
+        BenchSessionFsm* pFsm = &aFsms[i];
+
+        BenchSessionInitStates<false>(&pFsm->fsmRep, &pFsm->parent, &pFsm->on,
+                                      &pFsm->off);
+        pFsm->ctx.pOn = &pFsm->on;
+        pFsm->ctx.pOff = &pFsm->off;
+        pFsm->ctx.numTicks = 0;
+        FsmStart(&pFsm->fsmRep, &pFsm->off);
+    }
+    secsSetup = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (r = 0; r < kNumRounds; ++r) {
+        for (i = 0; i < kNumSessions; ++i) {
+            FsmDispatchEvent(&aFsms[i].fsmRep, (r & 3) ? &evtPoke : &evtJump);
+        }
+    }
+    secsRun = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    for (i = 0; i < kNumSessions; ++i) {
+        numTicksFsms += aFsms[i].ctx.numTicks;
+    }
+
+    printf("  %-40s %4u bytes/session, setup %6.3f sec, "
+           "%8.0f dispatches/sec\n", "embedded topology",
+           (unsigned int)sizeof(BenchSessionFsm), secsSetup,
+           secsRun > 0 ? kNumRounds * kNumSessions / secsRun : 0.0);
+
+    /// Shared definition
+    start = clock();
+    BenchSessionInitStates<true>(&def.fsmRep, &def.parent, &def.on, &def.off);
+    FsmSealMachine(&def.fsmRep, apDefStates, 3, def.aSealed,
+                   FSM_SEALED_STATE_COUNT(3));
+    FsmInitDefinition(&def.def, &def.fsmRep);
+
+    for (i = 0; i < kNumSessions; ++i) {
+        aCtxs[i].pOn = &def.on;
+        aCtxs[i].pOff = &def.off;
+        aCtxs[i].numTicks = 0;
+        FsmInitInstance(&aInstances[i], &def.def, &aCtxs[i]);
+        FsmStart(FSM_INSTANCE_MACHINE(&aInstances[i]), &def.off);
+    }
+    secsSetup = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (r = 0; r < kNumRounds; ++r) {
+        for (i = 0; i < kNumSessions; ++i) {
+            FsmDispatchEvent(FSM_INSTANCE_MACHINE(&aInstances[i]),
+                             (r & 3) ? &evtPoke : &evtJump);
+        }
+    }
+    secsRun = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    for (i = 0; i < kNumSessions; ++i) {
+        numTicksInstances += aCtxs[i].numTicks;
+    }
+
+    printf("  %-40s %4u bytes/session, setup %6.3f sec, "
+           "%8.0f dispatches/sec\n", "shared definition",
+           (unsigned int)(sizeof(FsmInstance) + sizeof(BenchSessionCtx)),
+           secsSetup,
+           secsRun > 0 ? kNumRounds * kNumSessions / secsRun : 0.0);
+
+    if (numTicksFsms != numTicksInstances) {
+        printf("  ERROR: %u ticks with embedded topology vs. %u ticks with "
+               "shared definition\n", numTicksFsms, numTicksInstances);
+    }
+
+    delete [] aCtxs;
+    delete [] aInstances;
+    delete [] aFsms;
+}
+
+
+/**
+ * Startup of a machine with 10k states (a complete 4-ary forest
+ * of depth 7): one FsmInitStateEx() plus one FsmInsertState()
+ * call per state vs. FsmBuildStates()
+ */
+static void
+BenchStartup()
+{
+    const unsigned int  kNumStates = 10000;
+    const int           kNumBuilds = 100;
+
+    FsmStateRecord*     aRecords = new FsmStateRecord[kNumStates];
+    FsmState*           aStates1 = new FsmState[kNumStates];
+    FsmState*           aStates2 = new FsmState[kNumStates];
+    FsmState**          apStates2 = new FsmState*[kNumStates];
+    FsmMachine          fsm1, fsm2;
+    clock_t             start;
+    double              secsInsert, secsBulk;
+    unsigned int        i;
+    int                 build;
+
+    printf("Startup (%u states, depth 7):\n", kNumStates);
+
+    for (i = 0; i < kNumStates; ++i) {
+        aRecords[i].pHandler = &BenchInnerStateHandler;
+        aRecords[i].pName = "bench";
+        aRecords[i].parent = (i < 4) ? -1 : (int)(i / 4) - 1;
+        aRecords[i].flags = 0;
+
+        apStates2[i] = &aStates2[i];
+    }
+
+    start = clock();
+    for (build = 0; build < kNumBuilds; ++build) {
+        FsmInitMachine(&fsm1, "BenchInsert");
+        for (i = 0; i < kNumStates; ++i) {
+            FsmInitStateEx(&aStates1[i], aRecords[i].pHandler,
+                           aRecords[i].pName, aRecords[i].flags);
+            FsmInsertState(&fsm1, &aStates1[i], (aRecords[i].parent < 0)
+                           ? NULL : &aStates1[aRecords[i].parent]);
+        }
+    }
+    secsInsert = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (build = 0; build < kNumBuilds; ++build) {
+        FsmInitMachine(&fsm2, "BenchBulk");
+        FsmBuildStates(&fsm2, aRecords, apStates2, kNumStates);
+    }
+    secsBulk = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("  %-40s %8.0f builds/sec\n", "FsmInitStateEx + FsmInsertState",
+           secsInsert > 0 ? kNumBuilds / secsInsert : 0.0);
+    printf("  %-40s %8.0f builds/sec\n", "FsmBuildStates",
+           secsBulk > 0 ? kNumBuilds / secsBulk : 0.0);
+
+    /// Both builds must yield the same topology
+    FsmStart(&fsm1, &aStates1[kNumStates - 1]);
+    FsmStart(&fsm2, &aStates2[kNumStates - 1]);
+    for (i = 0; i < kNumStates; ++i) {
+        if (!FsmIsInState(&fsm1, &aStates1[i]) !=
+            !FsmIsInState(&fsm2, &aStates2[i])) {
+            printf("  ERROR: topologies differ at state %u\n", i);
+            break;
+        }
+    }
+
+    delete [] apStates2;
+    delete [] aStates2;
+    delete [] aStates1;
+    delete [] aRecords;
+}
+
+
+/**
+ * The session FSM's topology as constant data (@see
+ * BenchSessionDef)
+ */
+static const FSM_CONST_TOPOLOGY(3) kBenchSessionTopology = {
+    {
+        FSM_CONST_ROOT_STATE(kBenchSessionTopology),
+        FSM_CONST_STATE(kBenchSessionTopology, 1,
+                        &BenchSessionParentHandler<true>, 0, 1, 3),
+        FSM_CONST_STATE(kBenchSessionTopology, 2,
+                        &BenchSessionLeafHandler<true>, 1, 2, 2),
+        FSM_CONST_STATE(kBenchSessionTopology, 3,
+                        &BenchSessionLeafHandler<true>, 1, 2, 3)
+    },
+    {"BenchSession", "parent", "on", "off"}
+};
+
+
+/**
+ * Dispatches the session benchmark's events to one instance of
+ * the given definition
+ *
+ * @return double elapsed seconds
+ */
+static double
+BenchRunSessionInstance(const FsmDefinition* pDef, FsmState* pOn,
+                        FsmState* pOff, unsigned int numEvents,
+                        unsigned int* pNumTicks)
+{
+    FsmInstance         instance;
+    BenchSessionCtx     ctx = {pOn, pOff, 0};
+    FsmEvent            evtPoke = {kBenchSig_poke};
+    FsmEvent            evtJump = {kBenchSig_jump};
+    clock_t             start;
+    unsigned int        i;
+
+    FsmInitInstance(&instance, pDef, &ctx);
+    FsmStart(FSM_INSTANCE_MACHINE(&instance), pOff);
+
+    start = clock();
+    for (i = 0; i < numEvents; ++i) {
+        FsmDispatchEvent(FSM_INSTANCE_MACHINE(&instance),
+                         (i & 3) ? &evtPoke : &evtJump);
+    }
+
+    *pNumTicks = ctx.numTicks;
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+/**
+ * Setting up the session FSM's definition by building and
+ * sealing the machine vs. from its constant topology, and
+ * dispatching events to an instance of each
+ */
+static void
+BenchConstTopology()
+{
+    const unsigned int  kNumSetups = 1000000;
+    const unsigned int  kNumEvents = 20000000;
+
+    BenchSessionDef     def;
+    FsmState*           apDefStates[3] = {&def.parent, &def.on, &def.off};
+    FsmDefinition       constDef;
+    unsigned int        numTicksBuilt, numTicksConst;
+    clock_t             start;
+    double              secsBuilt, secsConst, secsRunBuilt, secsRunConst;
+    unsigned int        i;
+
+    printf("Constant vs. built topology (3 states):\n");
+
+    start = clock();
+    for (i = 0; i < kNumSetups; ++i) {
+        BenchSessionInitStates<true>(&def.fsmRep, &def.parent, &def.on,
+                                     &def.off);
+        FsmSealMachine(&def.fsmRep, apDefStates, 3, def.aSealed,
+                       FSM_SEALED_STATE_COUNT(3));
+        FsmInitDefinition(&def.def, &def.fsmRep);
+    }
+    secsBuilt = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (i = 0; i < kNumSetups; ++i) {
+        FSM_INIT_CONST_DEFINITION(&constDef, kBenchSessionTopology);
+    }
+    secsConst = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    secsRunBuilt = BenchRunSessionInstance(&def.def, &def.on, &def.off,
+                                           kNumEvents, &numTicksBuilt);
+    secsRunConst = BenchRunSessionInstance(
+        &constDef, FSM_CONST_USER_STATE(kBenchSessionTopology, 2),
+        FSM_CONST_USER_STATE(kBenchSessionTopology, 3), kNumEvents,
+        &numTicksConst);
+
+    printf("  %-40s %8.0f ns/setup, %8.0f dispatches/sec\n",
+           "built and sealed", secsBuilt * 1e9 / kNumSetups,
+           secsRunBuilt > 0 ? kNumEvents / secsRunBuilt : 0.0);
+    printf("  %-40s %8.0f ns/setup, %8.0f dispatches/sec\n",
+           "constant topology", secsConst * 1e9 / kNumSetups,
+           secsRunConst > 0 ? kNumEvents / secsRunConst : 0.0);
+
+    if (numTicksBuilt != numTicksConst) {
+        printf("  ERROR: %u ticks with built topology vs. %u ticks with "
+               "constant topology\n", numTicksBuilt, numTicksConst);
+    }
+}
+
+
+/**
+ * Startup of a shared definition with 10k states (a complete
+ * 4-ary forest of depth 7): building and sealing the machine vs.
+ * loading its definition image from a memory-mapped file
+ */
+static void
+BenchDefinitionImage()
+{
+    const unsigned int      kNumStates = 10000;
+    const int               kNumLoads = 100;
+
+    FsmStateRecord*         aRecords = new FsmStateRecord[kNumStates];
+    FsmState*               aStates = new FsmState[kNumStates];
+    char*                   aNames = new char[kNumStates * 8];
+    FsmState**              apStates = new FsmState*[kNumStates];
+    FsmSealedState*         aSealed =
+        new FsmSealedState[FSM_SEALED_STATE_COUNT(kNumStates)];
+    FsmSealedState*         aLoaded =
+        new FsmSealedState[FSM_SEALED_STATE_COUNT(kNumStates)];
+    const FsmImageBinding   aBindings[] = {
+        {"inner", &BenchInnerStateHandler, NULL, NULL}
+    };
+    char                    path[] = "/tmp/BenchFsmImageXXXXXX";
+    FsmMachine              fsm;
+    FsmDefinition           builtDef, loadedDef;
+    FsmInstance             built, loaded;
+    unsigned int*           pBuf = NULL;
+    void*                   pImage = MAP_FAILED;
+    unsigned int            imageSize, numStates, numTransitions;
+    clock_t                 start;
+    double                  secsBuild, secsLoad;
+    unsigned int            i;
+    int                     fd, load, ok = TRUE;
+
+    printf("Definition startup (%u states, depth 7):\n", kNumStates);
+
+    for (i = 0; i < kNumStates; ++i) {
+        aRecords[i].pHandler = &BenchInnerStateHandler;
+        snprintf(&aNames[i * 8], 8, "s%u", i);
+        aRecords[i].pName = &aNames[i * 8];
+        aRecords[i].parent = (i < 4) ? -1 : (int)(i / 4) - 1;
+        aRecords[i].flags = 0;
+
+        apStates[i] = &aStates[i];
+    }
+
+    start = clock();
+    for (load = 0; load < kNumLoads; ++load) {
+        FsmInitMachine(&fsm, "BenchImage");
+        FsmBuildStates(&fsm, aRecords, apStates, kNumStates);
+        FsmSealMachine(&fsm, apStates, kNumStates, aSealed,
+                       FSM_SEALED_STATE_COUNT(kNumStates));
+        FsmInitDefinition(&builtDef, &fsm);
+    }
+    secsBuild = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    /// Write the image to a file, and map it
+    imageSize = FsmWriteDefinitionImage(&fsm, aBindings, 1, NULL, 0);
+    pBuf = new unsigned int[(imageSize + 3) / 4];
+    FsmWriteDefinitionImage(&fsm, aBindings, 1, pBuf, imageSize);
+
+    fd = mkstemp(path);
+    if (fd < 0 || write(fd, pBuf, imageSize) != (ssize_t)imageSize ||
+        MAP_FAILED == (pImage = mmap(NULL, imageSize, PROT_READ, MAP_SHARED,
+                                     fd, 0))) {
+        printf("  ERROR: can't map the image file %s\n", path);
+        ok = FALSE;
+    }
+
+    if (ok) {
+        start = clock();
+        for (load = 0; load < kNumLoads && ok; ++load) {
+            ok = FsmGetDefinitionImageInfo(pImage, imageSize, &numStates,
+                                           &numTransitions) &&
+                 FsmLoadDefinitionImage(&loadedDef, pImage, imageSize,
+                                        aBindings, 1, aLoaded,
+                                        FSM_SEALED_STATE_COUNT(numStates),
+                                        NULL, 0);
+        }
+        secsLoad = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        if (!ok) {
+            printf("  ERROR: can't load the image\n");
+        }
+    }
+
+    if (ok) {
+        printf("  %-40s %8.0f loads/sec\n", "FsmBuildStates + FsmSealMachine",
+               secsBuild > 0 ? kNumLoads / secsBuild : 0.0);
+        printf("  %-40s %8.0f loads/sec (%u-byte image)\n",
+               "FsmLoadDefinitionImage (mapped file)",
+               secsLoad > 0 ? kNumLoads / secsLoad : 0.0, imageSize);
+
+        /// Both definitions must have the same topology; the image
+        /// holds the states in pre-order, rather than in the order
+        /// in which they were sealed
+        FsmInitInstance(&built, &builtDef, NULL);
+        FsmInitInstance(&loaded, &loadedDef, NULL);
+        FsmStart(FSM_INSTANCE_MACHINE(&built), &aStates[kNumStates - 1]);
+        FsmStart(FSM_INSTANCE_MACHINE(&loaded),
+                 FsmFindDefinitionState(&loadedDef,
+                                        &aNames[(kNumStates - 1) * 8]));
+        for (i = 0; i < kNumStates; i += 97) {
+            if (!FsmIsInState(FSM_INSTANCE_MACHINE(&built), &aStates[i]) !=
+                !FsmIsInState(FSM_INSTANCE_MACHINE(&loaded),
+                              FsmFindDefinitionState(&loadedDef,
+                                                     &aNames[i * 8]))) {
+                printf("  ERROR: topologies differ at state %u\n", i);
+                break;
+            }
+        }
+    }
+
+    if (MAP_FAILED != pImage) {
+        munmap(pImage, imageSize);
+    }
+    if (fd >= 0) {
+        close(fd);
+        unlink(path);
+    }
+
+    delete [] pBuf;
+    delete [] aLoaded;
+    delete [] aSealed;
+    delete [] apStates;
+    delete [] aNames;
+    delete [] aStates;
+    delete [] aRecords;
+}
+
+
+/**
+ * The session context of instances of a live definition: the
+ * session's states are looked up again whenever the instance has
+ * moved to a new version (@see PalmFsmLive.h)
+ */
+struct BenchLiveCtx {
+    BenchSessionCtx         session;    ///< MUST be first member
+    const FsmDefinition*    pDef;
+};
+
+
+static int
+BenchLiveParentHandler(FsmState* pState, FsmMachine* pFsm,
+                       const FsmEvent* pEvt)
+{
+    if (kBenchSig_jump == pEvt->evtId) {
+        BenchLiveCtx*           pCtx = (BenchLiveCtx*)FsmGetInstanceContext(pFsm);
+        const FsmDefinition*    pDef = FsmGetLiveInstanceDefinition(pFsm);
+
+        if (pDef != pCtx->pDef) {
+            pCtx->pDef = pDef;
+            pCtx->session.pOn = FsmFindDefinitionState(pDef, "on");
+            pCtx->session.pOff = FsmFindDefinitionState(pDef, "off");
+        }
+
+        FsmBeginTransition(pFsm, FsmIsInState(pFsm, pCtx->session.pOn)
+                                 ? pCtx->session.pOff : pCtx->session.pOn);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+/**
+ * Builds a version of the live session definition; the leaves'
+ * state ids differ between the two versions
+ */
+static void
+BenchLiveBuildDef(BenchSessionDef* pDef, bool swapLeaves)
+{
+    FsmState* apStates[3] = {&pDef->parent, &pDef->on, &pDef->off};
+
+    if (swapLeaves) {
+        apStates[1] = &pDef->off;
+        apStates[2] = &pDef->on;
+    }
+
+    FsmInitMachine(&pDef->fsmRep, "BenchLiveSession");
+    FsmInitState(&pDef->parent, &BenchLiveParentHandler, "parent");
+    FsmInitState(&pDef->on, &BenchSessionLeafHandler<true>, "on");
+    FsmInitState(&pDef->off, &BenchSessionLeafHandler<true>, "off");
+    FsmInsertState(&pDef->fsmRep, &pDef->parent, NULL);
+    FsmInsertState(&pDef->fsmRep, &pDef->on, &pDef->parent);
+    FsmInsertState(&pDef->fsmRep, &pDef->off, &pDef->parent);
+    FsmSealMachine(&pDef->fsmRep, apStates, 3, pDef->aSealed,
+                   FSM_SEALED_STATE_COUNT(3));
+    FsmInitDefinition(&pDef->def, &pDef->fsmRep);
+}
+
+
+/**
+ * Round-robins events among many sessions: instances of a shared
+ * definition vs. instances of a live definition, without and with
+ * a new version (which renumbers the leaves) published after each
+ * round; the sessions MUST count the same ticks either way
+ */
+static void
+BenchLiveDefinition()
+{
+    const unsigned int  kNumSessions = 100000;
+    const unsigned int  kNumRounds = 20;
+
+    FsmInstance*        aInstances = new FsmInstance[kNumSessions];
+    BenchLiveCtx*       aCtxs = new BenchLiveCtx[kNumSessions];
+    FsmLiveVersion*     aVersions = new FsmLiveVersion[kNumRounds + 1];
+    BenchSessionDef     def, liveDefs[2];
+    FsmState*           apDefStates[3] = {&def.parent, &def.on, &def.off};
+    unsigned short      aIdMaps[2][FSM_SEALED_STATE_COUNT(3)];
+    FsmLiveDefinition   live;
+    FsmEvent            evtPoke = {kBenchSig_poke};
+    FsmEvent            evtJump = {kBenchSig_jump};
+    unsigned int        numTicks[3] = {0, 0, 0};
+    unsigned int        numReclaimed = 0;
+    clock_t             start;
+    double              secsRun;
+    int                 mode;
+    unsigned int        i, r;
+
+    static const char* const kLabels[3] = {
+        "shared definition", "live definition",
+        "live definition, new version per round"
+    };
+
+    printf("Live vs. shared definition (%u sessions, 3 states):\n",
+           kNumSessions);
+
+    BenchSessionInitStates<true>(&def.fsmRep, &def.parent, &def.on, &def.off);
+    FsmSealMachine(&def.fsmRep, apDefStates, 3, def.aSealed,
+                   FSM_SEALED_STATE_COUNT(3));
+    FsmInitDefinition(&def.def, &def.fsmRep);
+
+    BenchLiveBuildDef(&liveDefs[0], false);
+    BenchLiveBuildDef(&liveDefs[1], true);
+    FsmMapDefinitionStates(&liveDefs[1].def, &liveDefs[0].def, aIdMaps[0],
+                           FSM_SEALED_STATE_COUNT(3));
+    FsmMapDefinitionStates(&liveDefs[0].def, &liveDefs[1].def, aIdMaps[1],
+                           FSM_SEALED_STATE_COUNT(3));
+
+    for (mode = 0; mode < 3; ++mode) {
+        if (mode > 0) {
+            FsmInitLiveDefinition(&live, &aVersions[0], &liveDefs[0].def);
+        }
+
+        for (i = 0; i < kNumSessions; ++i) {
+            FsmMachine* pFsm = FSM_INSTANCE_MACHINE(&aInstances[i]);
+
+            aCtxs[i].session.numTicks = 0;
+
+            if (0 == mode) {
+                aCtxs[i].session.pOn = &def.on;
+                aCtxs[i].session.pOff = &def.off;
+                FsmInitInstance(&aInstances[i], &def.def, &aCtxs[i]);
+                FsmStart(pFsm, &def.off);
+            }
+            else {
+                aCtxs[i].pDef = NULL;
+                FsmInitLiveInstance(&aInstances[i], &live, &aCtxs[i]);
+                FsmStart(pFsm, &liveDefs[0].off);
+            }
+        }
+
+        start = clock();
+        for (r = 0; r < kNumRounds; ++r) {
+            for (i = 0; i < kNumSessions; ++i) {
+                FsmDispatchEvent(FSM_INSTANCE_MACHINE(&aInstances[i]),
+                                 (r & 3) ? &evtPoke : &evtJump);
+            }
+
+            if (2 == mode) {
+                FsmPublishLiveDefinition(&live, &aVersions[r + 1],
+                                         &liveDefs[(r + 1) & 1].def,
+                                         aIdMaps[(r + 1) & 1],
+                                         FSM_SEALED_STATE_COUNT(3));
+                while (FsmReclaimLiveVersion(&live)) {
+                    numReclaimed++;
+                }
+            }
+        }
+        secsRun = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        for (i = 0; i < kNumSessions; ++i) {
+            numTicks[mode] += aCtxs[i].session.numTicks;
+
+            if (mode > 0) {
+                FsmReleaseLiveInstance(&aInstances[i]);
+            }
+        }
+
+        if (mode > 0) {
+            while (FsmReclaimLiveVersion(&live)) {
+                numReclaimed++;
+            }
+        }
+
+        printf("  %-40s %8.0f dispatches/sec\n", kLabels[mode],
+               secsRun > 0 ? kNumRounds * kNumSessions / secsRun : 0.0);
+    }
+
+    if (numTicks[1] != numTicks[0] || numTicks[2] != numTicks[0]) {
+        printf("  ERROR: %u ticks with shared definition vs. %u and %u ticks "
+               "with live definition\n", numTicks[0], numTicks[1],
+               numTicks[2]);
+    }
+
+    if (numReclaimed != kNumRounds) {
+        printf("  ERROR: %u of %u superseded versions reclaimed\n",
+               numReclaimed, kNumRounds);
+    }
+
+    delete [] aVersions;
+    delete [] aCtxs;
+    delete [] aInstances;
+}
+
+
+/**
+ * The generated dispatch benchmark's context and handlers (@see
+ * BenchGenFsm.json): the leaves count ticks, the session state
+ * counts pings, and the link state's declarative transitions
+ * toggle between the leaves
+ */
+struct BenchGenCtx {
+    unsigned int    numTicks;
+    unsigned int    numPings;
+};
+
+
+int
+BenchGenSessionHandler(FsmState* pState, FsmMachine* pFsm,
+                       const FsmEvent* pEvt)
+{
+    if (kBenchGenSig_ping == pEvt->evtId) {
+        ((BenchGenCtx*)FsmGetInstanceContext(pFsm))->numPings++;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+int
+BenchGenLinkHandler(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    return FALSE;
+}
+
+
+int
+BenchGenLeafHandler(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    if (kBenchGenSig_tick == pEvt->evtId) {
+        ((BenchGenCtx*)FsmGetInstanceContext(pFsm))->numTicks++;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+int
+BenchGenIsOn(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    return FsmIsInState(pFsm, FSM_CONST_USER_STATE(kBenchGenTopology,
+                                                   kBenchGenState_on));
+}
+
+
+/**
+ * Dispatches the generated dispatch benchmark's events to an
+ * instance of the given definition via the given function
+ *
+ * @return double elapsed seconds
+ */
+static double
+BenchRunGenerated(const FsmDefinition* pDef,
+                  int (*pDispatch)(FsmMachine*, const FsmEvent*),
+                  unsigned int numEvents, BenchGenCtx* pCtx)
+{
+    static const FsmEvent kEvents[5] = {
+        {kBenchGenSig_tick}, {kBenchGenSig_tick}, {kBenchGenSig_toggle},
+        {kBenchGenSig_tick}, {kBenchGenSig_ping}
+    };
+
+    FsmInstance         instance;
+    clock_t             start;
+    unsigned int        i;
+
+    pCtx->numTicks = 0;
+    pCtx->numPings = 0;
+
+    FsmInitInstance(&instance, pDef, pCtx);
+    FsmStart(FSM_INSTANCE_MACHINE(&instance),
+             FSM_CONST_USER_STATE(kBenchGenTopology, kBenchGenState_off));
+
+    start = clock();
+    for (i = 0; i < numEvents; ++i) {
+        pDispatch(FSM_INSTANCE_MACHINE(&instance), &kEvents[i % 5]);
+    }
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+/**
+ * The same events dispatched to instances of the BenchGen
+ * statechart's definition by FsmDispatchEvent() and by the code
+ * that fsmgen generated for it (@see tools/fsmgen)
+ */
+static void
+BenchGenerated()
+{
+    const unsigned int  kNumEvents = 20000000;
+
+    FsmDefinition       def;
+    BenchGenCtx         engineCtx, genCtx;
+    double              secsEngine, secsGen;
+
+    printf("Runtime vs. generated dispatch (4 states):\n");
+
+    BenchGenInitDefinition(&def);
+
+    secsEngine = BenchRunGenerated(&def, &FsmDispatchEvent, kNumEvents,
+                                   &engineCtx);
+    secsGen = BenchRunGenerated(&def, &BenchGenDispatchEvent, kNumEvents,
+                                &genCtx);
+
+    printf("  %-40s %8.0f dispatches/sec\n", "FsmDispatchEvent()",
+           secsEngine > 0 ? kNumEvents / secsEngine : 0.0);
+    printf("  %-40s %8.0f dispatches/sec\n", "generated",
+           secsGen > 0 ? kNumEvents / secsGen : 0.0);
+
+    if (engineCtx.numTicks != genCtx.numTicks ||
+        engineCtx.numPings != genCtx.numPings) {
+        printf("  ERROR: %u/%u ticks/pings with FsmDispatchEvent() vs. " \
+               "%u/%u with generated dispatch\n", engineCtx.numTicks,
+               engineCtx.numPings, genCtx.numTicks, genCtx.numPings);
+    }
+}
+
+
+/**
+ * The same event loop against the shared library and against the
+ * header-only engine compiled into BenchmarkHeaderOnly.cpp
+ */
+static void
+BenchHeaderOnly()
+{
+    const unsigned int  kNumEvents = 20000000;
+    double              secsLib, secsHeaderOnly;
+
+    printf("Shared library vs. header-only engine (3 states):\n");
+
+    secsLib = BenchWorkloadRun(kNumEvents);
+    secsHeaderOnly = BenchHeaderOnlyDispatchSecs(kNumEvents);
+
+    printf("  %-40s %8.0f dispatches/sec\n", "shared library",
+           secsLib > 0 ? kNumEvents / secsLib : 0.0);
+    printf("  %-40s %8.0f dispatches/sec\n", "header-only",
+           secsHeaderOnly > 0 ? kNumEvents / secsHeaderOnly : 0.0);
+}
+
+
+/**
+ * The C++ adapter benchmark's world FSM (in the style of
+ * CplusplusTest.cpp's MyWorldFsm), whose states subclass either
+ * pmfsm::StateBase or pmfsm::StaticStateBase: strong winds drive
+ * it from outdoors to the shelter, and calm ones back out; the
+ * other winds are counted
+ */
+template<bool kIsStatic, class State_, class Fsm_, class Evt_>
+struct BenchCppStateBase {
+    typedef pmfsm::StateBase<Fsm_, Evt_> type;
+};
+
+template<class State_, class Fsm_, class Evt_>
+struct BenchCppStateBase<true, State_, Fsm_, Evt_> {
+    typedef pmfsm::StaticStateBase<State_, Fsm_, Evt_> type;
+};
+
+
+template<bool kIsStatic>
+class BenchWorldFsm : public pmfsm::StateMachineBase {
+
+ public:
+
+     BenchWorldFsm()
+     : StateMachineBase("BenchWorldFsm"), outdoors("outdoors"),
+       shelter("shelter"), numGusts(0)
+     {
+         FsmInsertState(this, &outdoors, NULL/*pParent*/);
+         FsmInsertState(this, &shelter, NULL/*pParent*/);
+     }
+
+ public:
+
+     class Event : public FsmEvent {
+     public:
+         explicit Event(int id)
+         {
+             evtId = id;
+         }
+
+         float mph; ///< Wind speed in miles per hour
+     };
+
+
+     class OutdoorsState : public BenchCppStateBase<
+         kIsStatic, OutdoorsState, BenchWorldFsm, Event>::type {
+
+      public:
+         explicit OutdoorsState(const char* pName)
+         : BenchCppStateBase<kIsStatic, OutdoorsState, BenchWorldFsm,
+                             Event>::type(pName)
+         {
+         }
+
+         bool OnFsmEvent(const Event* pEvt, BenchWorldFsm* pFsm)
+         {
+             if (kBenchSig_poke == pEvt->evtId) {
+                 if (pEvt->mph > 15) {
+                     FsmBeginTransition(pFsm, &pFsm->shelter);
+                 }
+                 else {
+                     pFsm->numGusts++;
+                 }
+                 return true;
+             }
+
+             return false;
+         }
+     }; /// class OutdoorsState
+
+
+     class ShelterState : public BenchCppStateBase<
+         kIsStatic, ShelterState, BenchWorldFsm, Event>::type {
+
+      public:
+         explicit ShelterState(const char* pName)
+         : BenchCppStateBase<kIsStatic, ShelterState, BenchWorldFsm,
+                             Event>::type(pName)
+         {
+         }
+
+         bool OnFsmEvent(const Event* pEvt, BenchWorldFsm* pFsm)
+         {
+             if (kBenchSig_poke == pEvt->evtId) {
+                 if (pEvt->mph < 5) {
+                     FsmBeginTransition(pFsm, &pFsm->outdoors);
+                 }
+                 else {
+                     pFsm->numGusts++;
+                 }
+                 return true;
+             }
+
+             return false;
+         }
+     }; /// class ShelterState
+
+ public:
+     OutdoorsState       outdoors;
+
+     ShelterState        shelter;
+
+     unsigned int        numGusts;
+
+}; /// class BenchWorldFsm
+
+
+/**
+ * The world FSM with pmfsm::FunctorState states built from
+ * lambdas
+ */
+class BenchLambdaWorldFsm : public pmfsm::StateMachineBase {
+
+ public:
+
+     typedef BenchWorldFsm<true>::Event Event;
+
+     typedef pmfsm::FunctorState<BenchLambdaWorldFsm, Event> State;
+
+     BenchLambdaWorldFsm()
+     : StateMachineBase("BenchLambdaWorldFsm"),
+       outdoors("outdoors", [](const Event& evt, BenchLambdaWorldFsm& fsm) {
+           if (kBenchSig_poke == evt.evtId) {
+               if (evt.mph > 15) {
+                   FsmBeginTransition(&fsm, &fsm.shelter);
+               }
+               else {
+                   fsm.numGusts++;
+               }
+               return true;
+           }
+           return false;
+       }),
+       shelter("shelter", [](const Event& evt, BenchLambdaWorldFsm& fsm) {
+           if (kBenchSig_poke == evt.evtId) {
+               if (evt.mph < 5) {
+                   FsmBeginTransition(&fsm, &fsm.outdoors);
+               }
+               else {
+                   fsm.numGusts++;
+               }
+               return true;
+           }
+           return false;
+       }),
+       numGusts(0)
+     {
+         FsmInsertState(this, &outdoors, NULL/*pParent*/);
+         FsmInsertState(this, &shelter, NULL/*pParent*/);
+     }
+
+ public:
+     State               outdoors;
+
+     State               shelter;
+
+     unsigned int        numGusts;
+
+}; /// class BenchLambdaWorldFsm
+
+
+/**
+ * Runs the given world FSM
+ *
+ * @return double elapsed seconds
+ */
+template<class World_>
+static double
+BenchRunWorld(unsigned int numEvents, unsigned int* pNumGusts)
+{
+    World_                                          world;
+    typename World_::Event                          evt(kBenchSig_poke);
+    static const float                              kMph[8] = {
+        10, 20, 10, 10, 2, 10, 10, 10
+    };
+    clock_t                                         start;
+    unsigned int                                    i;
+
+    FsmStart(&world, &world.outdoors);
+
+    start = clock();
+    for (i = 0; i < numEvents; ++i) {
+        evt.mph = kMph[i & 7];
+        FsmDispatchEvent(&world, &evt);
+    }
+
+    *pNumGusts = world.numGusts;
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+/**
+ * The C++ adapter's state bases: pmfsm::StateBase (a trampoline
+ * plus a virtual call per delivery) vs. pmfsm::StaticStateBase
+ * (a direct, inlined call) vs. pmfsm::FunctorState (the lambda
+ * inlined into its trampoline)
+ */
+static void
+BenchCplusplusStates()
+{
+    const unsigned int  kNumEvents = 20000000;
+    unsigned int        numGustsVirtual, numGustsStatic, numGustsLambda;
+    double              secsVirtual, secsStatic, secsLambda;
+
+    printf("C++ state base (2 states):\n");
+
+    secsVirtual = BenchRunWorld<BenchWorldFsm<false> >(kNumEvents,
+                                                       &numGustsVirtual);
+    secsStatic = BenchRunWorld<BenchWorldFsm<true> >(kNumEvents,
+                                                     &numGustsStatic);
+    secsLambda = BenchRunWorld<BenchLambdaWorldFsm>(kNumEvents,
+                                                    &numGustsLambda);
+
+    printf("  %-40s %8.0f dispatches/sec\n", "pmfsm::StateBase",
+           secsVirtual > 0 ? kNumEvents / secsVirtual : 0.0);
+    printf("  %-40s %8.0f dispatches/sec\n", "pmfsm::StaticStateBase",
+           secsStatic > 0 ? kNumEvents / secsStatic : 0.0);
+    printf("  %-40s %8.0f dispatches/sec\n", "pmfsm::FunctorState",
+           secsLambda > 0 ? kNumEvents / secsLambda : 0.0);
+
+    if (numGustsVirtual != numGustsStatic ||
+        numGustsLambda != numGustsStatic) {
+        printf("  ERROR: %u gusts with StateBase vs. %u with StaticStateBase "
+               "and %u with FunctorState\n", numGustsVirtual, numGustsStatic,
+               numGustsLambda);
+    }
+}
+
+
+/**
+ * Allocation counting for the event holder benchmark: the global
+ * operator new counts the allocations of the whole test
+ * application, which the benchmark samples around its loops
+ */
+static unsigned long gBenchNumAllocs = 0;
+
+
+void*
+operator new(size_t size)
+{
+    void* p = malloc(size ? size : 1);
+
+    if (!p) {
+        throw std::bad_alloc();
+    }
+
+    gBenchNumAllocs++;
+    return p;
+}
+
+
+void
+operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+
+void
+operator delete(void* p, size_t /*size*/) noexcept
+{
+    free(p);
+}
+
+
+/**
+ * The event holder benchmark's state machine: its only state
+ * consumes lines, whose text (longer than a string's inline
+ * buffer) it receives by reference
+ */
+class BenchLineFsm : public pmfsm::StateMachineBase {
+
+ public:
+
+     struct LineEvt : public pmfsm::TypedEvent<kBenchSig_poke> {
+         std::string    text;
+     };
+
+     typedef pmfsm::EventList<LineEvt> Events;
+
+
+     BenchLineFsm()
+     : StateMachineBase("BenchLineFsm"), reader("reader"), numChars(0)
+     {
+         FsmInsertState(this, &reader, NULL/*pParent*/);
+     }
+
+
+     class ReaderState
+         : public pmfsm::TypedStateBase<ReaderState, BenchLineFsm, Events> {
+      public:
+         explicit ReaderState(const char* pName)
+         : TypedStateBase(pName)
+         {
+         }
+
+         bool On(const LineEvt& evt, BenchLineFsm* pFsm)
+         {
+             pFsm->numChars += evt.text.size();
+             return true;
+         }
+     }; /// class ReaderState
+
+ public:
+     ReaderState         reader;
+
+     unsigned long       numChars;
+
+}; /// class BenchLineFsm
+
+
+/**
+ * Lines queued between a producer and the state machine, either
+ * the way C++ users have had to, copying each event into a heap
+ * object, or in pmfsm::EventHolder's: the producer moves each
+ * line into a ring of holders and gets it back after dispatch, so
+ * that the same strings travel around without being copied
+ */
+static void
+BenchEventHolder()
+{
+    const unsigned int  kNumLines = 16;
+    const unsigned int  kNumEvents = 10000000;
+
+    BenchLineFsm                    fsmHeap, fsmHolder;
+    BenchLineFsm::LineEvt           aLines[kNumLines];
+    BenchLineFsm::LineEvt*          apQueue[kNumLines];
+    pmfsm::EventHolder<>            aHolders[kNumLines];
+    unsigned long                   numAllocsHeap, numAllocsHolder;
+    clock_t                         start;
+    double                          secsHeap, secsHolder;
+    unsigned int                    i, j;
+
+    printf("C++ event payloads (%u-event queue):\n", kNumLines);
+
+    for (i = 0; i < kNumLines; ++i) {
+        aLines[i].text.assign(40 + i, 'a' + i);
+    }
+
+    FsmStart(&fsmHeap, &fsmHeap.reader);
+    FsmStart(&fsmHolder, &fsmHolder.reader);
+
+    numAllocsHeap = gBenchNumAllocs;
+    start = clock();
+    for (i = 0; i < kNumEvents; i += kNumLines) {
+        for (j = 0; j < kNumLines; ++j) {
+            apQueue[j] = new BenchLineFsm::LineEvt(aLines[j]);
+        }
+        for (j = 0; j < kNumLines; ++j) {
+            FsmDispatchEvent(&fsmHeap, apQueue[j]);
+            delete apQueue[j];
+        }
+    }
+    secsHeap = (double)(clock() - start) / CLOCKS_PER_SEC;
+    numAllocsHeap = gBenchNumAllocs - numAllocsHeap;
+
+    numAllocsHolder = gBenchNumAllocs;
+    start = clock();
+    for (i = 0; i < kNumEvents; i += kNumLines) {
+        for (j = 0; j < kNumLines; ++j) {
+            aHolders[j] = std::move(aLines[j]);
+        }
+        for (j = 0; j < kNumLines; ++j) {
+            FsmDispatchEvent(&fsmHolder, aHolders[j].Get());
+            aLines[j] = std::move(
+                static_cast<BenchLineFsm::LineEvt&>(*aHolders[j].Get()));
+            aHolders[j].Reset();
+        }
+    }
+    secsHolder = (double)(clock() - start) / CLOCKS_PER_SEC;
+    numAllocsHolder = gBenchNumAllocs - numAllocsHolder;
+
+    printf("  %-40s %8.0f dispatches/sec %6.2f allocs/event\n",
+           "heap-allocated copies",
+           secsHeap > 0 ? kNumEvents / secsHeap : 0.0,
+           (double)numAllocsHeap / kNumEvents);
+    printf("  %-40s %8.0f dispatches/sec %6.2f allocs/event\n",
+           "pmfsm::EventHolder",
+           secsHolder > 0 ? kNumEvents / secsHolder : 0.0,
+           (double)numAllocsHolder / kNumEvents);
+
+    if (fsmHolder.numChars != fsmHeap.numChars) {
+        printf("  ERROR: %lu chars with heap-allocated copies vs. %lu with "
+               "EventHolder\n", fsmHeap.numChars, fsmHolder.numChars);
+    }
+
+    if (numAllocsHolder != 0) {
+        printf("  ERROR: %lu allocations with EventHolder\n",
+               numAllocsHolder);
+    }
+}
+
+
+int
+BenchmarkTest()
+{
+    /// Keep the scheduler from migrating the benchmarks between CPUs
+#ifdef __linux__
+    {
+        cpu_set_t   cpus;
+        int         cpu = sched_getcpu();
+
+        if (cpu >= 0) {
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            (void)sched_setaffinity(0, sizeof(cpus), &cpus);
+        }
+    }
+#endif
+
+    BenchSealed();
+    BenchProfileGuidedLayout();
+    BenchSubscriptions();
+    BenchFlat();
+    BenchStateFlags();
+    BenchIsInState();
+    BenchDeep();
+    BenchHeaderOnly();
+    BenchCplusplusStates();
+    BenchEventHolder();
+    BenchByteStream();
+    BenchInstances();
+    BenchStartup();
+    BenchConstTopology();
+    BenchDefinitionImage();
+    BenchLiveDefinition();
+    BenchGenerated();
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ * ****************************************************************************
+ * @file BenchmarkHeaderOnly.cpp
+ *
+ * @brief  Runs the dispatch workload against the header-only
+ *         (amalgamated) engine; @see BenchmarkTest() for the
+ *         comparison with the shared library.
+ *
+ * ****************************************************************************
+ */
+
+#include <stdio.h>
+
+#include <PmStateMachineEngine/PalmFsmHeaderOnly.h>
+
+#include "TestCommon.h"
+#include "BenchDispatchWorkload.h"
+
+
+double
+BenchHeaderOnlyDispatchSecs(unsigned int numEvents)
+{
+    return BenchWorkloadRun(numEvents);
+}
@@ -0,0 +1,264 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ * ****************************************************************************
+ * @file CodegenTest.cpp
+ *
+ * @brief  Differential test of generated dispatch code (@see
+ *         tools/fsmgen): drives two instances of the GenTest
+ *         statechart (GenTestFsm.json) with the same pseudo-random
+ *         events, one via FsmDispatchEvent() and the other via
+ *         the generated GenTestDispatchEvent(), and compares the
+ *         traces of their handler, guard and action calls.
+ *
+ * The handlers make pseudo-random (but reproducible) decisions:
+ * they pass events on to the parent states, request state
+ * transitions, and take initial transitions, so that the random
+ * walks cover the engine's dispatch and transition semantics.
+ * ****************************************************************************
+ */
+
+#include <stdio.h>
+
+#include <vector>
+
+#include <PmStateMachineEngine/PalmFsm.h>
+#include <PmStateMachineEngine/PalmFsmDbg.h>
+#include <PmStateMachineEngine/PalmFsmImage.h>
+
+#include "GenTestFsm.h"
+#include "TestCommon.h"
+
+
+#undef TRUE
+#define TRUE 1
+
+#undef FALSE
+#define FALSE 0
+
+
+#define GEN_TEST_STATE(id__) FSM_CONST_USER_STATE(kGenTestTopology, id__)
+
+
+/**
+ * An instance's context
+ */
+struct GenTestCtx {
+    unsigned int        rng;    ///< drives the handlers' decisions
+    std::vector<int>    trace;  ///< calls, 4 entries each
+};
+
+
+enum GenTestCallKind {
+    kGenTestCall_handler,
+    kGenTestCall_guard,
+    kGenTestCall_action
+};
+
+
+static unsigned int
+GenTestRand(unsigned int* pRng)
+{
+    *pRng = *pRng * 1103515245 + 12345;
+    return *pRng >> 16;
+}
+
+
+static int
+GenTestStateId(const FsmState* pState)
+{
+    return pState ? (int)((const FsmConstState*)pState -
+                          kGenTestTopology.aStates_) : 0;
+}
+
+
+/**
+ * Records the call in the instance's trace, along with the
+ * current state that the callee sees; returns a pseudo-random
+ * number for the callee's decisions
+ */
+static unsigned int
+GenTestRecord(FsmMachine* pFsm, GenTestCallKind kind, FsmState* pState,
+              const FsmEvent* pEvt)
+{
+    GenTestCtx* pCtx = (GenTestCtx*)FsmGetInstanceContext(pFsm);
+
+    pCtx->trace.push_back(kind);
+    pCtx->trace.push_back(GenTestStateId(pState));
+    pCtx->trace.push_back(pEvt->evtId);
+    pCtx->trace.push_back(GenTestStateId(FsmDbgPeekCurrentState(pFsm)));
+
+    return GenTestRand(&pCtx->rng);
+}
+
+
+int
+GenTestHandler(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    unsigned int    r = GenTestRecord(pFsm, kGenTestCall_handler, pState,
+                                      pEvt);
+    FsmState*       pTarget = GEN_TEST_STATE(1 + r % kGenTestNumStates);
+
+    switch (pEvt->evtId) {
+    case kFsmEventEnterScope:
+    case kFsmEventExitScope:
+        return r & 1;
+
+    case kFsmEventBegin:
+        /// Initial transition to a proper descendant, if one was drawn
+        if (pTarget != pState && FsmIsAncestor(pState, pTarget)) {
+            FsmBeginTransition(pFsm, pTarget);
+        }
+        return TRUE;
+
+    default:
+        switch ((r >> 8) & 3) {
+        case 0:
+            return FALSE;
+        case 1:
+            FsmBeginTransition(pFsm, pTarget);
+            return TRUE;
+        default:
+            return TRUE;
+        }
+    }
+}
+
+
+int
+GenTestLeafHandler(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    /// Leaves pass most user events on to their parents
+    if (pEvt->evtId >= kFsmEventFirstUserEvent &&
+        (GenTestRecord(pFsm, kGenTestCall_handler, pState, pEvt) & 1)) {
+        return FALSE;
+    }
+
+    return GenTestHandler(pState, pFsm, pEvt);
+}
+
+
+int
+GenTestGuard(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    return GenTestRecord(pFsm, kGenTestCall_guard, pState, pEvt) & 1;
+}
+
+
+void
+GenTestAction(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    (void)GenTestRecord(pFsm, kGenTestCall_action, pState, pEvt);
+}
+
+
+/**
+ * Prints the first difference between the traces
+ */
+static void
+GenTestReportMismatch(unsigned int run, unsigned int step,
+                      const GenTestCtx& engineCtx, const GenTestCtx& genCtx)
+{
+    size_t i = 0;
+
+    while (i < engineCtx.trace.size() && i < genCtx.trace.size() &&
+           engineCtx.trace[i] == genCtx.trace[i]) {
+        ++i;
+    }
+
+    printf("CodegenTest: MISMATCH in run %u at event %u, trace entry %u " \
+           "of %u vs. %u\n", run, step, (unsigned int)(i / 4),
+           (unsigned int)(engineCtx.trace.size() / 4),
+           (unsigned int)(genCtx.trace.size() / 4));
+}
+
+
+int
+CodegenTest()
+{
+    const unsigned int  kNumRuns = 500;
+    const unsigned int  kNumEvents = 500;
+
+    FsmDefinition       def;
+    FsmInstance         engineFsm, genFsm;
+    GenTestCtx          engineCtx, genCtx;
+    unsigned int        numMismatches = 0;
+    unsigned long       numCalls = 0;
+    unsigned int        run, i;
+
+    GenTestInitDefinition(&def);
+
+    /// The names of the topology's states are kept apart from their
+    /// records; each one finds its state again
+    for (i = 1; i <= kGenTestNumStates; ++i) {
+        const char* pName = FsmDbgPeekStateName(GEN_TEST_STATE(i));
+
+        if (FsmFindDefinitionState(&def, pName) != GEN_TEST_STATE(i)) {
+            printf("CodegenTest: ERROR: state %u's name \"%s\" doesn't "
+                   "find it\n", i, pName);
+            return -1;
+        }
+    }
+
+    for (run = 0; run < kNumRuns; ++run) {
+        unsigned int    evtRng = run;
+        FsmState*       pStart = GEN_TEST_STATE(1 + run % kGenTestNumStates);
+
+        engineCtx.rng = genCtx.rng = run;
+        engineCtx.trace.clear();
+        genCtx.trace.clear();
+
+        FsmInitInstance(&engineFsm, &def, &engineCtx);
+        FsmInitInstance(&genFsm, &def, &genCtx);
+
+        FsmStart(FSM_INSTANCE_MACHINE(&engineFsm), pStart);
+        FsmStart(FSM_INSTANCE_MACHINE(&genFsm), pStart);
+
+        for (i = 0; i < kNumEvents; ++i) {
+            /// Include an event that the statechart doesn't name
+            FsmEvent    evt = {(FsmEventIdType)(kGenTestSig_a +
+                                                GenTestRand(&evtRng) % 6)};
+            int         isHandledByEngine;
+            int         isHandledByGen;
+
+            isHandledByEngine =
+                FsmDispatchEvent(FSM_INSTANCE_MACHINE(&engineFsm), &evt);
+            isHandledByGen =
+                GenTestDispatchEvent(FSM_INSTANCE_MACHINE(&genFsm), &evt);
+
+            if (isHandledByEngine != isHandledByGen ||
+                engineCtx.trace != genCtx.trace ||
+                GenTestStateId(FsmDbgPeekCurrentState(
+                    FSM_INSTANCE_MACHINE(&engineFsm))) !=
+                GenTestStateId(FsmDbgPeekCurrentState(
+                    FSM_INSTANCE_MACHINE(&genFsm)))) {
+                GenTestReportMismatch(run, i, engineCtx, genCtx);
+                ++numMismatches;
+                break;
+            }
+        }
+
+        numCalls += engineCtx.trace.size() / 4;
+    }
+
+    printf("CodegenTest: %u runs of %u events, %lu calls, %u mismatches\n",
+           kNumRuns, kNumEvents, numCalls, numMismatches);
+
+    return numMismatches ? -1 : 0;
+}
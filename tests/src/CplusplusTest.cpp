@@ -28,6 +28,11 @@
  * ****************************************************************************
  */
 
+#include <stdio.h>
+
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <PmStateMachineEngine/Cplusplus/PalmFsm.hpp>
 #include <PmStateMachineEngine/PalmFsm.h>
@@ -136,6 +141,518 @@ class MyWorldFsm : public pmfsm::StateMachineBase {
 }; /// class MyWorldFsm
 
 
+/**
+ * Differential test of pmfsm::StaticHsm: drives a StaticHsm and
+ * an equivalent engine FSM (made of pmfsm::StateBase states) with
+ * the same pseudo-random transition requests, and compares the
+ * traces of their entry and exit actions
+ *
+ * Topology (initial substates marked with *):
+ *
+ *   a (1)
+ *     a1 (2) *
+ *     a2 (3)
+ *       a2a (4) *
+ *       a2b (5)
+ *   b (6)
+ */
+struct CplusTraceEvt : public FsmEvent {
+    int src;    ///< id of the state that takes the transition
+    int target; ///< id of the transition's target state
+};
+
+enum {
+    kCplusTraceEvtId = kFsmEventFirstUserEvent,
+    kCplusTraceNumStates = 6
+};
+
+
+class StaticTraceHsm : public pmfsm::StaticHsm<StaticTraceHsm, CplusTraceEvt> {
+ public:
+     struct A;
+     struct A1;
+     struct A2;
+     struct A2a;
+     struct A2b;
+     struct B;
+
+     template<int kId_, class Parent_, class Initial_ = void>
+     struct TraceState : public pmfsm::StaticHsmState<Parent_, Initial_> {
+         static void OnEnter(StaticTraceHsm& fsm)
+         {
+             fsm.trace.push_back(kId_);
+         }
+
+         static void OnExit(StaticTraceHsm& fsm)
+         {
+             fsm.trace.push_back(-kId_);
+         }
+
+         template<class Context_>
+         static bool OnEvent(Context_& ctx, const CplusTraceEvt& evt)
+         {
+             if (evt.src != kId_) {
+                 return false;
+             }
+
+             switch (evt.target) {
+             case 1: ctx.template Transition<A>(); break;
+             case 2: ctx.template Transition<A1>(); break;
+             case 3: ctx.template Transition<A2>(); break;
+             case 4: ctx.template Transition<A2a>(); break;
+             case 5: ctx.template Transition<A2b>(); break;
+             case 6: ctx.template Transition<B>(); break;
+             }
+
+             return true;
+         }
+     };
+
+     struct A : public TraceState<1, pmfsm::StaticHsmTop, A1> {};
+     struct A1 : public TraceState<2, A> {};
+     struct A2 : public TraceState<3, A, A2a> {};
+     struct A2a : public TraceState<4, A2> {};
+     struct A2b : public TraceState<5, A2> {};
+     struct B : public TraceState<6, pmfsm::StaticHsmTop> {};
+
+     /// Returns IsInState() of the state with the given id
+     bool IsInStateId(int id) const
+     {
+         switch (id) {
+         case 1: return IsInState<A>();
+         case 2: return IsInState<A1>();
+         case 3: return IsInState<A2>();
+         case 4: return IsInState<A2a>();
+         case 5: return IsInState<A2b>();
+         case 6: return IsInState<B>();
+         }
+         return false;
+     }
+
+     std::vector<int>    trace;
+};
+
+
+class EngineTraceFsm : public pmfsm::StateMachineBase {
+ public:
+     class TraceState : public pmfsm::StateBase<EngineTraceFsm, CplusTraceEvt> {
+      public:
+         TraceState(const char* pName, int id)
+         : StateBase(pName), id_(id)
+         {
+         }
+
+         bool OnFsmEvent(const CplusTraceEvt* pEvt, EngineTraceFsm* pFsm)
+         {
+             switch (pEvt->evtId) {
+             case kFsmEventEnterScope:
+                 pFsm->trace.push_back(id_);
+                 return true;
+             case kFsmEventExitScope:
+                 pFsm->trace.push_back(-id_);
+                 return true;
+             case kCplusTraceEvtId:
+                 if (pEvt->src != id_) {
+                     return false;
+                 }
+                 FsmBeginTransition(pFsm, pFsm->apStates[pEvt->target]);
+                 return true;
+             }
+             return false;
+         }
+
+      private:
+         int id_;
+     };
+
+     EngineTraceFsm()
+     : StateMachineBase("EngineTraceFsm"), a("a", 1), a1("a1", 2),
+       a2("a2", 3), a2a("a2a", 4), a2b("a2b", 5), b("b", 6)
+     {
+         apStates[0] = NULL;
+         apStates[1] = &a;
+         apStates[2] = &a1;
+         apStates[3] = &a2;
+         apStates[4] = &a2a;
+         apStates[5] = &a2b;
+         apStates[6] = &b;
+
+         FsmInsertState(this, &a, NULL);
+         FsmInsertState(this, &a1, &a);
+         FsmInsertState(this, &a2, &a);
+         FsmInsertState(this, &a2a, &a2);
+         FsmInsertState(this, &a2b, &a2);
+         FsmInsertState(this, &b, NULL);
+         FsmSetInitialSubstate(&a, &a1);
+         FsmSetInitialSubstate(&a2, &a2a);
+     }
+
+     TraceState          a, a1, a2, a2a, a2b, b;
+     FsmState*           apStates[kCplusTraceNumStates + 1];
+     std::vector<int>    trace;
+};
+
+
+static int
+StaticHsmTest()
+{
+    const unsigned int  kNumEvents = 10000;
+
+    StaticTraceHsm      hsm;
+    EngineTraceFsm      fsm;
+    CplusTraceEvt       evt;
+    unsigned int        rng = 1;
+    unsigned int        i;
+    int                 id;
+
+    evt.evtId = kCplusTraceEvtId;
+
+    hsm.Start<StaticTraceHsm::A>();
+    FsmStart(&fsm, &fsm.a);
+
+    for (i = 0; i < kNumEvents; ++i) {
+        bool isHandledStatic, isHandledEngine;
+
+        rng = rng * 1103515245 + 12345;
+        evt.src = (rng >> 16) % kCplusTraceNumStates + 1;
+        evt.target = (rng >> 24) % kCplusTraceNumStates + 1;
+
+        isHandledStatic = hsm.DispatchEvent(evt);
+        isHandledEngine = FsmDispatchEvent(&fsm, &evt);
+
+        for (id = 1; id <= kCplusTraceNumStates; ++id) {
+            if (hsm.IsInStateId(id) != !!FsmIsInState(&fsm, fsm.apStates[id])) {
+                break;
+            }
+        }
+
+        if (isHandledStatic != isHandledEngine || id <= kCplusTraceNumStates ||
+            hsm.trace != fsm.trace) {
+            printf("StaticHsmTest: MISMATCH at event %u (%d -> %d)\n", i,
+                   evt.src, evt.target);
+            return -1;
+        }
+    }
+
+    printf("StaticHsmTest: %u events, %u entry/exit actions\n", kNumEvents,
+           (unsigned int)hsm.trace.size());
+
+    return 0;
+}
+
+
+/// MyWorldFsm with typed events (@see pmfsm::TypedStateBase)
+class TypedWorldFsm : public pmfsm::StateMachineBase {
+
+ public:
+
+     enum MyEventIds {
+         kMyEvtIdWind = kFsmEventFirstUserEvent,
+         kMyEvtIdHail,  ///< Not in MyEvents: no state handles it
+         kMyEvtIdSun,   ///< Nobody has an On() overload for it
+         kMyEvtIdRain
+     };
+
+     struct WindEvt : public pmfsm::TypedEvent<kMyEvtIdWind> {
+         float mph; ///< Wind speed in miles per hour
+     };
+
+     struct SunEvt : public pmfsm::TypedEvent<kMyEvtIdSun> {
+     };
+
+     struct RainEvt : public pmfsm::TypedEvent<kMyEvtIdRain> {
+         float in;  ///< Rain in inches
+     };
+
+     typedef pmfsm::EventList<WindEvt, SunEvt, RainEvt> MyEvents;
+
+
+     TypedWorldFsm()
+     : StateMachineBase("TypedWorldFsm"), outdoors("outdoors"),
+       porch("porch"), shelter("shelter"), numCalls(0), numPorchEntries(0)
+     {
+         FsmInsertState(this, &outdoors, NULL/*pParent*/);
+         FsmInsertState(this, &porch, &outdoors);
+         FsmInsertState(this, &shelter, NULL/*pParent*/);
+     }
+
+
+     class OutdoorsState
+         : public pmfsm::TypedStateBase<OutdoorsState, TypedWorldFsm,
+                                        MyEvents> {
+      public:
+         explicit OutdoorsState(const char* pName)
+         : TypedStateBase(pName)
+         {
+         }
+
+         bool On(const WindEvt& evt, TypedWorldFsm* pFsm)
+         {
+             ++pFsm->numCalls;
+             if (evt.mph > 15) {
+                 FsmBeginTransition(pFsm, &pFsm->shelter);
+             }
+             return true;
+         }
+
+         bool On(const RainEvt& evt, TypedWorldFsm* pFsm)
+         {
+             ++pFsm->numCalls;
+             if (evt.in > 2) {
+                 FsmBeginTransition(pFsm, &pFsm->shelter);
+             }
+             return true;
+         }
+     }; /// class OutdoorsState
+
+
+     /// Handles only rain: wind falls through to outdoors
+     class PorchState
+         : public pmfsm::TypedStateBase<PorchState, TypedWorldFsm,
+                                        MyEvents> {
+      public:
+         explicit PorchState(const char* pName)
+         : TypedStateBase(pName)
+         {
+         }
+
+         bool On(const pmfsm::EnterEvt&, TypedWorldFsm* pFsm)
+         {
+             ++pFsm->numPorchEntries;
+             return true;
+         }
+
+         bool On(const RainEvt& evt, TypedWorldFsm* pFsm)
+         {
+             ++pFsm->numCalls;
+             return evt.in > 0;
+         }
+     }; /// class PorchState
+
+
+     /// Handles nothing
+     class ShelterState
+         : public pmfsm::TypedStateBase<ShelterState, TypedWorldFsm,
+                                        MyEvents> {
+      public:
+         explicit ShelterState(const char* pName)
+         : TypedStateBase(pName)
+         {
+         }
+     }; /// class ShelterState
+
+ public:
+     OutdoorsState       outdoors;
+
+     PorchState          porch;
+
+     ShelterState        shelter;
+
+     unsigned int        numCalls;       ///< Calls of user event handlers
+
+     unsigned int        numPorchEntries;
+
+}; /// class TypedWorldFsm
+
+
+static int
+TypedEventTest()
+{
+    TypedWorldFsm           world;
+    TypedWorldFsm::WindEvt  wind;
+    TypedWorldFsm::SunEvt   sun;
+    TypedWorldFsm::RainEvt  rain;
+    FsmEvent                hail;
+
+    hail.evtId = TypedWorldFsm::kMyEvtIdHail;
+
+    FsmStart(&world, &world.porch);
+
+    wind.mph = 5;
+    rain.in = 0;
+
+    // porch handles rain; wind falls through to outdoors, while
+    // hail and sun aren't handled at all
+    if (!FsmDispatchEvent(&world, &wind) || world.numCalls != 1 ||
+        FsmDispatchEvent(&world, &hail) || world.numCalls != 1 ||
+        FsmDispatchEvent(&world, &sun) || world.numCalls != 1 ||
+        !FsmDispatchEvent(&world, &rain) || world.numCalls != 3 ||
+        !FsmIsInState(&world, &world.porch) || world.numPorchEntries != 1) {
+        printf("TypedEventTest: ERROR dispatching in porch\n");
+        return -1;
+    }
+
+    rain.in = 3;
+    if (!FsmDispatchEvent(&world, &rain) || world.numCalls != 4 ||
+        !FsmIsInState(&world, &world.porch)) {
+        printf("TypedEventTest: ERROR handling rain in porch\n");
+        return -1;
+    }
+
+    wind.mph = 100;
+    if (!FsmDispatchEvent(&world, &wind) || world.numCalls != 5 ||
+        !FsmIsInState(&world, &world.shelter)) {
+        printf("TypedEventTest: ERROR transitioning to shelter\n");
+        return -1;
+    }
+
+    if (FsmDispatchEvent(&world, &wind) || FsmDispatchEvent(&world, &rain) ||
+        world.numCalls != 5) {
+        printf("TypedEventTest: ERROR dispatching in shelter\n");
+        return -1;
+    }
+
+    printf("TypedEventTest: OK\n");
+
+    return 0;
+}
+
+
+/// A wind event too big for an EventHolder's inline storage
+struct CplusGaleEvt : public TypedWorldFsm::WindEvt {
+    char    report[2 * PMFSM_EVENT_HOLDER_CAPACITY];
+};
+
+
+static int
+EventHolderTest()
+{
+    TypedWorldFsm               world;
+    TypedWorldFsm::RainEvt      rain;
+    CplusGaleEvt                gale;
+    pmfsm::EventHolder<>        aQueue[3];
+    pmfsm::EventHolder<>        forwarded;
+    unsigned int                i;
+
+    FsmStart(&world, &world.porch);
+
+    rain.in = 1;
+    gale.mph = 100;
+    aQueue[0] = std::move(rain);
+    aQueue[1].Emplace<TypedWorldFsm::WindEvt>().mph = 5;
+    aQueue[2] = std::move(gale);
+
+    if (!aQueue[0].IsHeldInline() || !aQueue[1].IsHeldInline() ||
+        aQueue[2].IsHeldInline()) {
+        printf("EventHolderTest: ERROR in event storage\n");
+        return -1;
+    }
+
+    for (i = 0; i < 3; ++i) {
+        // Forward each event to another holder before dispatching it
+        forwarded = std::move(aQueue[i]);
+        if (!aQueue[i].IsEmpty() ||
+            !FsmDispatchEvent(&world, forwarded.Get())) {
+            printf("EventHolderTest: ERROR dispatching event %u\n", i);
+            return -1;
+        }
+    }
+
+    if (world.numCalls != 3 || !FsmIsInState(&world, &world.shelter)) {
+        printf("EventHolderTest: ERROR in handled events\n");
+        return -1;
+    }
+
+    printf("EventHolderTest: OK\n");
+
+    return 0;
+}
+
+
+/// MyWorldFsm with states built from lambdas (@see pmfsm::FunctorState)
+class LambdaWorldFsm : public pmfsm::StateMachineBase {
+
+ public:
+
+     typedef pmfsm::FunctorState<LambdaWorldFsm, MyWorldFsm::Event> State;
+
+     LambdaWorldFsm()
+     : StateMachineBase("LambdaWorldFsm"),
+       outdoors("outdoors",
+                [](const MyWorldFsm::Event& evt, LambdaWorldFsm& fsm) {
+                    if (MyWorldFsm::kMyEvtIdWind == evt.evtId) {
+                        if (evt.wind.mph > 15) {
+                            FsmBeginTransition(&fsm, &fsm.shelter);
+                        }
+                        return true;
+                    }
+                    return false;
+                }),
+       shelter(pmfsm::make_state<LambdaWorldFsm, MyWorldFsm::Event>(
+                   "shelter",
+                   [this](const MyWorldFsm::Event& evt, LambdaWorldFsm&) {
+                       if (kFsmEventEnterScope == evt.evtId) {
+                           ++numShelterEntries;
+                       }
+                       return false;
+                   })),
+       numShelterEntries(0)
+     {
+         FsmInsertState(this, &outdoors, NULL/*pParent*/);
+         FsmInsertState(this, &shelter, NULL/*pParent*/);
+     }
+
+ public:
+     State               outdoors;
+
+     State               shelter;
+
+     unsigned int        numShelterEntries;
+
+}; /// class LambdaWorldFsm
+
+
+static int
+FunctorStateTest()
+{
+    LambdaWorldFsm      world;
+    MyWorldFsm::Event   wind(MyWorldFsm::kMyEvtIdWind);
+    MyWorldFsm::Event   rain(MyWorldFsm::kMyEvtIdRain);
+    FsmMachine          fsm;
+
+    FsmStart(&world, &world.outdoors);
+
+    wind.wind.mph = 5;
+    rain.rain.in = 3;
+    if (!FsmDispatchEvent(&world, &wind) || FsmDispatchEvent(&world, &rain) ||
+        !FsmIsInState(&world, &world.outdoors)) {
+        printf("FunctorStateTest: ERROR dispatching outdoors\n");
+        return -1;
+    }
+
+    wind.wind.mph = 100;
+    if (!FsmDispatchEvent(&world, &wind) ||
+        !FsmIsInState(&world, &world.shelter) ||
+        world.numShelterEntries != 1) {
+        printf("FunctorStateTest: ERROR transitioning to shelter\n");
+        return -1;
+    }
+
+    {
+        // A callable that owns a string, moved out of make_state()
+        std::string name("idle");
+        auto idle = pmfsm::make_state(
+            "idle", [name](const FsmEvent& evt, FsmMachine&) {
+                return evt.evtId >= kFsmEventFirstUserEvent &&
+                       name == "idle";
+            });
+
+        FsmInitMachine(&fsm, "FunctorFsm");
+        FsmInsertState(&fsm, &idle, NULL/*pParent*/);
+        FsmStart(&fsm, &idle);
+
+        if (!FsmDispatchEvent(&fsm, &wind)) {
+            printf("FunctorStateTest: ERROR dispatching to make_state()\n");
+            return -1;
+        }
+    }
+
+    printf("FunctorStateTest: OK\n");
+
+    return 0;
+}
+
+
 int CplusPlusTest()
 {
      MyWorldFsm     world;
@@ -146,6 +663,18 @@ int CplusPlusTest()
      evt.wind.mph = 100;
      FsmDispatchEvent(&world, &evt);
 
-     return 0;
+     if (TypedEventTest() != 0) {
+         return -1;
+     }
+
+     if (EventHolderTest() != 0) {
+         return -1;
+     }
+
+     if (FunctorStateTest() != 0) {
+         return -1;
+     }
+
+     return StaticHsmTest();
 }
 
@@ -0,0 +1,429 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ * ****************************************************************************
+ * @file ImageTest.cpp
+ *
+ * @brief  Tests of definition images (@see PalmFsmImage.h): a round
+ *         trip from a sealed state machine through its image to a
+ *         loaded definition, whose instances must behave exactly
+ *         like those of the original, and loads of malformed
+ *         images, which must be rejected.
+ *
+ * The malformed images are made by patching a valid one through
+ * the public image format (@see FsmImageHeader).
+ * ****************************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include <PmStateMachineEngine/PalmFsm.h>
+#include <PmStateMachineEngine/PalmFsmDbg.h>
+#include <PmStateMachineEngine/PalmFsmImage.h>
+
+#include "TestCommon.h"
+
+
+#undef TRUE
+#define TRUE 1
+
+#undef FALSE
+#define FALSE 0
+
+
+enum ImageTestUserSignals {
+    kImageSig_go = kFsmEventFirstUserEvent,
+    kImageSig_poke,
+    kImageSig_stop
+};
+
+
+/**
+ * The state machine that the image is written from:
+ *
+ *  root
+ *   +-- idle       subscribes to go and poke; go -> active
+ *   |              (guarded, with an action); poke -> a1 (by the
+ *   |              handler)
+ *   +-- active     initial substate a2; stop -> idle (with an
+ *       |          action)
+ *       +-- a1     kFsmStateFlagNoExit
+ *       +-- a2
+ */
+typedef struct ImageTestFsm {
+    FsmMachine      fsmRep; ///< MUST be first member for C "subclassing"
+
+    FsmState        idle;
+    FsmState        active;
+    FsmState        a1;
+    FsmState        a2;
+} ImageTestFsm;
+
+
+/**
+ * An instance's context: the trace of the calls to its handlers,
+ * guards and actions
+ */
+typedef struct {
+    std::string     trace;
+    unsigned int    numGuardCalls;
+    FsmState*       pA1;    ///< the definition's a1 state object
+} ImageTestContext;
+
+
+static void
+ImageTestRecord(FsmMachine* pFsm, const char* pWhat, const FsmState* pState,
+                const FsmEvent* pEvt)
+{
+    ImageTestContext*   pContext =
+        (ImageTestContext*)FsmGetInstanceContext(pFsm);
+    char                buf[40];
+
+    snprintf(buf, sizeof(buf), "%s:%s:%d ", pWhat, FsmDbgPeekStateName(pState),
+             (int)pEvt->evtId);
+    pContext->trace += buf;
+}
+
+
+static int
+ImageTestHandler(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    ImageTestContext*   pContext =
+        (ImageTestContext*)FsmGetInstanceContext(pFsm);
+
+    ImageTestRecord(pFsm, "h", pState, pEvt);
+
+    if (kImageSig_poke == pEvt->evtId &&
+        0 == strcmp(FsmDbgPeekStateName(pState), "idle")) {
+        FsmBeginTransition(pFsm, pContext->pA1);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+/**
+ * Passes every other call
+ */
+static int
+ImageTestGuard(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    ImageTestContext*   pContext =
+        (ImageTestContext*)FsmGetInstanceContext(pFsm);
+
+    ImageTestRecord(pFsm, "g", pState, pEvt);
+    return (++pContext->numGuardCalls % 2) == 0;
+}
+
+
+static void
+ImageTestAction(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    ImageTestRecord(pFsm, "a", pState, pEvt);
+}
+
+
+static const FsmImageBinding kImageTestBindings[] = {
+    {"handler", &ImageTestHandler, NULL, NULL},
+    {"guard", NULL, &ImageTestGuard, NULL},
+    {"action", NULL, NULL, &ImageTestAction}
+};
+
+static const unsigned int kNumImageTestBindings =
+    sizeof(kImageTestBindings) / sizeof(kImageTestBindings[0]);
+
+static const unsigned int kNumImageTestStates = 4;
+
+
+/**
+ * Starts an instance of the given definition in idle, drives it
+ * with a fixed sequence of events, and returns the trace
+ */
+static std::string
+RunImageTestInstance(const FsmDefinition* pDef)
+{
+    static const FsmEventIdType kEvents[] = {
+        kImageSig_go,       ///< the guard fails: idle's handler gets it
+        kImageSig_go,       ///< idle -> active, which drills down to a2
+        kImageSig_poke,     ///< not handled
+        kImageSig_stop,     ///< active -> idle
+        kImageSig_poke,     ///< idle -> a1 by the handler
+        kImageSig_stop      ///< a1 isn't exited (kFsmStateFlagNoExit)
+    };
+
+    FsmInstance         instance;
+    ImageTestContext    context;
+    unsigned int        i;
+
+    context.numGuardCalls = 0;
+    context.pA1 = FsmFindDefinitionState(pDef, "a1");
+
+    FsmInitInstance(&instance, pDef, &context);
+    FsmStart(FSM_INSTANCE_MACHINE(&instance),
+             FsmFindDefinitionState(pDef, "idle"));
+
+    for (i = 0; i < sizeof(kEvents) / sizeof(kEvents[0]); ++i) {
+        FsmEvent    evt = {kEvents[i]};
+
+        FsmDispatchEvent(FSM_INSTANCE_MACHINE(&instance), &evt);
+    }
+
+    return context.trace;
+}
+
+
+/**
+ * Returns the index of the image's state record of the given name
+ */
+static unsigned int
+FindImageStateRecord(const void* pImage, const char* pName)
+{
+    const FsmImageHeader*      pHeader = (const FsmImageHeader*)pImage;
+    const FsmImageStateRecord* aRecords = (const FsmImageStateRecord*)
+        ((const char*)pImage + pHeader->statesOffset_);
+    const char*                pStrings =
+        (const char*)pImage + pHeader->stringsOffset_;
+    unsigned int               i;
+
+    for (i = 1; i <= pHeader->numStates_; ++i) {
+        if (0 == strcmp(pStrings + aRecords[i].name_, pName)) {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * Loads the given (patched) image into scratch storage
+ * 
+ * @return int the result of FsmLoadDefinitionImage()
+ */
+static int
+LoadImageTestImage(const void* pImage, unsigned int imageSize,
+                   const FsmImageBinding aBindings[], unsigned int numBindings)
+{
+    FsmDefinition       def;
+    FsmSealedState      aStorage[FSM_SEALED_STATE_COUNT(kNumImageTestStates)];
+    FsmTransitionDef    aTransitions[8];
+
+    return FsmLoadDefinitionImage(&def, pImage, imageSize, aBindings,
+                                  numBindings, aStorage,
+                                  sizeof(aStorage) / sizeof(aStorage[0]),
+                                  aTransitions,
+                                  sizeof(aTransitions) /
+                                  sizeof(aTransitions[0]));
+}
+
+
+/**
+ * @return int 0 if the given (patched) image is rejected, as it
+ *         should be; -1 otherwise
+ */
+static int
+ExpectImageRejected(const char* pWhat, const void* pImage,
+                    unsigned int imageSize,
+                    const FsmImageBinding aBindings[],
+                    unsigned int numBindings)
+{
+    if (LoadImageTestImage(pImage, imageSize, aBindings, numBindings)) {
+        printf("ImageTest: ERROR: %s: the image was loaded\n", pWhat);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * ****************************************************************************
+ */
+int
+ImageTest()
+{
+    static const FsmEventIdType kIdleEvents[] = {kImageSig_go, kImageSig_poke};
+
+    ImageTestFsm        fsm;
+    FsmState*           apStates[kNumImageTestStates];
+    FsmSealedState      aSealed[FSM_SEALED_STATE_COUNT(kNumImageTestStates)];
+    FsmSealedState      aLoaded[FSM_SEALED_STATE_COUNT(kNumImageTestStates)];
+    FsmTransitionDef    aLoadedTransitions[2];
+    FsmDefinition       builtDef, loadedDef;
+    unsigned int        aImage[256];
+    unsigned int        aPatched[256];
+    unsigned int        imageSize, numStates, numTransitions;
+    std::string         builtTrace, loadedTrace;
+    int                 result = 0;
+
+    const FsmTransitionDef idleTransitions[] = {
+        {kImageSig_go, &fsm.active, &ImageTestGuard, &ImageTestAction}
+    };
+    const FsmTransitionDef activeTransitions[] = {
+        {kImageSig_stop, &fsm.idle, NULL, &ImageTestAction}
+    };
+
+    /// Build, seal and write the state machine
+    FsmInitMachine(&fsm.fsmRep, "ImageTest");
+    FsmInitState(&fsm.idle, &ImageTestHandler, "idle");
+    FsmInitState(&fsm.active, &ImageTestHandler, "active");
+    FsmInitStateEx(&fsm.a1, &ImageTestHandler, "a1", kFsmStateFlagNoExit);
+    FsmInitState(&fsm.a2, &ImageTestHandler, "a2");
+
+    FsmDeclareStateEvents(&fsm.idle, kIdleEvents, 2);
+    FsmDeclareStateTransitions(&fsm.idle, idleTransitions, 1);
+    FsmDeclareStateTransitions(&fsm.active, activeTransitions, 1);
+    FsmSetInitialSubstate(&fsm.active, &fsm.a2);
+
+    FsmInsertState(&fsm.fsmRep, &fsm.idle, NULL/*pParent*/);
+    FsmInsertState(&fsm.fsmRep, &fsm.active, NULL/*pParent*/);
+    FsmInsertState(&fsm.fsmRep, &fsm.a1, &fsm.active);
+    FsmInsertState(&fsm.fsmRep, &fsm.a2, &fsm.active);
+
+    apStates[0] = &fsm.idle;
+    apStates[1] = &fsm.active;
+    apStates[2] = &fsm.a1;
+    apStates[3] = &fsm.a2;
+    FsmSealMachine(&fsm.fsmRep, apStates, kNumImageTestStates, aSealed,
+                   sizeof(aSealed) / sizeof(aSealed[0]));
+    FsmInitDefinition(&builtDef, &fsm.fsmRep);
+
+    imageSize = FsmWriteDefinitionImage(&fsm.fsmRep, kImageTestBindings,
+                                        kNumImageTestBindings, aImage,
+                                        sizeof(aImage));
+    if (!imageSize || imageSize > sizeof(aImage)) {
+        printf("ImageTest: ERROR: can't write the image (%u bytes)\n",
+               imageSize);
+        return -1;
+    }
+
+    /// Round trip: the loaded definition behaves like the built one
+    if (!FsmGetDefinitionImageInfo(aImage, imageSize, &numStates,
+                                   &numTransitions) ||
+        kNumImageTestStates != numStates || 2 != numTransitions ||
+        !FsmLoadDefinitionImage(&loadedDef, aImage, imageSize,
+                                kImageTestBindings, kNumImageTestBindings,
+                                aLoaded, sizeof(aLoaded) / sizeof(aLoaded[0]),
+                                aLoadedTransitions, numTransitions)) {
+        printf("ImageTest: ERROR: can't load the image\n");
+        return -1;
+    }
+
+    builtTrace = RunImageTestInstance(&builtDef);
+    loadedTrace = RunImageTestInstance(&loadedDef);
+
+    if (builtTrace != loadedTrace ||
+        std::string::npos == builtTrace.find("g:idle") ||
+        std::string::npos == builtTrace.find("a:active")) {
+        printf("ImageTest: ERROR: round trip:\n  built:  %s\n  loaded: %s\n",
+               builtTrace.c_str(), loadedTrace.c_str());
+        result = -1;
+    }
+
+    /// Malformed images: each case patches a fresh copy of the image
+    {
+        FsmImageHeader*           pHeader = (FsmImageHeader*)aPatched;
+        FsmImageStateRecord*      aRecords = NULL;
+        FsmImageTransitionRecord* aTransitions = NULL;
+        char*                     pStrings = NULL;
+
+        memcpy(aPatched, aImage, imageSize);
+        aRecords = (FsmImageStateRecord*)
+            ((char*)aPatched + pHeader->statesOffset_);
+        aTransitions = (FsmImageTransitionRecord*)
+            ((char*)aPatched + pHeader->transitionsOffset_);
+        pStrings = (char*)aPatched + pHeader->stringsOffset_;
+
+        /// Truncated: shorter than the header says, or consistently
+        /// shortened so that the string pool runs past its end
+        result |= ExpectImageRejected("truncated", aPatched, imageSize - 1,
+                                      kImageTestBindings,
+                                      kNumImageTestBindings);
+        result |= ExpectImageRejected("truncated header", aPatched,
+                                      sizeof(FsmImageHeader) - 1,
+                                      kImageTestBindings,
+                                      kNumImageTestBindings);
+
+        pHeader->imageSize_ = imageSize - 1;
+        result |= ExpectImageRejected("truncated string pool", aPatched,
+                                      imageSize - 1, kImageTestBindings,
+                                      kNumImageTestBindings);
+
+        /// Bad parent: a1 claims idle, which precedes active, as its
+        /// parent; and a state claims itself
+        memcpy(aPatched, aImage, imageSize);
+        aRecords[FindImageStateRecord(aPatched, "a1")].parent_ =
+            (unsigned short)FindImageStateRecord(aPatched, "idle");
+        result |= ExpectImageRejected("bad parent", aPatched, imageSize,
+                                      kImageTestBindings,
+                                      kNumImageTestBindings);
+
+        memcpy(aPatched, aImage, imageSize);
+        aRecords[FindImageStateRecord(aPatched, "a2")].parent_ =
+            (unsigned short)FindImageStateRecord(aPatched, "a2");
+        result |= ExpectImageRejected("self parent", aPatched, imageSize,
+                                      kImageTestBindings,
+                                      kNumImageTestBindings);
+
+        /// Out-of-range transition target
+        memcpy(aPatched, aImage, imageSize);
+        aTransitions[0].target_ = kNumImageTestStates + 1;
+        result |= ExpectImageRejected("out-of-range target", aPatched,
+                                      imageSize, kImageTestBindings,
+                                      kNumImageTestBindings);
+
+        /// Unbound names: the action isn't bound, or "guard" is bound
+        /// to a function of the wrong kind
+        memcpy(aPatched, aImage, imageSize);
+        result |= ExpectImageRejected("unbound action", aPatched, imageSize,
+                                      kImageTestBindings,
+                                      kNumImageTestBindings - 1);
+        {
+            const FsmImageBinding aWrongKind[] = {
+                {"handler", &ImageTestHandler, NULL, NULL},
+                {"guard", NULL, NULL, &ImageTestAction},
+                {"action", NULL, NULL, &ImageTestAction}
+            };
+
+            result |= ExpectImageRejected("guard bound as an action",
+                                          aPatched, imageSize, aWrongKind,
+                                          3);
+        }
+
+        /// Unterminated string pool
+        pStrings[pHeader->stringsSize_ - 1] = 'x';
+        result |= ExpectImageRejected("unterminated string pool", aPatched,
+                                      imageSize, kImageTestBindings,
+                                      kNumImageTestBindings);
+
+        /// The unpatched image still loads
+        memcpy(aPatched, aImage, imageSize);
+        if (!LoadImageTestImage(aPatched, imageSize, kImageTestBindings,
+                                kNumImageTestBindings)) {
+            printf("ImageTest: ERROR: the unpatched image was rejected\n");
+            result = -1;
+        }
+    }
+
+    return result;
+}
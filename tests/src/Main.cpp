@@ -310,6 +310,10 @@ Test1()
 
     struct Test1Fsm    fsm;
 
+    FsmTransitionCache  tranCache;
+    FsmTransitionPlan   tranPlans[8];
+    unsigned long       cacheHits, cacheMisses;
+
     FsmInitMachine((FsmMachine*)&fsm, "Test1");
 
     FsmDbgEnableLogging((FsmMachine*)&fsm,
@@ -348,6 +352,9 @@ Test1()
     FsmInsertState((FsmMachine*)&fsm, (FsmState*)&fsm.s21, (FsmState*)&fsm.s2);
     FsmInsertState((FsmMachine*)&fsm, (FsmState*)&fsm.s22, (FsmState*)&fsm.s2);
 
+    FsmAttachTransitionCache((FsmMachine*)&fsm, &tranCache, tranPlans,
+                             sizeof(tranPlans) / sizeof(tranPlans[0]));
+
 
     FsmStart((FsmMachine*)&fsm, (FsmState*)&fsm.s);
 
@@ -359,6 +366,14 @@ Test1()
         FsmDispatchEvent((FsmMachine*)&fsm, &evtWind);
     //}
 
+    printf("Test1 in s11: %d, in s2: %d, s is ancestor of s111: %d\n",
+           FsmIsInState((FsmMachine*)&fsm, (FsmState*)&fsm.s11),
+           FsmIsInState((FsmMachine*)&fsm, (FsmState*)&fsm.s2),
+           FsmIsAncestor((FsmState*)&fsm.s, (FsmState*)&fsm.s111));
+
+    FsmDbgGetTransitionCacheStats((FsmMachine*)&fsm, &cacheHits, &cacheMisses);
+    printf("Test1 transition cache: hits=%lu, misses=%lu\n",
+           cacheHits, cacheMisses);
 
     FsmStart((FsmMachine*)&fsm, (FsmState*)&fsm.s22);
 
@@ -366,15 +381,652 @@ Test1()
 }
 
 
+/**
+ * A state machine for tests that check which deliveries SME
+ * makes: all of its states use TraceStateHandler(), and are
+ * inserted by InsertTraceStates() as follows:
+ *
+ *  root
+ *   +-- a
+ *   |   +-- a1
+ *   |   |   +-- a11
+ *   |   +-- a2
+ *   +-- b
+ */
+typedef struct TraceFsm {
+    FsmMachine      fsmRep; ///< MUST be first member for C "subclassing"
+
+    enum TraceUserSignals {
+        kTraceSig_one = kFsmEventFirstUserEvent,
+        kTraceSig_two,
+        kTraceSig_goToB,    ///< the current state transitions to b
+        kTraceSig_goToA2    ///< the current state transitions to a2
+    };
+
+    FsmState        a;
+    FsmState        a1;
+    FsmState        a11;
+    FsmState        a2;
+    FsmState        b;
+} TraceFsm;
+
+
+/// Deliveries made to TraceStateHandler() (and calls to the
+/// TraceFsm's guards and actions) since the last CheckTrace()
+static std::string g_trace;
+
+
+/** 
+ * Appends the delivery to g_trace as "<state>:<event> "
+ * 
+ * @param pState
+ * @param pFsm
+ * @param pEvt
+ * 
+ * @return int
+ */
+static int
+TraceStateHandler(const FsmState* pState,
+                  TraceFsm* pFsm,
+                  const FsmEvent* pEvt)
+{
+    char    buf[40];
+
+    switch (pEvt->evtId) {
+    case kFsmEventEnterScope:
+        snprintf(buf, sizeof(buf), "%s:enter ", FsmDbgPeekStateName(pState));
+        break;
+    case kFsmEventExitScope:
+        snprintf(buf, sizeof(buf), "%s:exit ", FsmDbgPeekStateName(pState));
+        break;
+    case kFsmEventBegin:
+        snprintf(buf, sizeof(buf), "%s:begin ", FsmDbgPeekStateName(pState));
+        break;
+    default:
+        snprintf(buf, sizeof(buf), "%s:%d ", FsmDbgPeekStateName(pState),
+                 (int)(pEvt->evtId - kFsmEventFirstUserEvent));
+        break;
+    }
+
+    g_trace += buf;
+
+    if (TraceFsm::kTraceSig_goToB == pEvt->evtId) {
+        FsmBeginTransition((FsmMachine*)pFsm, &pFsm->b);
+        return TRUE;
+    }
+
+    if (TraceFsm::kTraceSig_goToA2 == pEvt->evtId) {
+        FsmBeginTransition((FsmMachine*)pFsm, &pFsm->a2);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+/** 
+ * Initializes the TraceFsm and its states (without inserting
+ * them)
+ * 
+ * @param pFsm
+ * @param pName
+ * @param aFlags Flags of a, a1, a11, a2 and b, in that order;
+ *               NULL for none
+ */
+static void
+InitTraceFsm(TraceFsm* pFsm, const char* pName, const unsigned int* aFlags)
+{
+    static const unsigned int   kNoFlags[5] = {0, 0, 0, 0, 0};
+
+    FsmStateHandlerFnType* const pHandler =
+        (FsmStateHandlerFnType*)&TraceStateHandler;
+
+    if (!aFlags) {
+        aFlags = kNoFlags;
+    }
+
+    FsmInitMachine((FsmMachine*)pFsm, pName);
+
+    FsmInitStateEx(&pFsm->a, pHandler, "a", aFlags[0]);
+    FsmInitStateEx(&pFsm->a1, pHandler, "a1", aFlags[1]);
+    FsmInitStateEx(&pFsm->a11, pHandler, "a11", aFlags[2]);
+    FsmInitStateEx(&pFsm->a2, pHandler, "a2", aFlags[3]);
+    FsmInitStateEx(&pFsm->b, pHandler, "b", aFlags[4]);
+
+    g_trace.clear();
+}
+
+
+/** 
+ * @param pFsm
+ */
+static void
+InsertTraceStates(TraceFsm* pFsm)
+{
+    FsmMachine* pMachine = (FsmMachine*)pFsm;
+
+    FsmInsertState(pMachine, &pFsm->a, NULL/*pParent*/);
+    FsmInsertState(pMachine, &pFsm->a1, &pFsm->a);
+    FsmInsertState(pMachine, &pFsm->a11, &pFsm->a1);
+    FsmInsertState(pMachine, &pFsm->a2, &pFsm->a);
+    FsmInsertState(pMachine, &pFsm->b, NULL/*pParent*/);
+}
+
+
+/** 
+ * Dispatches a user event to the TraceFsm
+ * 
+ * @param pFsm
+ * @param evtId
+ */
+static void
+DispatchTraceEvent(TraceFsm* pFsm, FsmEventIdType evtId)
+{
+    FsmEvent    evt = {evtId};
+
+    FsmDispatchEvent((FsmMachine*)pFsm, &evt);
+}
+
+
+/** 
+ * Compares g_trace with the expected trace, and clears it
+ * 
+ * @param pTestName
+ * @param pWhat What was traced
+ * @param pExpected
+ * 
+ * @return int 0 if they match; -1 otherwise
+ */
+static int
+CheckTrace(const char* pTestName, const char* pWhat, const char* pExpected)
+{
+    int result = 0;
+
+    if (g_trace != pExpected) {
+        printf("%s: ERROR: %s: got \"%s\", expected \"%s\"\n",
+               pTestName, pWhat, g_trace.c_str(), pExpected);
+        result = -1;
+    }
+
+    g_trace.clear();
+    return result;
+}
+
+
+/** 
+ * Per-state event subscription sets (@see FsmDeclareStateEvents())
+ * 
+ * @return int
+ */
+static int
+SubscriptionTest()
+{
+    static const FsmEventIdType kStateAEvents[] = {TraceFsm::kTraceSig_one};
+
+    TraceFsm    fsm;
+    int         result = 0;
+
+    InitTraceFsm(&fsm, "SubscriptionTest", NULL);
+
+    /// a1 handles no user events, a handles only kTraceSig_one, and a11
+    /// keeps the default (undeclared) subscription
+    FsmDeclareStateEvents(&fsm.a, kStateAEvents, 1);
+    FsmDeclareStateEvents(&fsm.a1, NULL, 0);
+
+    InsertTraceStates(&fsm);
+
+    /// Entry and initial transition events are always delivered
+    FsmStart((FsmMachine*)&fsm, &fsm.a1);
+    result |= CheckTrace("SubscriptionTest", "start",
+                         "a:enter a1:enter a1:begin ");
+
+    DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_one);
+    result |= CheckTrace("SubscriptionTest", "subscribed event", "a:0 ");
+
+    DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_two);
+    result |= CheckTrace("SubscriptionTest", "unsubscribed event", "");
+
+    FsmStart((FsmMachine*)&fsm, &fsm.a11);
+    g_trace.clear();
+
+    DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_two);
+    result |= CheckTrace("SubscriptionTest", "undeclared subscription",
+                         "a11:1 ");
+
+    return result;
+}
+
+
+/** 
+ * Guard of a declared transition that's never taken
+ */
+static int
+RejectingTraceGuard(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    (void)pState; (void)pFsm; (void)pEvt;
+
+    g_trace += "guard ";
+    return FALSE;
+}
+
+
+/** 
+ * Action of a declared transition
+ */
+static void
+TraceAction(FsmState* pState, FsmMachine* pFsm, const FsmEvent* pEvt)
+{
+    (void)pState; (void)pFsm; (void)pEvt;
+
+    g_trace += "action ";
+}
+
+
+/** 
+ * Declarative transition tables (@see FsmDeclareStateTransitions())
+ * 
+ * @return int
+ */
+static int
+DeclaredTransitionTest()
+{
+    TraceFsm    fsm;
+    int         result = 0;
+
+    const FsmTransitionDef stateATransitions[] = {
+        {TraceFsm::kTraceSig_one, &fsm.b, &RejectingTraceGuard, NULL},
+        {TraceFsm::kTraceSig_one, &fsm.a2, NULL, &TraceAction}
+    };
+
+    InitTraceFsm(&fsm, "DeclaredTransitionTest", NULL);
+    FsmDeclareStateTransitions(&fsm.a, stateATransitions, 2);
+    InsertTraceStates(&fsm);
+
+    FsmStart((FsmMachine*)&fsm, &fsm.a11);
+    g_trace.clear();
+
+    /// The table is consulted when the event reaches a, instead of a's
+    /// handler: the first passing entry is taken
+    DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_one);
+    result |= CheckTrace("DeclaredTransitionTest", "declared transition",
+                         "a11:0 a1:0 guard a11:exit a1:exit action "
+                         "a2:enter a2:begin ");
+
+    /// Events that the table doesn't cover go to the handler
+    DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_two);
+    result |= CheckTrace("DeclaredTransitionTest", "undeclared event",
+                         "a2:1 a:1 ");
+
+    return result;
+}
+
+
+/** 
+ * State capability flags (@see FsmInitStateEx()), in both an
+ * unsealed and a sealed state machine
+ * 
+ * @return int
+ */
+static int
+StateFlagsTest()
+{
+    /// a is a pass-through state, a1 has no exit behavior, and a11 no
+    /// initial transition
+    static const unsigned int kFlags[5] = {
+        kFsmStateFlagPassThrough, kFsmStateFlagNoExit, kFsmStateFlagNoBegin,
+        0, 0
+    };
+
+    TraceFsm        fsm;
+    FsmState*       apStates[5];
+    FsmSealedState  aSealed[FSM_SEALED_STATE_COUNT(5)];
+    int             result = 0;
+    int             isSealed = 0;
+
+    for (isSealed = 0; isSealed <= 1; ++isSealed) {
+        InitTraceFsm(&fsm, "StateFlagsTest", kFlags);
+        InsertTraceStates(&fsm);
+
+        if (isSealed) {
+            apStates[0] = &fsm.a;
+            apStates[1] = &fsm.a1;
+            apStates[2] = &fsm.a11;
+            apStates[3] = &fsm.a2;
+            apStates[4] = &fsm.b;
+            FsmSealMachine((FsmMachine*)&fsm, apStates, 5, aSealed,
+                           sizeof(aSealed) / sizeof(aSealed[0]));
+        }
+
+        FsmStart((FsmMachine*)&fsm, &fsm.a11);
+        result |= CheckTrace("StateFlagsTest", "start",
+                             "a1:enter a11:enter ");
+
+        /// User events still reach flagged states
+        DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_one);
+        result |= CheckTrace("StateFlagsTest", "user event",
+                             "a11:0 a1:0 a:0 ");
+
+        DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_goToB);
+        result |= CheckTrace("StateFlagsTest", "transition",
+                             "a11:2 a11:exit b:enter b:begin ");
+    }
+
+    return result;
+}
+
+
+/** 
+ * A flat state machine (only a and b, both top-level states),
+ * which takes the flat-machine fast path (@see FsmStart()), both
+ * unsealed and sealed
+ * 
+ * @return int
+ */
+static int
+FlatMachineTest()
+{
+    /// b has no exit behavior
+    static const unsigned int kFlags[5] = {0, 0, 0, 0, kFsmStateFlagNoExit};
+
+    TraceFsm        fsm;
+    FsmState*       apStates[2];
+    FsmSealedState  aSealed[FSM_SEALED_STATE_COUNT(2)];
+    int             result = 0;
+    int             isSealed = 0;
+
+    for (isSealed = 0; isSealed <= 1; ++isSealed) {
+        InitTraceFsm(&fsm, "FlatMachineTest", kFlags);
+        FsmInsertState((FsmMachine*)&fsm, &fsm.a, NULL/*pParent*/);
+        FsmInsertState((FsmMachine*)&fsm, &fsm.b, NULL/*pParent*/);
+
+        if (isSealed) {
+            apStates[0] = &fsm.a;
+            apStates[1] = &fsm.b;
+            FsmSealMachine((FsmMachine*)&fsm, apStates, 2, aSealed,
+                           sizeof(aSealed) / sizeof(aSealed[0]));
+        }
+
+        FsmStart((FsmMachine*)&fsm, &fsm.a);
+        result |= CheckTrace("FlatMachineTest", "start", "a:enter a:begin ");
+
+        DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_one);
+        result |= CheckTrace("FlatMachineTest", "user event", "a:0 ");
+
+        DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_goToB);
+        result |= CheckTrace("FlatMachineTest", "transition",
+                             "a:2 a:exit b:enter b:begin ");
+
+        DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_goToB);
+        result |= CheckTrace("FlatMachineTest", "self-transition",
+                             "b:2 b:enter b:begin ");
+
+        if (!FsmIsInState((FsmMachine*)&fsm, &fsm.b)) {
+            printf("FlatMachineTest: ERROR: not in b\n");
+            result = -1;
+        }
+    }
+
+    return result;
+}
+
+
+/** 
+ * Transitions replayed from the transition plan cache (@see
+ * FsmAttachTransitionCache()) deliver the same exit and entry
+ * events, in the same order, as transitions without a cache
+ * 
+ * @return int
+ */
+static int
+TransitionCacheTest()
+{
+    TraceFsm            fsm;
+    FsmTransitionCache  tranCache;
+    FsmTransitionPlan   tranPlans[8];
+    std::string         aTraces[2];
+    unsigned long       cacheHits = 0, cacheMisses = 0;
+    int                 result = 0;
+    int                 useCache = 0;
+    int                 round = 0;
+
+    for (useCache = 0; useCache <= 1; ++useCache) {
+        InitTraceFsm(&fsm, "TransitionCacheTest", NULL);
+        InsertTraceStates(&fsm);
+
+        if (useCache) {
+            FsmAttachTransitionCache((FsmMachine*)&fsm, &tranCache, tranPlans,
+                                     sizeof(tranPlans) / sizeof(tranPlans[0]));
+        }
+
+        /// Take the (a11, a2), (a2, b) and (b, b) transitions, whose
+        /// anchors are a, the root state and the root state, three
+        /// times in a row each: the first one misses, and the others
+        /// hit, even if the pairs map to the same slot
+        for (round = 0; round < 3; ++round) {
+            FsmStart((FsmMachine*)&fsm, &fsm.a11);
+            DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_goToA2);
+        }
+        for (round = 0; round < 3; ++round) {
+            FsmStart((FsmMachine*)&fsm, &fsm.a2);
+            DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_goToB);
+        }
+        for (round = 0; round < 3; ++round) {
+            DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_goToB);
+        }
+
+        aTraces[useCache] = g_trace;
+        g_trace.clear();
+    }
+
+    if (aTraces[0] != aTraces[1]) {
+        printf("TransitionCacheTest: ERROR: got \"%s\" with the cache, " \
+               "\"%s\" without\n", aTraces[1].c_str(), aTraces[0].c_str());
+        result = -1;
+    }
+
+    FsmDbgGetTransitionCacheStats((FsmMachine*)&fsm, &cacheHits, &cacheMisses);
+    if (6 != cacheHits || 3 != cacheMisses) {
+        printf("TransitionCacheTest: ERROR: hits=%lu, misses=%lu; " \
+               "expected hits=6, misses=3\n", cacheHits, cacheMisses);
+        result = -1;
+    }
+
+    return result;
+}
+
+
+/** 
+ * Declared initial substates (@see FsmSetInitialSubstate())
+ * 
+ * @return int
+ */
+static int
+InitialSubstateTest()
+{
+    TraceFsm    fsm;
+    int         result = 0;
+    int         pass = 0;
+
+    InitTraceFsm(&fsm, "InitialSubstateTest", NULL);
+
+    /// a drills down to a11 via a1's own initial substate
+    FsmSetInitialSubstate(&fsm.a, &fsm.a1);
+    FsmSetInitialSubstate(&fsm.a1, &fsm.a11);
+
+    InsertTraceStates(&fsm);
+
+    FsmStart((FsmMachine*)&fsm, &fsm.b);
+    g_trace.clear();
+
+    /// The second pass reuses the drill-down computed by the first
+    for (pass = 0; pass < 2; ++pass) {
+        FsmStart((FsmMachine*)&fsm, &fsm.a);
+        result |= CheckTrace("InitialSubstateTest", "drill-down",
+                             "a:enter a1:enter a11:enter a11:begin ");
+
+        DispatchTraceEvent(&fsm, TraceFsm::kTraceSig_goToB);
+        result |= CheckTrace("InitialSubstateTest", "exit",
+                             "a11:2 a11:exit a1:exit a:exit b:enter "
+                             "b:begin ");
+    }
+
+    return result;
+}
+
+
+/** 
+ * Counts log lines via the cookie, which points to an int
+ */
+static void
+CountingLogCb(FsmMachine* pFsm,
+              void* cookie,
+              enum FsmDbgLogLevel level,
+              const char* pFmt, ...)
+{
+    (void)pFsm; (void)level; (void)pFmt;
+
+    ++*(int*)cookie;
+}
+
+
+static int
+LogConfigTestHandler(const FsmState* pState,
+                     FsmMachine* pFsm,
+                     const FsmEvent* pEvt)
+{
+    (void)pState; (void)pFsm; (void)pEvt;
+
+    return FALSE;
+}
+
+
+static int
+LogConfigTest()
+{
+    FsmMachine      fsm;
+    FsmState        state;
+    FsmMachine      defFsm;
+    FsmState        defState;
+    FsmState* const apDefStates[] = {&defState};
+    FsmSealedState  aSealed[FSM_SEALED_STATE_COUNT(1)];
+    FsmDefinition   def;
+    FsmInstance     instance;
+    FsmDbgLogConfig logConfig;
+    int             numLines = 0;
+    int             result = 0;
+
+    FsmInitMachine(&fsm, "LogConfigTest");
+    FsmInitState(&state, (FsmStateHandlerFnType*)&LogConfigTestHandler,
+                 "state");
+    FsmInsertState(&fsm, &state, NULL/*pParent*/);
+
+    /// An FsmMachine logs via its own logging configuration
+    FsmDbgSetLogLevelThreshold(&fsm, kFsmDbgLogLevelDebug);
+    FsmDbgEnableLogging(&fsm, kFsmDbgLogOptEvents, CountingLogCb, &numLines);
+
+    FsmStart(&fsm, &state);
+
+    if (0 == numLines) {
+        printf("LogConfigTest: ERROR: nothing logged by an FsmMachine\n");
+        result = -1;
+    }
+
+    FsmDbgDisableLogging(&fsm);
+    numLines = 0;
+
+    FsmStart(&fsm, &state);
+
+    if (0 != numLines) {
+        printf("LogConfigTest: ERROR: %d lines logged after "
+               "FsmDbgDisableLogging()\n", numLines);
+        result = -1;
+    }
+
+    /// An instance logs only via an attached logging configuration
+    FsmInitMachine(&defFsm, "LogConfigTestDef");
+    FsmInitState(&defState, (FsmStateHandlerFnType*)&LogConfigTestHandler,
+                 "defState");
+    FsmInsertState(&defFsm, &defState, NULL/*pParent*/);
+    FsmSealMachine(&defFsm, apDefStates, 1, aSealed,
+                   FSM_SEALED_STATE_COUNT(1));
+    FsmInitDefinition(&def, &defFsm);
+    FsmInitInstance(&instance, &def, NULL);
+
+    FsmStart(FSM_INSTANCE_MACHINE(&instance), &defState);
+
+    if (0 != numLines) {
+        printf("LogConfigTest: ERROR: %d lines logged by an instance "
+               "without a logging configuration\n", numLines);
+        result = -1;
+    }
+
+    FsmDbgAttachLogConfig(FSM_INSTANCE_MACHINE(&instance), &logConfig);
+    FsmDbgSetLogLevelThreshold(FSM_INSTANCE_MACHINE(&instance),
+                               kFsmDbgLogLevelDebug);
+    FsmDbgEnableLogging(FSM_INSTANCE_MACHINE(&instance), kFsmDbgLogOptEvents,
+                        CountingLogCb, &numLines);
+
+    FsmStart(FSM_INSTANCE_MACHINE(&instance), &defState);
+
+    if (0 == numLines) {
+        printf("LogConfigTest: ERROR: nothing logged by an instance with "
+               "a logging configuration\n");
+        result = -1;
+    }
+
+    return result;
+}
+
+
 int main (int argc, char *argv[])
 {
     printf("Running Test1...\n");
     int result = Test1();
     printf("Test1 returned with result = %d\n", result);
 
+    printf("Running SubscriptionTest...\n");
+    result = SubscriptionTest();
+    printf("SubscriptionTest returned with result = %d\n", result);
+
+    printf("Running DeclaredTransitionTest...\n");
+    result = DeclaredTransitionTest();
+    printf("DeclaredTransitionTest returned with result = %d\n", result);
+
+    printf("Running StateFlagsTest...\n");
+    result = StateFlagsTest();
+    printf("StateFlagsTest returned with result = %d\n", result);
+
+    printf("Running FlatMachineTest...\n");
+    result = FlatMachineTest();
+    printf("FlatMachineTest returned with result = %d\n", result);
+
+    printf("Running InitialSubstateTest...\n");
+    result = InitialSubstateTest();
+    printf("InitialSubstateTest returned with result = %d\n", result);
+
+    printf("Running TransitionCacheTest...\n");
+    result = TransitionCacheTest();
+    printf("TransitionCacheTest returned with result = %d\n", result);
+
+    printf("Running LogConfigTest...\n");
+    result = LogConfigTest();
+    printf("LogConfigTest returned with result = %d\n", result);
+
     printf("Running CplusPlusTest...\n");
     result = CplusPlusTest();
     printf("CplusPlusTest returned with result = %d\n", result);
 
+    printf("Running CodegenTest...\n");
+    result = CodegenTest();
+    printf("CodegenTest returned with result = %d\n", result);
+
+    printf("Running ImageTest...\n");
+    result = ImageTest();
+    printf("ImageTest returned with result = %d\n", result);
+
+    printf("Running BenchmarkTest...\n");
+    result = BenchmarkTest();
+    printf("BenchmarkTest returned with result = %d\n", result);
+
     return 0;
 }
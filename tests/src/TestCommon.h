@@ -43,4 +43,16 @@ StateMachineLogCb(FsmMachine* pFsm,
 int
 CplusPlusTest();
 
+int
+CodegenTest();
+
+int
+ImageTest();
+
+int
+BenchmarkTest();
+
+double
+BenchHeaderOnlyDispatchSecs(unsigned int numEvents);
+
 #endif // TEST_COMMON_H
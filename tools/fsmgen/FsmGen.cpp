@@ -0,0 +1,1337 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2009-2013 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+/**
+ * ****************************************************************************
+ * @file FsmGen.cpp
+ *
+ * @brief  fsmgen: compiles a statechart description into C code
+ *         with specialized, switch-based event dispatch (@see
+ *         PalmFsmGen.h).
+ *
+ * Usage: fsmgen <statechart.json> <output-base> [<profile>]
+ *
+ * Writes <output-base>.h and <output-base>.c.  The statechart is
+ * a JSON object:
+ *
+ * {
+ *   "machine": "Session",              // C identifier prefix; FSM name
+ *   "events": ["open", "data", "close"],
+ *   "states": [
+ *     {
+ *       "name": "idle",                // unique C identifier
+ *       "handler": "SessionIdleHandler",
+ *       "flags": ["noBegin"],          // optional: noEntry, noExit,
+ *                                      // noBegin, passThrough
+ *       "events": ["open"],            // optional subscription set
+ *       "initial": "waiting",          // optional descendant state
+ *       "transitions": [               // optional
+ *         {"event": "open", "target": "active",
+ *          "guard": "SessionCanOpen", "action": "SessionOpen"}
+ *       ],
+ *       "states": [...]                // optional substates
+ *     }
+ *   ]
+ * }
+ *
+ * The names of handlers, guards and actions refer to functions of
+ * the SME types (@see FsmStateHandlerFnType,
+ * FsmTransitionGuardFnType and FsmTransitionActionFnType), which
+ * the generated header declares and the user defines.
+ *
+ * The generated code (e.g., for "Session"):
+ *
+ *  * enum SessionSignals: kSessionSig_open, ... (event ids,
+ *    starting at kFsmEventFirstUserEvent)
+ *  * enum SessionStates: kSessionState_idle, ... (state ids, in
+ *    pre-order, starting at 1)
+ *  * kSessionTopology: the constant topology; its user state
+ *    objects are FSM_CONST_USER_STATE(kSessionTopology, id)
+ *  * SessionInitDefinition(): initializes a definition from the
+ *    topology (@see FsmInitConstDefinition())
+ *  * SessionDispatchEvent(): FsmDispatchEvent() specialized for
+ *    the instances of that definition
+ *
+ * The optional profile is the text of FsmDbgWriteProfile() for an
+ * instance of the statechart's definition, run via
+ * FsmDispatchEvent() (generated dispatch doesn't count state use).
+ * It lays out the generated code of the hot states together:
+ * the dispatch cases of the current states, and the subscription
+ * sets and transition tables, come in order of decreasing use
+ * (the order of the entries in each table is semantic, and stays
+ * as it is).  The state ids and the topology don't depend on the
+ * profile.
+ * ****************************************************************************
+ */
+
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+
+/**
+ * A JSON value
+ */
+struct JsonValue {
+    enum Type {
+        kNull,
+        kBool,
+        kNumber,
+        kString,
+        kArray,
+        kObject
+    };
+
+    JsonValue()
+    : type(kNull), line(0)
+    {
+    }
+
+    const JsonValue* Find(const std::string& key) const
+    {
+        for (size_t i = 0; i < members.size(); ++i) {
+            if (members[i].first == key) {
+                return &members[i].second;
+            }
+        }
+        return NULL;
+    }
+
+    Type                                            type;
+    int                                             line;   ///< for errors
+    std::string                                     str;    ///< kString
+    std::vector<JsonValue>                          items;  ///< kArray
+    std::vector<std::pair<std::string, JsonValue> > members;///< kObject
+};
+
+
+/**
+ * Thrown on errors in the statechart description
+ */
+struct GenError {
+    GenError(int line_, const std::string& msg_)
+    : line(line_), msg(msg_)
+    {
+    }
+
+    int             line;   ///< 0 if unknown
+    std::string     msg;
+};
+
+
+/**
+ * A recursive-descent JSON parser
+ */
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text)
+    : text_(text), pos_(0), line_(1)
+    {
+    }
+
+    void Parse(JsonValue* pValue)
+    {
+        ParseValue(pValue);
+        SkipSpace();
+        if (pos_ != text_.size()) {
+            throw GenError(line_, "trailing characters after JSON value");
+        }
+    }
+
+private:
+    void SkipSpace()
+    {
+        while (pos_ < text_.size() && text_[pos_] &&
+               strchr(" \t\r\n", text_[pos_])) {
+            if ('\n' == text_[pos_]) {
+                ++line_;
+            }
+            ++pos_;
+        }
+    }
+
+    bool Accept(char c)
+    {
+        SkipSpace();
+        if (pos_ < text_.size() && c == text_[pos_]) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    void Expect(char c)
+    {
+        if (!Accept(c)) {
+            throw GenError(line_, std::string("expected '") + c + "'");
+        }
+    }
+
+    bool AcceptWord(const char* pWord)
+    {
+        size_t len = strlen(pWord);
+
+        if (0 == text_.compare(pos_, len, pWord)) {
+            pos_ += len;
+            return true;
+        }
+        return false;
+    }
+
+    void ParseString(std::string* pStr)
+    {
+        Expect('"');
+        while (pos_ < text_.size() && '"' != text_[pos_]) {
+            char c = text_[pos_++];
+
+            if ('\n' == c) {
+                throw GenError(line_, "unterminated string");
+            }
+            if ('\\' == c && pos_ < text_.size()) {
+                c = text_[pos_++];
+                switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case '"': case '\\': case '/': break;
+                default:
+                    throw GenError(line_, "unsupported escape in string");
+                }
+            }
+            pStr->push_back(c);
+        }
+        Expect('"');
+    }
+
+    void ParseValue(JsonValue* pValue)
+    {
+        SkipSpace();
+        pValue->line = line_;
+
+        if (pos_ >= text_.size()) {
+            throw GenError(line_, "unexpected end of input");
+        }
+
+        switch (text_[pos_]) {
+        case '{':
+            pValue->type = JsonValue::kObject;
+            ++pos_;
+            if (Accept('}')) {
+                return;
+            }
+            do {
+                std::pair<std::string, JsonValue> member;
+
+                SkipSpace();
+                ParseString(&member.first);
+                Expect(':');
+                ParseValue(&member.second);
+                pValue->members.push_back(member);
+            } while (Accept(','));
+            Expect('}');
+            return;
+
+        case '[':
+            pValue->type = JsonValue::kArray;
+            ++pos_;
+            if (Accept(']')) {
+                return;
+            }
+            do {
+                pValue->items.push_back(JsonValue());
+                ParseValue(&pValue->items.back());
+            } while (Accept(','));
+            Expect(']');
+            return;
+
+        case '"':
+            pValue->type = JsonValue::kString;
+            ParseString(&pValue->str);
+            return;
+
+        default:
+            if (AcceptWord("true") || AcceptWord("false")) {
+                pValue->type = JsonValue::kBool;
+                return;
+            }
+            if (AcceptWord("null")) {
+                return;
+            }
+            if (text_[pos_] && strchr("-0123456789", text_[pos_])) {
+                pValue->type = JsonValue::kNumber;
+                while (pos_ < text_.size() && text_[pos_] &&
+                       strchr("+-.0123456789eE", text_[pos_])) {
+                    ++pos_;
+                }
+                return;
+            }
+            throw GenError(line_, "unexpected character");
+        }
+    }
+
+    const std::string&  text_;
+    size_t              pos_;
+    int                 line_;
+};
+
+
+/**
+ * SME's state flags (@see enum FsmStateFlags)
+ */
+enum {
+    kGenFlagNoEntry     = 0x01,
+    kGenFlagNoExit      = 0x02,
+    kGenFlagNoBegin     = 0x04
+};
+
+
+struct GenTransition {
+    unsigned int    event;      ///< index into GenMachine::events
+    unsigned int    target;     ///< state id
+    std::string     targetName;
+    std::string     guard;      ///< empty if none
+    std::string     action;     ///< empty if none
+    int             line;
+};
+
+
+struct GenState {
+    std::string                 name;
+    std::string                 handler;
+    unsigned int                flags;
+    unsigned int                parent;         ///< state id; 0 = root
+    unsigned int                walkParent;     ///< @see FSM_CONST_STATE_EX
+    unsigned int                depth;
+    unsigned int                lastId;         ///< last descendant's id
+    std::string                 initialName;    ///< empty if none
+    unsigned int                initial;        ///< innermost; 0 if none
+    bool                        hasEventSet;
+    std::vector<unsigned int>   eventSet;       ///< sorted event indices
+    std::vector<GenTransition>  transitions;    ///< sorted by event (stable)
+    unsigned long               use;            ///< @see ReadProfile()
+    int                         line;
+};
+
+
+struct GenMachine {
+    std::string                 name;
+    std::vector<std::string>    events;
+    std::vector<GenState>       states;     ///< indexed by id; 0 = root
+};
+
+
+bool
+IsIdentifier(const std::string& str)
+{
+    if (str.empty() || isdigit((unsigned char)str[0])) {
+        return false;
+    }
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (!isalnum((unsigned char)str[i]) && '_' != str[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * Returns the value of the given member of the given object;
+ * NULL if it's optional and missing
+ */
+const JsonValue*
+GetMember(const JsonValue& obj, const char* pKey, JsonValue::Type type,
+          bool isRequired)
+{
+    const JsonValue* pValue = obj.Find(pKey);
+
+    if (!pValue) {
+        if (isRequired) {
+            throw GenError(obj.line, std::string("missing \"") + pKey + "\"");
+        }
+        return NULL;
+    }
+    if (pValue->type != type) {
+        throw GenError(pValue->line,
+                       std::string("wrong type of \"") + pKey + "\"");
+    }
+    return pValue;
+}
+
+
+/**
+ * Returns the given member that names a C identifier; empty if
+ * it's optional and missing
+ */
+std::string
+GetIdentifier(const JsonValue& obj, const char* pKey, bool isRequired)
+{
+    const JsonValue* pValue = GetMember(obj, pKey, JsonValue::kString,
+                                        isRequired);
+
+    if (!pValue) {
+        return std::string();
+    }
+    if (!IsIdentifier(pValue->str)) {
+        throw GenError(pValue->line, std::string("\"") + pKey +
+                       "\" must be a C identifier: " + pValue->str);
+    }
+    return pValue->str;
+}
+
+
+unsigned int
+FindEvent(const GenMachine& m, const JsonValue& name)
+{
+    for (size_t i = 0; i < m.events.size(); ++i) {
+        if (m.events[i] == name.str) {
+            return (unsigned int)i;
+        }
+    }
+    throw GenError(name.line, "undeclared event: " + name.str);
+}
+
+
+bool
+IsEarlierEvent(const GenTransition& t1, const GenTransition& t2)
+{
+    return t1.event < t2.event;
+}
+
+
+/**
+ * Appends the given state and its substates to the machine, in
+ * pre-order
+ */
+void
+ReadState(GenMachine* pM, const JsonValue& obj, unsigned int parent)
+{
+    GenState            state;
+    const JsonValue*    pValue = NULL;
+    unsigned int        id = (unsigned int)pM->states.size();
+    size_t              i;
+
+    if (JsonValue::kObject != obj.type) {
+        throw GenError(obj.line, "a state must be an object");
+    }
+
+    state.name = GetIdentifier(obj, "name", true);
+    state.handler = GetIdentifier(obj, "handler", true);
+    state.flags = 0;
+    state.parent = parent;
+    state.depth = pM->states[parent].depth + 1;
+    state.initialName = GetIdentifier(obj, "initial", false);
+    state.initial = 0;
+    state.hasEventSet = false;
+    state.use = 0;
+    state.line = obj.line;
+
+    /// Pass-through parents are walked past (@see FSM_WALK_PARENT_STATE)
+    state.walkParent = parent;
+    while (state.walkParent &&
+           (kGenFlagNoEntry | kGenFlagNoExit) ==
+           (pM->states[state.walkParent].flags &
+            (kGenFlagNoEntry | kGenFlagNoExit))) {
+        state.walkParent = pM->states[state.walkParent].walkParent;
+    }
+
+    if ((pValue = GetMember(obj, "flags", JsonValue::kArray, false))) {
+        for (i = 0; i < pValue->items.size(); ++i) {
+            const std::string& flag = pValue->items[i].str;
+
+            if ("noEntry" == flag) {
+                state.flags |= kGenFlagNoEntry;
+            }
+            else if ("noExit" == flag) {
+                state.flags |= kGenFlagNoExit;
+            }
+            else if ("noBegin" == flag) {
+                state.flags |= kGenFlagNoBegin;
+            }
+            else if ("passThrough" == flag) {
+                state.flags |= kGenFlagNoEntry | kGenFlagNoExit |
+                               kGenFlagNoBegin;
+            }
+            else {
+                throw GenError(pValue->items[i].line, "unknown flag: " + flag);
+            }
+        }
+    }
+
+    if ((pValue = GetMember(obj, "events", JsonValue::kArray, false))) {
+        state.hasEventSet = true;
+        for (i = 0; i < pValue->items.size(); ++i) {
+            state.eventSet.push_back(FindEvent(*pM, pValue->items[i]));
+        }
+        std::sort(state.eventSet.begin(), state.eventSet.end());
+        state.eventSet.erase(std::unique(state.eventSet.begin(),
+                                         state.eventSet.end()),
+                             state.eventSet.end());
+    }
+
+    if ((pValue = GetMember(obj, "transitions", JsonValue::kArray, false))) {
+        for (i = 0; i < pValue->items.size(); ++i) {
+            const JsonValue&    tranObj = pValue->items[i];
+            GenTransition       tran;
+
+            if (JsonValue::kObject != tranObj.type) {
+                throw GenError(tranObj.line,
+                               "a transition must be an object");
+            }
+
+            tran.event = FindEvent(*pM, *GetMember(tranObj, "event",
+                                                   JsonValue::kString, true));
+            tran.targetName = GetIdentifier(tranObj, "target", true);
+            tran.target = 0;
+            tran.guard = GetIdentifier(tranObj, "guard", false);
+            tran.action = GetIdentifier(tranObj, "action", false);
+            tran.line = tranObj.line;
+            state.transitions.push_back(tran);
+        }
+
+        /// SME tries the transitions of an event in table order
+        std::stable_sort(state.transitions.begin(), state.transitions.end(),
+                         &IsEarlierEvent);
+    }
+
+    pM->states.push_back(state);
+
+    if ((pValue = GetMember(obj, "states", JsonValue::kArray, false))) {
+        for (i = 0; i < pValue->items.size(); ++i) {
+            ReadState(pM, pValue->items[i], id);
+        }
+    }
+
+    pM->states[id].lastId = (unsigned int)pM->states.size() - 1;
+}
+
+
+/**
+ * Reads the statechart, and resolves the state names that it
+ * refers to
+ */
+void
+ReadMachine(GenMachine* pM, const JsonValue& doc)
+{
+    std::map<std::string, unsigned int> ids;
+    const JsonValue*                    pValue = NULL;
+    GenState                            root;
+    size_t                              i;
+    size_t                              j;
+
+    if (JsonValue::kObject != doc.type) {
+        throw GenError(doc.line, "the statechart must be an object");
+    }
+
+    pM->name = GetIdentifier(doc, "machine", true);
+
+    pValue = GetMember(doc, "events", JsonValue::kArray, true);
+    for (i = 0; i < pValue->items.size(); ++i) {
+        if (!IsIdentifier(pValue->items[i].str)) {
+            throw GenError(pValue->items[i].line,
+                           "an event must be a C identifier");
+        }
+        pM->events.push_back(pValue->items[i].str);
+    }
+
+    root.flags = 0;
+    root.parent = 0;
+    root.walkParent = 0;
+    root.depth = 0;
+    root.initial = 0;
+    root.hasEventSet = false;
+    root.use = 0;
+    root.line = doc.line;
+    pM->states.push_back(root);
+
+    pValue = GetMember(doc, "states", JsonValue::kArray, true);
+    for (i = 0; i < pValue->items.size(); ++i) {
+        ReadState(pM, pValue->items[i], 0);
+    }
+
+    /// At most 65534 user states (@see FSM_MAX_USER_STATES), besides
+    /// the root state
+    if (pM->states.size() < 2 || pM->states.size() > 0xFFFF) {
+        throw GenError(doc.line, "bad number of states");
+    }
+    pM->states[0].lastId = (unsigned int)pM->states.size() - 1;
+
+    for (i = 1; i < pM->states.size(); ++i) {
+        if (!ids.insert(std::make_pair(pM->states[i].name,
+                                       (unsigned int)i)).second) {
+            throw GenError(pM->states[i].line,
+                           "duplicate state: " + pM->states[i].name);
+        }
+    }
+
+    for (i = 1; i < pM->states.size(); ++i) {
+        GenState* pState = &pM->states[i];
+
+        for (j = 0; j < pState->transitions.size(); ++j) {
+            GenTransition* pTran = &pState->transitions[j];
+
+            if (!ids.count(pTran->targetName)) {
+                throw GenError(pTran->line,
+                               "unknown target state: " + pTran->targetName);
+            }
+            pTran->target = ids[pTran->targetName];
+        }
+
+        if (!pState->initialName.empty()) {
+            unsigned int initial = ids.count(pState->initialName)
+                                   ? ids[pState->initialName] : 0;
+
+            if (initial <= i || initial > pState->lastId) {
+                throw GenError(pState->line, "initial substate must be a " \
+                               "proper descendant: " + pState->initialName);
+            }
+            pState->initial = initial;
+        }
+    }
+
+    /// Name the innermost states of chains of initial substates, as
+    /// FSM_CONST_STATE_EX() requires; chains only lead to higher ids
+    for (i = pM->states.size() - 1; i > 0; --i) {
+        GenState* pState = &pM->states[i];
+
+        if (pState->initial && pM->states[pState->initial].initial) {
+            pState->initial = pM->states[pState->initial].initial;
+        }
+    }
+}
+
+
+/**
+ * Reads the use of the machine's states from a profile written by
+ * FsmDbgWriteProfile(): a state's use is the sum of the counters
+ * on the line that names it.  Lines that don't parse (e.g., the
+ * comment line) and unknown names are ignored, as
+ * FsmDbgReadProfile() does.
+ */
+void
+ReadProfile(GenMachine* pM, const std::string& text)
+{
+    std::istringstream                  in(text);
+    std::string                         line;
+    std::map<std::string, unsigned int> ids;
+    size_t                              i;
+
+    for (i = 1; i < pM->states.size(); ++i) {
+        ids.insert(std::make_pair(pM->states[i].name, (unsigned int)i));
+    }
+
+    while (std::getline(in, line)) {
+        std::istringstream  fields;
+        unsigned long       visits;
+        unsigned long       deliveries;
+        unsigned long       transitions;
+        std::string         name;
+        std::map<std::string, unsigned int>::const_iterator it;
+
+        if (!line.empty() && '\r' == line[line.size() - 1]) {
+            line.erase(line.size() - 1);
+        }
+        fields.str(line);
+
+        if (!(fields >> visits >> deliveries >> transitions) ||
+            ' ' != fields.get() || !std::getline(fields, name)) {
+            continue;
+        }
+
+        it = ids.find(name);
+        if (ids.end() != it) {
+            pM->states[it->second].use = visits + deliveries + transitions;
+        }
+    }
+}
+
+
+/**
+ * Writes the generated code
+ */
+class CodeWriter {
+public:
+    CodeWriter(const GenMachine& m, const std::string& source,
+               const std::string& headerName)
+    : m_(m), source_(source), headerName_(headerName)
+    {
+        size_t i;
+
+        for (i = 1; i < m_.states.size(); ++i) {
+            layout_.push_back((unsigned int)i);
+        }
+        std::stable_sort(layout_.begin(), layout_.end(), IsHotter(m_));
+    }
+
+    std::string Header() const;
+    std::string Source() const;
+
+private:
+    std::string Sig(unsigned int event) const
+    {
+        return "k" + m_.name + "Sig_" + m_.events[event];
+    }
+
+    std::string StateId(unsigned int id) const
+    {
+        return "k" + m_.name + "State_" + m_.states[id].name;
+    }
+
+    std::string State(unsigned int id) const
+    {
+        return "GEN_STATE(" + StateId(id) + ")";
+    }
+
+    unsigned int Anchor(unsigned int mainSrc, unsigned int target) const;
+    bool IsSubscribed(unsigned int id, int event) const;
+    void WriteEventCase(std::ostringstream& out, unsigned int current,
+                        int event) const;
+    void WriteTransition(std::ostringstream& out, unsigned int current,
+                         unsigned int mainSrc,
+                         const GenTransition& tran) const;
+    void WriteEntryPath(std::ostringstream& out, unsigned int anchor,
+                        unsigned int target) const;
+
+    /// Orders state ids by decreasing use
+    struct IsHotter {
+        explicit IsHotter(const GenMachine& m)
+        : m_(m)
+        {
+        }
+
+        bool operator()(unsigned int id1, unsigned int id2) const
+        {
+            return m_.states[id1].use > m_.states[id2].use;
+        }
+
+        const GenMachine& m_;
+    };
+
+    const GenMachine&           m_;
+    std::string                 source_;        ///< statechart file name
+    std::string                 headerName_;    ///< generated header's name
+
+    /// The user states' ids in the order that their code is laid out:
+    /// hottest first, else in pre-order
+    std::vector<unsigned int>   layout_;
+};
+
+
+/**
+ * Returns the transition anchor, as FindTransitionAnchor() in
+ * Fsm.c does
+ */
+unsigned int
+CodeWriter::Anchor(unsigned int mainSrc, unsigned int target) const
+{
+    unsigned int a = m_.states[mainSrc].parent;
+    unsigned int b = target;
+
+    /// Peer Source/Target states (including Main Source == Target)
+    if (m_.states[mainSrc].parent == m_.states[target].parent) {
+        return m_.states[mainSrc].parent;
+    }
+
+    /// Local Transition: Target is a descendant of Main Source
+    if (target > mainSrc && target <= m_.states[mainSrc].lastId) {
+        return mainSrc;
+    }
+
+    /// The deepest common ancestor of Main Source's parent and Target
+    while (m_.states[a].depth > m_.states[b].depth) {
+        a = m_.states[a].parent;
+    }
+    while (m_.states[b].depth > m_.states[a].depth) {
+        b = m_.states[b].parent;
+    }
+    while (a != b) {
+        a = m_.states[a].parent;
+        b = m_.states[b].parent;
+    }
+
+    return a;
+}
+
+
+/**
+ * Checks whether the state's handler receives the given event; a
+ * negative event stands for the events that the statechart doesn't
+ * name in the state's subscription set
+ */
+bool
+CodeWriter::IsSubscribed(unsigned int id, int event) const
+{
+    const GenState& state = m_.states[id];
+
+    return !state.hasEventSet ||
+           (event >= 0 && std::binary_search(state.eventSet.begin(),
+                                             state.eventSet.end(),
+                                             (unsigned int)event));
+}
+
+
+/**
+ * Writes the entry handler calls from (but not including) the
+ * anchor down to the target, as RecordEntryPath() records them
+ */
+void
+CodeWriter::WriteEntryPath(std::ostringstream& out, unsigned int anchor,
+                           unsigned int target) const
+{
+    std::vector<unsigned int>   path;
+    unsigned int                id;
+
+    for (id = target; id != anchor; id = m_.states[id].parent) {
+        if (!(m_.states[id].flags & kGenFlagNoEntry)) {
+            path.push_back(id);
+        }
+    }
+
+    while (!path.empty()) {
+        id = path.back();
+        path.pop_back();
+        out << "                (void)" << m_.states[id].handler << "("
+            << State(id) << ", pFsm, &kGenEntryEvt);\n";
+    }
+}
+
+
+/**
+ * Writes the code of a declarative transition from Main Source,
+ * with the given current state: the steps of FsmBeginTransition()
+ * and DoEntryActions() in Fsm.c, with the exit and entry paths
+ * resolved
+ */
+void
+CodeWriter::WriteTransition(std::ostringstream& out, unsigned int current,
+                            unsigned int mainSrc,
+                            const GenTransition& tran) const
+{
+    unsigned int anchor = Anchor(mainSrc, tran.target);
+    unsigned int target = tran.target;
+    unsigned int id;
+
+    out << "                /// " << m_.states[mainSrc].name << " --"
+        << m_.events[tran.event] << "--> " << m_.states[target].name << "\n"
+        << "                pRt->pTranTarget = " << State(target) << ";\n"
+        << "                pRt->pCurrentState = NULL;\n";
+
+    for (id = current; m_.states[id].depth > m_.states[anchor].depth;
+         id = m_.states[id].parent) {
+        if (!(m_.states[id].flags & kGenFlagNoExit)) {
+            out << "                (void)" << m_.states[id].handler << "("
+                << State(id) << ", pFsm, &kGenExitEvt);\n";
+        }
+    }
+
+    out << "                pRt->pEntryAnchor = "
+        << (anchor ? State(anchor) : "GEN_STATE(0)") << ";\n";
+
+    if (!tran.action.empty()) {
+        out << "                " << tran.action << "(" << State(mainSrc)
+            << ", pFsm, pEvt);\n";
+    }
+
+    out << "                pRt->pDispatchSrcState = NULL;\n";
+
+    WriteEntryPath(out, anchor, target);
+
+    /// Drill down the declared initial substates in one step
+    if (m_.states[target].initial) {
+        unsigned int initial = m_.states[target].initial;
+
+        out << "                pRt->pTranTarget = " << State(initial) << ";\n"
+            << "                pRt->pEntryAnchor = " << State(target)
+            << ";\n";
+        WriteEntryPath(out, target, initial);
+        target = initial;
+    }
+
+    if (m_.states[target].flags & kGenFlagNoBegin) {
+        out << "                pRt->pTranTarget = NULL;\n"
+            << "                pRt->pEntryAnchor = NULL;\n"
+            << "                pRt->pCurrentState = " << State(target)
+            << ";\n";
+    }
+    else {
+        /// kFsmEventBegin may request another transition
+        out << "                pRt->pEntryAnchor = " << State(target) << ";\n"
+            << "                (void)FsmGenCompleteDispatch(pFsm, pEvt, 1);\n";
+    }
+
+    out << "                return 1;\n";
+}
+
+
+/**
+ * Writes the dispatch of the given event in the given current
+ * state, as FsmDispatchEvent() walks it; a negative event stands
+ * for the events that no subscription set or transition of the
+ * state's configuration names
+ */
+void
+CodeWriter::WriteEventCase(std::ostringstream& out, unsigned int current,
+                           int event) const
+{
+    unsigned int    lastSrc = 0;
+    unsigned int    id;
+    size_t          i;
+
+    for (id = current; id; id = m_.states[id].parent) {
+        const GenState& state = m_.states[id];
+        bool            isTaken = false;
+
+        for (i = 0; i < state.transitions.size() && !isTaken; ++i) {
+            const GenTransition& tran = state.transitions[i];
+
+            if ((int)tran.event != event) {
+                continue;
+            }
+
+            if (lastSrc != id) {
+                out << "            pRt->pDispatchSrcState = " << State(id)
+                    << ";\n";
+                lastSrc = id;
+            }
+
+            if (tran.guard.empty()) {
+                out << "            {\n";
+                isTaken = true;
+            }
+            else {
+                out << "            if (" << tran.guard << "(" << State(id)
+                    << ", pFsm, pEvt)) {\n";
+            }
+            WriteTransition(out, current, id, tran);
+            out << "            }\n";
+        }
+
+        /// An unguarded transition ends the walk
+        if (isTaken) {
+            return;
+        }
+
+        if (IsSubscribed(id, event)) {
+            if (lastSrc != id) {
+                out << "            pRt->pDispatchSrcState = " << State(id)
+                    << ";\n";
+                lastSrc = id;
+            }
+            out << "            isHandled = " << state.handler << "("
+                << State(id) << ", pFsm, pEvt);\n"
+                << "            if (GenEndDelivery(pFsm, pEvt, isHandled)) {\n"
+                << "                return 1;\n"
+                << "            }\n";
+        }
+    }
+
+    if (lastSrc) {
+        out << "            pRt->pDispatchSrcState = NULL;\n";
+    }
+    out << "            return 0;\n";
+}
+
+
+std::string
+CodeWriter::Header() const
+{
+    std::ostringstream          out;
+    std::vector<std::string>    handlers;
+    std::vector<std::string>    guards;
+    std::vector<std::string>    actions;
+    std::string                 guardName = m_.name + "_FSM_GEN_H";
+    size_t                      i;
+    size_t                      j;
+
+    for (i = 1; i < m_.states.size(); ++i) {
+        handlers.push_back(m_.states[i].handler);
+        for (j = 0; j < m_.states[i].transitions.size(); ++j) {
+            const GenTransition& tran = m_.states[i].transitions[j];
+
+            if (!tran.guard.empty()) {
+                guards.push_back(tran.guard);
+            }
+            if (!tran.action.empty()) {
+                actions.push_back(tran.action);
+            }
+        }
+    }
+    std::sort(handlers.begin(), handlers.end());
+    handlers.erase(std::unique(handlers.begin(), handlers.end()),
+                   handlers.end());
+    std::sort(guards.begin(), guards.end());
+    guards.erase(std::unique(guards.begin(), guards.end()), guards.end());
+    std::sort(actions.begin(), actions.end());
+    actions.erase(std::unique(actions.begin(), actions.end()), actions.end());
+
+    for (i = 0; i < guardName.size(); ++i) {
+        guardName[i] = (char)toupper((unsigned char)guardName[i]);
+    }
+
+    out << "/* Generated by fsmgen from " << source_ << "; DO NOT EDIT */\n\n"
+        << "#ifndef " << guardName << "\n"
+        << "#define " << guardName << "\n\n"
+        << "#include <PmStateMachineEngine/PalmFsm.h>\n\n"
+        << "#ifdef __cplusplus\n"
+        << "extern \"C\" {\n"
+        << "#endif\n\n";
+
+    out << "enum " << m_.name << "Signals {\n";
+    for (i = 0; i < m_.events.size(); ++i) {
+        out << "    " << Sig((unsigned int)i)
+            << (i ? "" : " = kFsmEventFirstUserEvent")
+            << (i + 1 < m_.events.size() ? ",\n" : "\n");
+    }
+    out << "};\n\n";
+
+    out << "enum " << m_.name << "States {\n";
+    for (i = 1; i < m_.states.size(); ++i) {
+        out << "    " << StateId((unsigned int)i) << " = " << i << ",\n";
+    }
+    out << "    k" << m_.name << "NumStates = " << m_.states.size() - 1
+        << "\n};\n\n";
+
+    out << "typedef FSM_CONST_TOPOLOGY(" << m_.states.size() - 1 << ") "
+        << m_.name << "Topology;\n\n"
+        << "/// The user state objects are FSM_CONST_USER_STATE(k" << m_.name
+        << "Topology, id)\n"
+        << "extern const " << m_.name << "Topology k" << m_.name
+        << "Topology;\n\n";
+
+    out << "/// Implemented by the user\n";
+    for (i = 0; i < handlers.size(); ++i) {
+        out << "FsmStateHandlerFnType " << handlers[i] << ";\n";
+    }
+    for (i = 0; i < guards.size(); ++i) {
+        out << "FsmTransitionGuardFnType " << guards[i] << ";\n";
+    }
+    for (i = 0; i < actions.size(); ++i) {
+        out << "FsmTransitionActionFnType " << actions[i] << ";\n";
+    }
+    out << "\n";
+
+    out << "/// Initializes the given definition from k" << m_.name
+        << "Topology\n"
+        << "void\n" << m_.name << "InitDefinition(FsmDefinition* pDef);\n\n"
+        << "/// FsmDispatchEvent() for the instances of " << m_.name
+        << "InitDefinition()'s\n"
+        << "/// definitions\n"
+        << "int\n" << m_.name
+        << "DispatchEvent(FsmMachine* pFsm, const FsmEvent* pEvt);\n\n"
+        << "#ifdef __cplusplus\n"
+        << "}\n"
+        << "#endif\n\n"
+        << "#endif // " << guardName << "\n";
+
+    return out.str();
+}
+
+
+std::string
+CodeWriter::Source() const
+{
+    std::ostringstream  out;
+    std::string         topology = "k" + m_.name + "Topology";
+    size_t              i;
+    size_t              j;
+    int                 event;
+
+    out << "/* Generated by fsmgen from " << source_ << "; DO NOT EDIT */\n\n"
+        << "#include <stddef.h>\n\n"
+        << "#include <PmStateMachineEngine/PalmFsmGen.h>\n\n"
+        << "#include \"" << headerName_ << "\"\n\n"
+        << "#define GEN_STATE(id__) FSM_CONST_USER_STATE(" << topology
+        << ", id__)\n\n";
+
+    /// Subscription sets and transition tables
+    for (i = 0; i < layout_.size(); ++i) {
+        const GenState& state = m_.states[layout_[i]];
+
+        if (state.hasEventSet) {
+            out << "static const FsmEventIdType k" << m_.name << "Events_"
+                << state.name << "[] = {";
+            for (j = 0; j < state.eventSet.size(); ++j) {
+                out << (j ? ", " : "") << Sig(state.eventSet[j]);
+            }
+            out << (state.eventSet.empty() ? "0" : "") << "};\n\n";
+        }
+
+        if (!state.transitions.empty()) {
+            out << "static const FsmTransitionDef k" << m_.name
+                << "Transitions_" << state.name << "[] = {\n";
+            for (j = 0; j < state.transitions.size(); ++j) {
+                const GenTransition& tran = state.transitions[j];
+
+                out << "    {" << Sig(tran.event) << ", "
+                    << State(tran.target) << ", "
+                    << (tran.guard.empty() ? "NULL" : "&" + tran.guard) << ", "
+                    << (tran.action.empty() ? "NULL" : "&" + tran.action)
+                    << (j + 1 < state.transitions.size() ? "},\n" : "}\n");
+            }
+            out << "};\n\n";
+        }
+    }
+
+    /// The topology
+    out << "const " << m_.name << "Topology " << topology << " = {\n"
+        << "    {\n"
+        << "        FSM_CONST_ROOT_STATE(" << topology << ")";
+    for (i = 1; i < m_.states.size(); ++i) {
+        const GenState& state = m_.states[i];
+        std::string     flags;
+
+        out << ",\n";
+        if (!state.flags && state.walkParent == state.parent &&
+            !state.initial && !state.hasEventSet &&
+            state.transitions.empty()) {
+            out << "        FSM_CONST_STATE(" << topology << ", "
+                << StateId((unsigned int)i) << ",\n"
+                << "                        &" << state.handler << ", "
+                << state.parent << ", " << state.depth << ", "
+                << state.lastId << ")";
+            continue;
+        }
+
+        if (state.flags & kGenFlagNoEntry) {
+            flags += " | kFsmStateFlagNoEntry";
+        }
+        if (state.flags & kGenFlagNoExit) {
+            flags += " | kFsmStateFlagNoExit";
+        }
+        if (state.flags & kGenFlagNoBegin) {
+            flags += " | kFsmStateFlagNoBegin";
+        }
+
+        out << "        FSM_CONST_STATE_EX(" << topology << ", "
+            << StateId((unsigned int)i) << ",\n"
+            << "                           &" << state.handler << ", "
+            << state.parent << ", " << state.walkParent << ", "
+            << state.depth << ", " << state.lastId << ",\n"
+            << "                           "
+            << (flags.empty() ? "0" : flags.substr(3)) << ", "
+            << state.initial << ",\n"
+            << "                           ";
+        if (state.hasEventSet) {
+            out << "k" << m_.name << "Events_" << state.name << ", "
+                << state.eventSet.size() << ", ";
+        }
+        else {
+            out << "NULL, 0, ";
+        }
+        if (!state.transitions.empty()) {
+            out << "k" << m_.name << "Transitions_" << state.name << ", "
+                << state.transitions.size() << ")";
+        }
+        else {
+            out << "NULL, 0)";
+        }
+    }
+    out << "\n    },\n    {\n";
+    for (i = 0; i < m_.states.size(); ++i) {
+        out << "        \"" << (i ? m_.states[i].name : m_.name) << "\""
+            << (i + 1 < m_.states.size() ? ",\n" : "\n");
+    }
+    out << "    }\n};\n\n\n";
+
+    out << "void\n" << m_.name << "InitDefinition(FsmDefinition* pDef)\n"
+        << "{\n"
+        << "    FSM_INIT_CONST_DEFINITION(pDef, " << topology << ");\n"
+        << "}\n\n\n";
+
+    out << "static const FsmEvent kGenEntryEvt = {kFsmEventEnterScope};\n"
+        << "static const FsmEvent kGenExitEvt = {kFsmEventExitScope};\n\n"
+        << "/**\n"
+        << " * Ends the delivery of a user event to a state handler; returns\n"
+        << " * true if the event was handled\n"
+        << " */\n"
+        << "static int\n"
+        << "GenEndDelivery(FsmMachine* pFsm, const FsmEvent* pEvt, "
+        << "int isHandled)\n"
+        << "{\n"
+        << "    FsmGenRuntime* pRt = FSM_GEN_RUNTIME(pFsm);\n\n"
+        << "    if (!pRt->pTranTarget) {\n"
+        << "        if (isHandled) {\n"
+        << "            pRt->pDispatchSrcState = NULL;\n"
+        << "        }\n"
+        << "        return isHandled;\n"
+        << "    }\n\n"
+        << "    return FsmGenCompleteDispatch(pFsm, pEvt, isHandled);\n"
+        << "}\n\n\n";
+
+    out << "int\n" << m_.name
+        << "DispatchEvent(FsmMachine* pFsm, const FsmEvent* pEvt)\n"
+        << "{\n"
+        << "    FsmGenRuntime*  pRt = FSM_GEN_RUNTIME(pFsm);\n"
+        << "    unsigned int    current;\n"
+        << "    int             isHandled;\n\n"
+        << "    /// Let SME report API violations\n"
+        << "    if (!pRt->pCurrentState || pRt->pDispatchSrcState ||\n"
+        << "        pEvt->evtId < kFsmEventFirstUserEvent) {\n"
+        << "        return FsmDispatchEvent(pFsm, pEvt);\n"
+        << "    }\n\n"
+        << "    current = (unsigned int)((const FsmConstState*)"
+        << "pRt->pCurrentState -\n"
+        << "                             " << topology << ".aStates_);\n\n"
+        << "    switch (current) {\n";
+
+    for (i = 0; i < layout_.size(); ++i) {
+        std::ostringstream  defaultCase;
+        std::vector<bool>   isNamed(m_.events.size(), false);
+        unsigned int        current = layout_[i];
+        unsigned int        id;
+
+        /// The events that the state's configuration names
+        for (id = current; id; id = m_.states[id].parent) {
+            for (j = 0; j < m_.states[id].eventSet.size(); ++j) {
+                isNamed[m_.states[id].eventSet[j]] = true;
+            }
+            for (j = 0; j < m_.states[id].transitions.size(); ++j) {
+                isNamed[m_.states[id].transitions[j].event] = true;
+            }
+        }
+
+        WriteEventCase(defaultCase, current, -1);
+
+        out << "    case " << StateId(current) << ":\n"
+            << "        switch (pEvt->evtId) {\n";
+        for (event = 0; event < (int)m_.events.size(); ++event) {
+            std::ostringstream eventCase;
+
+            if (!isNamed[event]) {
+                continue;
+            }
+
+            WriteEventCase(eventCase, current, event);
+            if (eventCase.str() != defaultCase.str()) {
+                out << "        case " << Sig((unsigned int)event) << ":\n"
+                    << eventCase.str();
+            }
+        }
+        out << "        default:\n" << defaultCase.str()
+            << "        }\n\n";
+    }
+
+    out << "    default:\n"
+        << "        /// Not an instance of " << topology << "\n"
+        << "        return FsmDispatchEvent(pFsm, pEvt);\n"
+        << "    }\n"
+        << "}\n";
+
+    return out.str();
+}
+
+
+bool
+WriteFile(const std::string& path, const std::string& contents)
+{
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+
+    file << contents;
+    file.close();
+
+    if (!file) {
+        fprintf(stderr, "fsmgen: can't write %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+} // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    std::ostringstream  text;
+    JsonValue           doc;
+    GenMachine          m;
+    std::string         source;
+    std::string         base;
+    std::string         headerName;
+
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: fsmgen <statechart.json> <output-base> "
+                "[<profile>]\n");
+        return 2;
+    }
+
+    source = argv[1];
+    base = argv[2];
+    headerName = base.substr(base.find_last_of('/') + 1) + ".h";
+
+    {
+        std::ifstream file(argv[1], std::ios::in | std::ios::binary);
+
+        if (!file) {
+            fprintf(stderr, "fsmgen: can't read %s\n", argv[1]);
+            return 1;
+        }
+        text << file.rdbuf();
+    }
+
+    try {
+        std::string contents = text.str();
+
+        JsonParser(contents).Parse(&doc);
+        ReadMachine(&m, doc);
+    }
+    catch (const GenError& error) {
+        fprintf(stderr, "%s:%d: error: %s\n", argv[1], error.line,
+                error.msg.c_str());
+        return 1;
+    }
+
+    if (4 == argc) {
+        std::ifstream       file(argv[3], std::ios::in | std::ios::binary);
+        std::ostringstream  profile;
+
+        if (!file) {
+            fprintf(stderr, "fsmgen: can't read %s\n", argv[3]);
+            return 1;
+        }
+        profile << file.rdbuf();
+        ReadProfile(&m, profile.str());
+    }
+
+    source = source.substr(source.find_last_of('/') + 1);
+
+    {
+        CodeWriter writer(m, source, headerName);
+
+        if (!WriteFile(base + ".h", writer.Header()) ||
+            !WriteFile(base + ".c", writer.Source())) {
+            return 1;
+        }
+    }
+
+    return 0;
+}